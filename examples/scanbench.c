@@ -0,0 +1,183 @@
+/* GNU Mailutils -- a suite of utilities for electronic mail
+   Copyright (C) 2022 Free Software Foundation, Inc.
+
+   GNU Mailutils is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   GNU Mailutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Mailutils.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Microbenchmark for the mailbox scanners.
+
+   Usage: scanbench [-n COUNT] MBOX
+
+   Scans MBOX COUNT times using the stream (line-by-line) scanner and
+   the same number of times using the memory-mapped one, and reports the
+   best wall-clock time for each of them.  Each scan is run in a separate
+   subprocess, so that the choice of scanner (which is cached on first
+   use) can be changed between the runs.  Applies to mbox and dotmail
+   mailboxes. */
+
+#include <config.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <mailutils/mailutils.h>
+
+static int repeat = 5;
+
+static struct mu_option scanbench_options[] = {
+  { "count", 'n', "N", MU_OPTION_DEFAULT,
+    "repeat each scan N times",
+    mu_c_int, &repeat },
+  MU_OPTION_END
+}, *options[] = { scanbench_options, NULL };
+
+struct mu_cli_setup cli = {
+  options,
+  NULL,
+  "compare performance of mailbox scanners",
+  "MBOX"
+};
+
+static char *capa[] = {
+  "debug",
+  NULL
+};
+
+struct scan_result
+{
+  int rc;
+  size_t count;
+  double elapsed;
+};
+
+static void
+scan_child (char const *name, char const *scanner, int fd)
+{
+  struct scan_result res;
+  mu_mailbox_t mbox;
+  struct timeval start, stop;
+
+  setenv ("MU_MBOXRD_SCANNER", scanner, 1);
+  setenv ("MU_DOTMAIL_SCANNER", scanner, 1);
+
+  memset (&res, 0, sizeof res);
+  res.rc = mu_mailbox_create_default (&mbox, name);
+  if (res.rc == 0)
+    {
+      res.rc = mu_mailbox_open (mbox, MU_STREAM_READ);
+      if (res.rc == 0)
+	{
+	  gettimeofday (&start, NULL);
+	  res.rc = mu_mailbox_messages_count (mbox, &res.count);
+	  gettimeofday (&stop, NULL);
+	  res.elapsed = (stop.tv_sec - start.tv_sec)
+	                 + (stop.tv_usec - start.tv_usec) / 1e6;
+	  mu_mailbox_close (mbox);
+	}
+      mu_mailbox_destroy (&mbox);
+    }
+  write (fd, &res, sizeof res);
+  _exit (0);
+}
+
+static int
+scan (char const *name, char const *scanner, struct scan_result *res)
+{
+  int p[2];
+  pid_t pid;
+  ssize_t n;
+
+  if (pipe (p))
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "pipe", NULL, errno);
+      return -1;
+    }
+  pid = fork ();
+  if (pid == -1)
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "fork", NULL, errno);
+      return -1;
+    }
+  if (pid == 0)
+    {
+      close (p[0]);
+      scan_child (name, scanner, p[1]);
+    }
+  close (p[1]);
+  n = read (p[0], res, sizeof *res);
+  close (p[0]);
+  waitpid (pid, NULL, 0);
+  if (n != sizeof *res)
+    {
+      mu_error ("%s: scanner process failed", scanner);
+      return -1;
+    }
+  if (res->rc)
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "mu_mailbox_messages_count",
+		       name, res->rc);
+      return -1;
+    }
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  static char *scanners[] = { "stream", "mapped" };
+  double best[2];
+  size_t count[2];
+  char *name;
+  int i, j;
+
+  mu_register_all_mbox_formats ();
+
+  mu_cli (argc, argv, &cli, capa, NULL, &argc, &argv);
+
+  if (argc != 1)
+    {
+      mu_error ("wrong number of arguments");
+      return 1;
+    }
+  if (repeat <= 0)
+    {
+      mu_error ("invalid repeat count");
+      return 1;
+    }
+  name = argv[0];
+
+  for (i = 0; i < 2; i++)
+    {
+      for (j = 0; j < repeat; j++)
+	{
+	  struct scan_result res;
+
+	  if (scan (name, scanners[i], &res))
+	    return 1;
+	  if (j == 0 || res.elapsed < best[i])
+	    best[i] = res.elapsed;
+	  count[i] = res.count;
+	}
+      mu_printf ("%-8s %lu messages, %.6f s\n", scanners[i],
+		 (unsigned long) count[i], best[i]);
+    }
+
+  if (count[0] != count[1])
+    {
+      mu_error ("message counts differ");
+      return 1;
+    }
+  if (best[1] > 0)
+    mu_printf ("speedup  %.2f\n", best[0] / best[1]);
+  return 0;
+}
@@ -51,6 +51,9 @@ imap4d_capability_init ()
     "IDLE",
     "LITERAL+",
     "UNSELECT",
+    "ENABLE",
+    "CONDSTORE",
+    "QRESYNC",
     NULL
   };
   int i;
@@ -78,6 +81,7 @@ imap4d_capability (struct imap4d_session *session,
   mu_list_foreach (capa_list, print_capa, NULL);
   
   imap4d_auth_capability (session);
+  imap4d_compress_capability ();
   io_sendf ("\n");
 
   return io_completion_response (command, RESP_OK, "Completed");
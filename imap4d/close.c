@@ -29,6 +29,8 @@ imap4d_close0 (struct imap4d_command *command, imap4d_tokbuf_t tok,
   mu_mailbox_get_flags (mbox, &flags);
   if (flags & MU_STREAM_WRITE)
     {
+      mu_off_t size = expunge ? quota_mailbox_size (mbox) : -1;
+      
       silent_expunge = expunge;
       imap4d_enter_critical ();
       status = mu_mailbox_flush (mbox, expunge);
@@ -39,6 +41,8 @@ imap4d_close0 (struct imap4d_command *command, imap4d_tokbuf_t tok,
 	  mu_diag_funcall (MU_DIAG_ERROR, "mu_mailbox_flush", NULL, status);
 	  msg = "flushing mailbox failed";
 	}
+      else
+	quota_mailbox_update (mbox, size);
     }
   
   /* No messages are removed, and no error is given, if the mailbox is
@@ -45,7 +45,11 @@ struct imap4d_command imap4d_command_table [] =
   { "UID", imap4d_uid, STATE_SEL, STATE_NONE, STATE_NONE, NULL },
   { "NAMESPACE", imap4d_namespace, STATE_AUTH | STATE_SEL, STATE_NONE, STATE_NONE, NULL },
   { "ID", imap4d_id, STATE_AUTH | STATE_SEL, STATE_NONE, STATE_NONE, NULL },
+  { "ENABLE", imap4d_enable, STATE_AUTH, STATE_NONE, STATE_NONE, NULL },
   { "IDLE", imap4d_idle, STATE_SEL, STATE_NONE, STATE_NONE, NULL },
   { "STARTTLS", imap4d_starttls, STATE_NONAUTH, STATE_NONE, STATE_NONE, NULL },
+#ifdef HAVE_LIBZ
+  { "COMPRESS", imap4d_compress, STATE_AUTH | STATE_SEL, STATE_NONE, STATE_NONE, NULL },
+#endif
   { NULL, 0, 0, 0, 0, NULL }
 };
@@ -0,0 +1,75 @@
+/* GNU Mailutils -- a suite of utilities for electronic mail
+   Copyright (C) 2022 Free Software Foundation, Inc.
+
+   GNU Mailutils is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   GNU Mailutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Mailutils.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Implementation of COMPRESS extension (RFC 4978) */
+
+#include "imap4d.h"
+
+static int compression_active;
+
+/* Advertise the COMPRESS capability.  The command is valid only in the
+   authenticated state, so it is not shown before authentication. */
+void
+imap4d_compress_capability (void)
+{
+#ifdef HAVE_LIBZ
+  if (state != STATE_NONAUTH)
+    io_sendf (" COMPRESS=DEFLATE");
+#endif
+}
+
+/*
+3.  The COMPRESS Command
+
+   Arguments: Name of compression mechanism: "DEFLATE".
+
+   Responses: None
+
+   Result:    OK The server will compress its responses and expects the
+                 client to compress its commands.
+              NO Compression is already active.
+              BAD Unknown compression mechanism.
+*/
+
+int
+imap4d_compress (struct imap4d_session *session,
+		 struct imap4d_command *command, imap4d_tokbuf_t tok)
+{
+  int status;
+  int rc;
+
+  if (imap4d_tokbuf_argc (tok) != 3)
+    return io_completion_response (command, RESP_BAD, "Invalid arguments");
+  if (mu_c_strcasecmp (imap4d_tokbuf_getarg (tok, IMAP4_ARG_1), "DEFLATE"))
+    return io_completion_response (command, RESP_BAD,
+				   "Unknown compression mechanism");
+  if (compression_active)
+    return io_completion_response (command, RESP_NO,
+				   "[COMPRESSIONACTIVE] DEFLATE active");
+
+  status = io_completion_response (command, RESP_OK, "DEFLATE active");
+  rc = io_start_compression ();
+  if (rc)
+    {
+      /* The client will send compressed data from now on. */
+      mu_diag_funcall (MU_DIAG_ERROR, "io_start_compression", NULL, rc);
+      mu_diag_output (MU_DIAG_ERROR, _("session terminated"));
+      util_bye ();
+      exit (EX_OK);
+    }
+  compression_active = 1;
+  return status;
+}
@@ -0,0 +1,70 @@
+/* GNU Mailutils -- a suite of utilities for electronic mail
+   Copyright (C) 2022 Free Software Foundation, Inc.
+
+   GNU Mailutils is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   GNU Mailutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Mailutils.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Implementation of ENABLE extension (RFC 5161) */
+
+#include "imap4d.h"
+
+/*
+3.1.  The ENABLE Command
+
+   Arguments: capability names
+
+   Result:    OK: Relevant capabilities enabled
+              BAD: No arguments, or syntax error in an argument
+
+      The ENABLE command takes a list of capability names, and requests
+      the server to enable the named extensions.  Once enabled using
+      ENABLE, each extension remains active until the IMAP connection
+      is closed.
+*/
+
+int
+imap4d_enable (struct imap4d_session *session,
+               struct imap4d_command *command, imap4d_tokbuf_t tok)
+{
+  int argc = imap4d_tokbuf_argc (tok);
+  int i;
+  int condstore = 0, qresync = 0;
+
+  if (argc < 3)
+    return io_completion_response (command, RESP_BAD, "Invalid arguments");
+
+  /* Unknown capabilities are ignored. */
+  for (i = IMAP4_ARG_1; i < argc; i++)
+    {
+      char *arg = imap4d_tokbuf_getarg (tok, i);
+      if (mu_c_strcasecmp (arg, "CONDSTORE") == 0)
+	condstore = 1;
+      else if (mu_c_strcasecmp (arg, "QRESYNC") == 0)
+	qresync = 1;
+    }
+
+  io_sendf ("* ENABLED");
+  if (condstore && !condstore_enabled)
+    io_sendf (" CONDSTORE");
+  if (qresync && !qresync_enabled)
+    io_sendf (" QRESYNC");
+  io_sendf ("\n");
+
+  /* QRESYNC implies CONDSTORE. */
+  if (condstore || qresync)
+    imap4d_condstore_enable ();
+  if (qresync)
+    qresync_enabled = 1;
+
+  return io_completion_response (command, RESP_OK, "Completed");
+}
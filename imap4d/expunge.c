@@ -33,13 +33,17 @@ int
 imap4d_expunge (struct imap4d_session *session,
                 struct imap4d_command *command, imap4d_tokbuf_t tok)
 {
+  mu_off_t size;
+  
   if (imap4d_tokbuf_argc (tok) != 2)
     return io_completion_response (command, RESP_BAD, "Invalid arguments");
 
+  size = quota_mailbox_size (mbox);
   imap4d_enter_critical ();
   /* FIXME: check for errors.  */
   mu_mailbox_expunge (mbox);
   imap4d_leave_critical ();
+  quota_mailbox_update (mbox, size);
   
   imap4d_sync_invalidate ();
   imap4d_sync ();
@@ -38,6 +38,8 @@ struct fetch_runtime_closure
   char *err_text;      /* On return: error description if failed. */
 
   mu_list_t fnlist;
+  int changedsince_set;  /* CHANGEDSINCE modifier was given */
+  modseq_t changedsince; /* Its value */
 };
 
 struct fetch_function_closure;
@@ -64,6 +66,11 @@ struct fetch_parse_closure
   int isuid;
   mu_list_t fnlist;
   mu_msgset_t msgset;
+  char *setstr;          /* Message set as given in the command */
+  int modseq;            /* MODSEQ is requested */
+  int changedsince_set;  /* CHANGEDSINCE modifier was given */
+  modseq_t changedsince; /* Its value */
+  int vanished;          /* VANISHED modifier was given */
 };
 
 
@@ -241,7 +248,7 @@ fetch_envelope0 (mu_message_t msg)
   char *from = NULL;
   mu_header_t header = NULL;
 
-  mu_message_get_header (msg, &header);
+  imap4d_message_header (msg, NULL, &header);
 
   fetch_send_header_value (header, "Date", NULL, 0);
   fetch_send_header_value (header, "Subject", NULL, 1);
@@ -711,97 +718,48 @@ fetch_send_section_part (struct fetch_function_closure *ffc,
     io_sendf ("]");
 }
 
+/* Send SIZE bytes of STREAM, starting at offset START, as a literal.
+   START and SIZE refer to the CRLF-expanded data, MAX is the expanded
+   size of the stream.  START == 0 and SIZE == (size_t) -1 mean the
+   whole stream. */
 static int
 fetch_io (mu_stream_t stream, size_t start, size_t size, size_t max)
 {
-  if (start == 0 && size == (size_t) -1)
-    {
-      int rc;
-      
-      rc = mu_stream_seek (stream, 0, MU_SEEK_SET, NULL);
-      if (rc)
-	{
-	  mu_error ("seek error: %s", mu_stream_strerror (stream, rc));
-	  return RESP_BAD;
-	}
-      if (max)
-	{
-	  io_sendf (" {%lu}\n", (unsigned long) max);
-	  io_copy_out (stream, max);
-	  /* FIXME: Make sure exactly max bytes were sent */
-	}
-      else
-	io_sendf (" \"\"");
-    }
+  int partial = !(start == 0 && size == (size_t) -1);
+  int rc;
+
+  if (!partial)
+    size = max;
   else if (start > max)
+    size = 0;
+  else if (size > max - start)
+    size = max - start;
+
+  rc = mu_stream_seek (stream, 0, MU_SEEK_SET, NULL);
+  if (rc)
     {
-      io_sendf ("<%lu>", (unsigned long) start);
-      io_sendf (" \"\"");
+      mu_error ("seek error: %s", mu_stream_strerror (stream, rc));
+      return RESP_BAD;
     }
+
+  if (partial)
+    io_sendf ("<%lu>", (unsigned long) start);
+  if (size == 0)
+    io_sendf (" \"\"");
   else
     {
-      mu_stream_t rfc = NULL;
-      int rc;
-      char *buffer, *p;
-      size_t total = 0;
-      size_t n = 0;
-      
-      if (size > max)
-	size = max;
-      if (size + 2 < size) /* Check for integer overflow */
-	{
-	  mu_stream_destroy (&rfc);
-	  return RESP_BAD;
-	}
-      
-      mu_filter_create (&rfc, stream, "CRLF", MU_FILTER_ENCODE,
-			MU_STREAM_READ|MU_STREAM_SEEK);
-  
-      p = buffer = mu_alloc (size + 1);
-
-      rc = mu_stream_seek (rfc, start, MU_SEEK_SET, NULL);
+      io_sendf (" {%lu}\n", (unsigned long) size);
+      rc = io_copy_crlf (stream, start, size);
       if (rc)
 	{
-	  mu_error ("seek error: %s", mu_stream_strerror (rfc, rc));
-	  free (buffer);
-	  mu_stream_destroy (&rfc);
+	  mu_error ("error sending message data: %s", mu_strerror (rc));
 	  return RESP_BAD;
 	}
-
-      while (total < size
-	     && (rc = mu_stream_read (rfc, p, size - total, &n)) == 0
-	     && n > 0)
-	{
-	  total += n;
-	  p += n;
-	}
-
-      if (rc)
-	{
-	  mu_error ("read error: %s", mu_stream_strerror (rfc, rc));	  
-	  free (buffer);
-	  mu_stream_destroy (&rfc);
-	  return RESP_BAD;
-	}
-	  
-      *p = 0;
-      io_sendf ("<%lu>", (unsigned long) start);
-      if (total)
-	{
-	  io_sendf (" {%lu}\n", (unsigned long) total);
-	  io_enable_crlf (0);
-	  io_send_bytes (buffer, total);
-	  io_enable_crlf (1);
-	}
-      else
-	io_sendf (" \"\"");
-      free (buffer);
-      mu_stream_destroy (&rfc);
     }
   return RESP_OK;
 }
 
-
+
 /* Runtime functions */
 static int
 _frt_uid (struct fetch_function_closure *ffc,
@@ -814,6 +772,15 @@ _frt_uid (struct fetch_function_closure *ffc,
   return RESP_OK;
 }
 
+static int
+_frt_modseq (struct fetch_function_closure *ffc,
+	     struct fetch_runtime_closure *frt)
+{
+  io_sendf ("%s (%llu)", ffc->name,
+	    modseq_log_get (selected_modseq, frt->msgno));
+  return RESP_OK;
+}
+
 static int
 _frt_envelope (struct fetch_function_closure *ffc,
 	       struct fetch_runtime_closure *frt)
@@ -1095,6 +1062,12 @@ _send_header_name (void *item, void *data)
   return 0;
 }
 
+static int
+_header_not_cached (void *item, void *data MU_ARG_UNUSED)
+{
+  return !hdrcache_field_p (item);
+}
+
 static int
 count_nl (const char *str)
 {
@@ -1133,9 +1106,13 @@ _frt_header_fields (struct fetch_function_closure *ffc,
       return RESP_OK;
     }
 
-  /* Collect headers: */
-  if (mu_message_get_header (msg, &header)
-      || mu_header_get_iterator (header, &itr))
+  /* Collect headers.  Use the cached fields, if all requested ones
+     are cached. */
+  if (ffc->not || mu_list_foreach (ffc->headers, _header_not_cached, NULL))
+    status = mu_message_get_header (msg, &header);
+  else
+    status = imap4d_message_header (msg, NULL, &header);
+  if (status || mu_header_get_iterator (header, &itr))
     {
       frt_unregister_messages (frt);
       io_sendf (" NIL");
@@ -1260,6 +1237,7 @@ static struct fetch_att_tab fetch_att_tab[] = {
   { "ENVELOPE", _frt_envelope },
   { "FLAGS", _frt_flags },
   { "INTERNALDATE", _frt_internaldate },
+  { "MODSEQ", _frt_modseq },
   { "UID", _frt_uid },
   { NULL }
 };
@@ -1594,7 +1572,15 @@ parse_fetch_att (imap4d_parsebuf_t p)
   ent = find_fetch_att_tab (p->token);
   if (ent)
     {
-      if (!(ent->fun == _frt_uid && pclos->isuid))
+      if (ent->fun == _frt_modseq)
+	{
+	  if (imap4d_condstore_enable ())
+	    imap4d_parsebuf_exit (p, "[NOMODSEQ] No mod-sequences");
+	  if (!pclos->modseq)
+	    append_simple_function (pclos, ent->name, ent->fun);
+	  pclos->modseq = 1;
+	}
+      else if (!(ent->fun == _frt_uid && pclos->isuid))
 	append_simple_function (pclos, ent->name, ent->fun);
       imap4d_parsebuf_next (p, 0);
     }
@@ -1633,6 +1619,7 @@ parse_macro (imap4d_parsebuf_t p)
       parse_fetch_att_list (p);
       if (!(p->token && p->token[0] == ')'))
 	imap4d_parsebuf_exit (p, "Unknown token or missing closing parenthesis");
+      imap4d_parsebuf_next (p, 0);
     }
   else if ((exp = find_macro (p->token))) 
     {
@@ -1646,15 +1633,60 @@ parse_macro (imap4d_parsebuf_t p)
   
       p->arg = save_arg;
       p->tok = save_tok;
-
-      if (imap4d_parsebuf_peek (p))
-	imap4d_parsebuf_exit (p, "Too many arguments");
+      imap4d_parsebuf_next (p, 0);
     }     
   else
+    parse_fetch_att (p);
+}
+
+/* fetch-modifiers = SP "(" fetch-modifier *(SP fetch-modifier) ")"
+   fetch-modifier  = "CHANGEDSINCE" SP mod-sequence-value / "VANISHED"
+   (RFC 7162) */
+static void
+parse_fetch_modifiers (imap4d_parsebuf_t p)
+{
+  struct fetch_parse_closure *pclos = imap4d_parsebuf_data (p);
+
+  if (!p->token)
+    return;
+  if (p->token[0] != '(')
+    imap4d_parsebuf_exit (p, "Too many arguments");
+  while (imap4d_parsebuf_next (p, 1)[0] != ')')
     {
-      parse_fetch_att (p);
-      if (p->token)
-	imap4d_parsebuf_exit (p, "Too many arguments");
+      if (mu_c_strcasecmp (p->token, "CHANGEDSINCE") == 0)
+	{
+	  char *end;
+
+	  imap4d_parsebuf_next (p, 1);
+	  if (!mu_isdigit (p->token[0]))
+	    imap4d_parsebuf_exit (p, "Invalid mod-sequence");
+	  errno = 0;
+	  pclos->changedsince = strtoull (p->token, &end, 10);
+	  if (errno || *end)
+	    imap4d_parsebuf_exit (p, "Invalid mod-sequence");
+	  pclos->changedsince_set = 1;
+	}
+      else if (mu_c_strcasecmp (p->token, "VANISHED") == 0)
+	{
+	  if (!pclos->isuid || !qresync_enabled)
+	    imap4d_parsebuf_exit (p, "VANISHED not allowed");
+	  pclos->vanished = 1;
+	}
+      else
+	imap4d_parsebuf_exit (p, "Unknown fetch modifier");
+    }
+  if (imap4d_parsebuf_next (p, 0))
+    imap4d_parsebuf_exit (p, "Too many arguments");
+  if (pclos->vanished && !pclos->changedsince_set)
+    imap4d_parsebuf_exit (p, "VANISHED requires CHANGEDSINCE");
+  if (pclos->changedsince_set)
+    {
+      if (imap4d_condstore_enable ())
+	imap4d_parsebuf_exit (p, "[NOMODSEQ] No mod-sequences");
+      /* CHANGEDSINCE implies MODSEQ */
+      if (!pclos->modseq)
+	append_simple_function (pclos, "MODSEQ", _frt_modseq);
+      pclos->modseq = 1;
     }
 }
     
@@ -1668,6 +1700,7 @@ fetch_thunk (imap4d_parsebuf_t pb)
   struct fetch_parse_closure *pclos = imap4d_parsebuf_data (pb);
   
   mstr = imap4d_parsebuf_next (pb, 1);
+  pclos->setstr = mstr;
 
   status = mu_msgset_create (&pclos->msgset, mbox, MU_MSGSET_NUM);
   if (status)
@@ -1690,6 +1723,7 @@ fetch_thunk (imap4d_parsebuf_t pb)
     append_simple_function (pclos, "UID", _frt_uid);
 
   parse_macro (pb);
+  parse_fetch_modifiers (pb);
   return RESP_OK;
 }
 
@@ -1699,6 +1733,10 @@ _fetch_from_message (size_t msgno, mu_message_t msg, void *data)
   int rc = 0;
   struct fetch_runtime_closure *frc = data;
 
+  if (frc->changedsince_set
+      && modseq_log_get (selected_modseq, msgno) <= frc->changedsince)
+    return 0;
+
   frc->msgno = msgno;
   frc->msg = msg;
 
@@ -1710,6 +1748,25 @@ _fetch_from_message (size_t msgno, mu_message_t msg, void *data)
   return rc;
 }
 
+/* Send the VANISHED (EARLIER) response listing UIDs from the requested
+   set that were expunged since the CHANGEDSINCE mod-sequence. */
+static void
+fetch_vanished (struct fetch_parse_closure *pclos)
+{
+  mu_msgset_t known;
+
+  if (mu_msgset_create (&known, NULL, MU_MSGSET_NUM))
+    return;
+  if (mu_msgset_parse_imap (known, MU_MSGSET_NUM, pclos->setstr, NULL))
+    {
+      /* E.g. a lone "*": report all expunged messages. */
+      mu_msgset_free (known);
+      known = NULL;
+    }
+  imap4d_vanished_earlier (pclos->changedsince, known);
+  mu_msgset_free (known);
+}
+
 /* Where the real implementation is.  It is here since UID command also
    calls FETCH.  */
 int
@@ -1743,9 +1800,14 @@ imap4d_fetch0 (imap4d_tokbuf_t tok, int isuid, char **err_text)
       /* Prepare status code. It will be replaced if an error occurs in the
 	 loop below */
       frc.err_text = "Completed";
+      frc.changedsince_set = pclos.changedsince_set;
+      frc.changedsince = pclos.changedsince;
 
+      if (pclos.vanished)
+	fetch_vanished (&pclos);
       mu_msgset_foreach_message (pclos.msgset, _fetch_from_message, &frc);
       mu_list_destroy (&frc.msglist);
+      hdrcache_flush (selected_hdrcache);
     }
   
   mu_list_destroy (&pclos.fnlist);
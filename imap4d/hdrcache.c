@@ -0,0 +1,707 @@
+/* GNU Mailutils -- a suite of utilities for electronic mail
+   Copyright (C) 2022 Free Software Foundation, Inc.
+
+   GNU Mailutils is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   GNU Mailutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Mailutils.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "imap4d.h"
+
+/* Header field cache.
+
+   The header fields most often requested by clients (those that make up
+   the ENVELOPE, as well as References and Content-Type) are kept in a
+   cache file beside the mailbox: ".mu-hdrcache" in the directory of a
+   maildir or MH mailbox, and ".NAME.hdrcache" in the directory of a
+   mailbox file NAME.  Its first line is
+
+     HDRCACHE UIDVALIDITY
+
+   and the rest of it consists of records
+
+     UID LENGTH
+     HEADER
+
+   where HEADER is LENGTH bytes long and contains the cached fields of
+   message UID in RFC 822 form, followed by an empty line.  Since a
+   message never changes once it has been assigned a UID, the records
+   remain valid as long as the UIDVALIDITY of the mailbox stays the
+   same.  If it changes, the cache is truncated.
+
+   FETCH ENVELOPE, FETCH BODY[HEADER.FIELDS] and the SEARCH keys that
+   examine the cached fields use the header built from the record, so
+   that the message header need not be read from the mailbox.  Missing
+   records are created on the fly and appended to the file under an
+   exclusive fcntl lock, so that several imap4d processes can share it.
+   When the file has too many records of expunged messages, it is
+   rewritten. */
+
+#define HDRCACHE_DIR_FILE_NAME ".mu-hdrcache"
+#define HDRCACHE_FILE_SUFFIX ".hdrcache"
+#define HDRCACHE_MAGIC "HDRCACHE"
+/* Pending records are written out when their size exceeds this value */
+#define HDRCACHE_BUFSIZE (64*1024)
+/* The file is compacted when it has more than twice as many records as
+   there are messages in the mailbox, plus this number. */
+#define HDRCACHE_COMPACT_SLACK 1024
+
+/* Cached header fields */
+static char const *hdrcache_fields[] = {
+  MU_HEADER_DATE,
+  MU_HEADER_SUBJECT,
+  MU_HEADER_FROM,
+  MU_HEADER_SENDER,
+  MU_HEADER_REPLY_TO,
+  MU_HEADER_TO,
+  MU_HEADER_CC,
+  MU_HEADER_BCC,
+  MU_HEADER_IN_REPLY_TO,
+  MU_HEADER_MESSAGE_ID,
+  MU_HEADER_REFERENCES,
+  MU_HEADER_CONTENT_TYPE,
+  NULL
+};
+
+struct hdrcache_ent
+{
+  size_t uid;           /* Message UID */
+  off_t off;            /* Offset of the header in the file or, if
+			   pending is set, in the output buffer */
+  size_t len;           /* Length of the header */
+  int pending;          /* The record is not written yet */
+};
+
+struct hdrcache
+{
+  char *file_name;      /* Cache file name */
+  uid_t owner;          /* Mailbox owner */
+  int fd;               /* Cache file descriptor */
+  dev_t dev;            /* Device and */
+  ino_t ino;            /* inode of the cache file */
+  off_t offset;         /* Offset of the first unread record */
+  unsigned long uidvalidity;    /* UIDVALIDITY of the mailbox */
+  size_t nrec;          /* Number of records in the file */
+  struct hdrcache_ent *ent;     /* Cached messages, in UID order */
+  size_t nent;
+  size_t maxent;
+  char *buf;            /* Output buffer */
+  size_t buflen;
+  size_t bufsize;
+  size_t last_uid;      /* UID of the last looked up message and */
+  mu_header_t last_hdr; /* its cached header */
+};
+
+/* Enable the header cache */
+int imap4d_header_cache;
+/* The header cache of the selected mailbox, or NULL. */
+hdrcache_t selected_hdrcache;
+
+/* Return true if the header field NAME is cached. */
+int
+hdrcache_field_p (const char *name)
+{
+  int i;
+
+  for (i = 0; hdrcache_fields[i]; i++)
+    if (mu_c_strcasecmp (hdrcache_fields[i], name) == 0)
+      return 1;
+  return 0;
+}
+
+/* Return the name of the cache file of the mailbox MBX and store the
+   mailbox owner in *POWNER. */
+static char *
+hdrcache_file_name (mu_mailbox_t mbx, uid_t *powner)
+{
+  mu_url_t url;
+  char const *path;
+  struct stat st;
+  char *dir, *base, *name;
+
+  if (mu_mailbox_get_url (mbx, &url)
+      || mu_url_sget_path (url, &path)
+      || path[0] != '/'
+      || stat (path, &st))
+    return NULL;
+  *powner = st.st_uid;
+  if (S_ISDIR (st.st_mode))
+    return mu_make_file_name (path, HDRCACHE_DIR_FILE_NAME);
+
+  dir = mu_strdup (path);
+  base = strrchr (dir, '/');
+  *base++ = 0;
+  name = mu_alloc (strlen (dir) + strlen (base)
+		   + sizeof (HDRCACHE_FILE_SUFFIX) + 2);
+  sprintf (name, "%s/.%s%s", dir, base, HDRCACHE_FILE_SUFFIX);
+  free (dir);
+  return name;
+}
+
+static int
+hdrcache_lock (int fd, int type)
+{
+  struct flock fl;
+
+  memset (&fl, 0, sizeof fl);
+  fl.l_type = type;
+  fl.l_whence = SEEK_SET;
+  while (fcntl (fd, F_SETLKW, &fl))
+    {
+      if (errno != EINTR)
+	return errno;
+    }
+  return 0;
+}
+
+static void
+hdrcache_release (hdrcache_t cache)
+{
+  hdrcache_lock (cache->fd, F_UNLCK);
+}
+
+/* Forget the records read from the cache file, retaining the pending
+   ones. */
+static void
+hdrcache_forget (hdrcache_t cache)
+{
+  size_t i, j;
+
+  for (i = j = 0; i < cache->nent; i++)
+    if (cache->ent[i].pending)
+      cache->ent[j++] = cache->ent[i];
+  cache->nent = j;
+  cache->nrec = 0;
+}
+
+/* Truncate the cache file and write the file header to it. */
+static int
+hdrcache_reset (hdrcache_t cache)
+{
+  char hdr[64];
+  int len;
+
+  len = snprintf (hdr, sizeof hdr, "%s %lu\n", HDRCACHE_MAGIC,
+		  cache->uidvalidity);
+  if (ftruncate (cache->fd, 0) || pwrite (cache->fd, hdr, len, 0) != len)
+    return errno;
+  cache->offset = len;
+  hdrcache_forget (cache);
+  return 0;
+}
+
+/* Look up UID in the entry table.  If not found, return NULL and
+   store in *PPOS the index where it should be inserted. */
+static struct hdrcache_ent *
+hdrcache_find (hdrcache_t cache, size_t uid, size_t *ppos)
+{
+  size_t lo = 0, hi = cache->nent;
+
+  while (lo < hi)
+    {
+      size_t mid = (lo + hi) / 2;
+      if (cache->ent[mid].uid == uid)
+	return &cache->ent[mid];
+      if (cache->ent[mid].uid < uid)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  if (ppos)
+    *ppos = lo;
+  return NULL;
+}
+
+static struct hdrcache_ent *
+hdrcache_add (hdrcache_t cache, size_t uid)
+{
+  size_t pos;
+  struct hdrcache_ent *ep = hdrcache_find (cache, uid, &pos);
+
+  if (!ep)
+    {
+      if (cache->nent == cache->maxent)
+	cache->ent = mu_2nrealloc (cache->ent, &cache->maxent,
+				   sizeof cache->ent[0]);
+      if (pos < cache->nent)
+	memmove (cache->ent + pos + 1, cache->ent + pos,
+		 (cache->nent - pos) * sizeof cache->ent[0]);
+      cache->nent++;
+      ep = &cache->ent[pos];
+      ep->uid = uid;
+    }
+  return ep;
+}
+
+/* Read the records added to the file since the last call.  A damaged
+   record and anything following it are removed.  If the file is empty
+   or belongs to another UIDVALIDITY, start it anew. */
+static int
+hdrcache_replay (hdrcache_t cache)
+{
+  struct stat st;
+  char *buf, *p, *end;
+  off_t base = cache->offset;
+  size_t size;
+  ssize_t n;
+
+  if (fstat (cache->fd, &st))
+    return errno;
+  if (st.st_size <= base)
+    return base == 0 ? hdrcache_reset (cache) : 0;
+  size = st.st_size - base;
+  buf = mu_alloc (size + 1);
+  n = pread (cache->fd, buf, size, base);
+  if (n < 0)
+    {
+      int rc = errno;
+      free (buf);
+      return rc;
+    }
+  buf[n] = 0;
+  end = buf + n;
+  p = buf;
+
+  if (base == 0)
+    {
+      size_t len = sizeof (HDRCACHE_MAGIC) - 1;
+
+      if (strncmp (p, HDRCACHE_MAGIC, len) || p[len] != ' '
+	  || strtoul (p + len + 1, &p, 10) != cache->uidvalidity
+	  || *p != '\n')
+	{
+	  free (buf);
+	  return hdrcache_reset (cache);
+	}
+      p++;
+    }
+
+  while (p < end)
+    {
+      unsigned long uid, len;
+      struct hdrcache_ent *ep;
+      char *q;
+
+      uid = strtoul (p, &q, 10);
+      if (q == p || *q != ' ')
+	break;
+      len = strtoul (q + 1, &q, 10);
+      if (*q != '\n' || len == 0 || len > end - q - 1 || q[len] != '\n')
+	break;
+      q++;
+      ep = hdrcache_add (cache, uid);
+      ep->off = base + (q - buf);
+      ep->len = len;
+      ep->pending = 0;
+      cache->nrec++;
+      p = q + len;
+    }
+  cache->offset = base + (p - buf);
+  n = p < end;
+  free (buf);
+
+  if (n)
+    {
+      mu_diag_output (MU_DIAG_ERROR, _("%s: damaged record at offset %lu"),
+		      cache->file_name, (unsigned long) cache->offset);
+      if (ftruncate (cache->fd, cache->offset))
+	return errno;
+    }
+  return 0;
+}
+
+/* Open the cache file and lock it.  The file usually resides in a
+   directory other users can write to, so it is opened with
+   mu_sidecar_open. */
+static int
+hdrcache_open_file (hdrcache_t cache)
+{
+  struct stat st;
+  int rc;
+
+  rc = mu_sidecar_open (cache->file_name, O_RDWR | O_CREAT, cache->owner,
+			&cache->fd, NULL);
+  if (rc)
+    {
+      cache->fd = -1;
+      return rc;
+    }
+  rc = hdrcache_lock (cache->fd, F_WRLCK);
+  if (rc == 0 && fstat (cache->fd, &st))
+    rc = errno;
+  if (rc)
+    {
+      close (cache->fd);
+      cache->fd = -1;
+      return rc;
+    }
+  cache->dev = st.st_dev;
+  cache->ino = st.st_ino;
+  cache->offset = 0;
+  hdrcache_forget (cache);
+  return 0;
+}
+
+/* Lock the cache file.  If it has been replaced by another process,
+   reopen it. */
+static int
+hdrcache_acquire (hdrcache_t cache)
+{
+  struct stat st;
+  int rc;
+
+  if (cache->fd == -1)
+    return hdrcache_open_file (cache);
+  rc = hdrcache_lock (cache->fd, F_WRLCK);
+  if (rc)
+    return rc;
+  if (stat (cache->file_name, &st) == 0
+      && st.st_dev == cache->dev && st.st_ino == cache->ino)
+    return 0;
+  close (cache->fd);
+  return hdrcache_open_file (cache);
+}
+
+/* Rewrite the cache file, retaining only the records of the messages
+   present in MBX, if it has grown too large.  Called with the file
+   locked and no pending records. */
+static void
+hdrcache_compact (hdrcache_t cache, mu_mailbox_t mbx)
+{
+  char *tmpname;
+  int fd;
+  size_t i, count = 0;
+  char *buf = NULL;
+  size_t bufsize = 0;
+  char hdr[64];
+  int len;
+  struct stat st;
+  int rc = 0;
+
+  mu_mailbox_messages_count (mbx, &count);
+  if (cache->nrec <= 2 * count + HDRCACHE_COMPACT_SLACK)
+    return;
+
+  rc = mu_sidecar_tempfile (cache->file_name, &fd, &tmpname);
+  if (rc)
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "mu_sidecar_tempfile",
+		       cache->file_name, rc);
+      return;
+    }
+
+  len = snprintf (hdr, sizeof hdr, "%s %lu\n", HDRCACHE_MAGIC,
+		  cache->uidvalidity);
+  if (write (fd, hdr, len) != len)
+    rc = errno;
+  for (i = 1; rc == 0 && i <= count; i++)
+    {
+      mu_message_t msg;
+      size_t uid;
+      struct hdrcache_ent *ep;
+
+      if (mu_mailbox_get_message (mbx, i, &msg)
+	  || mu_message_get_uid (msg, &uid)
+	  || (ep = hdrcache_find (cache, uid, NULL)) == NULL)
+	continue;
+      if (ep->len > bufsize)
+	{
+	  bufsize = ep->len;
+	  buf = mu_realloc (buf, bufsize);
+	}
+      len = snprintf (hdr, sizeof hdr, "%lu %lu\n", (unsigned long) uid,
+		      (unsigned long) ep->len);
+      if (pread (cache->fd, buf, ep->len, ep->off) != ep->len
+	  || write (fd, hdr, len) != len
+	  || write (fd, buf, ep->len) != ep->len)
+	rc = errno ? errno : EIO;
+    }
+  free (buf);
+
+  if (rc == 0)
+    rc = hdrcache_lock (fd, F_WRLCK);
+  if (rc == 0 && fstat (fd, &st))
+    rc = errno;
+  if (rc == 0 && rename (tmpname, cache->file_name))
+    rc = errno;
+  if (rc)
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "hdrcache_compact", tmpname, rc);
+      close (fd);
+      unlink (tmpname);
+    }
+  else
+    {
+      close (cache->fd);
+      cache->fd = fd;
+      cache->dev = st.st_dev;
+      cache->ino = st.st_ino;
+      cache->offset = 0;
+      hdrcache_forget (cache);
+      rc = hdrcache_replay (cache);
+      if (rc)
+	mu_diag_funcall (MU_DIAG_ERROR, "hdrcache_replay", cache->file_name,
+			 rc);
+    }
+  free (tmpname);
+}
+
+/* Write out the pending records. */
+int
+hdrcache_flush (hdrcache_t cache)
+{
+  off_t off = 0;
+  size_t i;
+  int rc;
+
+  if (!cache || cache->buflen == 0)
+    return 0;
+  rc = hdrcache_acquire (cache);
+  if (rc == 0)
+    rc = hdrcache_replay (cache);
+  if (rc == 0)
+    {
+      struct stat st;
+
+      if (fstat (cache->fd, &st))
+	rc = errno;
+      else
+	{
+	  off = st.st_size;
+	  if (pwrite (cache->fd, cache->buf, cache->buflen, off)
+	      != cache->buflen)
+	    {
+	      rc = errno ? errno : EIO;
+	      if (ftruncate (cache->fd, off))
+		/* Nothing more to do */;
+	    }
+	}
+    }
+  if (cache->fd != -1)
+    hdrcache_release (cache);
+
+  /* Convert the pending entries.  If the records could not be written,
+     forget them. */
+  for (i = 0; i < cache->nent; )
+    {
+      struct hdrcache_ent *ep = &cache->ent[i];
+      if (ep->pending)
+	{
+	  if (rc)
+	    {
+	      memmove (ep, ep + 1, (cache->nent - i - 1) * sizeof *ep);
+	      cache->nent--;
+	      continue;
+	    }
+	  ep->off += off;
+	  ep->pending = 0;
+	  cache->nrec++;
+	}
+      i++;
+    }
+  if (rc == 0)
+    cache->offset = off + cache->buflen;
+  else
+    mu_diag_funcall (MU_DIAG_ERROR, "hdrcache_flush", cache->file_name, rc);
+  cache->buflen = 0;
+  return rc;
+}
+
+static void
+hdrcache_output (hdrcache_t cache, const char *str, size_t len)
+{
+  while (cache->buflen + len > cache->bufsize)
+    cache->buf = mu_2nrealloc (cache->buf, &cache->bufsize, 1);
+  memcpy (cache->buf + cache->buflen, str, len);
+  cache->buflen += len;
+}
+
+/* Create a pending record for message MSG with the given UID.  Return
+   its entry. */
+static struct hdrcache_ent *
+hdrcache_record (hdrcache_t cache, mu_message_t msg, size_t uid)
+{
+  mu_header_t header;
+  size_t i, count;
+  size_t hdrstart;
+  char buf[64];
+  int len;
+  struct hdrcache_ent *ep;
+
+  if (mu_message_get_header (msg, &header)
+      || mu_header_get_field_count (header, &count))
+    return NULL;
+
+  /* The length is inserted after the UID when it is known. */
+  len = snprintf (buf, sizeof buf, "%lu ", (unsigned long) uid);
+  hdrcache_output (cache, buf, len);
+  hdrstart = cache->buflen;
+  for (i = 1; i <= count; i++)
+    {
+      const char *name, *value;
+
+      if (mu_header_sget_field_name (header, i, &name) == 0
+	  && hdrcache_field_p (name)
+	  && mu_header_sget_field_value (header, i, &value) == 0)
+	{
+	  hdrcache_output (cache, name, strlen (name));
+	  hdrcache_output (cache, ": ", 2);
+	  hdrcache_output (cache, value, strlen (value));
+	  hdrcache_output (cache, "\n", 1);
+	}
+    }
+  hdrcache_output (cache, "\n", 1);
+
+  /* Insert the length after the UID */
+  len = snprintf (buf, sizeof buf, "%lu\n",
+		  (unsigned long) (cache->buflen - hdrstart));
+  hdrcache_output (cache, buf, len);
+  memmove (cache->buf + hdrstart + len, cache->buf + hdrstart,
+	   cache->buflen - hdrstart - len);
+  memcpy (cache->buf + hdrstart, buf, len);
+
+  ep = hdrcache_add (cache, uid);
+  ep->off = hdrstart + len;
+  ep->len = cache->buflen - ep->off;
+  ep->pending = 1;
+  return ep;
+}
+
+/* Return in *PHDR the cached header fields of message MSG.  The header
+   remains valid until the next call. */
+static int
+hdrcache_get (hdrcache_t cache, mu_message_t msg, mu_header_t *phdr)
+{
+  size_t uid;
+  struct hdrcache_ent *ep;
+  char *buf;
+  int rc;
+
+  if ((rc = mu_message_get_uid (msg, &uid)) != 0)
+    return rc;
+  if (uid == 0)
+    return MU_ERR_NOENT;
+  if (cache->last_hdr && cache->last_uid == uid)
+    {
+      *phdr = cache->last_hdr;
+      return 0;
+    }
+  mu_header_destroy (&cache->last_hdr);
+
+  ep = hdrcache_find (cache, uid, NULL);
+  if (!ep)
+    {
+      if (cache->buflen > HDRCACHE_BUFSIZE)
+	hdrcache_flush (cache);
+      ep = hdrcache_record (cache, msg, uid);
+      if (!ep)
+	return MU_ERR_NOENT;
+    }
+
+  if (ep->pending)
+    rc = mu_header_create (&cache->last_hdr, cache->buf + ep->off, ep->len);
+  else
+    {
+      buf = mu_alloc (ep->len);
+      if (pread (cache->fd, buf, ep->len, ep->off) != ep->len)
+	rc = errno ? errno : EIO;
+      else
+	rc = mu_header_create (&cache->last_hdr, buf, ep->len);
+      free (buf);
+    }
+  if (rc)
+    {
+      mu_header_destroy (&cache->last_hdr);
+      return rc;
+    }
+  cache->last_uid = uid;
+  *phdr = cache->last_hdr;
+  return 0;
+}
+
+/* Open the header cache for mailbox MBX. */
+int
+hdrcache_open (mu_mailbox_t mbx, hdrcache_t *ret)
+{
+  hdrcache_t cache;
+  int rc;
+
+  cache = mu_zalloc (sizeof (*cache));
+  cache->fd = -1;
+  cache->file_name = hdrcache_file_name (mbx, &cache->owner);
+  if (!cache->file_name)
+    {
+      free (cache);
+      return ENOSYS;
+    }
+  rc = util_uidvalidity (mbx, &cache->uidvalidity);
+  if (rc == 0)
+    rc = hdrcache_open_file (cache);
+  if (rc == 0)
+    {
+      rc = hdrcache_replay (cache);
+      if (rc == 0)
+	hdrcache_compact (cache, mbx);
+      hdrcache_release (cache);
+    }
+  if (rc)
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "hdrcache_open", cache->file_name, rc);
+      hdrcache_destroy (&cache);
+      return rc;
+    }
+  *ret = cache;
+  return 0;
+}
+
+void
+hdrcache_destroy (hdrcache_t *pcache)
+{
+  hdrcache_t cache = *pcache;
+  if (cache)
+    {
+      hdrcache_flush (cache);
+      if (cache->fd != -1)
+	close (cache->fd);
+      mu_header_destroy (&cache->last_hdr);
+      free (cache->file_name);
+      free (cache->ent);
+      free (cache->buf);
+      free (cache);
+      *pcache = NULL;
+    }
+}
+
+/* Start caching the headers of the selected mailbox. */
+void
+imap4d_hdrcache_select (void)
+{
+  hdrcache_destroy (&selected_hdrcache);
+  if (imap4d_header_cache && mbox)
+    hdrcache_open (mbox, &selected_hdrcache);
+}
+
+/* Return in *PHDR the header of message MSG to be used for looking up
+   the field NAME (or all the cached fields, if NAME is NULL).  This is
+   the cached header if MSG belongs to the selected mailbox and NAME is
+   cached, and the message header otherwise. */
+int
+imap4d_message_header (mu_message_t msg, const char *name, mu_header_t *phdr)
+{
+  mu_mailbox_t mbx;
+
+  if (selected_hdrcache
+      && (!name || hdrcache_field_p (name))
+      && mu_message_get_mailbox (msg, &mbx) == 0 && mbx == mbox
+      && hdrcache_get (selected_hdrcache, msg, phdr) == 0)
+    return 0;
+  return mu_message_get_header (msg, phdr);
+}
@@ -15,6 +15,128 @@
    along with GNU Mailutils.  If not, see <http://www.gnu.org/licenses/>. */
 
 #include "imap4d.h"
+#ifdef HAVE_SYS_INOTIFY_H
+# include <sys/inotify.h>
+#endif
+
+/* Mailbox change watcher.
+
+   While the client is idling, changes to the selected mailbox are
+   reported as soon as they happen.  If inotify is available, the
+   mailbox file (for mbox) or its directories (for maildir and MH) are
+   watched, and the watcher descriptor is multiplexed with the client
+   input.  Otherwise, or if the watch cannot be set up (e.g. for remote
+   mailboxes), the mailbox is polled each idle_poll_interval seconds. */
+
+#ifdef HAVE_SYS_INOTIFY_H
+static int
+watch_add (int fd, char const *dir, char const *name, uint32_t mask)
+{
+  char *file = NULL;
+  int rc;
+
+  if (name)
+    {
+      file = mu_make_file_name (dir, name);
+      if (!file)
+	return -1;
+      dir = file;
+    }
+  rc = inotify_add_watch (fd, dir, mask);
+  if (rc == -1 && errno != ENOENT)
+    mu_diag_funcall (MU_DIAG_ERROR, "inotify_add_watch", dir, errno);
+  free (file);
+  return rc;
+}
+
+/* Start watching the selected mailbox.  Return the inotify descriptor,
+   or -1 if the mailbox cannot be watched. */
+static int
+idle_watch_open (void)
+{
+  mu_url_t url;
+  char const *path;
+  struct stat st;
+  int fd;
+  int nwatch = 0;
+
+  if (!mbox
+      || mu_mailbox_get_url (mbox, &url)
+      || mu_url_sget_path (url, &path)
+      || stat (path, &st))
+    return -1;
+
+  fd = inotify_init ();
+  if (fd == -1)
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "inotify_init", NULL, errno);
+      return -1;
+    }
+
+  if (S_ISDIR (st.st_mode))
+    {
+      /* Messages are created, renamed and removed in the maildir "new"
+	 and "cur" subdirectories, or in the MH folder itself. */
+      static char *subdir[] = { "new", "cur", NULL };
+      int i;
+      uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+	              | IN_CLOSE_WRITE;
+
+      for (i = 0; subdir[i]; i++)
+	if (watch_add (fd, path, subdir[i], mask) != -1)
+	  nwatch++;
+      if (nwatch == 0 && watch_add (fd, path, NULL, mask) != -1)
+	nwatch++;
+    }
+  else if (watch_add (fd, path, NULL,
+		      IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF)
+	   != -1)
+    nwatch++;
+
+  if (nwatch == 0)
+    {
+      close (fd);
+      return -1;
+    }
+  return fd;
+}
+
+/* Read pending events from FD.  Return 1 if any of them reports a
+   change to the mailbox, and 0 otherwise.  Names starting with a dot
+   are ignored: these are auxiliary files (such as the MH sequences
+   file or the property files), which we may update ourselves. */
+static int
+idle_watch_read (int fd)
+{
+  char buf[4096]
+    __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+  ssize_t n;
+  char *p;
+  int changed = 0;
+
+  n = read (fd, buf, sizeof buf);
+  if (n <= 0)
+    return 1;
+  for (p = buf; p < buf + n;
+       p += sizeof (struct inotify_event) + ((struct inotify_event *)p)->len)
+    {
+      struct inotify_event *ev = (struct inotify_event *) p;
+      if (ev->len == 0 || ev->name[0] != '.')
+	changed = 1;
+    }
+  return changed;
+}
+#else
+# define idle_watch_open() (-1)
+# define idle_watch_read(fd) 1
+#endif
+
+static void
+idle_watch_close (int fd)
+{
+  if (fd != -1)
+    close (fd);
+}
 
 int
 imap4d_idle (struct imap4d_session *session,
@@ -23,7 +145,8 @@ imap4d_idle (struct imap4d_session *session,
   struct timeval stop_time, tv, *to;
   char *token_str = NULL;
   size_t token_size = 0, token_len;
-  
+  int watch_fd;
+
   if (imap4d_tokbuf_argc (tok) != 2)
     return io_completion_response (command, RESP_BAD, "Invalid arguments");
 
@@ -37,16 +160,16 @@ imap4d_idle (struct imap4d_session *session,
     {
       gettimeofday (&stop_time, NULL);
       stop_time.tv_sec += idle_timeout;
-      to = &tv;
     }
-  else
-    to = NULL;
+
+  watch_fd = idle_watch_open ();
 
   while (1)
     {
       int rc;
+      struct timeval wait_tv, *wait_to;
 
-      if (to)
+      if (idle_timeout)
 	{
 	  struct timeval d;
 
@@ -55,7 +178,43 @@ imap4d_idle (struct imap4d_session *session,
 	    {
 	      imap4d_bye (ERR_TIMEOUT);
 	    }
-	  *to = mu_timeval_sub (&stop_time, &d);
+	  tv = mu_timeval_sub (&stop_time, &d);
+	  to = &tv;
+	}
+      else
+	to = NULL;
+
+      wait_to = to;
+      if (idle_poll_interval
+	  && (!to || to->tv_sec >= idle_poll_interval))
+	{
+	  wait_tv.tv_sec = idle_poll_interval;
+	  wait_tv.tv_usec = 0;
+	  wait_to = &wait_tv;
+	}
+
+      rc = io_wait_input (watch_fd, wait_to);
+      if (rc == -1)
+	imap4d_bye (ERR_NO_IFILE);
+      if (!(rc & IO_READY_CLIENT))
+	{
+	  /* The mailbox has changed or the poll interval has expired. */
+	  int changed = 1;
+
+	  if (rc & IO_READY_FD)
+	    {
+	      changed = idle_watch_read (watch_fd);
+	      /* The mailbox file could have been replaced.  Restart
+		 watching before looking at it. */
+	      idle_watch_close (watch_fd);
+	      watch_fd = idle_watch_open ();
+	    }
+	  if (changed)
+	    {
+	      imap4d_sync ();
+	      io_flush ();
+	    }
+	  continue;
 	}
 
       rc = mu_stream_timed_getline (iostream, &token_str, &token_size,
@@ -74,7 +233,7 @@ imap4d_idle (struct imap4d_session *session,
 	  mu_error ("%s", _("eof while idling"));
 	  imap4d_bye (ERR_NO_IFILE);
 	}
-      
+
       token_len = mu_rtrim_class (token_str, MU_CTYPE_ENDLN);
 
       if (token_len == 4 && mu_c_strcasecmp (token_str, "done") == 0)
@@ -83,7 +242,7 @@ imap4d_idle (struct imap4d_session *session,
       imap4d_sync ();
       io_flush ();
     }
+  idle_watch_close (watch_fd);
   free (token_str);
   return io_completion_response (command, RESP_OK, "terminated");
 }
-
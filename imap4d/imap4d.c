@@ -22,6 +22,8 @@
 
 mu_m_server_t server;
 unsigned int idle_timeout = 1800;
+unsigned int idle_poll_interval = 30;
+unsigned int quota_reconcile_interval = 86400;
 int imap4d_transcript;
 
 mu_mailbox_t mbox;              /* Current mailbox */
@@ -553,6 +555,20 @@ static struct mu_cfg_param imap4d_cfg_param[] = {
     N_("Use only encrypted ident responses.") },
   { "id-fields", MU_CFG_LIST_OF(mu_c_string), &imap4d_id_list, 0, NULL,
     N_("List of fields to return in response to ID command.") },
+  { "idle-poll-interval", mu_c_uint, &idle_poll_interval, 0, NULL,
+    N_("While in IDLE state, check the mailbox for changes each <n> "
+       "seconds.  0 disables polling."),
+    N_("n") },
+  { "quota-reconcile-interval", mu_c_uint, &quota_reconcile_interval, 0, NULL,
+    N_("Recompute the mailbox usage recorded in the usage ledger if it "
+       "is older than <n> seconds.  0 disables the ledger."),
+    N_("n") },
+  { "header-cache", mu_c_bool, &imap4d_header_cache, 0, NULL,
+    N_("Cache the most often requested header fields of the messages in "
+       "a file beside the mailbox.") },
+  { "text-index", mu_c_bool, &imap4d_text_index, 0, NULL,
+    N_("Keep a full-text index of the messages in a file beside the "
+       "mailbox and use it to speed up SEARCH BODY and TEXT.") },
   { "mandatory-locking", mu_cfg_section },
   { ".server", mu_cfg_section, NULL, 0, NULL,
     N_("Server configuration.") },
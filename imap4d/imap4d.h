@@ -219,6 +219,8 @@ extern int ident_port;
 extern char *ident_keyfile;
 extern int ident_encrypt_only;
 extern unsigned int idle_timeout;
+extern unsigned int idle_poll_interval;
+extern unsigned int quota_reconcile_interval;
 extern int imap4d_transcript;
 extern mu_list_t imap4d_id_list;
 extern int imap4d_argc;                 
@@ -238,7 +240,7 @@ extern int  io_send_bytes (const char *buf, size_t size);
 extern int  io_send_qstring (const char *);
 extern int  io_send_astring (const char *);
 extern int  io_send_literal (const char *);
-extern int  io_copy_out (mu_stream_t str, size_t size);
+extern int  io_copy_crlf (mu_stream_t str, size_t start, size_t size);
 extern int  io_completion_response (struct imap4d_command *, int,
                                     const char *, ...) MU_PRINTFLIKE(3,4);
 extern int io_stream_completion_response (mu_stream_t str,
@@ -247,9 +249,13 @@ extern int io_stream_completion_response (mu_stream_t str,
 					  const char *format, ...)
                                     MU_PRINTFLIKE(4,5);
 void io_getline (char **pbuf, size_t *psize, size_t *pnbytes);
+#define IO_READY_CLIENT 0x1
+#define IO_READY_FD     0x2
+int io_wait_input (int fd, struct timeval *to);
 void io_setio (int, int, struct mu_tls_config *);
 void io_flush (void);
 void io_enable_crlf (int);
+int io_start_compression (void);
 
 imap4d_tokbuf_t imap4d_tokbuf_init (void);
 void imap4d_tokbuf_destroy (imap4d_tokbuf_t *tok);
@@ -308,6 +314,9 @@ extern int  imap4d_close (struct imap4d_session *,
 			  struct imap4d_command *, imap4d_tokbuf_t);
 extern int  imap4d_unselect (struct imap4d_session *,
 			     struct imap4d_command *, imap4d_tokbuf_t);
+extern int  imap4d_compress (struct imap4d_session *,
+			     struct imap4d_command *, imap4d_tokbuf_t);
+extern void imap4d_compress_capability (void);
 extern int  imap4d_copy (struct imap4d_session *,
 			 struct imap4d_command *, imap4d_tokbuf_t);
 extern int  imap4d_copy0 (imap4d_tokbuf_t, int isuid, char **err_text);
@@ -315,6 +324,8 @@ extern int  imap4d_create (struct imap4d_session *,
 			   struct imap4d_command *, imap4d_tokbuf_t);
 extern int  imap4d_delete (struct imap4d_session *,
 			   struct imap4d_command *, imap4d_tokbuf_t);
+extern int  imap4d_enable (struct imap4d_session *,
+			   struct imap4d_command *, imap4d_tokbuf_t);
 extern int  imap4d_examine (struct imap4d_session *,
 			    struct imap4d_command *, imap4d_tokbuf_t);
 extern int  imap4d_expunge (struct imap4d_session *,
@@ -338,7 +349,7 @@ extern int  imap4d_search (struct imap4d_session *,
 extern int  imap4d_search0 (imap4d_tokbuf_t, int isuid, char **repyptr);
 extern int  imap4d_select (struct imap4d_session *,
 			   struct imap4d_command *, imap4d_tokbuf_t);
-extern int  imap4d_select0 (struct imap4d_command *, const char *, int);
+extern int  imap4d_select0 (struct imap4d_command *, imap4d_tokbuf_t, int);
 extern int  imap4d_select_status (void);
 extern int  imap4d_starttls (struct imap4d_session *,
 			     struct imap4d_command *, imap4d_tokbuf_t);
@@ -386,7 +397,50 @@ extern void imap4d_sync_invalidate (void);
 extern int imap4d_sync_flags (size_t);
 extern size_t uid_to_msgno (size_t);
 extern void imap4d_set_observer (mu_mailbox_t mbox);
-  
+
+/* Mod-sequences (RFC 7162).  */
+typedef unsigned long long modseq_t;
+typedef struct modseq_log *modseq_log_t;
+
+extern int condstore_enabled;
+extern int qresync_enabled;
+extern modseq_log_t selected_modseq;
+
+int modseq_log_open (mu_mailbox_t mbx, modseq_log_t *ret);
+void modseq_log_destroy (modseq_log_t *plog);
+int modseq_log_reconcile (modseq_log_t log, mu_mailbox_t mbx, size_t first);
+int modseq_log_commit (modseq_log_t log, mu_mailbox_t mbx);
+int modseq_log_refresh (modseq_log_t log);
+void modseq_log_touch (modseq_log_t log, size_t msgno);
+modseq_t modseq_log_highest (modseq_log_t log);
+modseq_t modseq_log_get (modseq_log_t log, size_t msgno);
+size_t modseq_log_uid (modseq_log_t log, size_t msgno);
+int modseq_log_vanished (modseq_log_t log, modseq_t since, mu_msgset_t known,
+			 size_t uidnext, mu_msgset_t *ret);
+void imap4d_vanished_earlier (modseq_t since, mu_msgset_t known);
+void imap4d_modseq_select (void);
+int imap4d_condstore_enable (void);
+
+/* Header field cache.  */
+typedef struct hdrcache *hdrcache_t;
+
+extern int imap4d_header_cache;
+extern hdrcache_t selected_hdrcache;
+
+int hdrcache_open (mu_mailbox_t mbx, hdrcache_t *ret);
+void hdrcache_destroy (hdrcache_t *pcache);
+int hdrcache_flush (hdrcache_t cache);
+int hdrcache_field_p (const char *name);
+void imap4d_hdrcache_select (void);
+int imap4d_message_header (mu_message_t msg, const char *name,
+			   mu_header_t *phdr);
+
+/* Full-text index.  */
+extern int imap4d_text_index;
+extern txtidx_t selected_txtidx;
+
+void imap4d_txtidx_select (void);
+
 /* Signal handling.  */
 extern RETSIGTYPE imap4d_master_signal (int);
 extern RETSIGTYPE imap4d_child_signal (int);
@@ -515,6 +569,8 @@ extern void auth_gsasl_init (void);
 void quota_setup (void);
 int quota_check (mu_off_t size);
 void quota_update (mu_off_t size);
+mu_off_t quota_mailbox_size (mu_mailbox_t mbx);
+void quota_mailbox_update (mu_mailbox_t mbx, mu_off_t oldsize);
 
 #ifdef __cplusplus
 }
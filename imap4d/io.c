@@ -17,8 +17,13 @@
 #include "imap4d.h"
 #include <mailutils/property.h>
 #include <mailutils/datetime.h>
+#include <sys/uio.h>
 
 mu_stream_t iostream;
+static int io_ifd = -1;         /* Input descriptor of the client */
+static int io_ofd = -1;         /* Output descriptor of the client, if it
+				   can be written to directly (see
+				   io_copy_crlf) */
 
 static void
 log_cipher (mu_stream_t stream)
@@ -59,6 +64,7 @@ io_setio (int ifd, int ofd, struct mu_tls_config *tls_conf)
     imap4d_bye (ERR_NO_IFILE);
   if (ofd == -1)
     imap4d_bye (ERR_NO_OFILE);
+  io_ifd = ifd;
 
   if (tls_conf)
     {
@@ -86,6 +92,7 @@ io_setio (int ifd, int ofd, struct mu_tls_config *tls_conf)
 
       mu_stream_unref (istream);
       mu_stream_unref (ostream);
+      io_ofd = ofd;
     }
   
   /* Convert all writes to CRLF form.
@@ -118,6 +125,7 @@ io_setio (int ifd, int ofd, struct mu_tls_config *tls_conf)
 	    {
 	      mu_stream_unref (iostream);
 	      iostream = xstr;
+	      io_ofd = -1;
 	    }
 	}
     }
@@ -127,7 +135,8 @@ int
 imap4d_init_tls_server (struct mu_tls_config *tls_conf)
 {
   int rc;
-  
+
+  io_ofd = -1;
   rc = mu_starttls (&iostream, tls_conf, MU_TLS_SERVER);
   if (rc == 0)
     log_cipher (iostream);
@@ -140,6 +149,75 @@ imap4d_init_tls_server (struct mu_tls_config *tls_conf)
   return rc;
 }
 
+/* Start compressing the data exchanged with the client (RFC 4978).
+   The deflate filters are inserted right above the transport stream,
+   i.e. below the CRLF filter and the transcript stream (if any). */
+int
+io_start_compression (void)
+{
+  mu_stream_t tstr, str, stream[2], zin, zout, zstr;
+  struct mu_buffer_query q;
+  int t = 1;
+  int rc;
+
+  io_flush ();
+  io_ofd = -1;
+
+  /* Find the transport stream (see the comment in mu_starttls). */
+  tstr = str = iostream;
+  while ((rc = mu_stream_ioctl (str, MU_IOCTL_TOPSTREAM, MU_IOCTL_OP_GET,
+				stream)) == 0
+	 && stream[1] == NULL)
+    {
+      tstr = str;
+      str = stream[0];
+      mu_stream_unref (str);
+    }
+  if (rc == 0)
+    {
+      mu_stream_unref (stream[0]);
+      mu_stream_unref (stream[1]);
+    }
+  else if (rc != ENOSYS || tstr == str)
+    return MU_ERR_TRANSPORT_GET;
+
+  /* The inflate filter must get whatever data are available, without
+     waiting for a newline. */
+  mu_stream_set_buffer (str, mu_buffer_none, 0);
+  q.type = MU_TRANSPORT_INPUT;
+  q.buftype = mu_buffer_none;
+  q.bufsize = 0;
+  mu_stream_ioctl (str, MU_IOCTL_TRANSPORT_BUFFER, MU_IOCTL_OP_SET, &q);
+
+  rc = mu_filter_create (&zin, str, "deflate", MU_FILTER_DECODE,
+			 MU_STREAM_READ);
+  if (rc)
+    return rc;
+  mu_stream_ioctl (zin, MU_IOCTL_FILTER, MU_IOCTL_FILTER_SET_INTERACTIVE, &t);
+  mu_stream_set_buffer (zin, mu_buffer_none, 0);
+
+  rc = mu_filter_create (&zout, str, "deflate", MU_FILTER_ENCODE,
+			 MU_STREAM_WRITE);
+  if (rc)
+    {
+      mu_stream_unref (zin);
+      return rc;
+    }
+
+  rc = mu_iostream_create (&zstr, zin, zout);
+  mu_stream_unref (zin);
+  mu_stream_unref (zout);
+  if (rc)
+    return rc;
+  mu_stream_set_buffer (zstr, mu_buffer_none, 0);
+
+  stream[0] = zstr;
+  stream[1] = NULL;
+  rc = mu_stream_ioctl (tstr, MU_IOCTL_TOPSTREAM, MU_IOCTL_OP_SET, stream);
+  mu_stream_unref (zstr);
+  return rc;
+}
+
 /* Status Code to String.  */
 static const char *
 sc2string (int rc)
@@ -166,29 +244,195 @@ sc2string (int rc)
 
 /* FIXME: Check return values from the output functions */
 
+/* Copying message data to the client.
+
+   Messages are stored with LF line terminators, whereas IMAP requires
+   CRLF.  The CRLF-expanded size of a message part is its size plus the
+   number of lines in it, both of which are known beforehand, so the
+   literal length can be announced without reading the data.  The data
+   are then expanded a block at a time.
+
+   Unless TLS, compression or transcript is in effect, the expanded data
+   are written to the output descriptor directly, using writev with the
+   I/O vectors pointing into the input block interleaved with static CRLF
+   pairs, so that the message data are not copied.  Otherwise, they are
+   written to iostream with its CRLF filter disabled. */
+
+#define COPY_BUFSIZE (64*1024)
+#define COPY_IOVMAX  512
+
+struct copy_closure
+{
+  size_t pos;                     /* Current offset in the expanded data */
+  size_t start;                   /* Start of the requested range */
+  size_t end;                     /* End of the requested range */
+  struct iovec iov[COPY_IOVMAX];  /* Pending output */
+  int iovcnt;                     /* Number of used entries in iov */
+};
+
+static int
+copy_flush (struct copy_closure *cc)
+{
+  struct iovec *iov = cc->iov;
+  int iovcnt = cc->iovcnt;
+  int rc = 0;
+
+  cc->iovcnt = 0;
+  if (io_ofd == -1)
+    {
+      for (; iovcnt > 0; iov++, iovcnt--)
+	{
+	  rc = mu_stream_write (iostream, iov->iov_base, iov->iov_len, NULL);
+	  if (rc)
+	    break;
+	}
+      return rc;
+    }
+
+  while (iovcnt > 0)
+    {
+      ssize_t n = writev (io_ofd, iov, iovcnt);
+      if (n < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return errno;
+	}
+      /* Skip the vectors written in full and adjust the partially written
+	 one. */
+      for (; iovcnt > 0 && (size_t) n >= iov->iov_len; iov++, iovcnt--)
+	n -= iov->iov_len;
+      if (n > 0)
+	{
+	  iov->iov_base = (char *) iov->iov_base + n;
+	  iov->iov_len -= n;
+	}
+    }
+  return 0;
+}
+
+/* Append LEN bytes at P to the output, if they fall within the requested
+   range. */
+static int
+copy_add (struct copy_closure *cc, const char *p, size_t len)
+{
+  size_t off = cc->pos;
+
+  cc->pos += len;
+  if (cc->pos <= cc->start || off >= cc->end)
+    return 0;
+  if (off < cc->start)
+    {
+      p += cc->start - off;
+      len -= cc->start - off;
+    }
+  if (cc->pos > cc->end)
+    len -= cc->pos - cc->end;
+  cc->iov[cc->iovcnt].iov_base = (char *) p;
+  cc->iov[cc->iovcnt].iov_len = len;
+  if (++cc->iovcnt == COPY_IOVMAX)
+    return copy_flush (cc);
+  return 0;
+}
+
+/* Send SIZE bytes of data from STR, starting at offset START.  Each LF is
+   expanded to CRLF; START and SIZE refer to the expanded data.  STR must
+   be positioned at the beginning of the data.
+
+   If the stream ends prematurely or cannot be read, the output is padded
+   with spaces, so that the client gets exactly the number of bytes
+   announced in the literal.  The read error, if any, is returned after
+   that. */
 int
-io_copy_out (mu_stream_t str, size_t size)
+io_copy_crlf (mu_stream_t str, size_t start, size_t size)
 {
-  int rc;
+  static char blanks[] = "                                ";
+  struct copy_closure cc;
   struct mu_buffer_query oldbuf, newbuf;
-  
-  oldbuf.type = MU_TRANSPORT_OUTPUT;
-  if (mu_stream_ioctl (iostream, MU_IOCTL_TRANSPORT_BUFFER,
-		       MU_IOCTL_OP_GET, &oldbuf) == 0)
+  int setbuf = 0;
+  char *buf;
+  size_t n;
+  int rc = 0, rdrc = 0;
+
+  buf = malloc (COPY_BUFSIZE);
+  if (!buf)
+    return ENOMEM;
+  cc.pos = 0;
+  cc.start = start;
+  cc.end = start + size;
+  cc.iovcnt = 0;
+
+  if (io_ofd != -1)
+    rc = mu_stream_flush (iostream);
+  else
     {
-      newbuf.type = MU_TRANSPORT_OUTPUT;
-      newbuf.buftype = mu_buffer_full;
-      newbuf.bufsize = 64*1024;
-      mu_stream_ioctl (iostream, MU_IOCTL_TRANSPORT_BUFFER,
-		       MU_IOCTL_OP_SET, &newbuf);
+      io_enable_crlf (0);
+      oldbuf.type = MU_TRANSPORT_OUTPUT;
+      if (mu_stream_ioctl (iostream, MU_IOCTL_TRANSPORT_BUFFER,
+			   MU_IOCTL_OP_GET, &oldbuf) == 0)
+	{
+	  newbuf.type = MU_TRANSPORT_OUTPUT;
+	  newbuf.buftype = mu_buffer_full;
+	  newbuf.bufsize = COPY_BUFSIZE;
+	  mu_stream_ioctl (iostream, MU_IOCTL_TRANSPORT_BUFFER,
+			   MU_IOCTL_OP_SET, &newbuf);
+	  setbuf = 1;
+	}
     }
 
-  rc = mu_stream_copy (iostream, str, size, NULL);
+  while (rc == 0 && cc.pos < cc.end)
+    {
+      char *p, *q, *end;
 
-  mu_stream_ioctl (iostream, MU_IOCTL_TRANSPORT_BUFFER,
-		   MU_IOCTL_OP_SET, &oldbuf);
+      rdrc = mu_stream_read (str, buf, COPY_BUFSIZE, &n);
+      if (rdrc || n == 0)
+	break;
+      for (p = buf, end = buf + n; rc == 0 && p < end && cc.pos < cc.end;
+	   p = q + 1)
+	{
+	  q = memchr (p, '\n', end - p);
+	  if (!q)
+	    {
+	      rc = copy_add (&cc, p, end - p);
+	      break;
+	    }
+	  rc = copy_add (&cc, p, q - p);
+	  if (rc == 0)
+	    rc = copy_add (&cc, "\r\n", 2);
+	}
+      /* The vectors refer to buf, which is about to be reused. */
+      if (rc == 0)
+	rc = copy_flush (&cc);
+    }
 
-  return rc;
+  if (rc == 0 && cc.pos < cc.end)
+    {
+      if (rdrc == 0)
+	mu_diag_output (MU_DIAG_ERROR,
+			_("message is %lu bytes shorter than expected"),
+			(unsigned long) (cc.end - cc.pos));
+      if (cc.pos < cc.start)
+	cc.pos = cc.start;
+      while (rc == 0 && cc.pos < cc.end)
+	{
+	  n = cc.end - cc.pos;
+	  if (n > sizeof blanks - 1)
+	    n = sizeof blanks - 1;
+	  rc = copy_add (&cc, blanks, n);
+	}
+      if (rc == 0)
+	rc = copy_flush (&cc);
+    }
+
+  if (io_ofd == -1)
+    {
+      if (setbuf)
+	mu_stream_ioctl (iostream, MU_IOCTL_TRANSPORT_BUFFER,
+			 MU_IOCTL_OP_SET, &oldbuf);
+      io_enable_crlf (1);
+    }
+  free (buf);
+  return rc ? rc : rdrc;
 }
 
 int
@@ -356,6 +600,53 @@ io_flush ()
   mu_stream_flush (iostream);
 }
 
+/* Wait until input is available from the client or on the descriptor
+   FD (unless it is -1), or until the timeout TO expires (NULL means no
+   timeout).  Return a bitmask of IO_READY_CLIENT and IO_READY_FD (0 if
+   the timeout expired), or -1 on error. */
+int
+io_wait_input (int fd, struct timeval *to)
+{
+  int flags = MU_STREAM_READY_RD;
+  struct timeval zero = { 0, 0 };
+  fd_set rdset;
+  int rc;
+
+  /* The input may already be buffered in the stream. */
+  rc = mu_stream_wait (iostream, &flags, fd == -1 ? to : &zero);
+  if (rc == 0)
+    {
+      if (flags & MU_STREAM_READY_RD)
+	return IO_READY_CLIENT;
+      if (fd == -1)
+	return 0;
+    }
+  else if (rc != ENOSYS)
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "mu_stream_wait", NULL, rc);
+      return -1;
+    }
+
+  FD_ZERO (&rdset);
+  FD_SET (io_ifd, &rdset);
+  if (fd != -1)
+    FD_SET (fd, &rdset);
+  rc = select ((fd > io_ifd ? fd : io_ifd) + 1, &rdset, NULL, NULL, to);
+  if (rc == -1)
+    {
+      if (errno == EINTR)
+	return 0;
+      mu_diag_funcall (MU_DIAG_ERROR, "select", NULL, errno);
+      return -1;
+    }
+  rc = 0;
+  if (FD_ISSET (io_ifd, &rdset))
+    rc |= IO_READY_CLIENT;
+  if (fd != -1 && FD_ISSET (fd, &rdset))
+    rc |= IO_READY_FD;
+  return rc;
+}
+
 void
 io_getline (char **pbuf, size_t *psize, size_t *pnbytes)
 {
@@ -695,7 +986,10 @@ imap4d_readline (struct imap4d_tokbuf *tok)
 	  /* Client can ask for non-synchronised literal,
 	     if a '+' is appended to the octet count. */
 	  if (*sp == '}')
-	    io_sendf ("+ GO AHEAD\n");
+	    {
+	      io_sendf ("+ GO AHEAD\n");
+	      io_flush ();
+	    }
 	  else if (*sp != '+')
 	    break;
 	  xscript_declare_client_payload (number);
@@ -0,0 +1,854 @@
+/* GNU Mailutils -- a suite of utilities for electronic mail
+   Copyright (C) 2022 Free Software Foundation, Inc.
+
+   GNU Mailutils is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   GNU Mailutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Mailutils.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include "imap4d.h"
+
+/* Mod-sequences (RFC 7162).
+
+   The mod-sequences of a mailbox are kept in a log file beside it:
+   ".mu-modseq" in the directory of a maildir or MH mailbox, and
+   ".NAME.modseq" in the directory of a mailbox file NAME.  The log is
+   the same for all mailbox formats.  Its first line is
+
+     MODSEQ FLOOR
+
+   and the rest of it consists of records
+
+     MODSEQ UID FLAGS
+
+   each of which states that message UID was assigned mod-sequence
+   MODSEQ when its flags became FLAGS (a decimal attribute bitmask).
+   FLAGS is "-" if the message was expunged.  Later records override
+   earlier ones.  All mod-sequences in the log are greater than FLOOR,
+   and expunged messages are tracked only since FLOOR.
+
+   Mod-sequences are assigned by comparing the flags recorded in the
+   log with the actual ones, so that changes made by other programs are
+   noticed as well, albeit only when imap4d rescans the mailbox.  Each
+   comparison assigns a single new mod-sequence to all the changes it
+   finds.  The log is accessed under an exclusive fcntl lock and
+   appended to, so that several imap4d processes can share it.  When it
+   grows too long, it is rewritten and the records of expunged messages
+   are discarded. */
+
+#define MODSEQ_DIR_LOG_NAME ".mu-modseq"
+#define MODSEQ_FILE_LOG_SUFFIX ".modseq"
+#define MODSEQ_LOG_MAGIC "MODSEQ"
+/* Expunged flags value */
+#define MODSEQ_GONE (-1)
+/* The log is compacted when it has more than twice as many records as
+   there are messages in the mailbox, plus this number. */
+#define MODSEQ_COMPACT_SLACK 1024
+
+struct modseq_msg
+{
+  size_t uid;           /* Message UID */
+  int flags;            /* Recorded flags, or MODSEQ_GONE */
+  modseq_t modseq;      /* Mod-sequence, or 0 if not recorded */
+  int check;            /* Flags must be compared with the recorded ones */
+};
+
+struct modseq_vanished
+{
+  size_t uid;           /* UID of the expunged message */
+  modseq_t modseq;      /* Mod-sequence of the expunge */
+};
+
+struct modseq_log
+{
+  char *file_name;      /* Log file name */
+  uid_t owner;          /* Mailbox owner */
+  int fd;               /* Log file descriptor */
+  dev_t dev;            /* Device and */
+  ino_t ino;            /* inode of the log file */
+  off_t offset;         /* Offset of the first unread record */
+  size_t nrec;          /* Number of records in the log */
+  modseq_t floor;       /* Mod-sequence floor */
+  modseq_t highest;     /* Highest mod-sequence */
+  struct modseq_msg *msg;       /* Mailbox messages, in UID order */
+  size_t nmsg;
+  size_t maxmsg;
+  int resync;           /* Records for unknown messages were inserted
+			   out of order: msg no longer matches the
+			   message numbering. */
+  struct modseq_vanished *van;  /* Expunged messages */
+  size_t nvan;
+  size_t maxvan;
+  char *buf;            /* Output buffer */
+  size_t buflen;
+  size_t bufsize;
+};
+
+/* Mod-sequence support state of the session. */
+int condstore_enabled;
+int qresync_enabled;
+/* The log of the selected mailbox, or NULL if the mailbox has no
+   mod-sequences. */
+modseq_log_t selected_modseq;
+
+/* Return the name of the log file of the mailbox MBX and store the
+   mailbox owner in *POWNER. */
+static char *
+modseq_log_name (mu_mailbox_t mbx, uid_t *powner)
+{
+  mu_url_t url;
+  char const *path;
+  struct stat st;
+  char *dir, *base, *name;
+
+  if (mu_mailbox_get_url (mbx, &url)
+      || mu_url_sget_path (url, &path)
+      || path[0] != '/'
+      || stat (path, &st))
+    return NULL;
+  *powner = st.st_uid;
+  if (S_ISDIR (st.st_mode))
+    return mu_make_file_name (path, MODSEQ_DIR_LOG_NAME);
+
+  dir = mu_strdup (path);
+  base = strrchr (dir, '/');
+  *base++ = 0;
+  name = mu_alloc (strlen (dir) + strlen (base)
+		   + sizeof (MODSEQ_FILE_LOG_SUFFIX) + 2);
+  sprintf (name, "%s/.%s%s", dir, base, MODSEQ_FILE_LOG_SUFFIX);
+  free (dir);
+  return name;
+}
+
+static int
+modseq_log_lock (int fd, int type)
+{
+  struct flock fl;
+
+  memset (&fl, 0, sizeof fl);
+  fl.l_type = type;
+  fl.l_whence = SEEK_SET;
+  while (fcntl (fd, F_SETLKW, &fl))
+    {
+      if (errno != EINTR)
+	return errno;
+    }
+  return 0;
+}
+
+/* Open the log file and lock it.  If the log is empty, initialize it.
+   A new log starts from the current time in microseconds, so that its
+   mod-sequences are greater than those of any log it could replace.
+   The log usually resides in a directory other users can write to,
+   so it is opened with mu_sidecar_open. */
+static int
+modseq_log_open_file (modseq_log_t log)
+{
+  struct stat st;
+  int rc;
+
+  rc = mu_sidecar_open (log->file_name, O_RDWR | O_CREAT, log->owner,
+			&log->fd, NULL);
+  if (rc)
+    {
+      log->fd = -1;
+      return rc;
+    }
+  rc = modseq_log_lock (log->fd, F_WRLCK);
+  if (rc == 0 && fstat (log->fd, &st))
+    rc = errno;
+  if (rc == 0 && st.st_size == 0)
+    {
+      struct timeval tv;
+      char hdr[64];
+      int len;
+
+      gettimeofday (&tv, NULL);
+      len = snprintf (hdr, sizeof hdr, "%s %llu\n", MODSEQ_LOG_MAGIC,
+		      (unsigned long long) tv.tv_sec * 1000000 + tv.tv_usec);
+      if (write (log->fd, hdr, len) != len)
+	rc = errno;
+    }
+  if (rc)
+    {
+      close (log->fd);
+      log->fd = -1;
+      return rc;
+    }
+  log->dev = st.st_dev;
+  log->ino = st.st_ino;
+  log->offset = 0;
+  log->nrec = 0;
+  log->nvan = 0;
+  return 0;
+}
+
+/* Lock the log.  If it has been replaced by another process, reopen it
+   and start reading it anew. */
+static int
+modseq_log_acquire (modseq_log_t log)
+{
+  struct stat st;
+  int rc;
+
+  if (log->fd == -1)
+    return modseq_log_open_file (log);
+  rc = modseq_log_lock (log->fd, F_WRLCK);
+  if (rc)
+    return rc;
+  if (stat (log->file_name, &st) == 0
+      && st.st_dev == log->dev && st.st_ino == log->ino)
+    return 0;
+  close (log->fd);
+  return modseq_log_open_file (log);
+}
+
+static void
+modseq_log_release (modseq_log_t log)
+{
+  modseq_log_lock (log->fd, F_UNLCK);
+}
+
+/* Look up UID in the message table.  If not found, return NULL and
+   store in *PPOS the index where it should be inserted. */
+static struct modseq_msg *
+modseq_log_find (modseq_log_t log, size_t uid, size_t *ppos)
+{
+  size_t lo = 0, hi = log->nmsg;
+
+  while (lo < hi)
+    {
+      size_t mid = (lo + hi) / 2;
+      if (log->msg[mid].uid == uid)
+	return &log->msg[mid];
+      if (log->msg[mid].uid < uid)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  if (ppos)
+    *ppos = lo;
+  return NULL;
+}
+
+static void
+modseq_log_add_vanished (modseq_log_t log, size_t uid, modseq_t modseq)
+{
+  if (log->nvan == log->maxvan)
+    log->van = mu_2nrealloc (log->van, &log->maxvan, sizeof log->van[0]);
+  log->van[log->nvan].uid = uid;
+  log->van[log->nvan].modseq = modseq;
+  log->nvan++;
+}
+
+static void
+modseq_log_apply (modseq_log_t log, modseq_t modseq, size_t uid, int flags)
+{
+  size_t pos;
+  struct modseq_msg *mp = modseq_log_find (log, uid, &pos);
+  if (!mp && flags != MODSEQ_GONE)
+    {
+      /* A message we have not seen yet, recorded by another process. */
+      if (log->nmsg == log->maxmsg)
+	log->msg = mu_2nrealloc (log->msg, &log->maxmsg, sizeof log->msg[0]);
+      if (pos < log->nmsg)
+	{
+	  memmove (log->msg + pos + 1, log->msg + pos,
+		   (log->nmsg - pos) * sizeof log->msg[0]);
+	  log->resync = 1;
+	}
+      log->nmsg++;
+      mp = &log->msg[pos];
+      mp->uid = uid;
+      mp->check = 0;
+    }
+  if (mp)
+    {
+      mp->modseq = modseq;
+      mp->flags = flags;
+    }
+  if (flags == MODSEQ_GONE)
+    modseq_log_add_vanished (log, uid, modseq);
+  if (modseq > log->highest)
+    log->highest = modseq;
+  log->nrec++;
+}
+
+/* Read the records added to the log since the last call. */
+static int
+modseq_log_replay (modseq_log_t log)
+{
+  struct stat st;
+  char *buf, *p, *end;
+  size_t size;
+  ssize_t n;
+
+  if (fstat (log->fd, &st))
+    return errno;
+  if (st.st_size <= log->offset)
+    return 0;
+  size = st.st_size - log->offset;
+  buf = mu_alloc (size + 1);
+  n = pread (log->fd, buf, size, log->offset);
+  if (n < 0)
+    {
+      int rc = errno;
+      free (buf);
+      return rc;
+    }
+  buf[n] = 0;
+  end = buf + n;
+  p = buf;
+
+  if (log->offset == 0)
+    {
+      size_t len = sizeof (MODSEQ_LOG_MAGIC) - 1;
+      if (strncmp (p, MODSEQ_LOG_MAGIC, len) || p[len] != ' ')
+	{
+	  free (buf);
+	  return MU_ERR_FORMAT;
+	}
+      log->floor = strtoull (p + len + 1, &p, 10);
+      if (*p != '\n')
+	{
+	  free (buf);
+	  return MU_ERR_FORMAT;
+	}
+      p++;
+      log->highest = log->floor;
+    }
+
+  while (p < end)
+    {
+      char *eol = memchr (p, '\n', end - p);
+      unsigned long long modseq;
+      unsigned long uid;
+      int flags;
+      char *q;
+
+      if (!eol)
+	break;  /* Incomplete record: leave it for the next time */
+      *eol = 0;
+      modseq = strtoull (p, &q, 10);
+      if (*q == ' ')
+	{
+	  uid = strtoul (q + 1, &q, 10);
+	  if (*q == ' ')
+	    {
+	      if (q[1] == '-')
+		flags = MODSEQ_GONE;
+	      else
+		flags = strtol (q + 1, NULL, 10);
+	      if (modseq && uid)
+		modseq_log_apply (log, modseq, uid, flags);
+	    }
+	}
+      p = eol + 1;
+    }
+  log->offset += p - buf;
+  free (buf);
+  return 0;
+}
+
+static void
+modseq_log_record (modseq_log_t log, modseq_t modseq, size_t uid, int flags)
+{
+  char rec[64];
+  int len;
+
+  if (flags == MODSEQ_GONE)
+    len = snprintf (rec, sizeof rec, "%llu %lu -\n",
+		    (unsigned long long) modseq, (unsigned long) uid);
+  else
+    len = snprintf (rec, sizeof rec, "%llu %lu %d\n",
+		    (unsigned long long) modseq, (unsigned long) uid, flags);
+  while (log->buflen + len > log->bufsize)
+    log->buf = mu_2nrealloc (log->buf, &log->bufsize, 1);
+  memcpy (log->buf + log->buflen, rec, len);
+  log->buflen += len;
+  log->nrec++;
+}
+
+static int
+modseq_log_flush (modseq_log_t log)
+{
+  int rc = 0;
+
+  if (log->buflen)
+    {
+      if (lseek (log->fd, 0, SEEK_END) == -1
+	  || write (log->fd, log->buf, log->buflen) != log->buflen)
+	rc = errno;
+      else
+	log->offset += log->buflen;
+      log->buflen = 0;
+    }
+  return rc;
+}
+
+/* Rewrite the log, keeping only the records of existing messages.
+   The new log is written to a temporary file, which then replaces the
+   log.  Other processes notice that when they next lock the log. */
+static void
+modseq_log_compact (modseq_log_t log)
+{
+  char *tmpname;
+  int fd;
+  size_t i;
+  int rc;
+  struct stat st;
+
+  rc = mu_sidecar_tempfile (log->file_name, &fd, &tmpname);
+  if (rc)
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "mu_sidecar_tempfile", log->file_name,
+		       rc);
+      return;
+    }
+
+  log->buflen = 0;
+  log->nrec = 0;
+  for (i = 0; i < log->nmsg; i++)
+    if (log->msg[i].modseq && log->msg[i].flags != MODSEQ_GONE)
+      modseq_log_record (log, log->msg[i].modseq, log->msg[i].uid,
+			 log->msg[i].flags);
+
+  if (dprintf (fd, "%s %llu\n", MODSEQ_LOG_MAGIC,
+	       (unsigned long long) log->highest) < 0
+      || write (fd, log->buf, log->buflen) != log->buflen
+      || fstat (fd, &st))
+    rc = errno;
+  else if (rename (tmpname, log->file_name))
+    rc = errno;
+  log->buflen = 0;
+
+  if (rc)
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "modseq_log_compact", tmpname, rc);
+      close (fd);
+      unlink (tmpname);
+      free (tmpname);
+      return;
+    }
+  free (tmpname);
+
+  /* Switch to the new log.  The lock on the old one is released when
+     it is closed. */
+  modseq_log_lock (fd, F_WRLCK);
+  close (log->fd);
+  log->fd = fd;
+  log->dev = st.st_dev;
+  log->ino = st.st_ino;
+  log->offset = st.st_size;
+  log->floor = log->highest;
+  log->nvan = 0;
+}
+
+static int
+modseq_log_commit_changes (modseq_log_t log)
+{
+  int rc = modseq_log_flush (log);
+  if (rc)
+    mu_diag_funcall (MU_DIAG_ERROR, "write", log->file_name, rc);
+  else if (log->nrec > 2 * log->nmsg + MODSEQ_COMPACT_SLACK)
+    modseq_log_compact (log);
+  modseq_log_release (log);
+  return rc;
+}
+
+static int
+message_uid_flags (mu_mailbox_t mbx, size_t msgno, size_t *puid, int *pflags)
+{
+  mu_message_t msg;
+  mu_attribute_t attr;
+  int rc;
+
+  if ((rc = mu_mailbox_get_message (mbx, msgno, &msg)) != 0
+      || (rc = mu_message_get_uid (msg, puid)) != 0
+      || (rc = mu_message_get_attribute (msg, &attr)) != 0)
+    return rc;
+  return mu_attribute_get_flags (attr, pflags);
+}
+
+/* Create the mod-sequence log for mailbox MBX. */
+int
+modseq_log_open (mu_mailbox_t mbx, modseq_log_t *ret)
+{
+  modseq_log_t log;
+  int rc;
+
+  log = mu_zalloc (sizeof (*log));
+  log->file_name = modseq_log_name (mbx, &log->owner);
+  if (!log->file_name)
+    {
+      free (log);
+      return ENOSYS;
+    }
+  rc = modseq_log_open_file (log);
+  if (rc == 0)
+    {
+      modseq_log_release (log);
+      *ret = log;
+    }
+  else
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "modseq_log_open", log->file_name, rc);
+      free (log->file_name);
+      free (log);
+    }
+  return rc;
+}
+
+void
+modseq_log_destroy (modseq_log_t *plog)
+{
+  modseq_log_t log = *plog;
+  if (log)
+    {
+      if (log->fd != -1)
+	close (log->fd);
+      free (log->file_name);
+      free (log->msg);
+      free (log->van);
+      free (log->buf);
+      free (log);
+      *plog = NULL;
+    }
+}
+
+/* Compare the flags of the first N messages that were marked by
+   modseq_log_touch with the recorded ones, and assign MODSEQ to those
+   that have changed.  Return 1 if there were any. */
+static int
+modseq_log_check_touched (modseq_log_t log, mu_mailbox_t mbx, size_t n,
+			  modseq_t modseq)
+{
+  size_t i;
+  int changed = 0;
+
+  for (i = 0; i < n; i++)
+    {
+      struct modseq_msg *mp = &log->msg[i];
+      size_t uid;
+      int flags;
+
+      if (!mp->check)
+	continue;
+      mp->check = 0;
+      if (message_uid_flags (mbx, i + 1, &uid, &flags) == 0
+	  && uid == mp->uid && flags != mp->flags)
+	{
+	  mp->flags = flags;
+	  mp->modseq = modseq;
+	  modseq_log_record (log, modseq, uid, flags);
+	  changed = 1;
+	}
+    }
+  return changed;
+}
+
+static int
+modseq_log_begin (modseq_log_t log)
+{
+  int rc = modseq_log_acquire (log);
+  if (rc == 0)
+    {
+      rc = modseq_log_replay (log);
+      if (rc)
+	modseq_log_release (log);
+    }
+  return rc;
+}
+
+/* Bring the log in sync with the mailbox, assigning a new mod-sequence
+   to the messages whose flags have changed, to the new messages and to
+   the expunged ones.  If FIRST is greater than 1, only the messages
+   starting from FIRST are examined (e.g. if the mailbox has only been
+   appended to), and of the ones before it only those marked by
+   modseq_log_touch. */
+int
+modseq_log_reconcile (modseq_log_t log, mu_mailbox_t mbx, size_t first)
+{
+  struct modseq_msg *newmsg;
+  size_t total, i, j, n;
+  modseq_t modseq;
+  int changed;
+  int rc;
+
+  rc = mu_mailbox_messages_count (mbx, &total);
+  if (rc)
+    return rc;
+  rc = modseq_log_begin (log);
+  if (rc)
+    return rc;
+
+  modseq = log->highest + 1;
+  if (first < 1 || first - 1 > log->nmsg || first - 1 > total
+      || log->resync)
+    first = 1;
+  log->resync = 0;
+  changed = modseq_log_check_touched (log, mbx, first - 1, modseq);
+
+  /* Merge the rest of the mailbox with the log.  Both are ordered by
+     UID. */
+  newmsg = mu_calloc (total ? total : 1, sizeof newmsg[0]);
+  if (first > 1)
+    memcpy (newmsg, log->msg, (first - 1) * sizeof newmsg[0]);
+  j = n = first - 1;
+  for (i = first - 1; i < total; i++)
+    {
+      size_t uid;
+      int flags;
+
+      if (message_uid_flags (mbx, i + 1, &uid, &flags))
+	continue;
+      for (; j < log->nmsg && log->msg[j].uid < uid; j++)
+	if (log->msg[j].flags != MODSEQ_GONE)
+	  {
+	    modseq_log_record (log, modseq, log->msg[j].uid, MODSEQ_GONE);
+	    modseq_log_add_vanished (log, log->msg[j].uid, modseq);
+	    changed = 1;
+	  }
+      if (j < log->nmsg && log->msg[j].uid == uid)
+	newmsg[n] = log->msg[j++];
+      else
+	{
+	  newmsg[n].uid = uid;
+	  newmsg[n].modseq = 0;
+	}
+      newmsg[n].check = 0;
+      if (newmsg[n].modseq == 0 || newmsg[n].flags != flags)
+	{
+	  newmsg[n].flags = flags;
+	  newmsg[n].modseq = modseq;
+	  modseq_log_record (log, modseq, uid, flags);
+	  changed = 1;
+	}
+      n++;
+    }
+  for (; j < log->nmsg; j++)
+    if (log->msg[j].flags != MODSEQ_GONE)
+      {
+	modseq_log_record (log, modseq, log->msg[j].uid, MODSEQ_GONE);
+	modseq_log_add_vanished (log, log->msg[j].uid, modseq);
+	changed = 1;
+      }
+
+  free (log->msg);
+  log->msg = newmsg;
+  log->nmsg = n;
+  log->maxmsg = total ? total : 1;
+  if (changed)
+    log->highest = modseq;
+
+  return modseq_log_commit_changes (log);
+}
+
+/* Assign a new mod-sequence to the messages marked by modseq_log_touch
+   whose flags have changed. */
+int
+modseq_log_commit (modseq_log_t log, mu_mailbox_t mbx)
+{
+  int rc = modseq_log_begin (log);
+  if (rc == 0)
+    {
+      if (modseq_log_check_touched (log, mbx, log->nmsg, log->highest + 1))
+	log->highest++;
+      rc = modseq_log_commit_changes (log);
+    }
+  return rc;
+}
+
+/* Mark message MSGNO for checking by the next modseq_log_reconcile. */
+void
+modseq_log_touch (modseq_log_t log, size_t msgno)
+{
+  if (msgno >= 1 && msgno <= log->nmsg)
+    log->msg[msgno-1].check = 1;
+}
+
+/* Read the changes made by other processes. */
+int
+modseq_log_refresh (modseq_log_t log)
+{
+  int rc = modseq_log_begin (log);
+  if (rc == 0)
+    modseq_log_release (log);
+  return rc;
+}
+
+modseq_t
+modseq_log_highest (modseq_log_t log)
+{
+  return log->highest;
+}
+
+/* Return the mod-sequence of message MSGNO, or 0 if it is unknown. */
+modseq_t
+modseq_log_get (modseq_log_t log, size_t msgno)
+{
+  if (msgno >= 1 && msgno <= log->nmsg)
+    return log->msg[msgno-1].modseq;
+  return 0;
+}
+
+/* Return the UID of message MSGNO, as of the last reconciliation, or 0
+   if it is unknown. */
+size_t
+modseq_log_uid (modseq_log_t log, size_t msgno)
+{
+  if (msgno >= 1 && msgno <= log->nmsg)
+    return log->msg[msgno-1].uid;
+  return 0;
+}
+
+static int
+msgset_add_filtered (mu_msgset_t set, size_t beg, size_t end,
+		     mu_msgset_t filter)
+{
+  mu_list_t list;
+  mu_iterator_t itr;
+  int rc;
+
+  if (!filter)
+    return mu_msgset_add_range (set, beg, end, MU_MSGSET_NUM);
+
+  rc = mu_msgset_get_list (filter, &list);
+  if (rc == 0)
+    rc = mu_list_get_iterator (list, &itr);
+  if (rc)
+    return rc;
+  for (mu_iterator_first (itr); rc == 0 && !mu_iterator_is_done (itr);
+       mu_iterator_next (itr))
+    {
+      struct mu_msgrange *r;
+      size_t b, e;
+
+      mu_iterator_current (itr, (void **) &r);
+      b = r->msg_beg > beg ? r->msg_beg : beg;
+      e = (r->msg_end == 0 || r->msg_end > end) ? end : r->msg_end;
+      if (b <= e)
+	rc = mu_msgset_add_range (set, b, e, MU_MSGSET_NUM);
+    }
+  mu_iterator_destroy (&itr);
+  return rc;
+}
+
+/* Return in *RET the set of UIDs of the messages expunged since
+   mod-sequence SINCE.  If KNOWN is not NULL, limit the result to the
+   UIDs it contains.  UIDNEXT is the next UID to be assigned in the
+   mailbox.  If SINCE is older than the log, return all UIDs below
+   UIDNEXT that are not in use. */
+int
+modseq_log_vanished (modseq_log_t log, modseq_t since, mu_msgset_t known,
+		     size_t uidnext, mu_msgset_t *ret)
+{
+  mu_msgset_t set;
+  size_t i;
+  int rc;
+
+  rc = mu_msgset_create (&set, NULL, MU_MSGSET_NUM);
+  if (rc)
+    return rc;
+
+  if (since < log->floor)
+    {
+      size_t prev = 0;
+
+      for (i = 0; rc == 0 && i <= log->nmsg; i++)
+	{
+	  size_t uid = i < log->nmsg ? log->msg[i].uid : uidnext;
+	  if (uid > prev + 1)
+	    rc = msgset_add_filtered (set, prev + 1, uid - 1, known);
+	  prev = uid;
+	}
+    }
+  else
+    {
+      for (i = 0; rc == 0 && i < log->nvan; i++)
+	{
+	  size_t uid = log->van[i].uid;
+	  struct modseq_msg *mp;
+
+	  if (log->van[i].modseq <= since)
+	    continue;
+	  mp = modseq_log_find (log, uid, NULL);
+	  if (mp && mp->flags != MODSEQ_GONE)
+	    continue;
+	  rc = msgset_add_filtered (set, uid, uid, known);
+	}
+    }
+
+  if (rc == 0)
+    rc = mu_msgset_aggregate (set);
+  if (rc)
+    mu_msgset_free (set);
+  else
+    *ret = set;
+  return rc;
+}
+
+/* Print the VANISHED (EARLIER) response for the messages expunged since
+   SINCE.  See modseq_log_vanished for the description of KNOWN. */
+void
+imap4d_vanished_earlier (modseq_t since, mu_msgset_t known)
+{
+  mu_msgset_t set;
+  size_t uidnext = 1;
+  int rc;
+
+  mu_mailbox_uidnext (mbox, &uidnext);
+  rc = modseq_log_vanished (selected_modseq, since, known, uidnext, &set);
+  if (rc)
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "modseq_log_vanished", NULL, rc);
+      return;
+    }
+  if (!mu_msgset_is_empty (set))
+    {
+      io_sendf ("* VANISHED (EARLIER) ");
+      mu_msgset_imap_print (iostream, set);
+      io_sendf ("\n");
+    }
+  mu_msgset_free (set);
+}
+
+/* Start tracking the mod-sequences of the selected mailbox. */
+void
+imap4d_modseq_select (void)
+{
+  modseq_log_destroy (&selected_modseq);
+  if (condstore_enabled && mbox)
+    modseq_log_open (mbox, &selected_modseq);
+}
+
+/* Enable CONDSTORE for the rest of the session.  This is done by the
+   ENABLE command and implicitly by the first command that uses
+   mod-sequences.  Return 0 if the selected mailbox (if any) supports
+   mod-sequences. */
+int
+imap4d_condstore_enable (void)
+{
+  if (!condstore_enabled)
+    {
+      condstore_enabled = 1;
+      if (mbox)
+	{
+	  imap4d_modseq_select ();
+	  if (selected_modseq
+	      && modseq_log_reconcile (selected_modseq, mbox, 1) == 0)
+	    io_untagged_response (RESP_OK,
+				  "[HIGHESTMODSEQ %llu] Highest",
+				  modseq_log_highest (selected_modseq));
+	}
+    }
+  return (mbox && !selected_modseq) ? MU_ERR_NOENT : 0;
+}
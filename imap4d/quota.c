@@ -75,7 +75,7 @@ addsize (mu_folder_t folder, struct mu_list_response *resp, void *data)
   return 0;
 }
   
-void
+static int
 directory_size (const char *dirname, mu_off_t *size)
 {
   mu_folder_t folder;
@@ -86,7 +86,7 @@ directory_size (const char *dirname, mu_off_t *size)
   if (status)
     {
       mu_diag_funcall (MU_DIAG_ERROR, "mu_folder_create", dirname, status);
-      return;
+      return status;
     }
 
   status = mu_folder_open (folder, MU_STREAM_READ);
@@ -94,7 +94,7 @@ directory_size (const char *dirname, mu_off_t *size)
     {
       mu_diag_funcall (MU_DIAG_ERROR, "mu_folder_open", dirname, status);
       mu_folder_destroy (&folder);
-      return;
+      return status;
     }
 
   memset (&sizeinfo, 0, sizeof (sizeinfo));
@@ -112,16 +112,53 @@ directory_size (const char *dirname, mu_off_t *size)
 		      (unsigned long)sizeinfo.nfiles,
 		      (unsigned long)sizeinfo.nerrs);
     }
+  mu_folder_destroy (&folder);
   *size = sizeinfo.size;
+  return status;
 }
 
 
 mu_off_t used_size;
 
+/* Usage ledger is in use. */
+static int ledger_enabled;
+
 void
 quota_setup (void)
 {
-  directory_size (real_homedir, &used_size);
+  int rc;
+  
+  if (quota_reconcile_interval)
+    {
+      time_t stamp;
+      
+      rc = mu_usage_ledger_read (real_homedir, &used_size, &stamp);
+      if (rc == 0)
+	{
+	  time_t now = time (NULL);
+	  if (stamp <= now && now - stamp < quota_reconcile_interval)
+	    {
+	      ledger_enabled = 1;
+	      return;
+	    }
+	}
+      else if (rc != ENOENT)
+	mu_diag_funcall (MU_DIAG_ERROR, "mu_usage_ledger_read",
+			 real_homedir, rc);
+    }
+
+  /* No ledger, or it is outdated: compute the actual usage. */
+  used_size = 0;
+  if (directory_size (real_homedir, &used_size) == 0
+      && quota_reconcile_interval)
+    {
+      rc = mu_usage_ledger_write (real_homedir, used_size);
+      if (rc)
+	mu_diag_funcall (MU_DIAG_ERROR, "mu_usage_ledger_write",
+			 real_homedir, rc);
+      else
+	ledger_enabled = 1;
+    }
 }
 
 int
@@ -136,6 +173,17 @@ quota_check (mu_off_t size)
   if (auth_data->quota == 0)
     return RESP_OK;
 
+  if (ledger_enabled)
+    {
+      /* Pick up changes made by other processes. */
+      rc = mu_usage_ledger_read (real_homedir, &used_size, NULL);
+      if (rc)
+	{
+	  mu_diag_funcall (MU_DIAG_ERROR, "mu_usage_ledger_read",
+			   real_homedir, rc);
+	  ledger_enabled = 0;
+	}
+    }
   total = used_size;
 
   mailbox_name = namespace_get_name ("INBOX", &record, NULL);
@@ -196,5 +244,53 @@ quota_check (mu_off_t size)
 void
 quota_update (mu_off_t size)
 {
+  if (ledger_enabled)
+    {
+      int rc = mu_usage_ledger_update (real_homedir, size, &used_size);
+      if (rc == 0)
+	return;
+      mu_diag_funcall (MU_DIAG_ERROR, "mu_usage_ledger_update",
+		       real_homedir, rc);
+      ledger_enabled = 0;
+    }
   used_size += size;
 }
+
+/* Return the size of the mailbox MBX, if it is accounted in the quota
+   usage, and -1 otherwise.  This is used together with
+   quota_mailbox_update to account for the space freed by expunging
+   messages. */
+mu_off_t
+quota_mailbox_size (mu_mailbox_t mbx)
+{
+  mu_url_t url;
+  char const *path;
+  size_t len;
+  mu_off_t size;
+  
+  if (!auth_data || auth_data->quota == 0 || !real_homedir)
+    return -1;
+  if (mu_mailbox_get_url (mbx, &url) || mu_url_sget_path (url, &path))
+    return -1;
+  len = strlen (real_homedir);
+  while (len > 1 && real_homedir[len-1] == '/')
+    len--;
+  if (strncmp (path, real_homedir, len) || path[len] != '/')
+    return -1;
+  if (mu_mailbox_get_size (mbx, &size))
+    return -1;
+  return size;
+}
+
+/* Update quota usage after modifying the mailbox MBX, whose size before
+   modification, as returned by quota_mailbox_size, was OLDSIZE. */
+void
+quota_mailbox_update (mu_mailbox_t mbx, mu_off_t oldsize)
+{
+  mu_off_t size;
+  
+  if (oldsize < 0 || mu_mailbox_get_size (mbx, &size))
+    return;
+  if (size != oldsize)
+    quota_update (size - oldsize);
+}
@@ -30,6 +30,13 @@
    node is of type search_node (see below) and contains either data
    (struct value) or an instruction, which evaluates to a boolean value.
 
+   Before execution, the function search_plan reorders the operands of
+   AND and OR nodes so that cheaper conditions are evaluated first, and
+   folds constant subexpressions.  Since evaluation of AND and OR stops
+   as soon as the result is known, this avoids examining headers and
+   bodies of messages that are already excluded by their flags, size or
+   date.
+
    The function search_run recursively evaluates the tree and returns a
    boolean number, 0 or 1 depending on whether the current message meets
    the search conditions. */
@@ -69,6 +76,15 @@ struct value
 
 #define MAX_NODE_ARGS 2
 
+/* Estimated cost of evaluating a condition, in ascending order. */
+enum search_cost
+  {
+    cost_const,      /* Constant value */
+    cost_attr,       /* Message number, UID, flags, size or internal date */
+    cost_header,     /* Header fields */
+    cost_body        /* Message body */
+  };
+
 struct search_node;
 
 typedef void (*instr_fn) (struct parsebuf *, struct search_node *,
@@ -85,6 +101,10 @@ struct search_node
       instr_fn fun;
       int narg;
       struct search_node *arg[MAX_NODE_ARGS];
+      enum search_cost cost;    /* Estimated evaluation cost */
+      size_t evals;             /* Number of evaluations */
+      size_t hits;              /* Number of times it evaluated to true */
+      txtidx_set_t cand;        /* Candidate messages for BODY and TEXT */
     } key;
     struct search_node *arg[2]; /* Binary operation */
     struct value value;
@@ -129,6 +149,8 @@ static void cond_to (struct parsebuf *, struct search_node *,
 		     struct value *, struct value *);
 static void cond_uid (struct parsebuf *, struct search_node *,
 		      struct value *, struct value *);
+static void cond_modseq (struct parsebuf *, struct search_node *,
+			 struct value *, struct value *);
 
 /* A basic condition structure */
 struct cond
@@ -137,35 +159,38 @@ struct cond
   char *argtypes;      /* String of argument types or NULL if it takes no
 			  args */
   instr_fn inst;       /* Corresponding instruction function */
+  enum search_cost cost; /* Estimated evaluation cost */
 };
 
 /* Types are: s -- string
 	      n -- number
 	      d -- date
 	      m -- message set
+	      q -- mod-sequence, optionally preceded by entry name and type
 */
 
 /* List of basic conditions. "ALL" and <message set> is handled separately */
 struct cond condlist[] =
 {
-  { "BCC",        "s",  cond_bcc },
-  { "BEFORE",     "d",  cond_before },
-  { "BODY",       "s",  cond_body },
-  { "CC",         "s",  cond_cc },
-  { "FROM",       "s",  cond_from },
-  { "HEADER",     "ss", cond_header },
-  { "KEYWORD",    "s",  cond_keyword },
-  { "LARGER",     "n",  cond_larger },
-  { "ON",         "d",  cond_on },
-  { "SENTBEFORE", "d",  cond_sentbefore },
-  { "SENTON",     "d",  cond_senton },
-  { "SENTSINCE",  "d",  cond_sentsince },
-  { "SINCE",      "d",  cond_since },
-  { "SMALLER",    "n",  cond_smaller },
-  { "SUBJECT",    "s",  cond_subject },
-  { "TEXT",       "s",  cond_text },
-  { "TO",         "s",  cond_to },
-  { "UID",        "u",  cond_uid },
+  { "BCC",        "s",  cond_bcc,        cost_header },
+  { "BEFORE",     "d",  cond_before,     cost_attr },
+  { "BODY",       "s",  cond_body,       cost_body },
+  { "CC",         "s",  cond_cc,         cost_header },
+  { "FROM",       "s",  cond_from,       cost_header },
+  { "HEADER",     "ss", cond_header,     cost_header },
+  { "KEYWORD",    "s",  cond_keyword,    cost_attr },
+  { "LARGER",     "n",  cond_larger,     cost_attr },
+  { "MODSEQ",     "q",  cond_modseq,     cost_attr },
+  { "ON",         "d",  cond_on,         cost_attr },
+  { "SENTBEFORE", "d",  cond_sentbefore, cost_header },
+  { "SENTON",     "d",  cond_senton,     cost_header },
+  { "SENTSINCE",  "d",  cond_sentsince,  cost_header },
+  { "SINCE",      "d",  cond_since,      cost_attr },
+  { "SMALLER",    "n",  cond_smaller,    cost_attr },
+  { "SUBJECT",    "s",  cond_subject,    cost_header },
+  { "TEXT",       "s",  cond_text,       cost_body },
+  { "TO",         "s",  cond_to,         cost_header },
+  { "UID",        "u",  cond_uid,        cost_attr },
   { NULL }
 };
 
@@ -229,6 +254,8 @@ struct parsebuf
   char *charset;                /* Charset, other than US-ASCII requested */
 
   struct search_node *tree;     /* Parse tree */
+  int modseq;                   /* MODSEQ criterion is used */
+  int txtidx_updated;           /* Full-text index has been updated */
 
 				/* Execution time only: */
   size_t msgno;                 /* Number of current message */
@@ -242,7 +269,9 @@ static void *parse_alloc (struct parsebuf *pb, size_t size);
 static struct search_node *parse_search_key_list (struct parsebuf *pb);
 static struct search_node *parse_search_key (struct parsebuf *pb);
 static int parse_gettoken (struct parsebuf *pb, int req);
+static void search_plan (struct parsebuf *pb);
 static int search_run (struct parsebuf *pb);
+static void search_report (struct parsebuf *pb);
 static void do_search (struct parsebuf *pb);
 static int available_charset (const char *charset);
 
@@ -333,7 +362,9 @@ imap4d_search0 (imap4d_tokbuf_t tok, int isuid, char **err_text)
     }
 
   /* Execute compiled expression */
+  search_plan (&parsebuf);
   do_search (&parsebuf);
+  search_report (&parsebuf);
 
   parse_free_mem (&parsebuf);
 
@@ -347,6 +378,7 @@ void
 do_search (struct parsebuf *pb)
 {
   size_t count = 0;
+  modseq_t highest = 0;
 
   mu_mailbox_messages_count (mbox, &count);
 
@@ -364,9 +396,20 @@ do_search (struct parsebuf *pb)
 	    }
 	  else
 	    io_sendf (" %s", mu_umaxtostr (0, pb->msgno));
+	  if (pb->modseq)
+	    {
+	      modseq_t n = modseq_log_get (selected_modseq, pb->msgno);
+	      if (n > highest)
+		highest = n;
+	    }
 	}
     }
+  /* RFC 7162, 3.1.5: report the highest mod-sequence of the found
+     messages. */
+  if (highest)
+    io_sendf (" (MODSEQ %llu)", highest);
   io_sendf ("\n");
+  hdrcache_flush (selected_hdrcache);
 }
 
 /* Parse buffer functions */
@@ -421,7 +464,7 @@ parse_regmem (struct parsebuf *pb, void *mem, void (*f) (void*))
 void *
 parse_alloc (struct parsebuf *pb, size_t size)
 {
-  void *p = mu_alloc (size);
+  void *p = mu_zalloc (size);
   return parse_regmem (pb, p, NULL);
 }
 
@@ -636,6 +679,7 @@ parse_simple_key (struct parsebuf *pb)
 	  node->v.key.narg = 1;
 	  node->v.key.arg[0] = np;
 	  node->v.key.fun = cond_msgset;
+	  node->v.key.cost = cost_attr;
 
 	  parse_gettoken (pb, 0);
 
@@ -661,6 +705,7 @@ parse_simple_key (struct parsebuf *pb)
   node->v.key.keyword = condp->name;
   node->v.key.fun = condp->inst;
   node->v.key.narg = 0;
+  node->v.key.cost = condp->cost;
 
   parse_gettoken (pb, 0);
   if (condp->argtypes)
@@ -715,6 +760,37 @@ parse_simple_key (struct parsebuf *pb)
 	      arg->v.value.v.date = time;
 	      break;
 
+	    case 'q': /* [entry-name entry-type-req] mod-sequence-valzer,
+			 i.e. "0" / mod-sequence-value */
+	      if (imap4d_condstore_enable ())
+		{
+		  pb->err_mesg = "[NOMODSEQ] No mod-sequences";
+		  return NULL;
+		}
+	      if (!mu_isdigit (pb->token[0]))
+		{
+		  /* Mod-sequences are kept per message, not per flag, so
+		     the entry name and type are ignored. */
+		  parse_gettoken (pb, 0);
+		  if (pb->token)
+		    parse_gettoken (pb, 0);
+		  if (!pb->token)
+		    {
+		      pb->err_mesg = "Not enough arguments for criterion";
+		      return NULL;
+		    }
+		}
+	      number = strtoull (pb->token, &s, 10);
+	      if (*s || !mu_isdigit (pb->token[0]))
+		{
+		  pb->err_mesg = "Invalid mod-sequence";
+		  return NULL;
+		}
+	      arg->v.value.type = value_number;
+	      arg->v.value.v.number = number;
+	      pb->modseq = 1;
+	      break;
+
 	    case 'u': /* UID message set */
 	      arg->v.value.v.msgset = parse_msgset_create (pb, NULL,
 							   MU_MSGSET_NUM);
@@ -739,6 +815,241 @@ parse_simple_key (struct parsebuf *pb)
   return node;
 }
 
+/* Query planner */
+
+/* Return 1 if NODE is a constant and store its value in *VAL */
+static int
+node_const_value (struct search_node *node, int *val)
+{
+  switch (node->type)
+    {
+    case node_value:
+      if (node->v.value.type != value_number)
+	return 0;
+      *val = node->v.value.v.number != 0;
+      return 1;
+
+    case node_false:
+      *val = 0;
+      return 1;
+
+    default:
+      return 0;
+    }
+}
+
+/* Turn NODE into a constant with the value VAL */
+static void
+node_set_const (struct search_node *node, int val)
+{
+  if (val)
+    {
+      node->type = node_value;
+      node->v.value.type = value_number;
+      node->v.value.v.number = 1;
+    }
+  else
+    node->type = node_false;
+}
+
+/* Operands of a chain of AND or OR nodes */
+struct oplist
+{
+  struct search_node **op;      /* Operands */
+  enum search_cost *cost;       /* Their costs */
+  size_t n;                     /* Number of operands */
+  size_t max;                   /* Allocated size of op and cost */
+  struct search_node **bin;     /* Binary nodes of the chain */
+  size_t nbin;                  /* Number of binary nodes */
+  size_t maxbin;                /* Allocated size of bin */
+};
+
+static enum search_cost search_plan_node (struct search_node *node);
+
+/* Collect in OPL the operands of the chain of binary nodes of the
+   same TYPE rooted at NODE, planning each of them. */
+static void
+oplist_collect (struct oplist *opl, struct search_node *node,
+		enum node_type type)
+{
+  if (node->type == type)
+    {
+      if (opl->nbin == opl->maxbin)
+	opl->bin = mu_2nrealloc (opl->bin, &opl->maxbin, sizeof (opl->bin[0]));
+      opl->bin[opl->nbin++] = node;
+      oplist_collect (opl, node->v.arg[0], type);
+      oplist_collect (opl, node->v.arg[1], type);
+    }
+  else
+    {
+      if (opl->n == opl->max)
+	{
+	  opl->op = mu_2nrealloc (opl->op, &opl->max, sizeof (opl->op[0]));
+	  opl->cost = mu_realloc (opl->cost, opl->max * sizeof (opl->cost[0]));
+	}
+      opl->cost[opl->n] = search_plan_node (node);
+      opl->op[opl->n++] = node;
+    }
+}
+
+/* Plan the chain of AND or OR nodes rooted at NODE: fold constant
+   operands and order the rest by ascending cost.  The sort is stable,
+   so operands of equal cost are evaluated in the order given by the
+   client. */
+static enum search_cost
+search_plan_chain (struct search_node *node)
+{
+  struct oplist opl;
+  enum node_type type = node->type;
+  int absorb = type == node_or; /* Value that decides the result */
+  enum search_cost cost = cost_const;
+  size_t i, j;
+
+  memset (&opl, 0, sizeof opl);
+  oplist_collect (&opl, node, type);
+
+  /* Drop the neutral constants.  If any operand is the absorbing
+     constant, the whole chain evaluates to it. */
+  for (i = j = 0; i < opl.n; i++)
+    {
+      int val;
+
+      if (node_const_value (opl.op[i], &val))
+	{
+	  if (val == absorb)
+	    break;
+	}
+      else
+	{
+	  opl.op[j] = opl.op[i];
+	  opl.cost[j] = opl.cost[i];
+	  j++;
+	}
+    }
+
+  if (i < opl.n || j == 0)
+    /* Either the absorbing value was found, or all operands were
+       neutral. */
+    node_set_const (node, i < opl.n ? absorb : !absorb);
+  else if (j == 1)
+    {
+      /* A single operand remains: replace the chain with it. */
+      *node = *opl.op[0];
+      cost = opl.cost[0];
+    }
+  else
+    {
+      opl.n = j;
+
+      /* Insertion sort by cost */
+      for (i = 1; i < opl.n; i++)
+	{
+	  struct search_node *op = opl.op[i];
+	  enum search_cost c = opl.cost[i];
+
+	  for (j = i; j > 0 && opl.cost[j-1] > c; j--)
+	    {
+	      opl.op[j] = opl.op[j-1];
+	      opl.cost[j] = opl.cost[j-1];
+	    }
+	  opl.op[j] = op;
+	  opl.cost[j] = c;
+	}
+      cost = opl.cost[opl.n-1];
+
+      /* Rebuild the chain as a left-deep tree, reusing its binary
+	 nodes.  The first of them is NODE, which remains the root. */
+      for (i = 0; i < opl.n - 1; i++)
+	{
+	  struct search_node *bn = opl.bin[i];
+	  bn->type = type;
+	  bn->v.arg[0] = i == opl.n - 2 ? opl.op[0] : opl.bin[i+1];
+	  bn->v.arg[1] = opl.op[opl.n - 1 - i];
+	}
+    }
+
+  free (opl.op);
+  free (opl.cost);
+  free (opl.bin);
+  return cost;
+}
+
+/* Plan evaluation of the subtree rooted at NODE.  Return its estimated
+   cost. */
+static enum search_cost
+search_plan_node (struct search_node *node)
+{
+  enum search_cost cost;
+  int val;
+
+  switch (node->type)
+    {
+    case node_call:
+      return node->v.key.cost;
+
+    case node_and:
+    case node_or:
+      return search_plan_chain (node);
+
+    case node_not:
+      cost = search_plan_node (node->v.arg[0]);
+      if (node_const_value (node->v.arg[0], &val))
+	node_set_const (node, !val);
+      return cost;
+
+    default:
+      return cost_const;
+    }
+}
+
+static void
+search_plan (struct parsebuf *pb)
+{
+  search_plan_node (pb->tree);
+}
+
+/* Log the number of evaluations of each search key, in the order of
+   evaluation. */
+static void
+search_report_node (struct search_node *node)
+{
+  switch (node->type)
+    {
+    case node_call:
+      {
+	struct search_node *arg = node->v.key.arg[0];
+	mu_debug_log ("SEARCH %s%s%s: %zu evaluations, %zu matches",
+		      node->v.key.keyword,
+		      node->v.key.narg > 0 && arg->v.value.type == value_string
+		        ? " " : "",
+		      node->v.key.narg > 0 && arg->v.value.type == value_string
+		        ? arg->v.value.v.string : "",
+		      node->v.key.evals, node->v.key.hits);
+      }
+      break;
+
+    case node_and:
+    case node_or:
+      search_report_node (node->v.arg[0]);
+      search_report_node (node->v.arg[1]);
+      break;
+
+    case node_not:
+      search_report_node (node->v.arg[0]);
+      break;
+
+    default:
+      break;
+    }
+}
+
+static void
+search_report (struct parsebuf *pb)
+{
+  if (mu_debug_level_p (MU_DEBCAT_APP, MU_DEBUG_TRACE1))
+    search_report_node (pb->tree);
+}
+
 /* Executes a query from parsebuf */
 void
 evaluate_node (struct search_node *node, struct parsebuf *pb,
@@ -758,6 +1069,9 @@ evaluate_node (struct search_node *node, struct parsebuf *pb,
 	}
 
       node->v.key.fun (pb, node, argval, val);
+      node->v.key.evals++;
+      if (val->v.number)
+	node->v.key.hits++;
       break;
 
     case node_and:
@@ -830,7 +1144,7 @@ _scan_header (struct parsebuf *pb, char *name, char *value)
   int result = 0;
   char *needle;
   
-  mu_message_get_header (pb->msg, &header);
+  imap4d_message_header (pb->msg, name, &header);
 
   unistr_downcase (value, &needle);
 
@@ -869,7 +1183,7 @@ _header_date (struct parsebuf *pb, time_t *timep)
   const char *hval;
   mu_header_t header = NULL;
 
-  mu_message_get_header (pb->msg, &header);
+  imap4d_message_header (pb->msg, MU_HEADER_DATE, &header);
   if (mu_header_sget_value (header, "Date", &hval) == 0
       && util_parse_822_date (hval, timep, datetime_date_only))
     return 0;
@@ -1079,6 +1393,64 @@ _scan_body (struct parsebuf *pb, char *text)
 {
   return _match_multipart (pb, pb->msg, text);
 }
+
+/* Full-text index */
+
+/* Use the full-text index for SEARCH BODY and TEXT */
+int imap4d_text_index;
+/* The full-text index of the selected mailbox, or NULL */
+txtidx_t selected_txtidx;
+
+void
+imap4d_txtidx_select (void)
+{
+  txtidx_close (&selected_txtidx);
+  if (imap4d_text_index && mbox)
+    {
+      int rc = txtidx_open (mbox, TXTIDX_CREATE, &selected_txtidx);
+      if (rc && rc != ENOSYS)
+	mu_diag_funcall (MU_DIAG_ERROR, "txtidx_open", NULL, rc);
+    }
+}
+
+static void
+free_txtidx_set (void *ptr)
+{
+  txtidx_set_free (ptr);
+}
+
+/* Return 0 if the body of the current message cannot contain the text
+   searched for by NODE, according to the full-text index.  The index
+   covers searches in US-ASCII and UTF-8. */
+static int
+_body_candidate (struct parsebuf *pb, struct search_node *node, char *text)
+{
+  size_t uid;
+
+  if (!selected_txtidx
+      || (pb->charset && mu_c_strcasecmp (pb->charset, "UTF-8")))
+    return 1;
+  if (!node->v.key.cand)
+    {
+      int rc;
+
+      if (!pb->txtidx_updated)
+	{
+	  /* Index the messages added since the last search */
+	  rc = txtidx_update (selected_txtidx, mbox);
+	  if (rc)
+	    mu_diag_funcall (MU_DIAG_ERROR, "txtidx_update", NULL, rc);
+	  pb->txtidx_updated = 1;
+	}
+      rc = txtidx_lookup (selected_txtidx, text, &node->v.key.cand);
+      if (rc)
+	mu_diag_funcall (MU_DIAG_ERROR, "txtidx_lookup", NULL, rc);
+      parse_regmem (pb, node->v.key.cand, free_txtidx_set);
+    }
+  if (mu_message_get_uid (pb->msg, &uid))
+    return 1;
+  return txtidx_set_member (node->v.key.cand, uid);
+}
 
 /* Basic instructions */
 
@@ -1124,7 +1496,8 @@ cond_body (struct parsebuf *pb, struct search_node *node, struct value *arg,
 	   struct value *retval)
 {
   retval->type = value_number;
-  retval->v.number = _scan_body (pb, arg[0].v.string);
+  retval->v.number = _body_candidate (pb, node, arg[0].v.string)
+		     && _scan_body (pb, arg[0].v.string);
 }
 
 static void
@@ -1186,6 +1559,15 @@ cond_larger (struct parsebuf *pb, struct search_node *node, struct value *arg,
   retval->v.number = size > arg[0].v.number;
 }
 
+static void
+cond_modseq (struct parsebuf *pb, struct search_node *node, struct value *arg,
+	     struct value *retval)
+{
+  retval->type = value_number;
+  retval->v.number = modseq_log_get (selected_modseq, pb->msgno)
+                       >= (modseq_t) arg[0].v.number;
+}
+
 static void
 cond_on (struct parsebuf *pb, struct search_node *node, struct value *arg,
 	 struct value *retval)
@@ -1289,7 +1671,8 @@ cond_text (struct parsebuf *pb, struct search_node *node, struct value *arg,
 {
   char *s = arg[0].v.string;
   retval->type = value_number;
-  retval->v.number = _scan_header_all (pb, s) || _scan_body (pb, s);
+  retval->v.number = _scan_header_all (pb, s)
+		     || (_body_candidate (pb, node, s) && _scan_body (pb, s));
 }
 
 static void
@@ -1308,7 +1691,7 @@ cond_uid (struct parsebuf *pb, struct search_node *node, struct value *arg,
   size_t uid = 0;
 
   mu_message_get_uid (pb->msg, &uid);
-  rc = mu_msgset_locate (arg[0].v.msgset, pb->msgno, NULL);
+  rc = mu_msgset_locate (arg[0].v.msgset, uid, NULL);
   retval->type = value_number;
   retval->v.number = rc == 0;
 }
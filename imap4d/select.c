@@ -18,29 +18,182 @@
 
 static int select_flags;
 
-/* select          ::= "SELECT" SPACE mailbox  */
+/* select          ::= "SELECT" SPACE mailbox [SPACE "(" select-param
+                       *(SPACE select-param) ")"]  */
 
 int
 imap4d_select (struct imap4d_session *session,
                struct imap4d_command *command, imap4d_tokbuf_t tok)
 {
-  if (imap4d_tokbuf_argc (tok) != 3)
-    return io_completion_response (command, RESP_BAD, "Invalid arguments");
-  return imap4d_select0 (command, imap4d_tokbuf_getarg (tok, IMAP4_ARG_1),
-			 MU_STREAM_RDWR);
+  return imap4d_select0 (command, tok, MU_STREAM_RDWR);
+}
+
+/* SELECT and EXAMINE parameters (RFC 7162) */
+struct select_param
+{
+  int condstore;               /* CONDSTORE was given */
+  int qresync;                 /* QRESYNC was given */
+  unsigned long uidvalidity;   /* Last known UIDVALIDITY */
+  modseq_t modseq;             /* Last known mod-sequence */
+  char *known_uids;            /* Optional set of known UIDs */
+};
+
+static int
+get_number (imap4d_tokbuf_t tok, int i, unsigned long long *ret)
+{
+  char *arg = imap4d_tokbuf_getarg (tok, i);
+  char *p;
+
+  if (!arg || !mu_isdigit (arg[0]))
+    return 1;
+  errno = 0;
+  *ret = strtoull (arg, &p, 10);
+  return errno || *p;
+}
+
+/* "QRESYNC" SP "(" uidvalidity SP mod-sequence-value [SP known-uids]
+   [SP seq-match-data] ")"
+
+   The seq-match-data is accepted but not used: UIDs of the known
+   messages suffice to compute the VANISHED response. */
+static int
+parse_qresync (imap4d_tokbuf_t tok, int *pi, struct select_param *param)
+{
+  int i = *pi;
+  char *arg;
+  unsigned long long n;
+
+  if ((arg = imap4d_tokbuf_getarg (tok, ++i)) == NULL || strcmp (arg, "("))
+    return 1;
+  if (get_number (tok, ++i, &n) || n == 0 || n > ULONG_MAX)
+    return 1;
+  param->uidvalidity = n;
+  if (get_number (tok, ++i, &n))
+    return 1;
+  param->modseq = n;
+  arg = imap4d_tokbuf_getarg (tok, ++i);
+  if (arg && strcmp (arg, "(") && strcmp (arg, ")"))
+    {
+      param->known_uids = arg;
+      arg = imap4d_tokbuf_getarg (tok, ++i);
+    }
+  if (arg && strcmp (arg, "(") == 0)
+    {
+      /* Skip seq-match-data */
+      while ((arg = imap4d_tokbuf_getarg (tok, ++i)) && strcmp (arg, ")"))
+	;
+      if (arg)
+	arg = imap4d_tokbuf_getarg (tok, ++i);
+    }
+  if (!arg || strcmp (arg, ")"))
+    return 1;
+  param->qresync = 1;
+  *pi = i;
+  return 0;
+}
+
+/* Parse optional SELECT/EXAMINE parameters (RFC 4466). */
+static int
+parse_select_params (imap4d_tokbuf_t tok, struct select_param *param)
+{
+  int argc = imap4d_tokbuf_argc (tok);
+  int i = IMAP4_ARG_2;
+  char *arg;
+
+  if (argc == i)
+    return 0;
+  if (strcmp (imap4d_tokbuf_getarg (tok, i), "("))
+    return 1;
+  for (i++; (arg = imap4d_tokbuf_getarg (tok, i)) != NULL; i++)
+    {
+      if (strcmp (arg, ")") == 0)
+	return i + 1 != argc;
+      else if (mu_c_strcasecmp (arg, "CONDSTORE") == 0)
+	param->condstore = 1;
+      else if (mu_c_strcasecmp (arg, "QRESYNC") == 0)
+	{
+	  /* QRESYNC must be enabled first. */
+	  if (!qresync_enabled || parse_qresync (tok, &i, param))
+	    return 1;
+	}
+      else
+	return 1;
+    }
+  return 1;
+}
+
+/* Send the changes since the last known state of the mailbox: VANISHED
+   (EARLIER) response for the expunged messages and FETCH responses for
+   those whose flags have changed. */
+static int
+select_qresync (struct select_param *param)
+{
+  unsigned long uidvalidity;
+  mu_msgset_t known = NULL;
+  size_t total = 0, i;
+  int rc;
+
+  if (util_uidvalidity (mbox, &uidvalidity)
+      || uidvalidity != param->uidvalidity)
+    return 0;
+
+  if (param->known_uids)
+    {
+      rc = mu_msgset_create (&known, NULL, MU_MSGSET_NUM);
+      if (rc)
+	return rc;
+      rc = mu_msgset_parse_imap (known, MU_MSGSET_NUM, param->known_uids,
+				 NULL);
+      if (rc)
+	{
+	  mu_msgset_free (known);
+	  return rc;
+	}
+    }
+  imap4d_vanished_earlier (param->modseq, known);
+
+  mu_mailbox_messages_count (mbox, &total);
+  for (i = 1; i <= total; i++)
+    {
+      size_t uid = modseq_log_uid (selected_modseq, i);
+      modseq_t modseq = modseq_log_get (selected_modseq, i);
+      mu_message_t msg;
+      mu_attribute_t attr;
+
+      if (modseq <= param->modseq
+	  || (known && mu_msgset_locate (known, uid, NULL))
+	  || mu_mailbox_get_message (mbox, i, &msg)
+	  || mu_message_get_attribute (msg, &attr))
+	continue;
+      io_sendf ("* %lu FETCH (UID %lu FLAGS (", (unsigned long) i,
+		(unsigned long) uid);
+      util_print_flags (attr);
+      io_sendf (") MODSEQ (%llu))\n", modseq);
+    }
+  mu_msgset_free (known);
+  return 0;
 }
 
 /* This code is shared with EXAMINE.  */
 int
-imap4d_select0 (struct imap4d_command *command, const char *mboxname,
+imap4d_select0 (struct imap4d_command *command, imap4d_tokbuf_t tok,
 		int flags)
 {
   int status;
+  char *mboxname;
   char *mailbox_name;
   mu_record_t record;
+  struct select_param param;
   
   /* FIXME: Check state.  */
 
+  if (imap4d_tokbuf_argc (tok) < 3)
+    return io_completion_response (command, RESP_BAD, "Invalid arguments");
+  memset (&param, 0, sizeof param);
+  if (parse_select_params (tok, &param))
+    return io_completion_response (command, RESP_BAD, "Invalid arguments");
+  mboxname = imap4d_tokbuf_getarg (tok, IMAP4_ARG_1);
+
   /* Even if a mailbox is selected, a SELECT EXAMINE or LOGOUT
      command MAY be issued without previously issuing a CLOSE command.
      The SELECT, EXAMINE, and LOGOUT commands implicitly close the
@@ -55,7 +208,11 @@ imap4d_select0 (struct imap4d_command *command, const char *mboxname,
       mu_mailbox_destroy (&mbox);
       /* Destroy the old uid table.  */
       imap4d_sync ();
+      if (qresync_enabled)
+	io_untagged_response (RESP_OK, "[CLOSED] Previous mailbox closed");
     }
+  if (param.condstore)
+    imap4d_condstore_enable ();
 
   if (mu_c_strcasecmp (mboxname, "INBOX") == 0)
     flags |= MU_STREAM_CREAT;
@@ -99,10 +256,15 @@ imap4d_select0 (struct imap4d_command *command, const char *mboxname,
       state = STATE_SEL;
 
       imap4d_set_observer (mbox);
+      imap4d_modseq_select ();
+      imap4d_hdrcache_select ();
+      imap4d_txtidx_select ();
       
       if ((status = imap4d_select_status ()) == 0)
 	{
 	  free (mailbox_name);
+	  if (param.qresync && selected_modseq)
+	    select_qresync (&param);
 	  /* Need to set the state explicitly for select.  */
 	  return io_sendf ("%s OK [%s] %s Completed\n", command->tag,
 			   ((flags & MU_STREAM_RDWR) == MU_STREAM_RDWR) ?
@@ -154,6 +316,12 @@ imap4d_select_status ()
   else
     io_untagged_response (RESP_OK, "[PERMANENTFLAGS (%s)] Permanent flags",
                           mflags);
+  if (selected_modseq)
+    io_untagged_response (RESP_OK, "[HIGHESTMODSEQ %llu] Highest",
+			  modseq_log_highest (selected_modseq));
+  else if (condstore_enabled)
+    io_untagged_response (RESP_OK,
+			  "[NOMODSEQ] Mailbox does not support mod-sequences");
 
   return 0;
 }
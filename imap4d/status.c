@@ -27,6 +27,7 @@ static int status_recent      (mu_mailbox_t);
 static int status_uidnext     (mu_mailbox_t);
 static int status_uidvalidity (mu_mailbox_t);
 static int status_unseen      (mu_mailbox_t);
+static int status_highestmodseq (mu_mailbox_t);
 
 struct status_table {
   char *name;
@@ -37,6 +38,7 @@ struct status_table {
   {"UIDNEXT", status_uidnext},
   {"UIDVALIDITY", status_uidvalidity},
   {"UNSEEN", status_unseen},
+  {"HIGHESTMODSEQ", status_highestmodseq},
   { NULL }
 };
 
@@ -219,3 +221,22 @@ status_unseen (mu_mailbox_t smbox)
   io_sendf ("UNSEEN %lu", (unsigned long) unseen);
   return 0;
 }
+
+/* RFC 7162, 3.1.10: the highest mod-sequence of the mailbox, or 0 if it
+   does not support mod-sequences. */
+static int
+status_highestmodseq (mu_mailbox_t smbox)
+{
+  modseq_log_t log;
+  modseq_t highest = 0;
+
+  imap4d_condstore_enable ();
+  if (modseq_log_open (smbox, &log) == 0)
+    {
+      if (modseq_log_reconcile (log, smbox, 1) == 0)
+	highest = modseq_log_highest (log);
+      modseq_log_destroy (&log);
+    }
+  io_sendf ("HIGHESTMODSEQ %llu", highest);
+  return 0;
+}
@@ -25,7 +25,35 @@ struct store_parse_closure
   int type;
   int isuid;
   mu_msgset_t msgset;
+  int unchangedsince_set;   /* UNCHANGEDSINCE modifier was given */
+  modseq_t unchangedsince;  /* Its value */
+  mu_msgset_t modified;     /* Messages that failed the UNCHANGEDSINCE test */
 };
+
+/* store-modifiers     = SP "(" "UNCHANGEDSINCE" SP mod-sequence-valzer ")"
+   mod-sequence-valzer = "0" / mod-sequence-value
+   (RFC 7162) */
+static void
+parse_store_modifiers (imap4d_parsebuf_t p)
+{
+  struct store_parse_closure *pclos = imap4d_parsebuf_data (p);
+  char *end;
+
+  if (mu_c_strcasecmp (imap4d_parsebuf_next (p, 1), "UNCHANGEDSINCE"))
+    imap4d_parsebuf_exit (p, "Unknown store modifier");
+  imap4d_parsebuf_next (p, 1);
+  if (!mu_isdigit (p->token[0]))
+    imap4d_parsebuf_exit (p, "Invalid mod-sequence");
+  errno = 0;
+  pclos->unchangedsince = strtoull (p->token, &end, 10);
+  if (errno || *end)
+    imap4d_parsebuf_exit (p, "Invalid mod-sequence");
+  if (imap4d_parsebuf_next (p, 1)[0] != ')')
+    imap4d_parsebuf_exit (p, "Missing closing parenthesis");
+  if (imap4d_condstore_enable ())
+    imap4d_parsebuf_exit (p, "[NOMODSEQ] No mod-sequences");
+  pclos->unchangedsince_set = 1;
+}
   
 static int
 store_thunk (imap4d_parsebuf_t p)
@@ -38,6 +66,11 @@ store_thunk (imap4d_parsebuf_t p)
   
   mstr = imap4d_parsebuf_next (p, 1);
   data = imap4d_parsebuf_next (p, 1);
+  if (*data == '(')
+    {
+      parse_store_modifiers (p);
+      data = imap4d_parsebuf_next (p, 1);
+    }
 
   if (*data == '+')
     {
@@ -95,7 +128,18 @@ _do_store (size_t msgno, mu_message_t msg, void *data)
 {
   struct store_parse_closure *pclos = data;
   mu_attribute_t attr = NULL;
-      
+
+  if (pclos->unchangedsince_set
+      && modseq_log_get (selected_modseq, msgno) > pclos->unchangedsince)
+    {
+      size_t n = msgno;
+
+      if (pclos->isuid)
+	mu_message_get_uid (msg, &n);
+      mu_msgset_add_range (pclos->modified, n, n, MU_MSGSET_NUM);
+      return 0;
+    }
+  
   mu_message_get_attribute (msg, &attr);
 	      
   switch (pclos->how)
@@ -113,28 +157,75 @@ _do_store (size_t msgno, mu_message_t msg, void *data)
       mu_attribute_set_flags (attr, pclos->type);
     }
 
-	  
-  if (pclos->ack)
+  if (selected_modseq)
+    modseq_log_touch (selected_modseq, msgno);
+  return 0;
+}
+
+static int
+_ack_store (size_t msgno, mu_message_t msg, void *data)
+{
+  struct store_parse_closure *pclos = data;
+  mu_attribute_t attr = NULL;
+  size_t uid = 0;
+
+  mu_message_get_uid (msg, &uid);
+  if (pclos->modified
+      && mu_msgset_locate (pclos->modified, pclos->isuid ? uid : msgno,
+			   NULL) == 0)
+    return 0;
+
+  /* With CONDSTORE, the new mod-sequence is reported even if .SILENT
+     was requested (RFC 7162, 3.1.3). */
+  if (pclos->ack || selected_modseq)
     {
       io_sendf ("* %lu FETCH (", (unsigned long) msgno);
-      
-      if (pclos->isuid)
+
+      if (pclos->isuid || qresync_enabled)
+	io_sendf ("UID %lu ", (unsigned long) uid);
+      if (pclos->ack)
 	{
-	  size_t uid;
-	  int rc = mu_mailbox_translate (mbox, MU_MAILBOX_UID_TO_MSGNO,
-					 msgno, &uid);
-	  if (rc == 0)
-	    io_sendf ("UID %lu ", (unsigned long) uid);
+	  mu_message_get_attribute (msg, &attr);
+	  io_sendf ("FLAGS (");
+	  util_print_flags (attr);
+	  io_sendf (")");
+	  if (selected_modseq)
+	    io_sendf (" ");
 	}
-      io_sendf ("FLAGS (");
-      util_print_flags (attr);
-      io_sendf ("))\n");
+      if (selected_modseq)
+	io_sendf ("MODSEQ (%llu)", modseq_log_get (selected_modseq, msgno));
+      io_sendf (")\n");
     }
   /* Update the flags of uid table.  */
   imap4d_sync_flags (msgno);
   return 0;
 }
 
+/* Return the completion text for a partially failed conditional STORE.
+   The returned string remains valid until the next call. */
+static char *
+modified_text (mu_msgset_t modified)
+{
+  static char *text;
+  mu_stream_t str;
+  mu_off_t size;
+
+  free (text);
+  text = NULL;
+  if (mu_memory_stream_create (&str, MU_STREAM_RDWR))
+    imap4d_bye (ERR_NO_MEM);
+  mu_stream_printf (str, "[MODIFIED ");
+  mu_msgset_imap_print (str, modified);
+  mu_stream_printf (str, "] Conditional STORE failed");
+  mu_stream_size (str, &size);
+  text = mu_alloc (size + 1);
+  mu_stream_seek (str, 0, MU_SEEK_SET, NULL);
+  mu_stream_read (str, text, size, NULL);
+  text[size] = 0;
+  mu_stream_destroy (&str);
+  return text;
+}
+
 int
 imap4d_store0 (imap4d_tokbuf_t tok, int isuid, char **ptext)
 {
@@ -152,12 +243,26 @@ imap4d_store0 (imap4d_tokbuf_t tok, int isuid, char **ptext)
 			     ptext);
   if (rc == RESP_OK)
     {
+      if (pclos.unchangedsince_set)
+	{
+	  /* Make sure the mod-sequences are up to date. */
+	  modseq_log_refresh (selected_modseq);
+	  if (mu_msgset_create (&pclos.modified, NULL, MU_MSGSET_NUM))
+	    imap4d_bye (ERR_NO_MEM);
+	}
       mu_msgset_foreach_message (pclos.msgset, _do_store, &pclos);
+      if (selected_modseq)
+	modseq_log_commit (selected_modseq, mbox);
+      mu_msgset_foreach_message (pclos.msgset, _ack_store, &pclos);
     
-      *ptext = "Completed";
+      if (pclos.modified && !mu_msgset_is_empty (pclos.modified))
+	*ptext = modified_text (pclos.modified);
+      else
+	*ptext = "Completed";
     }
   
   mu_msgset_free (pclos.msgset);
+  mu_msgset_free (pclos.modified);
   
   return rc;
 }
@@ -24,6 +24,10 @@ static int *attr_table;
 static size_t attr_table_count;
 static size_t attr_table_max;
 static int attr_table_valid;
+/* Range of messages appended to the mailbox since the last notification,
+   as reported by the mailbox driver.  If the mailbox was only appended
+   to, flags of the existing messages need not be rechecked. */
+static size_t new_first, new_last;
 
 static void
 realloc_attributes (size_t total)
@@ -43,6 +47,7 @@ imap4d_sync_invalidate ()
 {
   attr_table_valid = 0;
   attr_table_count = 0;
+  new_first = new_last = 0;
 }
 
 static void
@@ -65,15 +70,42 @@ reread_attributes (void)
   attr_table_valid = 1;
 }
 
+static void
+notify_flags (size_t msgno, int flags)
+{
+  io_sendf ("* %lu FETCH (", (unsigned long) msgno);
+  if (qresync_enabled && selected_modseq)
+    io_sendf ("UID %lu ",
+	      (unsigned long) modseq_log_uid (selected_modseq, msgno));
+  io_sendf ("FLAGS (");
+  mu_imap_format_flags (iostream, flags, 1);
+  io_sendf (")");
+  if (selected_modseq)
+    io_sendf (" MODSEQ (%llu)", modseq_log_get (selected_modseq, msgno));
+  io_sendf (")\n");
+}
+
 static void
 notify (void)
 {
   size_t total = 0;
   size_t recent = 0;
+  size_t first = 1;
   
   mu_mailbox_messages_count (mbox, &total);
   mu_mailbox_messages_recent (mbox, &recent);
 
+  if (attr_table_valid
+      && new_first == attr_table_count + 1 && new_last == total)
+    first = new_first;
+
+  if (selected_modseq)
+    {
+      int rc = modseq_log_reconcile (selected_modseq, mbox, first);
+      if (rc)
+	mu_diag_funcall (MU_DIAG_ERROR, "modseq_log_reconcile", NULL, rc);
+    }
+  
   if (!attr_table_valid)
     {
       reread_attributes ();
@@ -84,7 +116,7 @@ notify (void)
       size_t i;
 
       realloc_attributes (total);
-      for (i = 1; i <= total; i++)
+      for (i = first; i <= total; i++)
 	{
 	  mu_message_t msg = NULL;
 	  mu_attribute_t nattr = NULL;
@@ -98,9 +130,7 @@ notify (void)
 	    {
 	      if (nflags != attr_table[i-1])
 		{
-		  io_sendf ("* %lu FETCH FLAGS (",  (unsigned long) i);
-		  mu_imap_format_flags (iostream, nflags, 1);
-		  io_sendf (")\n");
+		  notify_flags (i, nflags);
 		  attr_table[i-1] = nflags;
 		}
 	    }
@@ -109,6 +139,8 @@ notify (void)
 	}
     }
   
+  new_first = new_last = 0;
+  
   io_untagged_response (RESP_NONE, "%lu EXISTS", (unsigned long) total);
   io_untagged_response (RESP_NONE, "%lu RECENT", (unsigned long) recent);
 }
@@ -154,6 +186,15 @@ action (mu_observer_t observer, size_t type, void *data, void *action_data)
       mailbox_corrupt = 0;
       break;
 
+    case MU_EVT_MAILBOX_NEW_MESSAGES:
+      {
+	size_t *range = data;
+	if (new_first == 0)
+	  new_first = range[0];
+	new_last = range[1];
+      }
+      break;
+      
     case MU_EVT_MAILBOX_MESSAGE_EXPUNGE:
       /* The EXPUNGE response reports that the specified message sequence
 	 number has been permanently removed from the mailbox.  The message
@@ -164,8 +205,16 @@ action (mu_observer_t observer, size_t type, void *data, void *action_data)
       if (!silent_expunge)
 	{
 	  size_t *exp = data;
-	  io_untagged_response (RESP_NONE, "%lu EXPUNGED",
-				(unsigned long) (exp[0] - exp[1]));
+	  size_t uid;
+
+	  /* With QRESYNC, VANISHED is sent instead (RFC 7162, 3.2.10). */
+	  if (qresync_enabled && selected_modseq
+	      && (uid = modseq_log_uid (selected_modseq, exp[0])) != 0)
+	    io_untagged_response (RESP_NONE, "VANISHED %lu",
+				  (unsigned long) uid);
+	  else
+	    io_untagged_response (RESP_NONE, "%lu EXPUNGED",
+				  (unsigned long) (exp[0] - exp[1]));
 	}
     }
   return 0;
@@ -183,6 +232,7 @@ imap4d_set_observer (mu_mailbox_t mbox)
   mu_observable_attach (observable,
 			MU_EVT_MAILBOX_CORRUPT|
 			MU_EVT_MAILBOX_DESTROY|
+			MU_EVT_MAILBOX_NEW_MESSAGES|
 			MU_EVT_MAILBOX_MESSAGE_EXPUNGE,
 			observer);
   mailbox_corrupt = 0;
@@ -196,7 +246,12 @@ imap4d_sync (void)
      It may be because of close or before select/examine a new mailbox.
      If it was a close we do not send any notification.  */
   if (mbox == NULL)
-    imap4d_sync_invalidate ();
+    {
+      imap4d_sync_invalidate ();
+      modseq_log_destroy (&selected_modseq);
+      hdrcache_destroy (&selected_hdrcache);
+      txtidx_close (&selected_txtidx);
+    }
   else if (!attr_table_valid || !mu_mailbox_is_updated (mbox))
     {
       if (mailbox_corrupt)
@@ -210,6 +265,8 @@ imap4d_sync (void)
 	  if (status)
 	    imap4d_bye (ERR_MAILBOX_CORRUPTED);
 	  imap4d_set_observer (mbox);
+	  imap4d_hdrcache_select ();
+	  imap4d_txtidx_select ();
 	  imap4d_sync_invalidate ();
 	  mailbox_corrupt = 0;
 	  io_untagged_response (RESP_NONE,
@@ -0,0 +1,34 @@
+/* Define PATH_* macros from paths in $(top_srcdir)/paths. */
+
+#ifdef HAVE_PATHS_H
+#include <paths.h>
+#endif
+
+#ifndef PATH_SENDMAIL
+#define PATH_SENDMAIL _PATH_SENDMAIL
+#endif
+#ifndef PATH_MAILDIR
+#define PATH_MAILDIR _PATH_MAILDIR
+#endif
+#ifndef PATH_DEV
+#define PATH_DEV _PATH_DEV
+#endif
+#ifndef PATH_TTY_PFX
+#define PATH_TTY_PFX _PATH_DEV
+#endif
+#ifndef PATH_DEVNULL
+#define PATH_DEVNULL _PATH_DEVNULL
+#endif
+#ifndef PATH_UTMP
+#define PATH_UTMP _PATH_UTMP
+#endif
+#ifndef PATH_UTMPX
+#define PATH_UTMPX _PATH_UTMPX
+#endif
+#ifndef PATH_WTMP
+#define PATH_WTMP _PATH_WTMP
+#endif
+#ifndef PATH_TTY
+#define PATH_TTY _PATH_TTY
+#endif
+
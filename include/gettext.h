@@ -0,0 +1 @@
+../lib/gnu/gettext.h
\ No newline at end of file
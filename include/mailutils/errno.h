@@ -122,7 +122,8 @@ extern "C" {
 #define MU_ERR_TLS (MU_ERR_BASE+91)
 #define MU_ERR_TRANSPORT_GET (MU_ERR_BASE+92)
 #define MU_ERR_TRANSPORT_SET (MU_ERR_BASE+93)
-#define MU_ERR_LAST (MU_ERR_BASE+94)
+#define MU_ERR_MBX_CHANGED (MU_ERR_BASE+94)
+#define MU_ERR_LAST (MU_ERR_BASE+95)
 
 #ifndef ECANCELED
 # define ECANCELED MU_ERR_CANCELED
@@ -129,6 +129,7 @@ extern mu_filter_record_t mu_percent_filter;
 extern mu_filter_record_t mu_dq_filter;
 extern mu_filter_record_t mu_fromrd_filter;
 extern mu_filter_record_t mu_fromrb_filter;
+extern mu_filter_record_t mu_deflate_filter;
 
 enum mu_iconv_fallback_mode
   {
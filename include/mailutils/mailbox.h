@@ -34,6 +34,12 @@ int mu_set_folder_directory (const char *p);
 const char *mu_mailbox_url (void);
 const char *mu_folder_directory (void);
 int mu_construct_user_mailbox_url (char **pout, const char *name);
+void mu_set_mailbox_index (int v);
+int mu_mailbox_index_enabled (void);
+void mu_set_mailbox_single_instance (int v);
+int mu_mailbox_single_instance_enabled (void);
+void mu_set_mailbox_scan_threads (size_t n);
+size_t mu_mailbox_scan_threads (void);
 
 int mu_mailbox_expand_name (const char *name, char **expansion);
   
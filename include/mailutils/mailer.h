@@ -47,6 +47,16 @@ extern int mu_mailer_send_fragments (mu_mailer_t mailer, mu_message_t msg,
 extern int mu_mailer_set_url_default       (const char* url);
 extern int mu_mailer_get_url_default       (const char** url);
 
+/* Connection cache.  Mailers that support it keep their connections
+   open after mu_mailer_close and reuse them for subsequent messages
+   sent to the same URL. */
+extern size_t mu_mailer_cache_size;         /* Max. number of idle
+					       connections; 0 disables */
+extern unsigned mu_mailer_cache_idle_timeout; /* Seconds */
+extern size_t mu_mailer_cache_max_messages; /* Per connection; 0 means
+					       unlimited */
+extern void mu_mailer_cache_flush (void);
+
 /* Accessor functions. */
 extern int mu_mailer_get_property   (mu_mailer_t, mu_property_t *);
 int mu_mailer_set_property (mu_mailer_t, mu_property_t);
@@ -32,6 +32,9 @@ extern "C" {
 #define MU_EVT_MAILBOX_MESSAGE_EXPUNGE  0x010  /*  size_t [2]
 					           (message number/number of 
 					            messages removed so far) */
+#define MU_EVT_MAILBOX_NEW_MESSAGES     0x800  /*  size_t [2]
+					           (numbers of the first and
+					            last appended message) */
   /* Folder events */
 #define MU_EVT_FOLDER_DESTROY           0x020  /*  mu_folder_t */
 #define MU_EVT_FOLDER_AUTHORITY_FAILED  0x040  /*  NULL */
@@ -25,6 +25,8 @@ typedef int (*mu_conn_loop_fp) (int fd, void *conn_data, void *server_data);
 typedef void (*mu_conn_free_fp) (void *conn_data, void *server_data);
 typedef int (*mu_server_idle_fp) (void *server_data);
 typedef void (*mu_server_free_fp) (void *server_data);
+typedef int (*mu_server_timer_fp) (void *data, void *server_data);
+typedef int (*mu_server_signal_fp) (int signo, void *data, void *server_data);
 	       
 #define MU_SERVER_SUCCESS    0
 #define MU_SERVER_CLOSE_CONN 1
@@ -42,6 +44,12 @@ int mu_server_add_connection (mu_server_t srv,
 struct timeval;
 int mu_server_set_timeout (mu_server_t srv, struct timeval *to);
 int mu_server_count (mu_server_t srv, size_t *pcount);
+int mu_server_add_timer (mu_server_t srv, struct timeval const *interval,
+			 void *data, mu_server_timer_fp fp,
+			 mu_conn_free_fp free);
+int mu_server_add_signal (mu_server_t srv, int signo,
+			  void *data, mu_server_signal_fp fp,
+			  mu_conn_free_fp free);
 
 
 /* IP (TCP and UDP) server */
@@ -144,6 +144,7 @@ extern mu_debug_handle_t mu_sieve_debug_handle;
 extern mu_list_t mu_sieve_include_path;
 extern mu_list_t mu_sieve_library_path;
 extern mu_list_t mu_sieve_library_path_prefix;
+extern size_t mu_sieve_cache_size;
 
 extern mu_sieve_tag_def_t mu_sieve_match_part_tags[];
 
@@ -327,6 +328,8 @@ const char *mu_sieve_type_str (mu_sieve_data_type type);
 /* Principal entry points */
 
 int mu_sieve_compile (mu_sieve_machine_t mach, const char *name);
+int mu_sieve_compile_cached (mu_sieve_machine_t mach, const char *name);
+void mu_sieve_cache_flush (void);
 int mu_sieve_compile_text (mu_sieve_machine_t mach,
 			   const char *buf, size_t bufsize,
 			   struct mu_locus_point const *pt);
@@ -71,6 +71,12 @@ int mu_smtp_capa_test (mu_smtp_t smtp, const char *capa, const char **pret);
 int mu_smtp_capa_iterator (mu_smtp_t smtp, mu_iterator_t *itr);
 int mu_smtp_starttls (mu_smtp_t smtp);
 
+/* Enable (MU_SMTP_TRACE_SET), disable (MU_SMTP_TRACE_CLR) or query
+   (MU_SMTP_TRACE_QRY) the use of the PIPELINING (RFC 2920) and
+   CHUNKING (RFC 3030) extensions. */
+int mu_smtp_pipelining (mu_smtp_t smtp, int op);
+int mu_smtp_chunking (mu_smtp_t smtp, int op);
+
 int mu_smtp_mail_basic (mu_smtp_t smtp, const char *email,
 			const char *fmt, ...) MU_PRINTFLIKE(3,4);
 int mu_smtp_rcpt_basic (mu_smtp_t smtp, const char *email,
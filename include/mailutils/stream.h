@@ -238,6 +238,16 @@ enum mu_buffer_type
      Has effect only if the stream is unbuffered
    */
 #define MU_IOCTL_FILTER_SET_OUTBUF_SIZE  2
+
+  /* Get or set interactive mode:
+     Arg: int*
+     In interactive mode, the read filter returns as soon as any output
+     is available, and reads its transport only when the input buffered
+     so far has been consumed.  This is needed when reading from network
+     connections.
+   */
+#define MU_IOCTL_FILTER_GET_INTERACTIVE 3
+#define MU_IOCTL_FILTER_SET_INTERACTIVE 4
   
   /* TLS transport streams */
   /* Get cipher info.
@@ -17,6 +17,7 @@
 
 #ifndef _MAILUTILS_SYS_AMD_H
 # define _MAILUTILS_SYS_AMD_H
+# include <time.h>
 # define MAX_OPEN_STREAMS 16
 
 /* Notifications ADD_MESG. */
@@ -45,6 +46,13 @@
 #define _MU_AMD_PROP_UIDVALIDITY "uid-validity"
 #define _MU_AMD_PROP_UIDNEXT "uidnext"
 #define _MU_AMD_PROP_SIZE "size"
+#define _MU_AMD_PROP_SIZE_COUNT "size-count"
+#define _MU_AMD_PROP_SIZE_MTIME "size-mtime"
+#define _MU_AMD_PROP_SIZE_STAMP "size-stamp"
+
+/* Recompute the mailbox size stored in the properties if it was last
+   computed more than this number of seconds ago. */
+#define _MU_AMD_SIZE_RECONCILE_INTERVAL 3600
 
 #define _MU_AMD_PROP_FILE_NAME ".mu-prop"
 
@@ -63,6 +71,7 @@ struct _amd_message
 			       body_start. */
   size_t header_lines;      /* Number of lines in the header part */
   size_t body_lines;        /* Number of lines in the body */
+  char *uidl;               /* Cached POP3 UIDL, if computed */
 
   mu_message_t message;     /* Corresponding mu_message_t */
   struct _amd_data *amd;    /* Back pointer.  */
@@ -98,9 +107,12 @@ struct _amd_data
   int (*scan0)     (mu_mailbox_t mailbox, size_t msgno, size_t *pcount,
 		    int do_notify);
   int (*mailbox_size) (mu_mailbox_t mailbox, mu_off_t *psize);
+  int (*mailbox_mtime) (struct _amd_data *, struct timespec *);
+  int (*mailbox_count) (struct _amd_data *, size_t *);
   int (*qfetch)    (struct _amd_data *, mu_message_qid_t qid);
   int (*msg_cmp) (struct _amd_message *, struct _amd_message *);
   int (*message_uid) (mu_message_t msg, size_t *puid);
+  int (*message_uidl) (mu_message_t msg, char **puidl);
   int (*remove) (struct _amd_data *);
   int (*delete_msg) (struct _amd_data *, struct _amd_message *);
   int (*chattr_msg) (struct _amd_message *, int);
@@ -121,7 +133,7 @@ struct _amd_data
   int pool_first;    /* Index to the first used entry in msg_pool */
   int pool_last;     /* Index to the first free entry in msg_pool */
 
-  time_t mtime;      /* Time of last modification */
+  struct timespec mtime; /* Time of last modification */
 
   mu_mailbox_t mailbox; /* Back pointer. */
 };
@@ -145,5 +157,8 @@ int amd_remove_dir (const char *name);
 int amd_reset_uidvalidity (struct _amd_data *amd);
 int amd_update_uidnext (struct _amd_data *amd, size_t *newval);
 int amd_alloc_uid (struct _amd_data *amd, size_t *newval);
+struct stat;
+void amd_stat_mtime (struct stat const *st, struct timespec *ts);
+int amd_timespec_cmp (struct timespec const *a, struct timespec const *b);
 
 #endif		    
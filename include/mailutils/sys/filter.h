@@ -42,6 +42,7 @@ struct _mu_filter_stream
   int mode;
   unsigned flag_disabled:1;
   unsigned flag_eof:1;
+  unsigned flag_interactive:1;
   size_t outbuf_size;
   struct _mu_filter_buffer inbuf, outbuf;
   mu_filter_xcode_t xcode;
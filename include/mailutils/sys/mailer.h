@@ -53,6 +53,13 @@ struct _mu_mailer
 
 int _mu_mailer_mailbox_init (mu_mailbox_t mailbox);
 int _mu_mailer_folder_init (mu_folder_t folder MU_ARG_UNUSED);
+
+/* Connection cache interface for mailer implementations */
+typedef void (*_mu_mailer_conn_free_t) (void *conn);
+
+int _mu_mailer_cache_get (mu_url_t url, void **pconn, size_t *pcount);
+int _mu_mailer_cache_put (mu_url_t url, void *conn, size_t count,
+			  _mu_mailer_conn_free_t freefn);
   
 # define MAILER_NOTIFY(mailer, type) \
   if (mailer->observer) observer_notify (mailer->observer, type)
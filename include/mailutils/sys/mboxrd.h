@@ -45,12 +45,16 @@ struct mu_mboxrd_message
   size_t body_size;       /* Number of octets in message body
 			     (after >From unescape) */
   size_t body_lines;      /* Number of lines in message body */
+  char *uidl;             /* Cached POP3 UIDL, if computed */
   mu_message_t message;   /* Pointer to the message object if any */
   /* Backlink to the mailbox */
   struct mu_mboxrd_mailbox *mbox; /* Mailbox */
   size_t num;             /* Number of this message in the mailbox (0-based) */  
 };
 
+/* Number of trailing mailbox bytes kept to detect appends */
+#define MU_MBOXRD_TAIL_MAX 64
+
 struct mu_mboxrd_mailbox
 {
   char *name;                /* Disk file name */
@@ -69,9 +73,14 @@ struct mu_mboxrd_mailbox
   struct mu_mboxrd_message **mesg; /* Array of messages */
   size_t mesg_count;       /* Number of messages in mesgv */
   size_t mesg_max;         /* Actual capacity of mesg */
+
+  unsigned char tail[MU_MBOXRD_TAIL_MAX]; /* Last bytes of the mailbox */
+  size_t tail_len;         /* Number of bytes in tail */
 };
 
 int mu_mboxrd_mailbox_init (mu_mailbox_t mailbox);
+int mu_mboxrd_alloc_message (struct mu_mboxrd_mailbox *dmp,
+			     struct mu_mboxrd_message **dmsg_ptr);
 void mu_mboxrd_message_free (struct mu_mboxrd_message *dmsg);
 int mu_mboxrd_message_get (struct mu_mboxrd_message *dmsg, mu_message_t *mptr);
 int mu_mboxrd_message_attr_load (struct mu_mboxrd_message *dmsg);
@@ -81,4 +90,29 @@ int mu_mboxrd_message_reconstruct (mu_stream_t dest,
 				   struct mu_mboxrd_message *ref,
 				   char const *x_imapbase);
 
+/* A range of bytes moved during in-place compaction of a mailbox */
+struct mu_mboxrd_move
+{
+  mu_off_t src;            /* Source offset */
+  mu_off_t dst;            /* Destination offset (less than src) */
+  mu_off_t len;            /* Number of bytes to move */
+};
+
+struct mu_mboxrd_journal;
+
+int mu_mboxrd_journal_begin (struct mu_mboxrd_mailbox *dmp,
+			     struct mu_mboxrd_move *mv, size_t count,
+			     mu_off_t size,
+			     struct mu_mboxrd_journal **pjrn);
+int mu_mboxrd_journal_run (struct mu_mboxrd_journal *jrn);
+int mu_mboxrd_journal_recover (struct mu_mboxrd_mailbox *dmp);
+extern void (*mu_mboxrd_compact_hook) (void);
+
+char *mu_mboxrd_sidecar_name (struct mu_mboxrd_mailbox *dmp,
+			      char const *suffix);
+int mu_mboxrd_tail_update (struct mu_mboxrd_mailbox *dmp);
+int mu_mboxrd_tail_unchanged (struct mu_mboxrd_mailbox *dmp);
+int mu_mboxrd_index_load (struct mu_mboxrd_mailbox *dmp, mu_off_t *poff);
+int mu_mboxrd_index_update (struct mu_mboxrd_mailbox *dmp);
+
 #endif  
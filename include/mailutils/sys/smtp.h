@@ -34,6 +34,10 @@
 
 #define MU_SMTP_XSCRIPT_MASK(n) (0x100<<(n))
 
+# define _MU_SMTP_PIPELINING 0x1000 /* Pipeline commands (RFC 2920) */
+# define _MU_SMTP_CHUNKING   0x2000 /* Use BDAT instead of DATA (RFC 3030) */
+# define _MU_SMTP_BDAT       0x4000 /* BDAT transfer in progress */
+
 enum mu_smtp_state
   {
     MU_SMTP_INIT,
@@ -73,6 +77,13 @@ struct _mu_smtp
   
   mu_list_t mlrepl;
   struct mu_buffer_query savebuf;
+
+  /* Pipelining and chunking */
+  int pipe_mail;               /* MAIL reply is pending */
+  size_t pipe_rcpt;            /* Number of pending RCPT replies */
+  size_t bdat_pending;         /* Number of pending BDAT replies */
+  int bdat_failed;             /* A BDAT chunk has been rejected */
+  int bdat_xlev;               /* Transcript level for chunk payload */
 };
 
 #define MU_SMTP_FSET(p,f) ((p)->flags |= (f))
@@ -97,6 +108,13 @@ int _mu_smtp_gsasl_auth (mu_smtp_t smtp);
 int _mu_smtp_mech_impl (mu_smtp_t smtp, mu_list_t list);
 int _mu_smtp_data_begin (mu_smtp_t smtp);
 int _mu_smtp_data_end (mu_smtp_t smtp);
+int _mu_smtp_buffer_full (mu_smtp_t smtp);
+int _mu_smtp_buffer_restore (mu_smtp_t smtp);
+void _mu_smtp_pipeline_start (mu_smtp_t smtp);
+int _mu_smtp_pipeline_sync (mu_smtp_t smtp);
+int _mu_smtp_pipeline_drain (mu_smtp_t smtp);
+int _mu_smtp_bdat_writer (mu_smtp_t smtp, mu_stream_t *pstream);
+int _mu_smtp_bdat_sync (mu_smtp_t smtp, size_t max);
 
 int _mu_smtp_get_streams (mu_smtp_t smtp, mu_stream_t *streams);
 int _mu_smtp_set_streams (mu_smtp_t smtp, mu_stream_t *streams);
@@ -0,0 +1 @@
+../../../libmailutils/wordsplit/wordsplit.h
\ No newline at end of file
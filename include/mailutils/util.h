@@ -302,6 +302,20 @@ int mu_file_safety_compose (int *res, const char *name, int defval);
 
 int mu_file_mode_to_safety_criteria (int mode);
 int mu_safety_criteria_to_file_mode (int crit);
+
+struct stat;
+int mu_sidecar_open (char const *name, int flags, uid_t owner,
+		     int *pfd, struct stat *pst);
+int mu_sidecar_tempfile (char const *name, int *pfd, char **ptmpname);
+
+  /* ----------------------- */
+  /* Mailbox usage ledger    */
+  /* ----------------------- */
+#define MU_USAGE_LEDGER_NAME ".mu-usage"
+
+int mu_usage_ledger_read (const char *dir, mu_off_t *psize, time_t *pstamp);
+int mu_usage_ledger_write (const char *dir, mu_off_t size);
+int mu_usage_ledger_update (const char *dir, mu_off_t delta, mu_off_t *psize);
   
 #ifdef __cplusplus
 }
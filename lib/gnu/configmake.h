@@ -0,0 +1,28 @@
+/* DO NOT EDIT! GENERATED AUTOMATICALLY! */
+#define PREFIX "/usr/local"
+#define EXEC_PREFIX "/usr/local"
+#define BINDIR "/usr/local/bin"
+#define SBINDIR "/usr/local/sbin"
+#define LIBEXECDIR "/usr/local/libexec"
+#define DATAROOTDIR "/usr/local/share"
+#define DATADIR "/usr/local/share"
+#define SYSCONFDIR "/usr/local/etc"
+#define SHAREDSTATEDIR "/usr/local/com"
+#define LOCALSTATEDIR "/usr/local/var"
+#define RUNSTATEDIR "/usr/local/var/run"
+#define INCLUDEDIR "/usr/local/include"
+#define OLDINCLUDEDIR "/usr/include"
+#define DOCDIR "/usr/local/share/doc/mailutils"
+#define INFODIR "/usr/local/share/info"
+#define HTMLDIR "/usr/local/share/doc/mailutils"
+#define DVIDIR "/usr/local/share/doc/mailutils"
+#define PDFDIR "/usr/local/share/doc/mailutils"
+#define PSDIR "/usr/local/share/doc/mailutils"
+#define LIBDIR "/usr/local/lib"
+#define LISPDIR "/usr/local/share/emacs/site-lisp"
+#define LOCALEDIR "/usr/local/share/locale"
+#define MANDIR "/usr/local/share/man"
+#define PKGDATADIR "/usr/local/share/mailutils"
+#define PKGINCLUDEDIR "/usr/local/include/mailutils"
+#define PKGLIBDIR "/usr/local/lib/mailutils"
+#define PKGLIBEXECDIR "/usr/local/libexec/mailutils"
@@ -36,6 +36,37 @@ void unistr_downcase (char const *input, char **output);
 int unistr_is_substring (char const *haystack, char const *needle);
 int unistr_is_substring_dn (char const *haystack, char const *needle);
 
+/* Full-text index of a mailbox */
+typedef struct txtidx *txtidx_t;
+typedef struct txtidx_set *txtidx_set_t;
+
+#define TXTIDX_CREATE 0x01  /* Create the index file if it does not exist */
+#define TXTIDX_APPEND 0x02  /* Only append to the index file */
+
+struct txtidx_stat
+{
+  size_t size;              /* Size of the index file */
+  size_t segments;          /* Number of segments */
+  size_t trigrams;          /* Number of trigram table entries */
+  size_t indexed;           /* Number of indexed messages */
+  size_t stale;             /* Indexed messages no longer in the mailbox */
+  size_t unindexed;         /* Messages not in the index */
+  size_t errors;            /* Problems found by txtidx_verify */
+};
+
+int txtidx_open (mu_mailbox_t mbox, int flags, txtidx_t *ret);
+void txtidx_close (txtidx_t *pidx);
+char const *txtidx_file (txtidx_t idx);
+int txtidx_update (txtidx_t idx, mu_mailbox_t mbox);
+int txtidx_compact (txtidx_t idx, mu_mailbox_t mbox);
+int txtidx_clear (txtidx_t idx);
+int txtidx_lookup (txtidx_t idx, char const *text, txtidx_set_t *ret);
+int txtidx_set_member (txtidx_set_t set, size_t uid);
+void txtidx_set_free (txtidx_set_t set);
+int txtidx_stat (txtidx_t idx, mu_mailbox_t mbox, struct txtidx_stat *st);
+int txtidx_verify (txtidx_t idx, mu_mailbox_t mbox, int deep,
+		   struct txtidx_stat *st);
+
 int message_body_stream (mu_message_t msg, int unix_header,
 			 char const *charset,
 			 mu_stream_t *pstr);
@@ -115,7 +115,7 @@ sieve_init (const char *prog, const char **env, mu_script_descr_t *pdescr)
       if (mu_script_sieve_log)
 	mu_sieve_set_logger (mach, _sieve_action_log);
       sieve_setenv (mach, env);
-      rc = mu_sieve_compile (mach, prog);
+      rc = mu_sieve_compile_cached (mach, prog);
     }
   *pdescr = (mu_script_descr_t) mach;
   return rc;
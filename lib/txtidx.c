@@ -0,0 +1,1747 @@
+/* GNU Mailutils -- a suite of utilities for electronic mail
+   Copyright (C) 2022 Free Software Foundation, Inc.
+
+   GNU Mailutils is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   GNU Mailutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Mailutils.  If not, see <http://www.gnu.org/licenses/>. */
+
+/*
+ * Full-text index of a mailbox.
+ *
+ * The index speeds up searching for a substring in message bodies (IMAP
+ * SEARCH BODY and TEXT).  For each message it records the set of
+ * trigrams (sequences of three bytes) occurring in the lines of its text
+ * parts, after decoding their transfer encoding and folding the case.
+ * A message may contain a string only if it contains all trigrams of the
+ * string, so the index yields a set of candidate messages, which are
+ * then checked by the usual means.
+ *
+ * The text parts are indexed in two forms: as is, and converted to
+ * UTF-8 from the charset they declare.  Thus the index can be used
+ * for searches in US-ASCII and UTF-8.
+ *
+ * The index of the mailbox file NAME is kept in the file .NAME.txtidx
+ * in the same directory, that of a directory mailbox (maildir, MH) in
+ * the file .mu-txtidx inside it.  The file begins with a header, which
+ * identifies the format and keeps the UIDVALIDITY of the mailbox.  It
+ * is followed by one or more segments, each of which describes a set
+ * of messages, identified by their UIDs, and consists of:
+ *
+ *   1. Segment header.
+ *   2. Sorted array of UIDs of the messages it describes.
+ *   3. Posting lists: for each trigram, the UIDs of the messages that
+ *      contain it, delta-encoded as variable-length integers.
+ *   4. Trigram table: sorted array of trigrams, with the number of
+ *      entries in their posting lists and their locations.
+ *
+ * New messages are indexed by appending a segment to the file under an
+ * exclusive fcntl lock.  When the segments accumulate or describe too
+ * many messages that no longer exist, the file is rewritten as a single
+ * segment.  If the UIDVALIDITY of the mailbox changes, it is started
+ * anew.  Files are replaced by renaming, so that the processes reading
+ * the old copy are not disturbed.
+ *
+ * Messages that cannot be indexed are listed under the pseudo-trigram
+ * TXTIDX_ANY, which matches any string.
+ *
+ * The index is stored in native byte order.  A file in another format
+ * or byte order is discarded.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <mailutils/types.h>
+#include <mailutils/alloc.h>
+#include <mailutils/assoc.h>
+#include <mailutils/cstr.h>
+#include <mailutils/diag.h>
+#include <mailutils/errno.h>
+#include <mailutils/filter.h>
+#include <mailutils/header.h>
+#include <mailutils/io.h>
+#include <mailutils/body.h>
+#include <mailutils/message.h>
+#include <mailutils/mailbox.h>
+#include <mailutils/mime.h>
+#include <mailutils/stream.h>
+#include <mailutils/url.h>
+#include <mailutils/util.h>
+#include "muaux.h"
+
+#define TXTIDX_DIR_FILE_NAME ".mu-txtidx"
+#define TXTIDX_FILE_SUFFIX   ".txtidx"
+#define TXTIDX_MAGIC         "MUTXTIX"
+#define TXTIDX_VERSION       1
+#define TXTIDX_BYTEORDER     0x01020304
+#define TXTIDX_SEGMENT_MAGIC 0x54474553  /* "SEGT" */
+
+/* Pseudo-trigram that matches anything */
+#define TXTIDX_ANY 0x1000000
+
+/* Write out a segment when the number of trigram occurrences collected
+   for it reaches this number. */
+#define TXTIDX_BATCH_SIZE (4*1024*1024)
+/* Rewrite the file when it has more segments than this, */
+#define TXTIDX_MAX_SEGMENTS 16
+/* or when it describes more messages no longer in the mailbox than
+   there are messages in it, plus this number. */
+#define TXTIDX_STALE_SLACK 1024
+
+struct txtidx_header
+{
+  char magic[8];
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t byteorder;
+  uint64_t uidvalidity;
+  uint64_t reserved2;
+};
+
+struct txtidx_segment_header
+{
+  uint32_t magic;
+  uint32_t nuids;            /* Number of UIDs */
+  uint32_t ntrigrams;        /* Number of entries in the trigram table */
+  uint32_t reserved;
+  uint64_t size;             /* Size of the segment */
+  uint64_t table_off;        /* Offset of the trigram table */
+};
+
+struct txtidx_trigram
+{
+  uint32_t trigram;
+  uint32_t count;            /* Number of UIDs in the posting list */
+  uint64_t offset;           /* Offset of the posting list */
+};
+
+#define ALIGN8(n) (((n) + 7) & ~(size_t)7)
+
+/* A segment in memory.  All offsets are relative to the beginning of
+   the file. */
+struct txtidx_segment
+{
+  size_t off;                /* Offset of the segment */
+  size_t size;               /* Its size */
+  size_t nuids;
+  size_t uids_off;           /* Offset of the UID array */
+  size_t ntrigrams;
+  size_t table_off;          /* Offset of the trigram table */
+};
+
+struct txtidx
+{
+  char *file_name;           /* Index file name */
+  uid_t owner;               /* Mailbox owner */
+  int flags;                 /* TXTIDX_* flags */
+  int fd;                    /* Index file descriptor */
+  dev_t dev;                 /* Device and */
+  ino_t ino;                 /* inode of the file */
+  unsigned long uidvalidity; /* UIDVALIDITY of the mailbox */
+  int valid;                 /* The file header is valid */
+  char *map;                 /* File mapping */
+  size_t mapsize;            /* Size of the mapping */
+  size_t end;                /* End of the last valid segment */
+  struct txtidx_segment *seg;/* Segments */
+  size_t nseg;
+  size_t maxseg;
+  uint32_t *uids;            /* Sorted UIDs of all indexed messages */
+  size_t nuids;
+  size_t maxuids;
+};
+
+struct txtidx_set
+{
+  int all;                   /* All messages are candidates */
+  uint32_t *indexed;         /* Indexed messages */
+  size_t nindexed;
+  uint32_t *cand;            /* Candidates among the indexed messages */
+  size_t ncand;
+};
+
+/* Vector of UIDs */
+struct uidvec
+{
+  uint32_t *v;
+  size_t n;
+  size_t max;
+};
+
+static void
+uidvec_add (struct uidvec *vec, uint32_t uid)
+{
+  if (vec->n == vec->max)
+    vec->v = mu_2nrealloc (vec->v, &vec->max, sizeof vec->v[0]);
+  vec->v[vec->n++] = uid;
+}
+
+static int
+uidcmp (const void *a, const void *b)
+{
+  uint32_t x = *(uint32_t const *) a;
+  uint32_t y = *(uint32_t const *) b;
+  return x < y ? -1 : x > y;
+}
+
+/* Sort the vector and remove duplicates from it. */
+static void
+uidvec_sort (struct uidvec *vec)
+{
+  size_t i, j;
+
+  if (vec->n < 2)
+    return;
+  qsort (vec->v, vec->n, sizeof vec->v[0], uidcmp);
+  for (i = j = 1; i < vec->n; i++)
+    if (vec->v[i] != vec->v[j-1])
+      vec->v[j++] = vec->v[i];
+  vec->n = j;
+}
+
+static int
+uid_member (uint32_t const *v, size_t n, uint32_t uid)
+{
+  return n > 0 && bsearch (&uid, v, n, sizeof v[0], uidcmp) != NULL;
+}
+
+/* Variable-length integers: 7 bits per byte, least significant first,
+   the high bit set in all bytes except the last one. */
+static size_t
+varint_put (unsigned char *p, uint32_t n)
+{
+  size_t i = 0;
+
+  while (n >= 0x80)
+    {
+      p[i++] = (n & 0x7f) | 0x80;
+      n >>= 7;
+    }
+  p[i++] = n;
+  return i;
+}
+
+/* Decode COUNT delta-encoded UIDs from P, not crossing END.  Store them
+   in VEC.  Return 0 on success and MU_ERR_PARSE if the list is damaged. */
+static int
+posting_decode (unsigned char const *p, unsigned char const *end,
+		size_t count, struct uidvec *vec)
+{
+  uint64_t uid = 0;
+  int first = 1;
+
+  while (count--)
+    {
+      uint32_t n = 0;
+      int shift = 0;
+
+      do
+	{
+	  if (p == end || shift > 28)
+	    return MU_ERR_PARSE;
+	  n |= (uint32_t) (*p & 0x7f) << shift;
+	  shift += 7;
+	}
+      while (*p++ & 0x80);
+      uid += n;
+      if (uid > UINT32_MAX || (n == 0 && !first))
+	return MU_ERR_PARSE;
+      uidvec_add (vec, uid);
+      first = 0;
+    }
+  return 0;
+}
+
+/* Output buffer */
+struct outbuf
+{
+  int fd;
+  unsigned char *buf;
+  size_t len;
+  size_t size;
+  off_t off;                 /* File offset of buf[0] */
+};
+
+#define OUTBUF_SIZE (1024*1024)
+
+static int
+outbuf_flush (struct outbuf *ob)
+{
+  size_t i = 0;
+
+  while (i < ob->len)
+    {
+      ssize_t n = pwrite (ob->fd, ob->buf + i, ob->len - i, ob->off + i);
+      if (n < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return errno;
+	}
+      i += n;
+    }
+  ob->off += ob->len;
+  ob->len = 0;
+  return 0;
+}
+
+static int
+outbuf_write (struct outbuf *ob, void const *data, size_t size)
+{
+  while (size)
+    {
+      size_t n;
+
+      if (ob->len == ob->size)
+	{
+	  int rc = outbuf_flush (ob);
+	  if (rc)
+	    return rc;
+	}
+      n = ob->size - ob->len;
+      if (n > size)
+	n = size;
+      memcpy (ob->buf + ob->len, data, n);
+      ob->len += n;
+      data = (char const *) data + n;
+      size -= n;
+    }
+  return 0;
+}
+
+static int
+outbuf_put_uids (struct outbuf *ob, uint32_t const *uids, size_t n)
+{
+  unsigned char tmp[8];
+  uint32_t prev = 0;
+  size_t i;
+  int rc = 0;
+
+  for (i = 0; rc == 0 && i < n; i++)
+    {
+      rc = outbuf_write (ob, tmp, varint_put (tmp, uids[i] - prev));
+      prev = uids[i];
+    }
+  return rc;
+}
+
+static int
+outbuf_pad (struct outbuf *ob)
+{
+  static char zero[8];
+  size_t n = ob->off + ob->len;
+  return outbuf_write (ob, zero, ALIGN8 (n) - n);
+}
+
+/* Index file handling */
+
+/* Return the name of the index file of the mailbox MBX and store the
+   mailbox owner in *POWNER. */
+static char *
+txtidx_file_name (mu_mailbox_t mbx, uid_t *powner)
+{
+  mu_url_t url;
+  char const *path;
+  struct stat st;
+  char *dir, *base, *name;
+
+  if (mu_mailbox_get_url (mbx, &url)
+      || mu_url_sget_path (url, &path)
+      || path[0] != '/'
+      || stat (path, &st))
+    return NULL;
+  *powner = st.st_uid;
+  if (S_ISDIR (st.st_mode))
+    return mu_make_file_name (path, TXTIDX_DIR_FILE_NAME);
+
+  dir = mu_strdup (path);
+  base = strrchr (dir, '/');
+  *base++ = 0;
+  name = mu_alloc (strlen (dir) + strlen (base)
+		   + sizeof (TXTIDX_FILE_SUFFIX) + 2);
+  sprintf (name, "%s/.%s%s", dir, base, TXTIDX_FILE_SUFFIX);
+  free (dir);
+  return name;
+}
+
+static int
+txtidx_lock (int fd, int type)
+{
+  struct flock fl;
+
+  memset (&fl, 0, sizeof fl);
+  fl.l_type = type;
+  fl.l_whence = SEEK_SET;
+  while (fcntl (fd, F_SETLKW, &fl))
+    {
+      if (errno != EINTR)
+	return errno;
+    }
+  return 0;
+}
+
+static void
+txtidx_unmap (txtidx_t idx)
+{
+  if (idx->map)
+    {
+      munmap (idx->map, idx->mapsize);
+      idx->map = NULL;
+      idx->mapsize = 0;
+    }
+  idx->nseg = 0;
+  idx->nuids = 0;
+  idx->end = 0;
+  idx->valid = 0;
+}
+
+/* Open the index file.  The file usually resides in a directory other
+   users can write to (e.g. the mail spool, when the index is updated
+   during delivery), so it is opened with mu_sidecar_open. */
+static int
+txtidx_open_file (txtidx_t idx)
+{
+  struct stat st;
+  int fd;
+  int rc;
+
+  rc = mu_sidecar_open (idx->file_name,
+			O_RDWR | ((idx->flags & TXTIDX_CREATE) ? O_CREAT : 0),
+			idx->owner, &fd, &st);
+  if (rc)
+    return rc;
+  if (idx->fd != -1)
+    close (idx->fd);
+  txtidx_unmap (idx);
+  idx->fd = fd;
+  idx->dev = st.st_dev;
+  idx->ino = st.st_ino;
+  return 0;
+}
+
+/* Lock the index file.  If it has been replaced by another process,
+   reopen it. */
+static int
+txtidx_acquire (txtidx_t idx, int type)
+{
+  for (;;)
+    {
+      struct stat st;
+      int rc = txtidx_lock (idx->fd, type);
+      if (rc)
+	return rc;
+      if (stat (idx->file_name, &st) == 0
+	  && st.st_dev == idx->dev && st.st_ino == idx->ino)
+	return 0;
+      txtidx_lock (idx->fd, F_UNLCK);
+      rc = txtidx_open_file (idx);
+      if (rc)
+	return rc;
+    }
+}
+
+static void
+txtidx_release (txtidx_t idx)
+{
+  txtidx_lock (idx->fd, F_UNLCK);
+}
+
+/* Parse the segment at offset OFF.  Return 0 if it is valid. */
+static int
+txtidx_parse_segment (txtidx_t idx, size_t off, struct txtidx_segment *seg)
+{
+  struct txtidx_segment_header hdr;
+  size_t uids_end;
+
+  if (off % 8 || idx->mapsize - off < sizeof hdr)
+    return MU_ERR_PARSE;
+  memcpy (&hdr, idx->map + off, sizeof hdr);
+  if (hdr.magic != TXTIDX_SEGMENT_MAGIC
+      || hdr.size > idx->mapsize - off
+      || hdr.size % 8)
+    return MU_ERR_PARSE;
+  uids_end = sizeof hdr + (size_t) hdr.nuids * sizeof (uint32_t);
+  if (uids_end > hdr.size
+      || hdr.table_off < uids_end
+      || hdr.table_off % 8
+      || hdr.table_off > hdr.size
+      || (hdr.size - hdr.table_off) / sizeof (struct txtidx_trigram)
+	   < hdr.ntrigrams)
+    return MU_ERR_PARSE;
+  seg->off = off;
+  seg->size = hdr.size;
+  seg->nuids = hdr.nuids;
+  seg->uids_off = off + sizeof hdr;
+  seg->ntrigrams = hdr.ntrigrams;
+  seg->table_off = off + hdr.table_off;
+  return 0;
+}
+
+static uint32_t const *
+seg_uids (txtidx_t idx, struct txtidx_segment *seg)
+{
+  return (uint32_t const *) (idx->map + seg->uids_off);
+}
+
+static struct txtidx_trigram const *
+seg_table (txtidx_t idx, struct txtidx_segment *seg)
+{
+  return (struct txtidx_trigram const *) (idx->map + seg->table_off);
+}
+
+/* Find trigram T in the table of SEG. */
+static struct txtidx_trigram const *
+seg_find (txtidx_t idx, struct txtidx_segment *seg, uint32_t t)
+{
+  struct txtidx_trigram const *tab = seg_table (idx, seg);
+  size_t lo = 0, hi = seg->ntrigrams;
+
+  while (lo < hi)
+    {
+      size_t mid = (lo + hi) / 2;
+      if (tab[mid].trigram == t)
+	return &tab[mid];
+      if (tab[mid].trigram < t)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  return NULL;
+}
+
+/* Decode the posting list of table entry ENT of SEG. */
+static int
+seg_postings (txtidx_t idx, struct txtidx_segment *seg,
+	      struct txtidx_trigram const *ent, struct uidvec *vec)
+{
+  if (ent->offset >= seg->table_off - seg->off)
+    return MU_ERR_PARSE;
+  return posting_decode ((unsigned char const *) idx->map + seg->off
+			   + ent->offset,
+			 (unsigned char const *) idx->map + seg->table_off,
+			 ent->count, vec);
+}
+
+/* Read the index file.  Must be called with the file locked. */
+static int
+txtidx_load (txtidx_t idx)
+{
+  struct stat st;
+  struct txtidx_header hdr;
+  size_t off;
+  struct uidvec uids;
+  size_t i;
+
+  if (fstat (idx->fd, &st))
+    return errno;
+  if ((size_t) st.st_size != idx->mapsize)
+    {
+      txtidx_unmap (idx);
+      if (st.st_size == 0)
+	return 0;
+      idx->map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, idx->fd, 0);
+      if (idx->map == MAP_FAILED)
+	{
+	  idx->map = NULL;
+	  return errno;
+	}
+      idx->mapsize = st.st_size;
+    }
+  else if (idx->valid && idx->end == idx->mapsize)
+    return 0;
+
+  idx->valid = 0;
+  idx->nseg = 0;
+  idx->end = 0;
+  if (idx->mapsize < sizeof hdr)
+    return 0;
+  memcpy (&hdr, idx->map, sizeof hdr);
+  if (memcmp (hdr.magic, TXTIDX_MAGIC, sizeof TXTIDX_MAGIC)
+      || hdr.version != TXTIDX_VERSION
+      || hdr.byteorder != TXTIDX_BYTEORDER
+      || hdr.uidvalidity != idx->uidvalidity)
+    return 0;
+  idx->valid = 1;
+
+  for (off = sizeof hdr; off < idx->mapsize; )
+    {
+      struct txtidx_segment seg;
+      if (txtidx_parse_segment (idx, off, &seg))
+	break;
+      if (idx->nseg == idx->maxseg)
+	idx->seg = mu_2nrealloc (idx->seg, &idx->maxseg, sizeof idx->seg[0]);
+      idx->seg[idx->nseg++] = seg;
+      off += seg.size;
+    }
+  idx->end = off;
+
+  uids.v = idx->uids;
+  uids.n = 0;
+  uids.max = idx->maxuids;
+  for (i = 0; i < idx->nseg; i++)
+    {
+      uint32_t const *p = seg_uids (idx, &idx->seg[i]);
+      size_t j;
+      for (j = 0; j < idx->seg[i].nuids; j++)
+	uidvec_add (&uids, p[j]);
+    }
+  uidvec_sort (&uids);
+  idx->uids = uids.v;
+  idx->nuids = uids.n;
+  idx->maxuids = uids.max;
+  return 0;
+}
+
+static int
+write_header (int fd, unsigned long uidvalidity)
+{
+  struct txtidx_header hdr;
+
+  memset (&hdr, 0, sizeof hdr);
+  memcpy (hdr.magic, TXTIDX_MAGIC, sizeof TXTIDX_MAGIC);
+  hdr.version = TXTIDX_VERSION;
+  hdr.byteorder = TXTIDX_BYTEORDER;
+  hdr.uidvalidity = uidvalidity;
+  if (pwrite (fd, &hdr, sizeof hdr, 0) != sizeof hdr)
+    return errno ? errno : EIO;
+  return 0;
+}
+
+/* Replace the index file with the temporary file TMPNAME (open on FD),
+   and reopen it. */
+static int
+txtidx_replace (txtidx_t idx, char const *tmpname, int fd)
+{
+  struct stat st;
+
+  if (fstat (idx->fd, &st) == 0)
+    fchmod (fd, st.st_mode & 07777);
+  if (rename (tmpname, idx->file_name))
+    {
+      int rc = errno;
+      unlink (tmpname);
+      close (fd);
+      return rc;
+    }
+  close (fd);
+  return txtidx_open_file (idx);
+}
+
+/* Create a temporary file for rewriting the index.  Return its name
+   in *PNAME and descriptor in *PFD. */
+static int
+txtidx_create_tmp (txtidx_t idx, char **pname, int *pfd)
+{
+  char *name;
+  int fd;
+  int rc;
+
+  rc = mu_sidecar_tempfile (idx->file_name, &fd, &name);
+  if (rc)
+    return rc;
+  rc = txtidx_lock (fd, F_WRLCK);
+  if (rc == 0)
+    rc = write_header (fd, idx->uidvalidity);
+  if (rc)
+    {
+      close (fd);
+      unlink (name);
+      free (name);
+      return rc;
+    }
+  *pname = name;
+  *pfd = fd;
+  return 0;
+}
+
+/* Start the index anew.  Must be called with the file locked
+   exclusively. */
+static int
+txtidx_reset (txtidx_t idx)
+{
+  char *tmpname;
+  int fd;
+  int rc;
+
+  if (idx->mapsize == 0)
+    {
+      /* Nobody can use an empty file: initialize it in place */
+      rc = write_header (idx->fd, idx->uidvalidity);
+      if (rc == 0)
+	rc = txtidx_load (idx);
+      return rc;
+    }
+  rc = txtidx_create_tmp (idx, &tmpname, &fd);
+  if (rc)
+    return rc;
+  rc = txtidx_replace (idx, tmpname, fd);
+  free (tmpname);
+  if (rc == 0)
+    rc = txtidx_acquire (idx, F_WRLCK);
+  if (rc == 0)
+    rc = txtidx_load (idx);
+  return rc;
+}
+
+/* Text extraction */
+
+struct txtidx_builder
+{
+  unsigned char *bitmap;     /* Trigrams seen in the current message */
+  struct uidvec tri;         /* The same, as a list */
+  uint64_t *pairs;           /* (trigram << 32) | uid */
+  size_t npairs;
+  size_t maxpairs;
+  struct uidvec uids;        /* Indexed messages */
+};
+
+static void
+builder_init (struct txtidx_builder *bld)
+{
+  memset (bld, 0, sizeof *bld);
+  bld->bitmap = mu_zalloc ((TXTIDX_ANY + 1) / 8);
+}
+
+static void
+builder_reset (struct txtidx_builder *bld)
+{
+  bld->npairs = 0;
+  bld->uids.n = 0;
+}
+
+static void
+builder_free (struct txtidx_builder *bld)
+{
+  free (bld->bitmap);
+  free (bld->tri.v);
+  free (bld->pairs);
+  free (bld->uids.v);
+}
+
+static inline void
+builder_add_trigram (struct txtidx_builder *bld, uint32_t t)
+{
+  if (!(bld->bitmap[t >> 3] & (1 << (t & 7))))
+    {
+      bld->bitmap[t >> 3] |= 1 << (t & 7);
+      uidvec_add (&bld->tri, t);
+    }
+}
+
+#define FOLD(c) (((c) >= 'A' && (c) <= 'Z') ? (c) - 'A' + 'a' : (c))
+
+/* Compute the trigram key of the three bytes at P.  ASCII letters are
+   folded to lower case, for the benefit of systems without Unicode
+   case mapping. */
+static inline uint32_t
+trigram (unsigned char const *p)
+{
+  return (FOLD (p[0]) << 16) | (FOLD (p[1]) << 8) | FOLD (p[2]);
+}
+
+/* Add trigrams of the line BUF, as it will be seen by the search code:
+   case-folded and terminated at the first NUL character. */
+static void
+builder_add_line (struct txtidx_builder *bld, char const *buf)
+{
+  char *lc;
+  unsigned char const *p;
+  size_t i, len;
+
+  unistr_downcase (buf, &lc);
+  p = (unsigned char const *) (lc ? lc : buf);
+  len = strlen ((char const *) p);
+  for (i = 0; i + 3 <= len; i++)
+    builder_add_trigram (bld, trigram (p + i));
+  free (lc);
+}
+
+/* Index the lines of text part MSG.  If CHARSET is not NULL, convert
+   the text from it to UTF-8. */
+static int
+builder_scan_stream (struct txtidx_builder *bld, mu_message_t msg,
+		     char const *encoding, char const *charset)
+{
+  mu_body_t body;
+  mu_stream_t str;
+  char *buffer = NULL;
+  size_t bufsize = 0;
+  size_t n;
+  int rc;
+
+  rc = mu_message_get_body (msg, &body);
+  if (rc == 0)
+    rc = mu_body_get_streamref (body, &str);
+  if (rc)
+    return rc;
+
+  if (encoding)
+    {
+      mu_stream_t flt;
+      rc = mu_filter_create (&flt, str, encoding, MU_FILTER_DECODE,
+			     MU_STREAM_READ);
+      mu_stream_unref (str);
+      if (rc)
+	/* Unsupported encoding: the message can't be searched either */
+	return 0;
+      str = flt;
+    }
+
+  if (charset)
+    {
+      char const *argv[] = { "iconv", NULL, "UTF-8", NULL };
+      mu_stream_t flt;
+
+      argv[1] = charset;
+      rc = mu_filter_chain_create (&flt, str,
+				   MU_FILTER_ENCODE,
+				   MU_STREAM_READ,
+				   MU_ARRAY_SIZE (argv) - 1,
+				   (char**) argv);
+      mu_stream_unref (str);
+      if (rc)
+	return 0;
+      str = flt;
+    }
+
+  while ((rc = mu_stream_getline (str, &buffer, &bufsize, &n)) == 0
+	 && n > 0)
+    builder_add_line (bld, buffer);
+  free (buffer);
+  mu_stream_destroy (&str);
+  return rc;
+}
+
+/* Index the text parts of MSG.  The traversal follows the one done when
+   searching message bodies. */
+static int
+builder_scan_part (struct txtidx_builder *bld, mu_message_t msg)
+{
+  mu_header_t hdr;
+  char *encoding;
+  int ismp;
+  mu_content_type_t ct;
+  char *buf;
+  int rc;
+
+  rc = mu_message_is_multipart (msg, &ismp);
+  if (rc == 0)
+    rc = mu_message_get_header (msg, &hdr);
+  if (rc)
+    return rc;
+
+  if (mu_header_aget_value_unfold (hdr, MU_HEADER_CONTENT_TYPE, &buf))
+    buf = mu_strdup ("text/plain");
+  rc = mu_content_type_parse (buf, NULL, &ct);
+  free (buf);
+  if (rc)
+    return 0;
+
+  if (mu_header_aget_value_unfold (hdr, MU_HEADER_CONTENT_TRANSFER_ENCODING,
+				   &encoding))
+    encoding = NULL;
+
+  if (ismp)
+    {
+      size_t i, nparts;
+
+      rc = mu_message_get_num_parts (msg, &nparts);
+      for (i = 1; rc == 0 && i <= nparts; i++)
+	{
+	  mu_message_t submsg;
+
+	  rc = mu_message_get_part (msg, i, &submsg);
+	  if (rc == 0)
+	    rc = builder_scan_part (bld, submsg);
+	}
+    }
+  else if (mu_c_strcasecmp (ct->type, "message") == 0
+	   && mu_c_strcasecmp (ct->subtype, "rfc822") == 0)
+    {
+      mu_message_t submsg;
+
+      if (mu_message_unencapsulate (msg, &submsg, NULL) == 0)
+	rc = builder_scan_part (bld, submsg);
+    }
+  else if (mu_c_strcasecmp (ct->type, "text") == 0)
+    {
+      struct mu_mime_param *param;
+
+      rc = builder_scan_stream (bld, msg, encoding, NULL);
+      if (rc == 0
+	  && mu_assoc_lookup (ct->param, "charset", &param) == 0
+	  && mu_c_strcasecmp (param->value, "UTF-8"))
+	rc = builder_scan_stream (bld, msg, encoding, param->value);
+    }
+
+  free (encoding);
+  mu_content_type_destroy (&ct);
+  return rc;
+}
+
+static void
+builder_add_pair (struct txtidx_builder *bld, uint32_t t, uint32_t uid)
+{
+  if (bld->npairs == bld->maxpairs)
+    bld->pairs = mu_2nrealloc (bld->pairs, &bld->maxpairs,
+			       sizeof bld->pairs[0]);
+  bld->pairs[bld->npairs++] = ((uint64_t) t << 32) | uid;
+}
+
+/* Index message MSG with the given UID. */
+static void
+builder_add_message (struct txtidx_builder *bld, mu_message_t msg,
+		     uint32_t uid)
+{
+  size_t i;
+  int rc;
+
+  bld->tri.n = 0;
+  rc = builder_scan_part (bld, msg);
+  for (i = 0; i < bld->tri.n; i++)
+    {
+      uint32_t t = bld->tri.v[i];
+      bld->bitmap[t >> 3] &= ~(1 << (t & 7));
+      if (rc == 0)
+	builder_add_pair (bld, t, uid);
+    }
+  if (rc)
+    {
+      mu_diag_output (MU_DIAG_NOTICE,
+		      "can't index message with UID %lu: %s",
+		      (unsigned long) uid, mu_strerror (rc));
+      builder_add_pair (bld, TXTIDX_ANY, uid);
+    }
+  uidvec_add (&bld->uids, uid);
+}
+
+static int
+paircmp (const void *a, const void *b)
+{
+  uint64_t x = *(uint64_t const *) a;
+  uint64_t y = *(uint64_t const *) b;
+  return x < y ? -1 : x > y;
+}
+
+/* Segment output */
+
+struct segment_writer
+{
+  struct outbuf ob;
+  off_t start;               /* Offset of the segment */
+  struct txtidx_trigram *tab;
+  size_t ntab;
+  size_t maxtab;
+};
+
+static int
+segment_begin (struct segment_writer *sw, int fd, off_t start,
+	       uint32_t const *uids, size_t nuids)
+{
+  struct txtidx_segment_header hdr;
+  int rc;
+
+  memset (sw, 0, sizeof *sw);
+  sw->ob.fd = fd;
+  sw->ob.size = OUTBUF_SIZE;
+  sw->ob.buf = mu_alloc (sw->ob.size);
+  sw->ob.off = start;
+  sw->start = start;
+  memset (&hdr, 0, sizeof hdr);
+  rc = outbuf_write (&sw->ob, &hdr, sizeof hdr);
+  if (rc == 0)
+    rc = outbuf_write (&sw->ob, uids, nuids * sizeof uids[0]);
+  return rc;
+}
+
+static int
+segment_add (struct segment_writer *sw, uint32_t t,
+	     uint32_t const *uids, size_t n)
+{
+  struct txtidx_trigram *ent;
+
+  if (n == 0)
+    return 0;
+  if (sw->ntab == sw->maxtab)
+    sw->tab = mu_2nrealloc (sw->tab, &sw->maxtab, sizeof sw->tab[0]);
+  ent = &sw->tab[sw->ntab++];
+  ent->trigram = t;
+  ent->count = n;
+  ent->offset = sw->ob.off + sw->ob.len - sw->start;
+  return outbuf_put_uids (&sw->ob, uids, n);
+}
+
+/* Finish the segment.  On success, return its size in *PSIZE. */
+static int
+segment_end (struct segment_writer *sw, size_t nuids, size_t *psize)
+{
+  struct txtidx_segment_header hdr;
+  int rc;
+
+  memset (&hdr, 0, sizeof hdr);
+  hdr.magic = TXTIDX_SEGMENT_MAGIC;
+  hdr.nuids = nuids;
+  hdr.ntrigrams = sw->ntab;
+  rc = outbuf_pad (&sw->ob);
+  if (rc == 0)
+    {
+      hdr.table_off = sw->ob.off + sw->ob.len - sw->start;
+      rc = outbuf_write (&sw->ob, sw->tab, sw->ntab * sizeof sw->tab[0]);
+    }
+  if (rc == 0)
+    rc = outbuf_flush (&sw->ob);
+  if (rc == 0)
+    {
+      hdr.size = sw->ob.off - sw->start;
+      if (pwrite (sw->ob.fd, &hdr, sizeof hdr, sw->start) != sizeof hdr)
+	rc = errno ? errno : EIO;
+      else
+	*psize = hdr.size;
+    }
+  free (sw->ob.buf);
+  free (sw->tab);
+  return rc;
+}
+
+/* Append the collected data to the index as a new segment. */
+static int
+txtidx_flush (txtidx_t idx, struct txtidx_builder *bld)
+{
+  struct segment_writer sw;
+  struct uidvec vec = { NULL, 0, 0 };
+  size_t i, size;
+  int rc;
+
+  if (bld->uids.n == 0)
+    return 0;
+  uidvec_sort (&bld->uids);
+  qsort (bld->pairs, bld->npairs, sizeof bld->pairs[0], paircmp);
+
+  rc = txtidx_acquire (idx, F_WRLCK);
+  if (rc)
+    return rc;
+  rc = txtidx_load (idx);
+  if (rc == 0 && !idx->valid)
+    /* The index was discarded by another process meanwhile.  The
+       messages will be indexed anew next time. */
+    goto end;
+  if (rc == 0 && idx->end < idx->mapsize && ftruncate (idx->fd, idx->end))
+    rc = errno;
+  if (rc)
+    goto end;
+
+  rc = segment_begin (&sw, idx->fd, idx->end, bld->uids.v, bld->uids.n);
+  for (i = 0; rc == 0 && i < bld->npairs; )
+    {
+      uint32_t t = bld->pairs[i] >> 32;
+
+      vec.n = 0;
+      for (; i < bld->npairs && (bld->pairs[i] >> 32) == t; i++)
+	uidvec_add (&vec, bld->pairs[i] & UINT32_MAX);
+      rc = segment_add (&sw, t, vec.v, vec.n);
+    }
+  if (rc == 0)
+    rc = segment_end (&sw, bld->uids.n, &size);
+  else
+    {
+      free (sw.ob.buf);
+      free (sw.tab);
+    }
+  if (rc)
+    {
+      if (ftruncate (idx->fd, idx->end))
+	/* Ignore it: the damaged tail is discarded when reading */;
+    }
+  else
+    rc = txtidx_load (idx);
+ end:
+  txtidx_release (idx);
+  free (vec.v);
+  builder_reset (bld);
+  return rc;
+}
+
+/* Rewrite the index as a single segment, omitting the messages not
+   listed in LIVE (unless it is NULL).  Must be called with the file
+   locked exclusively. */
+static int
+txtidx_rewrite (txtidx_t idx, struct uidvec *live)
+{
+  char *tmpname;
+  int fd;
+  struct segment_writer sw;
+  struct uidvec uids = { NULL, 0, 0 }, vec = { NULL, 0, 0 };
+  size_t *pos;
+  size_t i, size;
+  int rc;
+
+  rc = txtidx_create_tmp (idx, &tmpname, &fd);
+  if (rc)
+    return rc;
+
+  for (i = 0; i < idx->nuids; i++)
+    if (!live || uid_member (live->v, live->n, idx->uids[i]))
+      uidvec_add (&uids, idx->uids[i]);
+
+  pos = mu_calloc (idx->nseg ? idx->nseg : 1, sizeof pos[0]);
+  rc = segment_begin (&sw, fd, sizeof (struct txtidx_header),
+		      uids.v, uids.n);
+  while (rc == 0)
+    {
+      uint32_t t = UINT32_MAX;
+      int merged = 0;
+
+      /* Find the least trigram not yet processed */
+      for (i = 0; i < idx->nseg; i++)
+	if (pos[i] < idx->seg[i].ntrigrams)
+	  {
+	    uint32_t n = seg_table (idx, &idx->seg[i])[pos[i]].trigram;
+	    if (n < t)
+	      t = n;
+	  }
+      if (t == UINT32_MAX)
+	break;
+
+      vec.n = 0;
+      for (i = 0; rc == 0 && i < idx->nseg; i++)
+	{
+	  struct txtidx_trigram const *ent;
+
+	  if (pos[i] == idx->seg[i].ntrigrams)
+	    continue;
+	  ent = seg_table (idx, &idx->seg[i]) + pos[i];
+	  if (ent->trigram == t)
+	    {
+	      size_t j, n = vec.n;
+
+	      rc = seg_postings (idx, &idx->seg[i], ent, &vec);
+	      for (j = n; j < vec.n; j++)
+		if (uid_member (uids.v, uids.n, vec.v[j]))
+		  vec.v[n++] = vec.v[j];
+	      vec.n = n;
+	      merged++;
+	      pos[i]++;
+	    }
+	}
+      if (rc)
+	break;
+      if (merged > 1)
+	uidvec_sort (&vec);
+      rc = segment_add (&sw, t, vec.v, vec.n);
+    }
+  if (rc == 0)
+    rc = segment_end (&sw, uids.n, &size);
+  else
+    {
+      free (sw.ob.buf);
+      free (sw.tab);
+    }
+  free (pos);
+  free (uids.v);
+  free (vec.v);
+
+  if (rc == 0)
+    rc = txtidx_replace (idx, tmpname, fd);
+  else
+    {
+      close (fd);
+      unlink (tmpname);
+    }
+  free (tmpname);
+  if (rc == 0)
+    rc = txtidx_acquire (idx, F_WRLCK);
+  if (rc == 0)
+    rc = txtidx_load (idx);
+  return rc;
+}
+
+/* Public interface */
+
+int
+txtidx_open (mu_mailbox_t mbox, int flags, txtidx_t *ret)
+{
+  txtidx_t idx;
+  int rc;
+
+  idx = mu_zalloc (sizeof (*idx));
+  idx->fd = -1;
+  idx->flags = flags;
+  idx->file_name = txtidx_file_name (mbox, &idx->owner);
+  if (!idx->file_name)
+    {
+      free (idx);
+      return ENOSYS;
+    }
+  /* Open the file first: getting the UIDVALIDITY may require scanning
+     the mailbox, which is wasted if there is no index. */
+  rc = txtidx_open_file (idx);
+  if (rc == 0)
+    rc = mu_mailbox_uidvalidity (mbox, &idx->uidvalidity);
+  if (rc == 0)
+    {
+      rc = txtidx_acquire (idx, F_RDLCK);
+      if (rc == 0)
+	{
+	  rc = txtidx_load (idx);
+	  txtidx_release (idx);
+	}
+    }
+  if (rc)
+    txtidx_close (&idx);
+  *ret = idx;
+  return rc;
+}
+
+void
+txtidx_close (txtidx_t *pidx)
+{
+  txtidx_t idx = *pidx;
+
+  if (!idx)
+    return;
+  txtidx_unmap (idx);
+  if (idx->fd != -1)
+    close (idx->fd);
+  free (idx->file_name);
+  free (idx->seg);
+  free (idx->uids);
+  free (idx);
+  *pidx = NULL;
+}
+
+char const *
+txtidx_file (txtidx_t idx)
+{
+  return idx->file_name;
+}
+
+/* Collect the UIDs of the messages in MBOX. */
+static int
+mailbox_uids (mu_mailbox_t mbox, struct uidvec *vec)
+{
+  size_t i, count;
+  int rc;
+
+  rc = mu_mailbox_messages_count (mbox, &count);
+  for (i = 1; rc == 0 && i <= count; i++)
+    {
+      mu_message_t msg;
+      size_t uid;
+
+      rc = mu_mailbox_get_message (mbox, i, &msg);
+      if (rc == 0)
+	rc = mu_message_get_uid (msg, &uid);
+      if (rc == 0 && uid <= UINT32_MAX)
+	uidvec_add (vec, uid);
+    }
+  uidvec_sort (vec);
+  return rc;
+}
+
+/* Bring the index up to date with MBOX: index the messages not yet
+   described in it, and rewrite it if it is out of date or has
+   accumulated too much garbage (unless TXTIDX_APPEND is set). */
+int
+txtidx_update (txtidx_t idx, mu_mailbox_t mbox)
+{
+  struct uidvec live = { NULL, 0, 0 };
+  struct txtidx_builder bld;
+  size_t i, stale;
+  int rc;
+
+  rc = txtidx_acquire (idx, F_WRLCK);
+  if (rc)
+    return rc;
+  rc = txtidx_load (idx);
+  if (rc == 0 && !idx->valid)
+    {
+      if (idx->mapsize > 0 && (idx->flags & TXTIDX_APPEND))
+	{
+	  /* Leave it for the owner to rebuild */
+	  txtidx_release (idx);
+	  return 0;
+	}
+      rc = txtidx_reset (idx);
+    }
+  if (rc == 0)
+    rc = mailbox_uids (mbox, &live);
+  if (rc == 0 && !(idx->flags & TXTIDX_APPEND))
+    {
+      for (i = stale = 0; i < idx->nuids; i++)
+	if (!uid_member (live.v, live.n, idx->uids[i]))
+	  stale++;
+      if (idx->nseg > TXTIDX_MAX_SEGMENTS
+	  || stale > live.n + TXTIDX_STALE_SLACK)
+	rc = txtidx_rewrite (idx, &live);
+    }
+  txtidx_release (idx);
+
+  if (rc == 0)
+    {
+      size_t count;
+
+      /* Index the new messages without holding the lock */
+      builder_init (&bld);
+      rc = mu_mailbox_messages_count (mbox, &count);
+      for (i = 1; rc == 0 && i <= count; i++)
+	{
+	  mu_message_t msg;
+	  size_t uid;
+
+	  if (mu_mailbox_get_message (mbox, i, &msg)
+	      || mu_message_get_uid (msg, &uid)
+	      || uid > UINT32_MAX
+	      || uid_member (idx->uids, idx->nuids, uid))
+	    continue;
+	  builder_add_message (&bld, msg, uid);
+	  if (bld.npairs >= TXTIDX_BATCH_SIZE)
+	    rc = txtidx_flush (idx, &bld);
+	}
+      if (rc == 0)
+	rc = txtidx_flush (idx, &bld);
+      builder_free (&bld);
+    }
+  free (live.v);
+  return rc;
+}
+
+/* Compact the index: rewrite it as a single segment describing only
+   the messages present in MBOX. */
+int
+txtidx_compact (txtidx_t idx, mu_mailbox_t mbox)
+{
+  struct uidvec live = { NULL, 0, 0 };
+  int rc;
+
+  rc = mailbox_uids (mbox, &live);
+  if (rc == 0)
+    rc = txtidx_acquire (idx, F_WRLCK);
+  if (rc == 0)
+    {
+      rc = txtidx_load (idx);
+      if (rc == 0)
+	rc = idx->valid ? txtidx_rewrite (idx, &live) : txtidx_reset (idx);
+      txtidx_release (idx);
+    }
+  free (live.v);
+  return rc;
+}
+
+/* Discard the contents of the index. */
+int
+txtidx_clear (txtidx_t idx)
+{
+  int rc;
+
+  rc = txtidx_acquire (idx, F_WRLCK);
+  if (rc == 0)
+    {
+      rc = txtidx_load (idx);
+      if (rc == 0)
+	rc = txtidx_reset (idx);
+      txtidx_release (idx);
+    }
+  return rc;
+}
+
+static int
+entcmp (const void *a, const void *b)
+{
+  struct txtidx_trigram const *x = *(struct txtidx_trigram const **) a;
+  struct txtidx_trigram const *y = *(struct txtidx_trigram const **) b;
+  return x->count < y->count ? -1 : x->count > y->count;
+}
+
+/* Intersect the sorted vector A with the sorted vector B, leaving the
+   result in A. */
+static void
+uidvec_intersect (struct uidvec *a, struct uidvec const *b)
+{
+  size_t i = 0, j = 0, k = 0;
+
+  while (i < a->n && j < b->n)
+    {
+      if (a->v[i] < b->v[j])
+	i++;
+      else if (a->v[i] > b->v[j])
+	j++;
+      else
+	{
+	  a->v[k++] = a->v[i];
+	  i++;
+	  j++;
+	}
+    }
+  a->n = k;
+}
+
+/* Collect in CAND the messages from segment SEG that may contain all
+   trigrams from TRI. */
+static void
+seg_lookup (txtidx_t idx, struct txtidx_segment *seg,
+	    struct uidvec const *tri, struct uidvec *cand)
+{
+  struct txtidx_trigram const **ent;
+  struct txtidx_trigram const *any;
+  struct uidvec a = { NULL, 0, 0 }, b = { NULL, 0, 0 };
+  size_t i;
+  int rc = 0;
+
+  ent = mu_calloc (tri->n, sizeof ent[0]);
+  for (i = 0; i < tri->n; i++)
+    if ((ent[i] = seg_find (idx, seg, tri->v[i])) == NULL)
+      break;
+  if (i == tri->n)
+    {
+      /* Start from the shortest posting list */
+      qsort (ent, tri->n, sizeof ent[0], entcmp);
+      rc = seg_postings (idx, seg, ent[0], &a);
+      for (i = 1; rc == 0 && a.n > 0 && i < tri->n; i++)
+	{
+	  b.n = 0;
+	  rc = seg_postings (idx, seg, ent[i], &b);
+	  uidvec_intersect (&a, &b);
+	}
+    }
+  if ((any = seg_find (idx, seg, TXTIDX_ANY)) != NULL && rc == 0)
+    rc = seg_postings (idx, seg, any, &a);
+  if (rc)
+    {
+      /* Damaged segment: all its messages are candidates */
+      uint32_t const *uids = seg_uids (idx, seg);
+      a.n = 0;
+      for (i = 0; i < seg->nuids; i++)
+	uidvec_add (&a, uids[i]);
+    }
+  for (i = 0; i < a.n; i++)
+    uidvec_add (cand, a.v[i]);
+  free (a.v);
+  free (b.v);
+  free (ent);
+}
+
+/* Look up the messages whose bodies may contain TEXT.  The string is
+   compared in the same way as by unistr_is_substring_dn. */
+int
+txtidx_lookup (txtidx_t idx, char const *text, txtidx_set_t *ret)
+{
+  struct txtidx_set *set;
+  struct uidvec tri = { NULL, 0, 0 }, cand = { NULL, 0, 0 };
+  char *lc;
+  unsigned char const *p;
+  size_t i, len;
+  int rc;
+
+  set = mu_zalloc (sizeof (*set));
+  *ret = set;
+
+  unistr_downcase (text, &lc);
+  p = (unsigned char const *) (lc ? lc : text);
+  len = strlen ((char const *) p);
+  for (i = 0; i + 3 <= len; i++)
+    uidvec_add (&tri, trigram (p + i));
+  free (lc);
+  if (tri.n == 0)
+    {
+      set->all = 1;
+      return 0;
+    }
+  uidvec_sort (&tri);
+
+  rc = txtidx_acquire (idx, F_RDLCK);
+  if (rc == 0)
+    {
+      rc = txtidx_load (idx);
+      txtidx_release (idx);
+    }
+  if (rc || !idx->valid)
+    {
+      set->all = 1;
+      free (tri.v);
+      return rc;
+    }
+
+  for (i = 0; i < idx->nseg; i++)
+    seg_lookup (idx, &idx->seg[i], &tri, &cand);
+  uidvec_sort (&cand);
+  free (tri.v);
+
+  set->cand = cand.v;
+  set->ncand = cand.n;
+  set->nindexed = idx->nuids;
+  set->indexed = mu_calloc (idx->nuids ? idx->nuids : 1,
+			    sizeof set->indexed[0]);
+  memcpy (set->indexed, idx->uids, idx->nuids * sizeof set->indexed[0]);
+  return 0;
+}
+
+/* Return true if the message with the given UID is a candidate in SET. */
+int
+txtidx_set_member (txtidx_set_t set, size_t uid)
+{
+  return set->all
+	 || uid > UINT32_MAX
+	 || !uid_member (set->indexed, set->nindexed, uid)
+	 || uid_member (set->cand, set->ncand, uid);
+}
+
+void
+txtidx_set_free (txtidx_set_t set)
+{
+  if (set)
+    {
+      free (set->indexed);
+      free (set->cand);
+      free (set);
+    }
+}
+
+/* Statistics and verification */
+
+static int
+txtidx_stat0 (txtidx_t idx, mu_mailbox_t mbox, struct txtidx_stat *st,
+	      struct uidvec *live)
+{
+  size_t i;
+  int rc;
+
+  memset (st, 0, sizeof *st);
+  rc = mailbox_uids (mbox, live);
+  if (rc)
+    return rc;
+  rc = txtidx_acquire (idx, F_RDLCK);
+  if (rc)
+    return rc;
+  rc = txtidx_load (idx);
+  txtidx_release (idx);
+  if (rc)
+    return rc;
+  st->size = idx->mapsize;
+  if (!idx->valid)
+    {
+      st->unindexed = live->n;
+      return 0;
+    }
+  st->segments = idx->nseg;
+  st->indexed = idx->nuids;
+  for (i = 0; i < idx->nseg; i++)
+    st->trigrams += idx->seg[i].ntrigrams;
+  for (i = 0; i < idx->nuids; i++)
+    if (!uid_member (live->v, live->n, idx->uids[i]))
+      st->stale++;
+  for (i = 0; i < live->n; i++)
+    if (!uid_member (idx->uids, idx->nuids, live->v[i]))
+      st->unindexed++;
+  return 0;
+}
+
+/* Return statistics about the index of MBOX. */
+int
+txtidx_stat (txtidx_t idx, mu_mailbox_t mbox, struct txtidx_stat *st)
+{
+  struct uidvec live = { NULL, 0, 0 };
+  int rc = txtidx_stat0 (idx, mbox, st, &live);
+  free (live.v);
+  return rc;
+}
+
+static void
+verify_error (txtidx_t idx, struct txtidx_stat *st, struct txtidx_segment *seg,
+	      char const *fmt, unsigned long n)
+{
+  char *s;
+
+  mu_asprintf (&s, fmt, n);
+  mu_error ("%s: segment at %lu: %s", idx->file_name,
+	    (unsigned long) seg->off, s);
+  free (s);
+  st->errors++;
+}
+
+/* Check the structure of segment SEG. */
+static void
+verify_segment (txtidx_t idx, struct txtidx_segment *seg,
+		struct txtidx_stat *st)
+{
+  uint32_t const *uids = seg_uids (idx, seg);
+  struct txtidx_trigram const *tab = seg_table (idx, seg);
+  struct uidvec vec = { NULL, 0, 0 };
+  size_t i, j;
+
+  for (i = 1; i < seg->nuids; i++)
+    if (uids[i] <= uids[i-1])
+      {
+	verify_error (idx, st, seg, "UID list not sorted at %lu", i);
+	break;
+      }
+  for (i = 0; i < seg->ntrigrams; i++)
+    {
+      if (tab[i].trigram > TXTIDX_ANY
+	  || (i > 0 && tab[i].trigram <= tab[i-1].trigram))
+	{
+	  verify_error (idx, st, seg, "bad trigram table entry %lu", i);
+	  break;
+	}
+      vec.n = 0;
+      if (seg_postings (idx, seg, &tab[i], &vec))
+	{
+	  verify_error (idx, st, seg, "damaged posting list of trigram %lx",
+			tab[i].trigram);
+	  continue;
+	}
+      for (j = 0; j < vec.n; j++)
+	if (!uid_member (uids, seg->nuids, vec.v[j]))
+	  {
+	    verify_error (idx, st, seg, "posting list refers to unknown UID %lu",
+			  vec.v[j]);
+	    break;
+	  }
+    }
+  free (vec.v);
+}
+
+/* Compare the data collected in BLD with the contents of SEG. */
+static void
+verify_contents (txtidx_t idx, struct txtidx_segment *seg,
+		 struct txtidx_builder *bld, struct txtidx_stat *st)
+{
+  struct txtidx_trigram const *tab = seg_table (idx, seg);
+  struct uidvec vec = { NULL, 0, 0 }, exp = { NULL, 0, 0 };
+  size_t i = 0, j = 0, k;
+
+  uidvec_sort (&bld->uids);
+  qsort (bld->pairs, bld->npairs, sizeof bld->pairs[0], paircmp);
+  while (j < bld->npairs || i < seg->ntrigrams)
+    {
+      uint32_t t;
+
+      if (i < seg->ntrigrams
+	  && (j == bld->npairs || tab[i].trigram <= (bld->pairs[j] >> 32)))
+	t = tab[i].trigram;
+      else
+	t = bld->pairs[j] >> 32;
+
+      exp.n = 0;
+      for (; j < bld->npairs && (bld->pairs[j] >> 32) == t; j++)
+	uidvec_add (&exp, bld->pairs[j] & UINT32_MAX);
+
+      vec.n = 0;
+      if (i < seg->ntrigrams && tab[i].trigram == t)
+	{
+	  if (seg_postings (idx, seg, &tab[i], &vec))
+	    vec.n = 0;
+	  for (k = 0; k < vec.n; )
+	    if (uid_member (bld->uids.v, bld->uids.n, vec.v[k]))
+	      k++;
+	    else
+	      vec.v[k] = vec.v[--vec.n];
+	  uidvec_sort (&vec);
+	  i++;
+	}
+
+      if (vec.n != exp.n || memcmp (vec.v, exp.v, vec.n * sizeof vec.v[0]))
+	{
+	  uint32_t uid;
+
+	  for (k = 0; k < exp.n; k++)
+	    if (!uid_member (vec.v, vec.n, exp.v[k]))
+	      break;
+	  if (k < exp.n)
+	    uid = exp.v[k];
+	  else
+	    {
+	      for (k = 0; k < vec.n; k++)
+		if (!uid_member (exp.v, exp.n, vec.v[k]))
+		  break;
+	      uid = vec.v[k];
+	    }
+	  verify_error (idx, st, seg, "index out of sync for UID %lu", uid);
+	}
+    }
+  free (vec.v);
+  free (exp.v);
+  builder_reset (bld);
+}
+
+/* Verify the index of MBOX: check its structure and, if DEEP is set,
+   compare its contents with the mailbox.  Return statistics in ST.
+   The number of problems found is returned in st->errors. */
+int
+txtidx_verify (txtidx_t idx, mu_mailbox_t mbox, int deep,
+	       struct txtidx_stat *st)
+{
+  struct uidvec live = { NULL, 0, 0 };
+  struct txtidx_builder bld;
+  size_t i, n, count;
+  int rc;
+
+  rc = txtidx_stat0 (idx, mbox, st, &live);
+  free (live.v);
+  if (rc)
+    return rc;
+  if (!idx->valid)
+    {
+      if (idx->mapsize)
+	{
+	  mu_error ("%s: bad header or UIDVALIDITY mismatch", idx->file_name);
+	  st->errors++;
+	}
+      return 0;
+    }
+  if (idx->end != idx->mapsize)
+    {
+      mu_error ("%s: garbage at offset %lu", idx->file_name,
+		(unsigned long) idx->end);
+      st->errors++;
+    }
+  for (i = 0; i < idx->nseg; i++)
+    verify_segment (idx, &idx->seg[i], st);
+  if (!deep || st->errors)
+    return 0;
+
+  rc = mu_mailbox_messages_count (mbox, &count);
+  if (rc)
+    return rc;
+  builder_init (&bld);
+  for (i = 0; i < idx->nseg; i++)
+    {
+      struct txtidx_segment *seg = &idx->seg[i];
+      uint32_t const *uids = seg_uids (idx, seg);
+
+      for (n = 1; n <= count; n++)
+	{
+	  mu_message_t msg;
+	  size_t uid;
+
+	  if (mu_mailbox_get_message (mbox, n, &msg)
+	      || mu_message_get_uid (msg, &uid)
+	      || uid > UINT32_MAX
+	      || !uid_member (uids, seg->nuids, uid))
+	    continue;
+	  builder_add_message (&bld, msg, uid);
+	  if (bld.npairs >= TXTIDX_BATCH_SIZE)
+	    verify_contents (idx, seg, &bld, st);
+	}
+      if (bld.uids.n)
+	verify_contents (idx, seg, &bld, st);
+    }
+  builder_free (&bld);
+  return 0;
+}
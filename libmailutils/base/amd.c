@@ -58,6 +58,7 @@
 #include <mailutils/debug.h>
 #include <mailutils/envelope.h>
 #include <mailutils/error.h>
+#include <mailutils/io.h>
 #include <mailutils/errno.h>
 #include <mailutils/header.h>
 #include <mailutils/locker.h>
@@ -212,6 +213,149 @@ _amd_prop_store_off (struct _amd_data *amd, const char *name, mu_off_t val)
   return mu_property_set_value (amd->prop, name, p, 1);
 }
 
+/* Store in TS the modification time from ST, with the nanosecond part
+   if available.  Changes made within the same second must not go
+   unnoticed. */
+void
+amd_stat_mtime (struct stat const *st, struct timespec *ts)
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+  *ts = st->st_mtim;
+#else
+  ts->tv_sec = st->st_mtime;
+  ts->tv_nsec = 0;
+#endif
+}
+
+/* Compare two timestamps.  Return negative, zero or positive value,
+   if A is, respectively, earlier than, equal to or later than B. */
+int
+amd_timespec_cmp (struct timespec const *a, struct timespec const *b)
+{
+  if (a->tv_sec != b->tv_sec)
+    return a->tv_sec < b->tv_sec ? -1 : 1;
+  if (a->tv_nsec != b->tv_nsec)
+    return a->tv_nsec < b->tv_nsec ? -1 : 1;
+  return 0;
+}
+
+/* Get the modification time of the mailbox. */
+static int
+amd_mailbox_mtime (struct _amd_data *amd, struct timespec *pmtime)
+{
+  struct stat st;
+
+  if (amd->mailbox_mtime)
+    return amd->mailbox_mtime (amd, pmtime);
+  if (stat (amd->name, &st))
+    return errno;
+  amd_stat_mtime (&st, pmtime);
+  return 0;
+}
+
+/* Mailbox size ledger.
+
+   The mailbox size is kept in the "size" property, along with the
+   number of messages it accounts for ("size-count"), the mailbox
+   modification time at the moment it was stored, in nanoseconds
+   ("size-mtime"), and the time it was last computed from scratch
+   ("size-stamp").  The value is adjusted when messages are appended or
+   expunged, so that mu_mailbox_get_size need not examine each message
+   file.  It is recomputed if the mailbox has been modified by someone
+   else, or if it was computed more than _MU_AMD_SIZE_RECONCILE_INTERVAL
+   seconds ago.
+
+   Modification times have limited resolution, so two deliveries can
+   leave the mailbox with the same mtime.  The message count guards
+   against that: a delivery that is not accounted for in the ledger
+   makes the count differ from the number of messages on disk.  The
+   ledger is not used for formats that cannot count their messages
+   (see the mailbox_count method). */
+
+/* Convert mailbox modification time to the form stored in the
+   ledger. */
+static mu_off_t
+amd_size_ledger_mtime (struct timespec const *ts)
+{
+  return (mu_off_t) ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+/* Fetch the mailbox size and message count from the ledger.  Return
+   MU_ERR_NOENT if they are not available or are outdated. */
+static int
+amd_size_ledger_fetch (struct _amd_data *amd, mu_off_t *psize,
+		       size_t *pcount)
+{
+  mu_off_t size, count, mtime, stamp;
+  struct timespec t;
+  time_t now;
+  size_t n;
+
+  if (!amd->mailbox_count
+      || _amd_prop_fetch_off (amd, _MU_AMD_PROP_SIZE, &size)
+      || _amd_prop_fetch_off (amd, _MU_AMD_PROP_SIZE_COUNT, &count)
+      || _amd_prop_fetch_off (amd, _MU_AMD_PROP_SIZE_MTIME, &mtime)
+      || _amd_prop_fetch_off (amd, _MU_AMD_PROP_SIZE_STAMP, &stamp))
+    return MU_ERR_NOENT;
+  now = time (NULL);
+  if (stamp > now || now - stamp >= _MU_AMD_SIZE_RECONCILE_INTERVAL)
+    return MU_ERR_NOENT;
+  if (amd_mailbox_mtime (amd, &t) || amd_size_ledger_mtime (&t) != mtime)
+    return MU_ERR_NOENT;
+  if (amd->mailbox_count (amd, &n) || count < 0 || n != (size_t) count)
+    return MU_ERR_NOENT;
+  *psize = size;
+  *pcount = n;
+  return 0;
+}
+
+/* Store SIZE and COUNT in the ledger.  RECONCILED is true if they have
+   been computed from scratch. */
+static void
+amd_size_ledger_store (struct _amd_data *amd, mu_off_t size, size_t count,
+		       int reconciled)
+{
+  struct timespec t;
+
+  if (!amd->prop || !amd->mailbox_count || amd_mailbox_mtime (amd, &t))
+    return;
+  if (size < 0)
+    size = 0;
+  _amd_prop_store_off (amd, _MU_AMD_PROP_SIZE, size);
+  _amd_prop_store_off (amd, _MU_AMD_PROP_SIZE_COUNT, count);
+  _amd_prop_store_off (amd, _MU_AMD_PROP_SIZE_MTIME,
+		       amd_size_ledger_mtime (&t));
+  if (reconciled)
+    _amd_prop_store_off (amd, _MU_AMD_PROP_SIZE_STAMP, time (NULL));
+}
+
+/* Add the size of the file holding the message MHM, multiplied by SIGN
+   (1 or -1), to the running mailbox size *PSIZE.  Negative *PSIZE
+   means the size is not known, in which case it is left as is.  It is
+   also set to -1 if the message size cannot be determined. */
+static void
+amd_size_account (struct _amd_data *amd, struct _amd_message *mhm,
+		  int sign, mu_off_t *psize)
+{
+  char *name;
+  struct stat st;
+  int rc;
+
+  if (*psize < 0)
+    return;
+  if (amd->cur_msg_file_name (mhm, 1, &name))
+    rc = -1;
+  else
+    {
+      rc = stat (name, &st);
+      free (name);
+    }
+  if (rc)
+    *psize = -1;
+  else
+    *psize += sign * st.st_size;
+}
+
 static int
 _amd_prop_create (struct _amd_data *amd)
 {
@@ -451,6 +595,7 @@ amd_destroy (mu_mailbox_t mailbox)
       mu_message_destroy (&amd->msg_array[i]->message, amd->msg_array[i]);
       if (amd->msg_free)
 	amd->msg_free (amd->msg_array[i]);
+      free (amd->msg_array[i]->uidl);
       free (amd->msg_array[i]);
     }
   free (amd->msg_array);
@@ -525,6 +670,7 @@ amd_close (mu_mailbox_t mailbox)
       mu_message_destroy (&amd->msg_array[i]->message, amd->msg_array[i]);
       if (amd->msg_free)
 	amd->msg_free (amd->msg_array[i]);
+      free (amd->msg_array[i]->uidl);
       free (amd->msg_array[i]);
     }
   free (amd->msg_array);
@@ -548,6 +694,64 @@ amd_message_qid (mu_message_t msg, mu_message_qid_t *pqid)
   return mhm->amd->cur_msg_file_name (mhm, 0, pqid);
 }
 
+/* Return the POP3 UIDL of the message.  An existing X-UIDL header takes
+   precedence, so that the identifiers handed out by the generic code in
+   the past remain valid.  Otherwise, the format-specific message_uidl
+   method is consulted, and, failing that, the UIDL is derived from the
+   UIDVALIDITY and the message UID.  None of these require reading the
+   message body.  The result is cached in MHM.  */
+static int
+amd_message_uidl (mu_message_t msg, char *buffer, size_t buflen,
+		  size_t *pwriten)
+{
+  struct _amd_message *mhm = mu_message_get_owner (msg);
+  struct _amd_data *amd = mhm->amd;
+  size_t len;
+  int rc;
+
+  if (!mhm->uidl)
+    {
+      mu_header_t header;
+
+      rc = mu_message_get_header (msg, &header);
+      if (rc)
+	return rc;
+      rc = mu_header_aget_value_unfold (header, MU_HEADER_X_UIDL,
+					&mhm->uidl);
+      if (rc == 0 && mhm->uidl[0] == 0)
+	{
+	  free (mhm->uidl);
+	  mhm->uidl = NULL;
+	  rc = MU_ERR_NOENT;
+	}
+      if (rc == MU_ERR_NOENT && amd->message_uidl)
+	rc = amd->message_uidl (msg, &mhm->uidl);
+      if (rc == MU_ERR_NOENT && amd->message_uid)
+	{
+	  unsigned long uidvalidity;
+	  size_t uid;
+
+	  rc = amd_get_uidvalidity (amd->mailbox, &uidvalidity);
+	  if (rc == 0)
+	    rc = amd->message_uid (msg, &uid);
+	  if (rc == 0)
+	    rc = mu_asprintf (&mhm->uidl, "%lu.%lu", uidvalidity,
+			      (unsigned long) uid);
+	}
+      if (rc)
+	return rc;
+    }
+
+  len = strlen (mhm->uidl);
+  if (len >= buflen)
+    len = buflen - 1;
+  memcpy (buffer, mhm->uidl, len);
+  buffer[len] = 0;
+  if (pwriten)
+    *pwriten = len;
+  return 0;
+}
+
 static void
 amd_message_detach (mu_message_t msg)
 {
@@ -661,6 +865,7 @@ _amd_attach_message (mu_mailbox_t mailbox, struct _amd_message *mhm,
   /* Set the UID.  */
   if (mhm->amd->message_uid)
     mu_message_set_uid (msg, mhm->amd->message_uid, mhm);
+  mu_message_set_uidl (msg, amd_message_uidl, mhm);
   mu_message_set_qid (msg, amd_message_qid, mhm);
   
   /* Attach the message to the mailbox mbox data.  */
@@ -694,7 +899,7 @@ _amd_scan0 (struct _amd_data *amd, size_t msgno, size_t *pcount,
       _amd_prop_fetch_ulong (amd, _MU_AMD_PROP_UIDVALIDITY, &uidval) ||
       !uidval)
     {
-      uidval = (unsigned long) amd->mtime;
+      uidval = (unsigned long) amd->mtime.tv_sec;
       _amd_prop_store_off (amd, _MU_AMD_PROP_UIDVALIDITY, uidval);
     }
   return 0;
@@ -997,6 +1202,276 @@ _amd_message_save (struct _amd_data *amd, struct _amd_message *mhm,
   return status;
 }
 
+/* Single-instance delivery.
+
+   When the same message is appended to several mailboxes in turn (as
+   lmtpd and mda do when delivering to multiple recipients), the file
+   written for the first recipient is remembered and hard-linked into
+   the mailboxes of the subsequent ones, instead of formatting and
+   writing the message anew.  The link is made only if the resulting
+   file would be identical to the one that would have been written,
+   i.e. if the message has not been modified (e.g. by a Sieve
+   script), the envelope and attributes are the same and the
+   target mailbox stores its message status in the same way.  Since a
+   link shares the owner and mode of its source, it is used only if the
+   source file belongs to the current effective UID and has the mode the
+   target mailbox would have assigned.  On any failure (e.g. EXDEV when
+   the mailboxes are on different file systems) the message is copied.
+
+   In effect, this benefits only deliveries made under a single UID,
+   such as to virtual users.  Mda and lmtpd switch to the UID of each
+   local recipient, so no links are made between ordinary users'
+   mailboxes.  Neither are they made between recipients that lmtpd
+   serves in separate worker processes (delivery-workers > 1), as the
+   record below lives in the memory of a single process.
+
+   Single-instance delivery is enabled by mu_set_mailbox_single_instance
+   or the MU_MAILBOX_SINGLE_INSTANCE environment variable. */
+
+struct amd_instance
+{
+  mu_message_t msg;          /* Message the file was written for */
+  mu_observer_t observer;    /* Observer of its destruction */
+  char *file_name;           /* Name of the written file */
+  dev_t dev;                 /* Its device and inode */
+  ino_t ino;
+  char *sender;              /* Envelope sender and date */
+  char *date;
+  int attr_flags;            /* Message attributes */
+  int status;                /* MU_AMD_STATUS capability of the mailbox */
+  size_t header_lines;       /* Message layout in the file */
+  size_t header_size;
+  size_t body_start;
+  size_t body_lines;
+  size_t body_end;
+};
+
+static struct amd_instance amd_instance;
+
+static void
+amd_instance_forget (void)
+{
+  if (amd_instance.observer && amd_instance.msg)
+    {
+      mu_observable_t observable;
+      /* Detaching destroys the observer */
+      if (mu_message_get_observable (amd_instance.msg, &observable) == 0)
+	mu_observable_detach (observable, amd_instance.observer);
+    }
+  free (amd_instance.file_name);
+  free (amd_instance.sender);
+  free (amd_instance.date);
+  memset (&amd_instance, 0, sizeof (amd_instance));
+}
+
+static int
+amd_instance_destroy_action (mu_observer_t obs, size_t type, void *data,
+			     void *action_data)
+{
+  if (type == MU_EVT_MESSAGE_DESTROY && data == amd_instance.msg)
+    {
+      /* The observable is being destroyed along with its observers */
+      amd_instance.msg = NULL;
+      amd_instance_forget ();
+    }
+  return 0;
+}
+
+static void
+amd_envelope_strings (mu_envelope_t env, char const **psender,
+		      char const **pdate)
+{
+  *psender = *pdate = NULL;
+  if (env)
+    {
+      mu_envelope_sget_sender (env, psender);
+      mu_envelope_sget_date (env, pdate);
+    }
+}
+
+static int
+strnull_eq (char const *a, char const *b)
+{
+  if (!a || !b)
+    return a == b;
+  return strcmp (a, b) == 0;
+}
+
+/* Return true if neither the header nor the body of MSG has been
+   modified since amd_message_snapshot was called for it. */
+static int
+amd_message_pristine (mu_message_t msg)
+{
+  mu_header_t hdr;
+  mu_body_t body;
+
+  return mu_message_get_header (msg, &hdr) == 0
+	 && !mu_header_is_modified (hdr)
+	 && mu_message_get_body (msg, &body) == 0
+	 && !mu_body_is_modified (body);
+}
+
+/* Prepare MSG for tracking its modifications by amd_message_pristine.
+   Only messages that do not belong to a mailbox are eligible: their
+   modification flags carry no pending changes.  The message-level flag
+   and the body flag of such a message are set when it is assembled, so
+   the latter is cleared here.  Return true if MSG is eligible. */
+static int
+amd_message_snapshot (mu_message_t msg)
+{
+  mu_mailbox_t mbox;
+  mu_header_t hdr;
+  mu_body_t body;
+
+  if (mu_message_get_mailbox (msg, &mbox) == 0 && mbox)
+    return 0;
+  if (mu_message_get_header (msg, &hdr)
+      || mu_header_is_modified (hdr)
+      || mu_message_get_body (msg, &body))
+    return 0;
+  mu_body_clear_modified (body);
+  return 1;
+}
+
+/* Mode of a newly delivered message file in AMD */
+static mode_t
+amd_message_mode (struct _amd_data *amd)
+{
+  mode_t perms = mu_stream_flags_to_mode (amd->mailbox->flags, 0);
+  if (perms != 0)
+    {
+      mode_t mask = umask (0);
+      umask (mask);
+      return (0600 | perms) & ~mask;
+    }
+  return 0600;
+}
+
+/* Remember the file just written for MSG as the source of further
+   links. */
+static void
+amd_instance_record (struct _amd_data *amd, struct _amd_message *mhm,
+		     mu_message_t msg, mu_envelope_t env)
+{
+  char *name;
+  struct stat st;
+  char const *sender, *date;
+
+  if (!mu_mailbox_single_instance_enabled ())
+    return;
+  if (!amd_message_snapshot (msg))
+    return;
+  if (amd->cur_msg_file_name (mhm, 1, &name))
+    return;
+  if (stat (name, &st))
+    {
+      free (name);
+      return;
+    }
+
+  if (amd_instance.msg != msg)
+    {
+      mu_observable_t observable;
+      mu_observer_t observer;
+
+      amd_instance_forget ();
+      if (mu_message_get_observable (msg, &observable)
+	  || mu_observer_create (&observer, NULL))
+	{
+	  free (name);
+	  return;
+	}
+      mu_observer_set_action (observer, amd_instance_destroy_action, NULL);
+      if (mu_observable_attach (observable, MU_EVT_MESSAGE_DESTROY, observer))
+	{
+	  mu_observer_destroy (&observer, NULL);
+	  free (name);
+	  return;
+	}
+      amd_instance.msg = msg;
+      amd_instance.observer = observer;
+    }
+  else
+    {
+      free (amd_instance.file_name);
+      free (amd_instance.sender);
+      free (amd_instance.date);
+    }
+
+  amd_envelope_strings (env, &sender, &date);
+  amd_instance.file_name = name;
+  amd_instance.dev = st.st_dev;
+  amd_instance.ino = st.st_ino;
+  amd_instance.sender = sender ? strdup (sender) : NULL;
+  amd_instance.date = date ? strdup (date) : NULL;
+  amd_instance.attr_flags = mhm->attr_flags;
+  amd_instance.status = amd->capabilities & MU_AMD_STATUS;
+  amd_instance.header_lines = mhm->header_lines;
+  amd_instance.header_size = mhm->header_size;
+  amd_instance.body_start = mhm->body_start;
+  amd_instance.body_lines = mhm->body_lines;
+  amd_instance.body_end = mhm->body_end;
+  if ((sender && !amd_instance.sender) || (date && !amd_instance.date))
+    amd_instance_forget ();
+}
+
+/* Try to deliver the message of MHM by linking the file remembered by
+   amd_instance_record.  Return 0 on success. */
+static int
+amd_instance_link (struct _amd_data *amd, struct _amd_message *mhm,
+		   mu_envelope_t env)
+{
+  char *msg_name;
+  struct stat st;
+  char const *sender, *date;
+  int status;
+
+  if (!amd_instance.file_name
+      || amd_instance.msg != mhm->message
+      || !mu_mailbox_single_instance_enabled ())
+    return MU_ERR_NOENT;
+  amd_envelope_strings (env, &sender, &date);
+  if (!amd_message_pristine (mhm->message)
+      || !strnull_eq (sender, amd_instance.sender)
+      || !strnull_eq (date, amd_instance.date)
+      || mhm->attr_flags != amd_instance.attr_flags
+      || (amd->capabilities & MU_AMD_STATUS) != amd_instance.status
+      || mhm->header_size != mhm->body_start)
+    return MU_ERR_NOENT;
+
+  if (stat (amd_instance.file_name, &st))
+    return errno;
+  if (st.st_dev != amd_instance.dev || st.st_ino != amd_instance.ino
+      || st.st_uid != geteuid ()
+      || (st.st_mode & 07777) != amd_message_mode (amd))
+    return MU_ERR_NOENT;
+
+  status = amd->new_msg_file_name (mhm, mhm->attr_flags, 0, &msg_name);
+  if (status)
+    return status;
+  if (!msg_name)
+    return MU_ERR_NOENT;
+  if (link (amd_instance.file_name, msg_name))
+    {
+      status = errno;
+      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_TRACE1,
+		("cannot link %s to %s: %s",
+		 amd_instance.file_name, msg_name, mu_strerror (status)));
+      free (msg_name);
+      return status;
+    }
+  mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_TRACE1,
+	    ("linked %s to %s", amd_instance.file_name, msg_name));
+  free (msg_name);
+
+  mhm->header_lines = amd_instance.header_lines;
+  mhm->header_size = amd_instance.header_size;
+  mhm->body_start = amd_instance.body_start;
+  mhm->body_lines = amd_instance.body_lines;
+  mhm->body_end = amd_instance.body_end;
+  return 0;
+}
+
 static int
 amd_append_message (mu_mailbox_t mailbox, mu_message_t msg,
 		    mu_envelope_t env, mu_attribute_t atr)
@@ -1004,6 +1479,8 @@ amd_append_message (mu_mailbox_t mailbox, mu_message_t msg,
   int status;
   struct _amd_data *amd = mailbox->data;
   struct _amd_message *mhm;
+  mu_off_t size;
+  size_t count = 0;
   
   if (!mailbox || !msg)
     return EINVAL;
@@ -1040,12 +1517,18 @@ amd_append_message (mu_mailbox_t mailbox, mu_message_t msg,
 
   if (atr)
     mu_attribute_get_flags (atr, &mhm->attr_flags);
+
+  if (amd_size_ledger_fetch (amd, &size, &count))
+    size = -1;
   
-  status = _amd_message_save (amd, mhm, env, 0);
-  if (status)
+  if (amd_instance_link (amd, mhm, env))
     {
-      free (mhm);
-      return status;
+      status = _amd_message_save (amd, mhm, env, 0);
+      if (status)
+	{
+	  free (mhm);
+	  return status;
+	}
     }
 
   mhm->message = NULL;
@@ -1059,6 +1542,16 @@ amd_append_message (mu_mailbox_t mailbox, mu_message_t msg,
 
   if (amd->msg_finish_delivery)
     status = amd->msg_finish_delivery (amd, mhm, msg, atr);
+
+  if (status == 0)
+    amd_instance_record (amd, mhm, msg, env);
+  
+  if (status == 0 && size >= 0)
+    {
+      amd_size_account (amd, mhm, 1, &size);
+      if (size >= 0)
+	amd_size_ledger_store (amd, size, count + 1, 0);
+    }
   
   if (status == 0 && mailbox->observable)
     {
@@ -1212,20 +1705,6 @@ _compute_mailbox_size_recursive (struct _amd_data *amd, const char *name,
   return status;
 }
 
-static int
-compute_mailbox_size (struct _amd_data *amd, mu_off_t *psize)
-{
-  mu_off_t size = 0;
-  int rc = _compute_mailbox_size_recursive (amd, amd->name, &size);
-  if (rc == 0)
-    {
-      rc = _amd_prop_store_off (amd, _MU_AMD_PROP_SIZE, size);
-      if (rc == 0 && psize)
-	*psize = size;
-    }
-  return rc;
-}
-
 static int
 amd_remove_mbox (mu_mailbox_t mailbox)
 {
@@ -1264,7 +1743,7 @@ amd_remove_mbox (mu_mailbox_t mailbox)
 
 static int
 _amd_update_message (struct _amd_data *amd, struct _amd_message *mhm,
-		     int expunge, int *upd)
+		     int expunge, int *upd, mu_off_t *psize)
 {
   int flg, rc;
       
@@ -1299,10 +1778,14 @@ _amd_update_message (struct _amd_data *amd, struct _amd_message *mhm,
 		     mu_strerror (rc)));
 	  return rc;
 	}
-	  
+
+      amd_size_account (amd, mhm, -1, psize);
       rc = _amd_message_save (amd, mhm, NULL, expunge);
-      if (rc)
+      if (rc == 0)
+	amd_size_account (amd, mhm, 1, psize);
+      else
 	{
+	  *psize = -1;
 	  mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
 		    ("_amd_update_message: _amd_message_save failed: %s",
 		     mu_strerror (rc)));
@@ -1322,6 +1805,8 @@ amd_expunge (mu_mailbox_t mailbox)
   int updated = amd->has_new_msg;
   size_t expcount = 0;
   size_t last_expunged = 0;
+  mu_off_t size;
+  size_t count = 0;
   
   if (amd == NULL)
     return EINVAL;
@@ -1329,6 +1814,9 @@ amd_expunge (mu_mailbox_t mailbox)
   if (amd->msg_count == 0)
     return 0;
 
+  if (amd_size_ledger_fetch (amd, &size, &count))
+    size = -1;
+
   for (i = 0; i < amd->msg_count; i++)
     {
       mhm = amd->msg_array[i];
@@ -1338,6 +1826,8 @@ amd_expunge (mu_mailbox_t mailbox)
 	  int rc;
 	  struct _amd_message **pp;
 
+	  amd_size_account (amd, mhm, -1, &size);
+	  count--;
 	  if (amd->delete_msg)
 	    {
 	      rc = amd->delete_msg (amd, mhm);
@@ -1398,6 +1888,7 @@ amd_expunge (mu_mailbox_t mailbox)
 	  mu_message_destroy (&mhm->message, mhm);
 	  if (amd->msg_free)
 	    amd->msg_free (mhm);
+	  free (mhm->uidl);
 	  free (mhm);
 	  amd->msg_array[i] = NULL;
 	  last_expunged = i;
@@ -1413,7 +1904,7 @@ amd_expunge (mu_mailbox_t mailbox)
 	}
       else
 	{
-	  _amd_update_message (amd, mhm, 1, &updated);/*FIXME: Error checking*/
+	  _amd_update_message (amd, mhm, 1, &updated, &size);/*FIXME: Error checking*/
 	}
     }
 
@@ -1457,10 +1948,8 @@ amd_expunge (mu_mailbox_t mailbox)
 	}
     }
   
-  if (updated && !amd->mailbox_size)
-    {
-      compute_mailbox_size (amd, NULL);
-    }
+  if (updated && size >= 0)
+    amd_size_ledger_store (amd, size, count, 0);
   return 0;
 }
 
@@ -1471,6 +1960,8 @@ amd_sync (mu_mailbox_t mailbox)
   struct _amd_message *mhm;
   size_t i;
   int updated = amd->has_new_msg;
+  mu_off_t size;
+  size_t count = 0;
   
   if (amd == NULL)
     return EINVAL;
@@ -1478,6 +1969,9 @@ amd_sync (mu_mailbox_t mailbox)
   if (amd->msg_count == 0)
     return 0;
 
+  if (amd_size_ledger_fetch (amd, &size, &count))
+    size = -1;
+
   /* Find the first dirty(modified) message.  */
   for (i = 0; i < amd->msg_count; i++)
     {
@@ -1490,13 +1984,11 @@ amd_sync (mu_mailbox_t mailbox)
   for ( ; i < amd->msg_count; i++)
     {
       mhm = amd->msg_array[i];
-      _amd_update_message (amd, mhm, 0, &updated); 
+      _amd_update_message (amd, mhm, 0, &updated, &size); 
     }
 
-  if (updated && !amd->mailbox_size)
-    {
-      compute_mailbox_size (amd, NULL);
-    }
+  if (updated && size >= 0)
+    amd_size_ledger_store (amd, size, count, 0);
 
   return 0;
 }
@@ -1863,24 +2355,40 @@ amd_scan (mu_mailbox_t mailbox, size_t msgno, size_t *pcount)
 static int
 amd_is_updated (mu_mailbox_t mailbox)
 {
-  struct stat st;
   struct _amd_data *amd = mailbox->data;
+  struct timespec t;
 
-  if (stat (amd->name, &st) < 0)
+  if (amd_mailbox_mtime (amd, &t))
     return 1;
-
-  return amd->mtime == st.st_mtime;
+  return amd_timespec_cmp (&amd->mtime, &t) == 0;
 }
 
 static int
 amd_get_size (mu_mailbox_t mailbox, mu_off_t *psize)
 {
   struct _amd_data *amd = mailbox->data;
+  mu_off_t size = 0;
+  size_t count;
+  int rc;
+
+  if (amd_size_ledger_fetch (amd, psize, &count) == 0)
+    return 0;
+  /* Count the messages before computing their size: a message
+     delivered in between will then make the ledger mismatch, instead
+     of being silently left out of it. */
+  if (!amd->mailbox_count || amd->mailbox_count (amd, &count))
+    count = (size_t) -1;
   if (amd->mailbox_size)
-    return amd->mailbox_size (mailbox, psize);
-  if (_amd_prop_fetch_off (amd, _MU_AMD_PROP_SIZE, psize))
-    return compute_mailbox_size (amd, psize);
-  return 0;
+    rc = amd->mailbox_size (mailbox, &size);
+  else
+    rc = _compute_mailbox_size_recursive (amd, amd->name, &size);
+  if (rc == 0)
+    {
+      if (count != (size_t) -1)
+	amd_size_ledger_store (amd, size, count, 1);
+      *psize = size;
+    }
+  return rc;
 }
 
 /* Return number of open streams residing in a message pool */
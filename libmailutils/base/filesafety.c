@@ -23,6 +23,8 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <mailutils/types.h>
 #include <mailutils/errno.h>
 #include <mailutils/mu_auth.h>
@@ -265,3 +267,81 @@ mu_safety_criteria_to_file_mode (int crit)
       mode &= ~pck->mode;
   return mode;
 }
+
+#ifndef O_NOFOLLOW
+# define O_NOFOLLOW 0
+#endif
+
+/* Open the sidecar file NAME, i.e. a file keeping auxiliary data of a
+   mailbox owned by OWNER.  Such files are usually kept next to the
+   mailbox, i.e. in a directory other users may be able to write to.
+   FLAGS are open(2) flags.  With O_CREAT, a missing file is created
+   with mode 0600.  Refuse to open a symbolic link, a file with several
+   hard links, a file owned by someone other than OWNER or the effective
+   user, and a file writable by group or others.  On success, return the
+   descriptor in *PFD and, unless PST is NULL, the file status in
+   *PST. */
+int
+mu_sidecar_open (char const *name, int flags, uid_t owner,
+		 int *pfd, struct stat *pst)
+{
+  struct stat st;
+  int fd;
+  int rc = 0;
+
+  fd = open (name, flags | O_NOFOLLOW, 0600);
+  if (fd == -1)
+    return errno;
+  if (!pst)
+    pst = &st;
+  if (fstat (fd, pst))
+    rc = errno;
+  else if (!S_ISREG (pst->st_mode))
+    rc = MU_ERR_NOENT;
+  else if (pst->st_nlink != 1)
+    rc = MU_ERR_PERM_LINKED_WRDIR;
+  else if (pst->st_uid != owner && pst->st_uid != geteuid ())
+    rc = MU_ERR_PERM_OWNER_MISMATCH;
+  else if (pst->st_mode & S_IWGRP)
+    rc = MU_ERR_PERM_GROUP_WRITABLE;
+  else if (pst->st_mode & S_IWOTH)
+    rc = MU_ERR_PERM_WORLD_WRITABLE;
+  if (rc)
+    {
+      close (fd);
+      return rc;
+    }
+  *pfd = fd;
+  return 0;
+}
+
+/* Create a temporary file for rewriting the sidecar file NAME.  The
+   file is created exclusively, with mode 0600, in the same directory
+   as NAME, so that it can then be renamed to NAME.  Return its
+   descriptor in *PFD and its name in *PTMPNAME. */
+int
+mu_sidecar_tempfile (char const *name, int *pfd, char **ptmpname)
+{
+  struct mu_tempfile_hints hints;
+  char *p = strrchr (name, '/');
+  char *dir;
+  int rc;
+
+  if (p)
+    {
+      dir = malloc (p - name + 1);
+      if (!dir)
+	return ENOMEM;
+      memcpy (dir, name, p - name);
+      dir[p - name] = 0;
+      hints.tmpdir = dir[0] ? dir : "/";
+    }
+  else
+    {
+      dir = NULL;
+      hints.tmpdir = ".";
+    }
+  rc = mu_tempfile (&hints, MU_TEMPFILE_TMPDIR, pfd, ptmpname);
+  free (dir);
+  return rc;
+}
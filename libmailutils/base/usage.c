@@ -0,0 +1,186 @@
+/* GNU Mailutils -- a suite of utilities for electronic mail
+   Copyright (C) 2022 Free Software Foundation, Inc.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 3 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General
+   Public License along with this library.  If not, see
+   <http://www.gnu.org/licenses/>. */
+
+/* Mailbox usage ledger.
+
+   The ledger keeps the total size of the mailboxes in a directory (as a
+   rule, the user's home directory), so that the mail quota can be checked
+   without opening each mailbox.  It is stored in the file .mu-usage in
+   that directory, as a single line:
+
+     SIZE STAMP
+
+   where SIZE is the total size in bytes and STAMP is the time when the
+   size was last computed from scratch (reconciled).  Between
+   reconciliations, the ledger is adjusted by the programs that modify
+   the mailboxes.  All accesses are serialized using fcntl locks. */
+
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <mailutils/types.h>
+#include <mailutils/errno.h>
+#include <mailutils/util.h>
+
+static int
+ledger_open (const char *dir, int flags, int *pfd)
+{
+  char *name;
+  int fd;
+
+  name = mu_make_file_name (dir, MU_USAGE_LEDGER_NAME);
+  if (!name)
+    return errno;
+  fd = open (name, flags, 0600);
+  free (name);
+  if (fd == -1)
+    return errno;
+  *pfd = fd;
+  return 0;
+}
+
+static int
+ledger_lock (int fd, int type)
+{
+  struct flock fl;
+
+  memset (&fl, 0, sizeof fl);
+  fl.l_type = type;
+  fl.l_whence = SEEK_SET;
+  while (fcntl (fd, F_SETLKW, &fl))
+    {
+      if (errno != EINTR)
+	return errno;
+    }
+  return 0;
+}
+
+static int
+ledger_get (int fd, mu_off_t *psize, time_t *pstamp)
+{
+  char buf[64];
+  ssize_t n;
+  char *p;
+  unsigned long long size, stamp;
+
+  n = pread (fd, buf, sizeof buf - 1, 0);
+  if (n == -1)
+    return errno;
+  buf[n] = 0;
+  errno = 0;
+  size = strtoull (buf, &p, 10);
+  if (errno || p == buf || *p != ' ')
+    return MU_ERR_FORMAT;
+  stamp = strtoull (p + 1, &p, 10);
+  if (errno || *p != '\n')
+    return MU_ERR_FORMAT;
+  *psize = size;
+  if (pstamp)
+    *pstamp = stamp;
+  return 0;
+}
+
+static int
+ledger_put (int fd, mu_off_t size, time_t stamp)
+{
+  char buf[64];
+  int len;
+
+  len = snprintf (buf, sizeof buf, "%llu %llu\n",
+		  (unsigned long long) size, (unsigned long long) stamp);
+  if (ftruncate (fd, 0) || pwrite (fd, buf, len, 0) != len)
+    return errno;
+  return 0;
+}
+
+/* Read the ledger in DIR.  Store the recorded size in *PSIZE and the
+   time of the last reconciliation in *PSTAMP (unless it is NULL).
+   Return ENOENT if there is no ledger and MU_ERR_FORMAT if it is
+   corrupted. */
+int
+mu_usage_ledger_read (const char *dir, mu_off_t *psize, time_t *pstamp)
+{
+  int fd;
+  int rc;
+
+  rc = ledger_open (dir, O_RDONLY, &fd);
+  if (rc)
+    return rc;
+  rc = ledger_lock (fd, F_RDLCK);
+  if (rc == 0)
+    rc = ledger_get (fd, psize, pstamp);
+  close (fd);
+  return rc;
+}
+
+/* Reconcile the ledger in DIR: record SIZE as the actual usage, computed
+   at the current time.  Create the ledger if it does not exist. */
+int
+mu_usage_ledger_write (const char *dir, mu_off_t size)
+{
+  int fd;
+  int rc;
+
+  rc = ledger_open (dir, O_RDWR | O_CREAT, &fd);
+  if (rc)
+    return rc;
+  rc = ledger_lock (fd, F_WRLCK);
+  if (rc == 0)
+    rc = ledger_put (fd, size, time (NULL));
+  close (fd);
+  return rc;
+}
+
+/* Add DELTA (which may be negative) to the size recorded in the ledger
+   in DIR.  If PSIZE is not NULL, store the resulting size in it.
+   The ledger is never created by this function: ENOENT is returned if
+   it does not exist. */
+int
+mu_usage_ledger_update (const char *dir, mu_off_t delta, mu_off_t *psize)
+{
+  int fd;
+  int rc;
+  mu_off_t size;
+  time_t stamp;
+
+  rc = ledger_open (dir, O_RDWR, &fd);
+  if (rc)
+    return rc;
+  rc = ledger_lock (fd, F_WRLCK);
+  if (rc == 0)
+    rc = ledger_get (fd, &size, &stamp);
+  if (rc == 0)
+    {
+      if (delta < 0 && -delta > size)
+	size = 0;
+      else
+	size += delta;
+      rc = ledger_put (fd, size, stamp);
+      if (rc == 0 && psize)
+	*psize = size;
+    }
+  close (fd);
+  return rc;
+}
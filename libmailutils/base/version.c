@@ -88,6 +88,9 @@ static struct mu_conf_option mu_conf_option[] = {
 #ifdef WITH_UNISTRING
   { "WITH_UNISTRING", N_("Using GNU libunistring") },
 #endif  
+#ifdef HAVE_LIBZ
+  { "HAVE_LIBZ", N_("Deflate compression using zlib") },
+#endif
 #ifdef HAVE_MYSQL
   { "HAVE_MYSQL", N_("MySQL") },
 #endif
@@ -148,6 +148,15 @@ static struct mu_cfg_param mailer_cfg[] = {
   { "url", mu_cfg_callback, NULL, 0, cb_mailer,
     N_("Use this URL as the default mailer"),
     N_("url: string") },
+  { "cache-size", mu_c_size, &mu_mailer_cache_size, 0, NULL,
+    N_("Keep at most this number of idle mailer connections open for "
+       "reuse.  0 disables connection caching.") },
+  { "idle-timeout", mu_c_uint, &mu_mailer_cache_idle_timeout, 0, NULL,
+    N_("Close cached connections that have been idle for this number "
+       "of seconds.") },
+  { "max-messages", mu_c_size, &mu_mailer_cache_max_messages, 0, NULL,
+    N_("Close a connection after sending this number of messages over "
+       "it.  0 means unlimited.") },
   { NULL }
 };
 
@@ -276,6 +285,54 @@ cb_autodetect_accuracy (void *data, mu_config_value_t *val)
   return 0;
 }
 
+static int
+cb_mailbox_index (void *data, mu_config_value_t *val)
+{
+  int v;
+  
+  if (mu_cfg_assert_value_type (val, MU_CFG_STRING))
+    return 1;
+  if (mu_str_to_c (val->v.string, mu_c_bool, &v, NULL))
+    {
+      mu_error (_("not a boolean: %s"), val->v.string);
+      return 1;
+    }
+  mu_set_mailbox_index (v);
+  return 0;
+}
+
+static int
+cb_mailbox_single_instance (void *data, mu_config_value_t *val)
+{
+  int v;
+  
+  if (mu_cfg_assert_value_type (val, MU_CFG_STRING))
+    return 1;
+  if (mu_str_to_c (val->v.string, mu_c_bool, &v, NULL))
+    {
+      mu_error (_("not a boolean: %s"), val->v.string);
+      return 1;
+    }
+  mu_set_mailbox_single_instance (v);
+  return 0;
+}
+
+static int
+cb_mailbox_scan_threads (void *data, mu_config_value_t *val)
+{
+  size_t n;
+  
+  if (mu_cfg_assert_value_type (val, MU_CFG_STRING))
+    return 1;
+  if (mu_str_to_c (val->v.string, mu_c_size, &n, NULL))
+    {
+      mu_error (_("not a number: %s"), val->v.string);
+      return 1;
+    }
+  mu_set_mailbox_scan_threads (n);
+  return 0;
+}
+
 static struct mu_cfg_param mailbox_cfg[] = {
   { "mail-spool", mu_cfg_callback, NULL, 0, cb_mail_spool,
     N_("Use specified URL as a mailspool directory."),
@@ -298,6 +355,20 @@ static struct mu_cfg_param mailbox_cfg[] = {
        "            but possibly inaccurate\n"
        "  minimal - good balance between speed and accuracy"),
     N_("n: number") },
+  { "index", mu_cfg_callback, NULL, 0, cb_mailbox_index,
+    N_("Maintain on-disk indexes for mailboxes that support them."),
+    N_("arg: bool") },
+  { "single-instance", mu_cfg_callback, NULL, 0, cb_mailbox_single_instance,
+    N_("When delivering a message to several MH or maildir mailboxes, "
+       "write it once and hard-link it into the rest, if possible.  "
+       "Links are made only between deliveries run under the same UID "
+       "(e.g. for virtual users)."),
+    N_("arg: bool") },
+  { "scan-threads", mu_cfg_callback, NULL, 0, cb_mailbox_scan_threads,
+    N_("Maximum number of threads to use when scanning large mailboxes.  "
+       "0 means to use one thread per online CPU, 1 disables parallel "
+       "scanning."),
+    N_("n: number") },
   { NULL }
 };
 
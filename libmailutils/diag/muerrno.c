@@ -323,6 +323,9 @@ mu_errname (int e)
       case MU_ERR_TRANSPORT_SET:
         return "MU_ERR_TRANSPORT_SET";
 
+      case MU_ERR_MBX_CHANGED:
+        return "MU_ERR_MBX_CHANGED";
+
     }
 
   snprintf (buf, sizeof buf, _("Error %d"), e);
@@ -619,6 +622,9 @@ mu_strerror (int e)
     case MU_ERR_TRANSPORT_SET:
       return _("can't set transport descriptor");
 
+    case MU_ERR_MBX_CHANGED:
+      return _("Mailbox modified by another program");
+
     }
 
   return strerror (e);
@@ -96,6 +96,7 @@ mu_filter_get_list (mu_list_t *plist)
       mu_list_append (filter_list, mu_dq_filter);
       mu_list_append (filter_list, mu_fromrd_filter);
       mu_list_append (filter_list, mu_fromrb_filter);
+      mu_list_append (filter_list, mu_deflate_filter);
       
       /* FIXME: add the default encodings?  */
 
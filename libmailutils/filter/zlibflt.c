@@ -0,0 +1,270 @@
+/* GNU Mailutils -- a suite of utilities for electronic mail
+   Copyright (C) 2022 Free Software Foundation, Inc.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 3 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General
+   Public License along with this library.  If not, see
+   <http://www.gnu.org/licenses/>. */
+
+/* Deflate filter: compresses (encode mode) or decompresses (decode
+   mode) data in raw deflate format (RFC 1951).  The encoder takes an
+   optional argument: the compression level (0 - 9).
+
+   Flushing the encoder stream completes the current deflate block and
+   aligns the output on a byte boundary (Z_SYNC_FLUSH), so that the
+   data written so far can be decompressed by the peer.  This makes the
+   filter suitable for compressing network protocol streams (see RFC
+   4978).
+
+   Zlib cannot be asked to transcode the same input again if the output
+   does not fit, so the output is collected in an internal buffer.  If
+   it does not fit in the output buffer supplied by the caller, the
+   filter asks for more output space and keeps the data until it is
+   called with the same input again. */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <mailutils/stream.h>
+#include <mailutils/filter.h>
+#include <mailutils/errno.h>
+#include <mailutils/cctype.h>
+
+#if defined (HAVE_LIBZ) && defined (HAVE_ZLIB_H)
+#include <zlib.h>
+
+#define ZFLT_CHUNK 4096
+
+struct _zlib_filter
+{
+  z_stream strm;
+  int level;            /* Compression level */
+  int mode;             /* MU_FILTER_ENCODE or MU_FILTER_DECODE */
+  int init;             /* True if strm is initialized */
+  int eof;              /* End of compressed data reached */
+  char *buf;            /* Output buffer */
+  size_t size;          /* Size of buf */
+  size_t level_out;     /* Number of bytes pending in buf */
+  size_t consumed;      /* Number of input bytes used to produce them */
+};
+
+static int
+zlib_error (int rc)
+{
+  switch (rc)
+    {
+    case Z_MEM_ERROR:
+      return ENOMEM;
+
+    case Z_DATA_ERROR:
+      return MU_ERR_PARSE;
+
+    default:
+      return MU_ERR_FAILURE;
+    }
+}
+
+/* Run the input through zlib, collecting the output in FLT->buf. */
+static int
+zlib_run (struct _zlib_filter *flt, int flush, const char *input, size_t isize)
+{
+  z_stream *strm = &flt->strm;
+  int rc;
+
+  strm->next_in = (Bytef *) input;
+  strm->avail_in = isize;
+  do
+    {
+      if (flt->size - flt->level_out < ZFLT_CHUNK)
+	{
+	  size_t size = flt->size + ZFLT_CHUNK;
+	  char *p = realloc (flt->buf, size);
+	  if (!p)
+	    return ENOMEM;
+	  flt->buf = p;
+	  flt->size = size;
+	}
+      strm->next_out = (Bytef *) (flt->buf + flt->level_out);
+      strm->avail_out = flt->size - flt->level_out;
+      if (flt->mode == MU_FILTER_ENCODE)
+	rc = deflate (strm, flush);
+      else
+	rc = inflate (strm, flush);
+      flt->level_out = flt->size - strm->avail_out;
+      switch (rc)
+	{
+	case Z_OK:
+	  break;
+
+	case Z_STREAM_END:
+	  flt->eof = 1;
+	  /* fall through */
+	case Z_BUF_ERROR:
+	  /* No progress possible */
+	  flt->consumed = isize - strm->avail_in;
+	  return 0;
+
+	default:
+	  return zlib_error (rc);
+	}
+    }
+  while (strm->avail_in || strm->avail_out == 0);
+  flt->consumed = isize;
+  return 0;
+}
+
+static enum mu_filter_result
+_zlib_xcode (void *xd, enum mu_filter_command cmd, struct mu_filter_io *iobuf)
+{
+  struct _zlib_filter *flt = xd;
+  int rc;
+  int flush;
+
+  switch (cmd)
+    {
+    case mu_filter_init:
+      if (flt->init)
+	{
+	  if (flt->mode == MU_FILTER_ENCODE)
+	    rc = deflateReset (&flt->strm);
+	  else
+	    rc = inflateReset (&flt->strm);
+	}
+      else
+	{
+	  memset (&flt->strm, 0, sizeof flt->strm);
+	  if (flt->mode == MU_FILTER_ENCODE)
+	    rc = deflateInit2 (&flt->strm, flt->level, Z_DEFLATED, -MAX_WBITS,
+			       MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+	  else
+	    rc = inflateInit2 (&flt->strm, -MAX_WBITS);
+	}
+      if (rc != Z_OK)
+	{
+	  iobuf->errcode = zlib_error (rc);
+	  return mu_filter_failure;
+	}
+      flt->init = 1;
+      flt->eof = 0;
+      flt->level_out = flt->consumed = 0;
+      return mu_filter_ok;
+
+    case mu_filter_done:
+      if (flt->init)
+	{
+	  if (flt->mode == MU_FILTER_ENCODE)
+	    deflateEnd (&flt->strm);
+	  else
+	    inflateEnd (&flt->strm);
+	}
+      free (flt->buf);
+      return mu_filter_ok;
+
+    case mu_filter_xcode:
+      flush = Z_NO_FLUSH;
+      break;
+
+    case mu_filter_flush:
+      flush = Z_SYNC_FLUSH;
+      break;
+
+    case mu_filter_lastbuf:
+      flush = flt->mode == MU_FILTER_ENCODE ? Z_FINISH : Z_SYNC_FLUSH;
+      break;
+
+    default:
+      flush = Z_NO_FLUSH;
+    }
+
+  if (flt->level_out == 0 && !flt->eof)
+    {
+      rc = zlib_run (flt, flush, iobuf->input, iobuf->isize);
+      if (rc)
+	{
+	  iobuf->errcode = rc;
+	  return mu_filter_failure;
+	}
+    }
+  else if (flt->level_out == 0)
+    {
+      /* Ignore anything past the end of compressed data */
+      iobuf->osize = 0;
+      iobuf->eof = 1;
+      return mu_filter_ok;
+    }
+
+  if (flt->level_out > iobuf->osize)
+    {
+      iobuf->osize = flt->level_out;
+      return mu_filter_moreoutput;
+    }
+
+  memcpy (iobuf->output, flt->buf, flt->level_out);
+  iobuf->osize = flt->level_out;
+  iobuf->isize = flt->consumed;
+  flt->level_out = flt->consumed = 0;
+  if (flt->eof)
+    iobuf->eof = 1;
+  return mu_filter_ok;
+}
+
+static int
+alloc_state (void **pret, int mode, int argc, const char **argv)
+{
+  struct _zlib_filter *flt;
+  int level = Z_DEFAULT_COMPRESSION;
+
+  if (argc > 2)
+    return EINVAL;
+  if (argc == 2)
+    {
+      if (!(mu_isdigit (argv[1][0]) && argv[1][1] == 0))
+	return EINVAL;
+      level = argv[1][0] - '0';
+    }
+
+  flt = calloc (1, sizeof (*flt));
+  if (!flt)
+    return ENOMEM;
+  flt->level = level;
+  flt->mode = mode;
+  *pret = flt;
+  return 0;
+}
+#else
+static enum mu_filter_result
+_zlib_xcode (void *xd MU_ARG_UNUSED, enum mu_filter_command cmd MU_ARG_UNUSED,
+	     struct mu_filter_io *iobuf)
+{
+  iobuf->errcode = ENOSYS;
+  return mu_filter_failure;
+}
+
+static int
+alloc_state (void **pret MU_ARG_UNUSED, int mode MU_ARG_UNUSED,
+	     int argc MU_ARG_UNUSED, const char **argv MU_ARG_UNUSED)
+{
+  return ENOSYS;
+}
+#endif
+
+static struct _mu_filter_record _deflate_filter = {
+  "deflate",
+  alloc_state,
+  _zlib_xcode,
+  _zlib_xcode
+};
+
+mu_filter_record_t mu_deflate_filter = &_deflate_filter;
@@ -47,6 +47,9 @@ char *mu_ticket_file = "~/.mu-tickets";
 static char *_mu_mailbox_pattern;
 
 static char *_default_folder_dir = "Mail";
+static int _mu_mailbox_index = -1;
+static int _mu_mailbox_single_instance = -1;
+static size_t _mu_mailbox_scan_threads = (size_t) -1;
 static char *_mu_folder_dir;
 
 #define USERSUFFIX "${user}"
@@ -133,6 +136,77 @@ mu_set_folder_directory (const char *p)
   return 0;
 }
 
+void
+mu_set_mailbox_index (int v)
+{
+  _mu_mailbox_index = v;
+}
+
+/* Return true if mailbox drivers should maintain on-disk indexes.
+   Unless set explicitly, the value is taken from the environment
+   variable MU_MAILBOX_INDEX. */
+int
+mu_mailbox_index_enabled (void)
+{
+  if (_mu_mailbox_index == -1)
+    {
+      char *p = getenv ("MU_MAILBOX_INDEX");
+      if (!p || mu_str_to_c (p, mu_c_bool, &_mu_mailbox_index, NULL))
+	_mu_mailbox_index = 0;
+    }
+  return _mu_mailbox_index;
+}
+
+void
+mu_set_mailbox_single_instance (int v)
+{
+  _mu_mailbox_single_instance = v;
+}
+
+/* Return true if a message appended to several local mailboxes should
+   be stored once and hard-linked into each of them, where possible.
+   Unless set explicitly, the value is taken from the environment
+   variable MU_MAILBOX_SINGLE_INSTANCE. */
+int
+mu_mailbox_single_instance_enabled (void)
+{
+  if (_mu_mailbox_single_instance == -1)
+    {
+      char *p = getenv ("MU_MAILBOX_SINGLE_INSTANCE");
+      if (!p
+	  || mu_str_to_c (p, mu_c_bool, &_mu_mailbox_single_instance, NULL))
+	_mu_mailbox_single_instance = 0;
+    }
+  return _mu_mailbox_single_instance;
+}
+
+void
+mu_set_mailbox_scan_threads (size_t n)
+{
+  _mu_mailbox_scan_threads = n;
+}
+
+/* Return the maximum number of threads a mailbox driver may use to
+   scan a large mailbox.  Unless set explicitly, the value is taken from
+   the environment variable MU_MAILBOX_SCAN_THREADS.  0 means to use as
+   many threads as there are online processors. */
+size_t
+mu_mailbox_scan_threads (void)
+{
+  if (_mu_mailbox_scan_threads == (size_t) -1)
+    {
+      char *p = getenv ("MU_MAILBOX_SCAN_THREADS");
+      if (!p || mu_str_to_c (p, mu_c_size, &_mu_mailbox_scan_threads, NULL))
+	_mu_mailbox_scan_threads = 0;
+    }
+  if (_mu_mailbox_scan_threads == 0)
+    {
+      long n = sysconf (_SC_NPROCESSORS_ONLN);
+      return n > 0 ? n : 1;
+    }
+  return _mu_mailbox_scan_threads;
+}
+
 const char *
 mu_mailbox_url (void)
 {
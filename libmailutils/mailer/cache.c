@@ -0,0 +1,239 @@
+/* Mailer connection cache for GNU Mailutils
+   Copyright (C) 2022 Free Software Foundation, Inc.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 3 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General
+   Public License along with this library.  If not, see
+   <http://www.gnu.org/licenses/>. */
+
+/* Programs that send many messages through the same mailer (e.g. lmtpd
+   forwarding mail or running Sieve redirect actions) would otherwise
+   establish a new connection, with its TLS and authentication
+   overhead, for each message.  Mailer implementations that support
+   caching hand their connection over to this cache when the mailer is
+   closed (_mu_mailer_cache_put) and look for one when it is opened
+   (_mu_mailer_cache_get).  Connections are keyed by the mailer URL.
+
+   A connection stays in the cache for at most mu_mailer_cache_idle_timeout
+   seconds, and is not returned to it once mu_mailer_cache_max_messages
+   messages have been sent over it.  Remaining connections are shut down
+   when the program exits.
+
+   Cached connections belong to the process that created them.  A child
+   process never uses nor shuts down connections inherited from its
+   parent. */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <mailutils/errno.h>
+#include <mailutils/list.h>
+#include <mailutils/iterator.h>
+#include <mailutils/url.h>
+#include <mailutils/util.h>
+#include <mailutils/debug.h>
+#include <mailutils/sys/debcat.h>
+#include <mailutils/sys/mailer.h>
+
+size_t mu_mailer_cache_size = 0;
+unsigned mu_mailer_cache_idle_timeout = 60;
+size_t mu_mailer_cache_max_messages = 100;
+
+struct cache_entry
+{
+  void *conn;                   /* Connection object */
+  _mu_mailer_conn_free_t freefn;/* Function to shut it down */
+  size_t count;                 /* Number of messages sent so far */
+  time_t stamp;                 /* Time it was put in the cache */
+  pid_t pid;                    /* Owner process */
+  char key[1];                  /* Mailer URL */
+};
+
+static mu_list_t cache_list;    /* Most recently used entries first */
+static pid_t onexit_pid;        /* PID that registered the onexit hook */
+
+/* Shut down the connection, unless it was inherited from the parent
+   process. */
+static void
+cache_entry_free (void *item)
+{
+  struct cache_entry *ent = item;
+  if (ent->pid == getpid ())
+    ent->freefn (ent->conn);
+  free (ent);
+}
+
+static int
+cache_entry_expired (struct cache_entry *ent, time_t now)
+{
+  return ent->pid != getpid ()
+         || (mu_mailer_cache_idle_timeout
+	     && now - ent->stamp >= mu_mailer_cache_idle_timeout);
+}
+
+/* Remove expired entries and entries belonging to other processes. */
+static void
+cache_expire (void)
+{
+  mu_iterator_t itr;
+  time_t now = time (NULL);
+
+  if (mu_list_get_iterator (cache_list, &itr))
+    return;
+  for (mu_iterator_first (itr); !mu_iterator_is_done (itr);
+       mu_iterator_next (itr))
+    {
+      struct cache_entry *ent;
+
+      mu_iterator_current (itr, (void **) &ent);
+      if (cache_entry_expired (ent, now))
+	{
+	  mu_debug (MU_DEBCAT_MAILER, MU_DEBUG_TRACE1,
+		    ("closing idle connection to %s", ent->key));
+	  mu_iterator_ctl (itr, mu_itrctl_delete, NULL);
+	}
+    }
+  mu_iterator_destroy (&itr);
+}
+
+/* Remove the least recently used entries, leaving at most N. */
+static void
+cache_trim (size_t n)
+{
+  size_t count;
+
+  mu_list_count (cache_list, &count);
+  while (count > n)
+    {
+      mu_list_remove_nth (cache_list, count - 1);
+      count--;
+    }
+}
+
+static void
+cache_onexit (void *data)
+{
+  if (onexit_pid == getpid ())
+    mu_mailer_cache_flush ();
+}
+
+/* Look up a cached connection to URL.  On success, remove it from the
+   cache and return it in *PCONN, and the number of messages sent over
+   it in *PCOUNT.  Return MU_ERR_NOENT if there is no suitable
+   connection. */
+int
+_mu_mailer_cache_get (mu_url_t url, void **pconn, size_t *pcount)
+{
+  mu_iterator_t itr;
+  const char *key;
+  int rc;
+
+  if (!cache_list)
+    return MU_ERR_NOENT;
+  rc = mu_url_sget_name (url, &key);
+  if (rc)
+    return rc;
+
+  cache_expire ();
+
+  rc = mu_list_get_iterator (cache_list, &itr);
+  if (rc)
+    return rc;
+  rc = MU_ERR_NOENT;
+  for (mu_iterator_first (itr); !mu_iterator_is_done (itr);
+       mu_iterator_next (itr))
+    {
+      struct cache_entry *ent;
+
+      mu_iterator_current (itr, (void **) &ent);
+      if (strcmp (ent->key, key) == 0)
+	{
+	  *pconn = ent->conn;
+	  if (pcount)
+	    *pcount = ent->count;
+	  free (ent);
+	  mu_list_set_destroy_item (cache_list, NULL);
+	  mu_iterator_ctl (itr, mu_itrctl_delete, NULL);
+	  mu_list_set_destroy_item (cache_list, cache_entry_free);
+	  mu_debug (MU_DEBCAT_MAILER, MU_DEBUG_TRACE1,
+		    ("reusing connection to %s", key));
+	  rc = 0;
+	  break;
+	}
+    }
+  mu_iterator_destroy (&itr);
+  return rc;
+}
+
+/* Put the connection CONN to URL in the cache.  COUNT is the number of
+   messages sent over it so far.  FREEFN will be used to shut the
+   connection down when it expires.  On success, the cache takes over
+   the connection.  Otherwise, the caller retains it and should close it
+   as usual. */
+int
+_mu_mailer_cache_put (mu_url_t url, void *conn, size_t count,
+		      _mu_mailer_conn_free_t freefn)
+{
+  struct cache_entry *ent;
+  const char *key;
+  int rc;
+
+  if (mu_mailer_cache_size == 0)
+    return MU_ERR_CANCELED;
+  if (mu_mailer_cache_max_messages && count >= mu_mailer_cache_max_messages)
+    return MU_ERR_CANCELED;
+
+  rc = mu_url_sget_name (url, &key);
+  if (rc)
+    return rc;
+
+  if (!cache_list)
+    {
+      rc = mu_list_create (&cache_list);
+      if (rc)
+	return rc;
+      mu_list_set_destroy_item (cache_list, cache_entry_free);
+    }
+  if (onexit_pid != getpid ())
+    {
+      onexit_pid = getpid ();
+      mu_onexit (cache_onexit, NULL);
+    }
+
+  cache_expire ();
+  cache_trim (mu_mailer_cache_size - 1);
+
+  ent = malloc (sizeof (*ent) + strlen (key));
+  if (!ent)
+    return ENOMEM;
+  ent->conn = conn;
+  ent->freefn = freefn;
+  ent->count = count;
+  ent->stamp = time (NULL);
+  ent->pid = getpid ();
+  strcpy (ent->key, key);
+  rc = mu_list_prepend (cache_list, ent);
+  if (rc)
+    free (ent);
+  return rc;
+}
+
+/* Shut down all cached connections. */
+void
+mu_mailer_cache_flush (void)
+{
+  mu_list_destroy (&cache_list);
+}
@@ -21,6 +21,7 @@
 #include <mailutils/list.h>
 #include <mailutils/msgset.h>
 #include <mailutils/mailbox.h>
+#include <mailutils/message.h>
 #include <mailutils/sys/msgset.h>
 
 struct action_closure
@@ -31,31 +32,27 @@ struct action_closure
   int dir;
 };
 
+/* Call the action for message number N.  In UID mode, the action
+   receives the UID of the message. */
 static int
-call_action (struct action_closure *clos, size_t i)
+call_action (struct action_closure *clos, size_t n)
 {
   int rc;
   mu_message_t msg = NULL;
-  size_t n;
+  size_t i = n;
 
+  rc = mu_mailbox_get_message (clos->msgset->mbox, n, &msg);
+  if (rc == MU_ERR_NOENT)
+    return 0;
+  else if (rc)
+    return rc;
   if (_MU_MSGSET_MODE (clos->msgset->flags) == MU_MSGSET_UID)
     {
-      rc = mu_mailbox_translate (clos->msgset->mbox, MU_MAILBOX_UID_TO_MSGNO,
-				 i, &n);
-      if (rc == MU_ERR_NOENT)
-	return 0;
-      else if (rc)
+      rc = mu_message_get_uid (msg, &i);
+      if (rc)
 	return rc;
     }
-  else
-    n = i;
-  
-  rc = mu_mailbox_get_message (clos->msgset->mbox, n, &msg);
-  if (rc == MU_ERR_NOENT)
-    return 0;
-  else if (rc == 0)
-    rc = clos->action (i, msg, clos->data);
-  return rc;
+  return clos->action (i, msg, clos->data);
 }
 
 static int
@@ -63,14 +60,32 @@ procrange (void *item, void *data)
 {
   struct mu_msgrange *mp = item;
   struct action_closure *clos = data;
+  struct mu_msgrange r = *mp;
   size_t i;
   int rc = 0;
+
+  if (_MU_MSGSET_MODE (clos->msgset->flags) == MU_MSGSET_UID)
+    {
+      /* UIDs may be sparse: visit only the messages that exist within
+	 the range, instead of looking up each UID in it. */
+      rc = _mu_msgset_translate_range (clos->msgset, MU_MSGSET_NUM, &r);
+      if (rc == MU_ERR_NOENT)
+	return 0;
+      else if (rc)
+	return rc;
+      if (r.msg_end == MU_MSGNO_LAST)
+	{
+	  rc = mu_mailbox_messages_count (clos->msgset->mbox, &r.msg_end);
+	  if (rc)
+	    return rc;
+	}
+    }
   
   if (clos->dir)
-    for (i = mp->msg_end; rc == 0 && i >= mp->msg_beg; i--)
+    for (i = r.msg_end; rc == 0 && i >= r.msg_beg; i--)
       rc = call_action (clos, i);
   else
-    for (i = mp->msg_beg; i <= mp->msg_end; i++)
+    for (i = r.msg_beg; rc == 0 && i <= r.msg_end; i++)
       rc = call_action (clos, i);
   return rc;
 }
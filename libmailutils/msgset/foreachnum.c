@@ -75,7 +75,33 @@ procrange (void *item, void *data)
   size_t i;
   int rc = 0;
   
-  if (clos->flags & MU_MSGSET_FOREACH_BACKWARD)
+  if (clos->msgset->mbox
+      && _MU_MSGSET_MODE (clos->msgset->flags) == MU_MSGSET_UID
+      && _MU_MSGSET_MODE (clos->flags) == MU_MSGSET_NUM)
+    {
+      /* UIDs may be sparse: translate the range as a whole, instead
+	 of looking up each UID in it. */
+      struct mu_msgrange r = *mp;
+      
+      rc = _mu_msgset_translate_range (clos->msgset, MU_MSGSET_NUM, &r);
+      if (rc == MU_ERR_NOENT)
+	return 0;
+      else if (rc)
+	return rc;
+      if (r.msg_end == MU_MSGNO_LAST)
+	{
+	  rc = mu_mailbox_messages_count (clos->msgset->mbox, &r.msg_end);
+	  if (rc)
+	    return rc;
+	}
+      if (clos->flags & MU_MSGSET_FOREACH_BACKWARD)
+	for (i = r.msg_end; rc == 0 && i >= r.msg_beg; i--)
+	  rc = clos->action (i, clos->data);
+      else
+	for (i = r.msg_beg; rc == 0 && i <= r.msg_end; i++)
+	  rc = clos->action (i, clos->data);
+    }
+  else if (clos->flags & MU_MSGSET_FOREACH_BACKWARD)
     for (i = mp->msg_end; rc == 0 && i >= mp->msg_beg; i--)
       rc = call_action (clos, i);
   else
@@ -23,13 +23,102 @@
 #include <mailutils/mailbox.h>
 #include <mailutils/sys/msgset.h>
 
+/* Find the number of the first message in MBOX whose UID is not less
+   than UID (if LAST is 0), or that of the last message whose UID is not
+   greater than UID (if LAST is 1).  Messages are ordered by UID, so a
+   binary search over message numbers is used.  Return MU_ERR_NOENT if
+   there is no such message. */
+static int
+uid_bound (mu_mailbox_t mbox, size_t uid, int last, size_t *ret)
+{
+  size_t count, lo, hi;
+  int rc;
+
+  rc = mu_mailbox_translate (mbox, MU_MAILBOX_UID_TO_MSGNO, uid, ret);
+  if (rc != MU_ERR_NOENT)
+    return rc;
+  
+  rc = mu_mailbox_messages_count (mbox, &count);
+  if (rc)
+    return rc;
+  /* Find the first message whose UID is greater than (LAST), or not
+     less than (!LAST) the requested one. */
+  lo = 1;
+  hi = count + 1;
+  while (lo < hi)
+    {
+      size_t mid = lo + (hi - lo) / 2;
+      size_t n;
+      
+      rc = mu_mailbox_translate (mbox, MU_MAILBOX_MSGNO_TO_UID, mid, &n);
+      if (rc)
+	return rc;
+      if (n < uid || (last && n == uid))
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  
+  if (last)
+    {
+      if (lo == 1)
+	return MU_ERR_NOENT;
+      *ret = lo - 1;
+    }
+  else
+    {
+      if (lo > count)
+	return MU_ERR_NOENT;
+      *ret = lo;
+    }
+  return 0;
+}
+
+/* Translate the range of UIDs [*PBEG, *PEND] to the range of numbers of
+   the messages it contains.  UIDs need not be contiguous, so the range
+   bounds are looked up independently.  Return MU_ERR_NOENT if the range
+   contains no messages. */
+static int
+translate_uid_range (mu_mailbox_t mbox, size_t *pbeg, size_t *pend)
+{
+  size_t beg, end;
+  int rc;
+
+  if (*pend == *pbeg)
+    {
+      rc = mu_mailbox_translate (mbox, MU_MAILBOX_UID_TO_MSGNO, *pbeg, &beg);
+      if (rc)
+	return rc;
+      end = beg;
+    }
+  else
+    {
+      rc = uid_bound (mbox, *pbeg, 0, &beg);
+      if (rc)
+	return rc;
+      if (*pend == MU_MSGNO_LAST)
+	end = MU_MSGNO_LAST;
+      else
+	{
+	  rc = uid_bound (mbox, *pend, 1, &end);
+	  if (rc)
+	    return rc;
+	  if (end < beg)
+	    return MU_ERR_NOENT;
+	}
+    }
+  *pbeg = beg;
+  *pend = end;
+  return 0;
+}
+
 int
 _mu_msgset_translate_pair (mu_msgset_t mset, int mode,
 			   size_t *pbeg, size_t *pend)
 {
   if (mset->mbox)
     {
-      int cmd, rc;
+      int rc;
       size_t n = 1;
       size_t beg = *pbeg;
       size_t end = *pend;
@@ -37,52 +126,26 @@ _mu_msgset_translate_pair (mu_msgset_t mset, int mode,
       switch (mode)
 	{
 	case MU_MSGSET_NUM:
-	  cmd = MU_MAILBOX_UID_TO_MSGNO;
-	  break;
+	  return translate_uid_range (mset->mbox, pbeg, pend);
 
 	case MU_MSGSET_UID:
-	  cmd = MU_MAILBOX_MSGNO_TO_UID;
 	  break;
 
 	default:
 	  return EINVAL;
 	}
 
-      rc = mu_mailbox_translate (mset->mbox, cmd, beg, &n);
+      rc = mu_mailbox_translate (mset->mbox, MU_MAILBOX_MSGNO_TO_UID, beg, &n);
       if (rc)
-	{
-	  if (rc == MU_ERR_NOENT && cmd == MU_MAILBOX_UID_TO_MSGNO)
-	    {
-	      size_t x;
-	      
-	      if (end == MU_MSGNO_LAST)
-		{
-		  rc = mu_mailbox_uidnext (mset->mbox, &x);
-		  if (rc)
-		    return rc;
-		}
-	      else
-		x = end;
-	      for (; rc == MU_ERR_NOENT && beg <= x; beg++)
-		rc = mu_mailbox_translate (mset->mbox, cmd, beg, &n);
-	    }
-	  if (rc)
-	    return rc;
-	}
-
+	return rc;
       *pbeg = n;
       
       if (beg == end)
 	*pend = n;
       else if (end != MU_MSGNO_LAST)
 	{
-	  rc = mu_mailbox_translate (mset->mbox, cmd, end, &n);
-	  if (rc == MU_ERR_NOENT && cmd == MU_MAILBOX_UID_TO_MSGNO)
-	    {
-	      for (; rc == MU_ERR_NOENT && beg < end; end--)
-		rc = mu_mailbox_translate (mset->mbox, cmd, end, &n);
-	      
-	    }
+	  rc = mu_mailbox_translate (mset->mbox, MU_MAILBOX_MSGNO_TO_UID,
+				     end, &n);
 	  if (rc)
 	    return rc;
 	  *pend = n;
@@ -33,6 +33,10 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <sys/stat.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#include <fcntl.h>
 #include <limits.h>
 #include <mailutils/cctype.h>
 #include <mailutils/server.h>
@@ -89,6 +93,11 @@ struct _mu_m_server
   size_t max_children;           /* Maximum number of sub-processes to run. */
   size_t num_children;           /* Current number of running sub-processes. */
   pid_t *child_pid;
+  int pool;                      /* Run a pool of pre-forked workers. */
+  size_t pool_min_spare;         /* Min. number of idle workers. */
+  size_t pool_max_spare;         /* Max. number of idle workers. */
+  size_t pool_max_sessions;      /* Max. number of sessions per worker. */
+  struct pool_slot *pool_tab;    /* Worker scoreboard (shared memory). */
   char *pidfile;                 /* Name of a PID-file. */
   struct mu_sockaddr_hints hints; /* Default address hints. */
   time_t timeout;                /* Default idle timeout. */
@@ -102,6 +111,37 @@ struct _mu_m_server
 };
 
 
+/* Worker pool.
+
+   In the pool mode, the master process does not accept connections
+   itself.  Instead, it keeps a pool of pre-forked worker processes,
+   which accept connections on the shared listening sockets and serve
+   them in-process.  The state of each worker is kept in a scoreboard
+   located in shared memory and indexed by the same slot number as
+   the child_pid array.  Once a second the master checks the number of
+   idle workers and starts new ones, or asks the superfluous ones to
+   exit. */
+
+enum pool_state
+  {
+    POOL_FREE,           /* Slot is not used */
+    POOL_IDLE,           /* Worker waits for a connection */
+    POOL_BUSY            /* Worker serves a session */
+  };
+
+struct pool_slot
+{
+  volatile sig_atomic_t state;  /* Worker state (enum pool_state) */
+  volatile sig_atomic_t retire; /* Set by the master to stop an idle worker */
+};
+
+#define POOL_DEFAULT_MIN_SPARE    2
+#define POOL_DEFAULT_MAX_SPARE    8
+#define POOL_DEFAULT_MAX_SESSIONS 100
+
+static int pool_worker_mode;         /* Running as a pool worker. */
+static size_t pool_worker_sessions;  /* Number of sessions served by it. */
+
 static int need_cleanup = 0;
 static int stop = 0; /* FIXME: Must be per-m-server */
 static mu_list_t m_server_list;
@@ -152,6 +192,8 @@ unregister_child (mu_m_server_t msrv, pid_t pid)
     if (msrv->child_pid[i] == pid)
       {
 	msrv->child_pid[i] = UNUSED_PID;
+	if (msrv->pool_tab)
+	  msrv->pool_tab[i].state = POOL_FREE;
 	return 0;
       }
   return 1;
@@ -273,6 +315,9 @@ mu_m_server_create (mu_m_server_t *psrv, const char *ident)
 	}
     }
   srv->deftype = MU_IP_TCP;
+  srv->pool_min_spare = POOL_DEFAULT_MIN_SPARE;
+  srv->pool_max_spare = POOL_DEFAULT_MAX_SPARE;
+  srv->pool_max_sessions = POOL_DEFAULT_MAX_SESSIONS;
   MU_ASSERT (mu_server_create (&srv->server));
   mu_server_set_idle (srv->server, mu_m_server_idle);
   sigemptyset (&srv->sigmask);
@@ -574,6 +619,10 @@ mu_m_server_destroy (mu_m_server_t *pmsrv)
   mu_list_destroy (&msrv->srvlist);  
   mu_server_destroy (&msrv->server);
   free (msrv->child_pid);
+#ifdef HAVE_MMAP
+  if (msrv->pool_tab)
+    munmap (msrv->pool_tab, msrv->max_children * sizeof (msrv->pool_tab[0]));
+#endif
   /* FIXME: Send processes the TERM signal here?*/
   free (msrv->ident);
   free (msrv);
@@ -624,6 +673,236 @@ open_connection (mu_ip_server_t tcpsrv, mu_m_server_t msrv)
   return rc;
 }  
 
+static int
+pool_set_nonblock (void *item, void *data)
+{
+  mu_ip_server_t tcpsrv = item;
+  int fd = mu_ip_server_get_fd (tcpsrv);
+  int flags = fcntl (fd, F_GETFL);
+
+  /* Several workers may wake up on the same connection: the ones that
+     lose the race must not block in accept. */
+  if (flags == -1 || fcntl (fd, F_SETFL, flags | O_NONBLOCK) == -1)
+    return errno;
+  return 0;
+}
+
+/* Prepare the worker pool.  Return 0 on success.  On error, the
+   server falls back to forking a process per connection. */
+static int
+pool_init (mu_m_server_t msrv)
+{
+  size_t size;
+  int rc;
+  
+  if (msrv->deftype != MU_IP_TCP)
+    {
+      mu_diag_output (MU_DIAG_WARNING,
+		      _("%s: worker pool is supported only for TCP servers"),
+		      msrv->ident ? msrv->ident : "server");
+      return 1;
+    }
+  if (msrv->max_children == 0)
+    {
+      mu_diag_output (MU_DIAG_WARNING,
+		      _("%s: worker pool requires max-children"),
+		      msrv->ident ? msrv->ident : "server");
+      return 1;
+    }
+#if defined (HAVE_MMAP) && (defined (MAP_ANONYMOUS) || defined (MAP_ANON))
+# ifndef MAP_ANONYMOUS
+#  define MAP_ANONYMOUS MAP_ANON
+# endif
+  size = msrv->max_children * sizeof (msrv->pool_tab[0]);
+  msrv->pool_tab = mmap (NULL, size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (msrv->pool_tab == MAP_FAILED)
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "mmap", NULL, errno);
+      msrv->pool_tab = NULL;
+      return 1;
+    }
+  memset (msrv->pool_tab, 0, size);
+#else
+  mu_diag_output (MU_DIAG_WARNING,
+		  _("%s: worker pool is not supported on this system"),
+		  msrv->ident ? msrv->ident : "server");
+  return 1;
+#endif
+  rc = mu_list_foreach (msrv->srvlist, pool_set_nonblock, NULL);
+  if (rc)
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "fcntl", NULL, rc);
+      return 1;
+    }
+
+  if (msrv->pool_min_spare == 0)
+    msrv->pool_min_spare = 1;
+  if (msrv->pool_max_spare < msrv->pool_min_spare)
+    msrv->pool_max_spare = msrv->pool_min_spare;
+  return 0;
+}
+
+struct pool_wait
+{
+  fd_set fdset;
+  int maxfd;
+};
+
+static int
+pool_add_fd (void *item, void *data)
+{
+  struct pool_wait *pw = data;
+  int fd = mu_ip_server_get_fd (item);
+
+  if (fd >= 0)
+    {
+      FD_SET (fd, &pw->fdset);
+      if (fd > pw->maxfd)
+	pw->maxfd = fd;
+    }
+  return 0;
+}
+
+struct pool_accept
+{
+  struct pool_wait *wait;
+  struct pool_slot *slot;
+};
+
+static int
+pool_accept (void *item, void *data)
+{
+  struct pool_accept *pa = data;
+  int fd = mu_ip_server_get_fd (item);
+
+  if (pa->slot->retire)
+    return 1;
+  if (fd >= 0 && FD_ISSET (fd, &pa->wait->fdset))
+    {
+      pa->slot->state = POOL_BUSY;
+      mu_ip_server_accept (item, NULL);
+      pa->slot->state = POOL_IDLE;
+    }
+  return 0;
+}
+
+/* Main loop of a pool worker occupying the given SLOT.  Wait for
+   incoming connections and serve them, until asked to retire by the
+   master, or until the session limit is reached. */
+static void
+pool_worker (mu_m_server_t msrv, size_t slot, pid_t master)
+{
+  struct pool_slot *sp = &msrv->pool_tab[slot];
+
+  pool_worker_mode = 1;
+  mu_m_server_restore_signals (msrv);
+
+  while (!sp->retire
+	 && (msrv->pool_max_sessions == 0
+	     || pool_worker_sessions < msrv->pool_max_sessions))
+    {
+      struct pool_wait pw;
+      struct pool_accept pa;
+      struct timeval tv;
+      int rc;
+      
+      if (getppid () != master)
+	break;
+      
+      FD_ZERO (&pw.fdset);
+      pw.maxfd = -1;
+      mu_list_foreach (msrv->srvlist, pool_add_fd, &pw);
+      if (pw.maxfd == -1)
+	break;
+      /* Wake up periodically to check the retire flag. */
+      tv.tv_sec = 1;
+      tv.tv_usec = 0;
+      rc = select (pw.maxfd + 1, &pw.fdset, NULL, NULL, &tv);
+      if (rc == -1)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  mu_diag_funcall (MU_DIAG_ERROR, "select", NULL, errno);
+	  break;
+	}
+      if (rc == 0)
+	continue;
+      pa.wait = &pw;
+      pa.slot = sp;
+      mu_list_foreach (msrv->srvlist, pool_accept, &pa);
+    }
+  closelog ();
+  exit (0);
+}
+
+static void
+pool_spawn (mu_m_server_t msrv)
+{
+  size_t i;
+  pid_t pid;
+
+  for (i = 0; i < msrv->max_children; i++)
+    if (msrv->child_pid[i] == UNUSED_PID)
+      break;
+  if (i == msrv->max_children)
+    return;
+
+  /* Count the new worker as idle right away, to avoid spawning more
+     workers than needed. */
+  msrv->pool_tab[i].state = POOL_IDLE;
+  msrv->pool_tab[i].retire = 0;
+  pid = fork ();
+  if (pid == -1)
+    {
+      mu_diag_output (MU_DIAG_ERROR, "fork: %s", strerror (errno));
+      msrv->pool_tab[i].state = POOL_FREE;
+    }
+  else if (pid == 0)
+    pool_worker (msrv, i, getppid ());
+  else
+    register_child (msrv, pid);
+}
+
+/* Keep the number of idle workers between the configured limits. */
+static void
+pool_adjust (mu_m_server_t msrv)
+{
+  size_t i, idle = 0;
+  ssize_t last_idle = -1;
+
+  for (i = 0; i < msrv->max_children; i++)
+    if (msrv->child_pid[i] != UNUSED_PID
+	&& msrv->pool_tab[i].state == POOL_IDLE
+	&& !msrv->pool_tab[i].retire)
+      {
+	idle++;
+	last_idle = i;
+      }
+
+  if (idle < msrv->pool_min_spare)
+    {
+      for (i = idle; i < msrv->pool_min_spare
+	     && msrv->num_children < msrv->max_children; i++)
+	pool_spawn (msrv);
+    }
+  else if (idle > msrv->pool_max_spare)
+    /* Retire one worker at a time, to avoid oscillations. */
+    msrv->pool_tab[last_idle].retire = 1;
+}
+
+static int
+pool_run (mu_m_server_t msrv)
+{
+  while (mu_m_server_idle (NULL) == 0)
+    {
+      pool_adjust (msrv);
+      /* Interrupted by SIGCHLD when a worker exits. */
+      sleep (1);
+    }
+  return 0;
+}
+
 int
 mu_m_server_run (mu_m_server_t msrv)
 {
@@ -661,7 +940,10 @@ mu_m_server_run (mu_m_server_t msrv)
   
   if (msrv->ident)
     mu_diag_output (MU_DIAG_INFO, _("%s started"), msrv->ident);
-  rc = mu_server_run (msrv->server);
+  if (msrv->pool && pool_init (msrv) == 0)
+    rc = pool_run (msrv);
+  else
+    rc = mu_server_run (msrv->server);
   terminate_children (msrv);
   if (msrv->ident)
     mu_diag_output (MU_DIAG_INFO, _("%s terminated"), msrv->ident);
@@ -723,7 +1005,20 @@ m_srv_conn (int fd, struct sockaddr *sa, int salen,
   if (mu_m_server_check_acl (pconf->msrv, sa, salen))
     return 0;
 
-  if (!pconf->single_process)
+  if (pool_worker_mode)
+    {
+      /* Listening sockets are non-blocking in the pool mode, and on
+	 some systems accepted sockets inherit that flag. */
+      int flags = fcntl (fd, F_GETFL);
+      if (flags != -1 && (flags & O_NONBLOCK))
+	fcntl (fd, F_SETFL, flags & ~O_NONBLOCK);
+      pool_worker_sessions++;
+      if (!pconf->msrv->prefork
+	  || pconf->msrv->prefork (fd, sa, salen, pconf,
+				   pconf->msrv->data) == 0)
+	pconf->msrv->conn (fd, sa, salen, pconf, pconf->msrv->data);
+    }
+  else if (!pconf->single_process)
     {
       pid_t pid;
 
@@ -915,6 +1210,19 @@ static struct mu_cfg_param dot_server_cfg_param[] = {
   { "max-children", mu_c_size,
     NULL, mu_offsetof (struct _mu_m_server,max_children), NULL,
     N_("Maximum number of children processes to run simultaneously.") },
+  { "worker-pool", mu_c_bool,
+    NULL, mu_offsetof (struct _mu_m_server,pool), NULL,
+    N_("Serve connections by a pool of pre-forked worker processes.") },
+  { "min-spare-workers", mu_c_size,
+    NULL, mu_offsetof (struct _mu_m_server,pool_min_spare), NULL,
+    N_("Minimum number of idle workers in the pool.") },
+  { "max-spare-workers", mu_c_size,
+    NULL, mu_offsetof (struct _mu_m_server,pool_max_spare), NULL,
+    N_("Maximum number of idle workers in the pool.") },
+  { "max-worker-sessions", mu_c_size,
+    NULL, mu_offsetof (struct _mu_m_server,pool_max_sessions), NULL,
+    N_("Number of sessions a worker serves before exiting (0 means "
+       "unlimited).") },
   { "mode", mu_cfg_callback,
     NULL, mu_offsetof (struct _mu_m_server,mode), _cb_daemon_mode,
     N_("Set operation mode."),
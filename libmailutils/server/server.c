@@ -21,14 +21,33 @@
 #include <sys/select.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <mailutils/server.h>
 #include <mailutils/errno.h>
 #include <mailutils/acl.h>
+#include <mailutils/datetime.h>
 
 
+/* Event sources.
+
+   A server multiplexes three kinds of event sources: connections
+   (file descriptors ready for reading), timers and signals.  Signals
+   are delivered through a self-pipe, which is watched along with the
+   connections.
+
+   Readiness of the descriptors is checked using epoll, if it is
+   available.  Otherwise, or if the MU_SERVER_BACKEND environment
+   variable is set to "select", select is used.  The latter cannot
+   handle descriptors above FD_SETSIZE. */
+
 struct _mu_connection
 {
   struct _mu_connection *next, *prev;
@@ -38,6 +57,26 @@ struct _mu_connection
   void *data;
 };
 
+struct _mu_timer
+{
+  struct _mu_timer *next;
+  struct timeval interval;       /* Timer interval */
+  struct timeval due;            /* Time of the next expiration */
+  mu_server_timer_fp f_timer;
+  mu_conn_free_fp f_free;
+  void *data;
+};
+
+struct _mu_signal
+{
+  struct _mu_signal *next;
+  int signo;
+  mu_server_signal_fp f_signal;
+  mu_conn_free_fp f_free;
+  void *data;
+  struct sigaction oldact;       /* Disposition to restore on removal */
+};
+
 #define MU_SERVER_TIMEOUT 0x1
 
 struct _mu_server
@@ -47,11 +86,37 @@ struct _mu_server
   int flags;
   struct timeval timeout;
   struct _mu_connection *head, *tail;
+  struct _mu_timer *timers;
+  struct _mu_signal *signals;
+  int sigpipe[2];                /* Self-pipe for signal sources */
+  int epfd;                      /* epoll descriptor, or -1 */
   mu_server_idle_fp f_idle;
   mu_server_free_fp f_free;
   void *server_data;
 };
 
+#ifndef NSIG
+# define NSIG 64
+#endif
+
+/* Write ends of the self-pipes (plus one) for each signal. */
+static int signal_pipe[NSIG];
+
+static RETSIGTYPE
+signal_source_handler (int signo)
+{
+  if (signo > 0 && signo < NSIG && signal_pipe[signo])
+    {
+      int ec = errno;
+      unsigned char c = signo;
+      /* The pipe is non-blocking: if it is full, the signal is
+	 already pending anyway. */
+      if (write (signal_pipe[signo] - 1, &c, 1) == -1)
+	;
+      errno = ec;
+    }
+}
+
 void
 recompute_nfd (mu_server_t srv)
 {
@@ -60,6 +125,8 @@ recompute_nfd (mu_server_t srv)
   for (p = srv->head; p; p = p->next)
     if (p->fd > nfd)
       nfd = p->fd;
+  if (srv->sigpipe[0] > nfd)
+    nfd = srv->sigpipe[0];
   srv->nfd = nfd + 1;
 }
 
@@ -75,9 +142,14 @@ void
 remove_connection (mu_server_t srv, struct _mu_connection *conn)
 {
   struct _mu_connection *p;
-  
+
+#ifdef HAVE_SYS_EPOLL_H
+  if (srv->epfd != -1)
+    epoll_ctl (srv->epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+#endif
   close (conn->fd);
-  FD_CLR (conn->fd, &srv->fdset);
+  if (conn->fd < FD_SETSIZE)
+    FD_CLR (conn->fd, &srv->fdset);
 
   p = conn->prev;
   if (p)
@@ -97,6 +169,27 @@ remove_connection (mu_server_t srv, struct _mu_connection *conn)
   destroy_connection (srv, conn);
 }
 
+/* Call the handler of the connection CONN.  Return 1 if the server
+   must shut down. */
+static int
+connection_dispatch (mu_server_t srv, struct _mu_connection *conn)
+{
+  switch (conn->f_loop (conn->fd, conn->data, srv->server_data))
+    {
+    case 0:
+      break;
+      
+    case MU_SERVER_CLOSE_CONN:
+    default:
+      remove_connection (srv, conn);
+      break;
+      
+    case MU_SERVER_SHUTDOWN:
+      return 1;
+    }
+  return 0;
+}
+
 int
 connection_loop (mu_server_t srv, fd_set *fdset)
 {
@@ -104,66 +197,193 @@ connection_loop (mu_server_t srv, fd_set *fdset)
   for (conn = srv->head; conn;)
     {
       struct _mu_connection *next = conn->next;
-      if (FD_ISSET (conn->fd, fdset))
+      if (FD_ISSET (conn->fd, fdset) && connection_dispatch (srv, conn))
+	return 1;
+      conn = next;
+    }
+  return 0;
+}
+
+static void
+signal_remove (mu_server_t srv, struct _mu_signal **psig)
+{
+  struct _mu_signal *sig = *psig;
+  struct _mu_signal *p;
+
+  *psig = sig->next;
+  for (p = srv->signals; p; p = p->next)
+    if (p->signo == sig->signo)
+      break;
+  if (!p)
+    {
+      /* That was the last source for this signal */
+      sigaction (sig->signo, &sig->oldact, NULL);
+      signal_pipe[sig->signo] = 0;
+    }
+  if (sig->f_free)
+    sig->f_free (sig->data, srv->server_data);
+  free (sig);
+}
+
+/* Read signal numbers from the self-pipe and call the corresponding
+   handlers.  Return 1 if the server must shut down. */
+static int
+signal_dispatch (mu_server_t srv)
+{
+  unsigned char buf[64];
+  ssize_t n, i;
+
+  while ((n = read (srv->sigpipe[0], buf, sizeof buf)) > 0)
+    {
+      for (i = 0; i < n; i++)
 	{
-	  int rc;
+	  struct _mu_signal **psig;
 
-	  rc = conn->f_loop (conn->fd, conn->data, srv->server_data);
-	  switch (rc)
+	  for (psig = &srv->signals; *psig; )
+	    {
+	      struct _mu_signal *sig = *psig;
+	      if (sig->signo == buf[i])
+		{
+		  switch (sig->f_signal (sig->signo, sig->data,
+					 srv->server_data))
+		    {
+		    case 0:
+		      break;
+
+		    case MU_SERVER_SHUTDOWN:
+		      return 1;
+
+		    case MU_SERVER_CLOSE_CONN:
+		    default:
+		      signal_remove (srv, psig);
+		      continue;
+		    }
+		}
+	      psig = &sig->next;
+	    }
+	}
+    }
+  return 0;
+}
+
+static void
+timer_destroy (mu_server_t srv, struct _mu_timer *tp)
+{
+  if (tp->f_free)
+    tp->f_free (tp->data, srv->server_data);
+  free (tp);
+}
+
+/* Call the handlers of the expired timers.  Return 1 if the server
+   must shut down. */
+static int
+timer_dispatch (mu_server_t srv)
+{
+  struct _mu_timer **ptp, *tp;
+  struct timeval now;
+
+  gettimeofday (&now, NULL);
+  for (ptp = &srv->timers; (tp = *ptp); )
+    {
+      if (mu_timeval_cmp (&tp->due, &now) <= 0)
+	{
+	  switch (tp->f_timer (tp->data, srv->server_data))
 	    {
 	    case 0:
 	      break;
-	      
-	    case MU_SERVER_CLOSE_CONN:
-	    default:
-	      remove_connection (srv, conn);
-	      break;
-	      
+
 	    case MU_SERVER_SHUTDOWN:
 	      return 1;
+
+	    case MU_SERVER_CLOSE_CONN:
+	    default:
+	      *ptp = tp->next;
+	      timer_destroy (srv, tp);
+	      continue;
 	    }
+	  tp->due = mu_timeval_add (&now, &tp->interval);
 	}
-      conn = next;
+      ptp = &tp->next;
     }
   return 0;
 }
 
-void
+/* Compute the time to wait for events.  Return NULL if there's no
+   time limit. */
+static struct timeval *
+wait_timeout (mu_server_t srv, struct timeval *tv)
+{
+  struct timeval *to = NULL;
+  struct _mu_timer *tp;
+  struct timeval now;
+
+  if (srv->flags & MU_SERVER_TIMEOUT)
+    {
+      *tv = srv->timeout;
+      to = tv;
+    }
+  if (srv->timers)
+    gettimeofday (&now, NULL);
+  for (tp = srv->timers; tp; tp = tp->next)
+    {
+      struct timeval d;
+      
+      if (mu_timeval_cmp (&tp->due, &now) <= 0)
+	d.tv_sec = d.tv_usec = 0;
+      else
+	d = mu_timeval_sub (&tp->due, &now);
+      if (!to || mu_timeval_cmp (&d, tv) < 0)
+	{
+	  *tv = d;
+	  to = tv;
+	}
+    }
+  return to;
+}
+
+int
 make_fdset (mu_server_t srv)
 {
   struct _mu_connection *p;
   int nfd = 0;
   
   FD_ZERO (&srv->fdset);
+  if (srv->sigpipe[0] >= FD_SETSIZE)
+    return EMFILE;
   for (p = srv->head; p; p = p->next)
     {
+      if (p->fd >= FD_SETSIZE)
+	return EMFILE;
       FD_SET (p->fd, &srv->fdset);
       if (p->fd > nfd)
 	nfd = p->fd;
     }
+  if (srv->sigpipe[0] != -1)
+    {
+      FD_SET (srv->sigpipe[0], &srv->fdset);
+      if (srv->sigpipe[0] > nfd)
+	nfd = srv->sigpipe[0];
+    }
   srv->nfd = nfd + 1;
+  return 0;
 }
 
-int
-mu_server_run (mu_server_t srv)
+static int
+select_run (mu_server_t srv)
 {
-  int status = 0;
-  
-  if (!srv)
-    return EINVAL;
-  if (!srv->head)
-    return MU_ERR_NOENT;
-  
-  make_fdset (srv);  
+  int status = make_fdset (srv);
+
+  if (status)
+    return status;
   
   while (1)
     {
       int rc;
       fd_set rdset;
-      struct timeval *to;
+      struct timeval tv, *to;
       
       rdset = srv->fdset;
-      to = (srv->flags & MU_SERVER_TIMEOUT) ? &srv->timeout : NULL;
+      to = wait_timeout (srv, &tv);
       rc = select (srv->nfd, &rdset, NULL, NULL, to);
       if (rc == -1 && errno == EINTR)
 	{
@@ -174,13 +394,142 @@ mu_server_run (mu_server_t srv)
       if (rc < 0)
 	return errno;
 
+      if (srv->sigpipe[0] != -1 && FD_ISSET (srv->sigpipe[0], &rdset)
+	  && signal_dispatch (srv))
+	return MU_ERR_FAILURE;
+      if (srv->timers && timer_dispatch (srv))
+	return MU_ERR_FAILURE;
       if (connection_loop (srv, &rdset))
+	return MU_ERR_FAILURE;
+    }
+  return 0;
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+static int
+epoll_add (mu_server_t srv, int fd, void *ptr)
+{
+  struct epoll_event ev;
+
+  memset (&ev, 0, sizeof ev);
+  ev.events = EPOLLIN;
+  ev.data.ptr = ptr;
+  if (epoll_ctl (srv->epfd, EPOLL_CTL_ADD, fd, &ev))
+    return errno;
+  return 0;
+}
+
+/* Create the epoll descriptor and register all descriptors with it.
+   Return 0 on success. */
+static int
+epoll_open (mu_server_t srv)
+{
+  struct _mu_connection *p;
+  int rc;
+  
+  srv->epfd = epoll_create (1);
+  if (srv->epfd == -1)
+    return errno;
+  fcntl (srv->epfd, F_SETFD, FD_CLOEXEC);
+  /* The self-pipe is identified by a NULL pointer */
+  if (srv->sigpipe[0] != -1 && (rc = epoll_add (srv, srv->sigpipe[0], NULL)))
+    return rc;
+  for (p = srv->head; p; p = p->next)
+    if ((rc = epoll_add (srv, p->fd, p)) != 0)
+      return rc;
+  return 0;
+}
+
+static void
+epoll_close (mu_server_t srv)
+{
+  if (srv->epfd != -1)
+    {
+      close (srv->epfd);
+      srv->epfd = -1;
+    }
+}
+
+#define EPOLL_MAX_EVENTS 64
+
+static int
+epoll_run (mu_server_t srv)
+{
+  struct epoll_event events[EPOLL_MAX_EVENTS];
+  
+  while (1)
+    {
+      int i, n, ms;
+      struct timeval tv, *to;
+
+      to = wait_timeout (srv, &tv);
+      if (to)
+	/* Round up, so as not to wake up before a timer is due. */
+	ms = to->tv_sec * 1000 + (to->tv_usec + 999) / 1000;
+      else
+	ms = -1;
+      n = epoll_wait (srv->epfd, events, EPOLL_MAX_EVENTS, ms);
+      if (n == -1 && errno == EINTR)
+	{
+	  if (srv->f_idle && srv->f_idle (srv->server_data))
+	    break;
+	  continue;
+	}
+      if (n < 0)
+	return errno;
+
+      for (i = 0; i < n; i++)
+	{
+	  struct _mu_connection *conn = events[i].data.ptr;
+
+	  if (conn == NULL)
+	    {
+	      if (signal_dispatch (srv))
+		return MU_ERR_FAILURE;
+	    }
+	  /* A handler cannot remove connections other than its own,
+	     so the pointers remain valid throughout the loop. */
+	  else if (connection_dispatch (srv, conn))
+	    return MU_ERR_FAILURE;
+	}
+      if (srv->timers && timer_dispatch (srv))
+	return MU_ERR_FAILURE;
+    }
+  return 0;
+}
+#endif
+
+static int
+use_select (void)
+{
+  char *p = getenv ("MU_SERVER_BACKEND");
+  return p && strcmp (p, "select") == 0;
+}
+
+int
+mu_server_run (mu_server_t srv)
+{
+  int status;
+  
+  if (!srv)
+    return EINVAL;
+  if (!srv->head && !srv->timers && !srv->signals)
+    return MU_ERR_NOENT;
+
+#ifdef HAVE_SYS_EPOLL_H
+  if (!use_select ())
+    {
+      status = epoll_open (srv);
+      if (status == 0)
 	{
-	  status = MU_ERR_FAILURE;
-	  break;
+	  status = epoll_run (srv);
+	  epoll_close (srv);
+	  return status;
 	}
+      epoll_close (srv);
     }
-  return status;
+#endif
+  return select_run (srv);
 }
 
 int
@@ -189,6 +538,8 @@ mu_server_create (mu_server_t *psrv)
   mu_server_t srv = calloc (1, sizeof (*srv));
   if (!srv)
     return ENOMEM;
+  srv->sigpipe[0] = srv->sigpipe[1] = -1;
+  srv->epfd = -1;
   *psrv = srv;
   return 0;
 }
@@ -212,6 +563,21 @@ mu_server_destroy (mu_server_t *psrv)
       p = next;
     }
 
+  while (srv->timers)
+    {
+      struct _mu_timer *next = srv->timers->next;
+      timer_destroy (srv, srv->timers);
+      srv->timers = next;
+    }
+
+  while (srv->signals)
+    signal_remove (srv, &srv->signals);
+  if (srv->sigpipe[0] != -1)
+    {
+      close (srv->sigpipe[0]);
+      close (srv->sigpipe[1]);
+    }
+  
   if (srv->f_free)
     srv->f_free (srv->server_data);
   
@@ -271,7 +637,7 @@ mu_server_set_timeout (mu_server_t srv, struct timeval *to)
 int
 mu_server_add_connection (mu_server_t srv,
 			  int fd, void *data,
-			  mu_conn_loop_fp loop, mu_conn_free_fp free)
+			  mu_conn_loop_fp loop, mu_conn_free_fp f_free)
 {
   struct _mu_connection *p;
 
@@ -283,9 +649,29 @@ mu_server_add_connection (mu_server_t srv,
     return ENOMEM;
   p->fd = fd;
   p->f_loop = loop;
-  p->f_free = free;
+  p->f_free = f_free;
   p->data = data;
 
+#ifdef HAVE_SYS_EPOLL_H
+  /* Connections can be added from handlers while the server is
+     running. */
+  if (srv->epfd != -1)
+    {
+      int rc = epoll_add (srv, fd, p);
+      if (rc)
+	{
+	  free (p);
+	  return rc;
+	}
+    }
+#endif
+  if (fd < FD_SETSIZE)
+    {
+      FD_SET (fd, &srv->fdset);
+      if (fd >= srv->nfd)
+	srv->nfd = fd + 1;
+    }
+  
   p->next = NULL;
   p->prev = srv->tail;
   if (srv->tail)
@@ -296,4 +682,109 @@ mu_server_add_connection (mu_server_t srv,
   return 0;
 }
 
+/* Add a timer, which calls FP with DATA each INTERVAL.  The return
+   value of FP is interpreted as for connection handlers. */
+int
+mu_server_add_timer (mu_server_t srv, struct timeval const *interval,
+		     void *data, mu_server_timer_fp fp, mu_conn_free_fp f_free)
+{
+  struct _mu_timer *tp;
+  struct timeval now;
+  
+  if (!srv || !interval || !fp)
+    return EINVAL;
+  tp = malloc (sizeof (*tp));
+  if (!tp)
+    return ENOMEM;
+  tp->interval = *interval;
+  gettimeofday (&now, NULL);
+  tp->due = mu_timeval_add (&now, interval);
+  tp->f_timer = fp;
+  tp->f_free = f_free;
+  tp->data = data;
+  tp->next = srv->timers;
+  srv->timers = tp;
+  return 0;
+}
 
+static int
+sigpipe_open (mu_server_t srv)
+{
+  int i;
+  
+  if (srv->sigpipe[0] != -1)
+    return 0;
+  if (pipe (srv->sigpipe))
+    return errno;
+  for (i = 0; i < 2; i++)
+    {
+      fcntl (srv->sigpipe[i], F_SETFL,
+	     fcntl (srv->sigpipe[i], F_GETFL) | O_NONBLOCK);
+      fcntl (srv->sigpipe[i], F_SETFD, FD_CLOEXEC);
+    }
+#ifdef HAVE_SYS_EPOLL_H
+  if (srv->epfd != -1)
+    {
+      int rc = epoll_add (srv, srv->sigpipe[0], NULL);
+      if (rc)
+	return rc;
+    }
+#endif
+  if (srv->sigpipe[0] < FD_SETSIZE)
+    {
+      FD_SET (srv->sigpipe[0], &srv->fdset);
+      if (srv->sigpipe[0] >= srv->nfd)
+	srv->nfd = srv->sigpipe[0] + 1;
+    }
+  return 0;
+}
+
+/* Call FP with DATA each time the signal SIGNO is delivered.  The
+   handler is run synchronously, from the server loop.  The return
+   value of FP is interpreted as for connection handlers. */
+int
+mu_server_add_signal (mu_server_t srv, int signo,
+		      void *data, mu_server_signal_fp fp, mu_conn_free_fp f_free)
+{
+  struct _mu_signal *sig, *p;
+  int rc;
+  
+  if (!srv || !fp || signo <= 0 || signo >= NSIG)
+    return EINVAL;
+  rc = sigpipe_open (srv);
+  if (rc)
+    return rc;
+  sig = calloc (1, sizeof (*sig));
+  if (!sig)
+    return ENOMEM;
+  sig->signo = signo;
+  sig->f_signal = fp;
+  sig->f_free = f_free;
+  sig->data = data;
+
+  for (p = srv->signals; p; p = p->next)
+    if (p->signo == signo)
+      {
+	sig->oldact = p->oldact;
+	break;
+      }
+  if (!p)
+    {
+      struct sigaction act;
+
+      memset (&act, 0, sizeof act);
+      act.sa_handler = signal_source_handler;
+      sigemptyset (&act.sa_mask);
+      act.sa_flags = SA_RESTART;
+      if (sigaction (signo, &act, &sig->oldact))
+	{
+	  rc = errno;
+	  free (sig);
+	  return rc;
+	}
+      signal_pipe[signo] = srv->sigpipe[1] + 1;
+    }
+  sig->next = srv->signals;
+  srv->signals = sig;
+  return 0;
+}
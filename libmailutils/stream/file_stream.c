@@ -163,15 +163,17 @@ fd_open (struct _mu_stream *str)
   /* Handle CREAT with care, not to follow symlinks.  */
   if (fstr->stream.flags & MU_STREAM_CREAT)
     {
-      /* First see if the file already exists.  */
-      fd = open (fstr->filename, oflg);
-      if (fd == -1)
+      for (;;)
 	{
-	  /* Oops bail out.  */
-	  if (errno != ENOENT)
-	    return errno;
+	  /* First see if the file already exists.  */
+	  fd = open (fstr->filename, oflg);
+	  if (fd != -1 || errno != ENOENT)
+	    break;
 	  fd = open (fstr->filename, oflg|O_CREAT|O_EXCL,
 		     0600 | mu_stream_flags_to_mode (fstr->stream.flags, 0));
+	  /* Retry if another process has created the file meanwhile. */
+	  if (fd != -1 || errno != EEXIST)
+	    break;
 	}
     }
   else
@@ -174,7 +174,9 @@ filter_read (mu_stream_t stream, char *buf, size_t size, size_t *pret)
 {
   struct _mu_filter_stream *fs = (struct _mu_filter_stream *)stream;
   struct mu_filter_io iobuf;
-  size_t min_input_level = MU_FILTER_BUF_SIZE;
+  /* In interactive mode, don't read the transport while there is
+     unprocessed input. */
+  size_t min_input_level = fs->flag_interactive ? 1 : MU_FILTER_BUF_SIZE;
   size_t min_output_size = MU_FILTER_BUF_SIZE;
   enum mu_filter_command cmd = mu_filter_xcode;
   size_t total = 0;
@@ -198,7 +200,9 @@ filter_read (mu_stream_t stream, char *buf, size_t size, size_t *pret)
 	  
 	  if (MFB_rdbytes (&fs->inbuf) < min_input_level && !again)
 	    {
-	      rc = MFB_require (&fs->inbuf, min_input_level);
+	      rc = MFB_require (&fs->inbuf,
+				min_input_level < MU_FILTER_BUF_SIZE
+				  ? MU_FILTER_BUF_SIZE : min_input_level);
 	      if (rc)
 		return rc;
 	      rc = mu_stream_read (fs->transport,
@@ -315,6 +319,8 @@ filter_read (mu_stream_t stream, char *buf, size_t size, size_t *pret)
       MFB_advance_pos (&fs->outbuf, rdsize);
       total += rdsize;
 
+      if (fs->flag_interactive && total)
+	break;
     }
   while (!stop && total < size);
   
@@ -339,13 +345,13 @@ filter_write_internal (mu_stream_t stream, enum mu_filter_command cmd,
   size_t min_output_size = MU_FILTER_BUF_SIZE;
   size_t total = 0;
   int rc = 0;
-  int again;
+  int again = 0;
   int stop = 0;
+  enum mu_filter_result res = mu_filter_ok;
   
   do
     {
       size_t rdsize;
-      enum mu_filter_result res;
 
       if (MFB_rdbytes (&fs->inbuf) < min_input_level)
 	{
@@ -423,7 +429,9 @@ filter_write_internal (mu_stream_t stream, enum mu_filter_command cmd,
       else
 	break;
     }
-  while (!stop && (MFB_rdbytes (&fs->outbuf) || again));
+  while (!stop
+	 && (MFB_rdbytes (&fs->outbuf) || again
+	     || res == mu_filter_moreoutput));
   if (pret)
     *pret = total;
   else if (total < size && rc == 0)
@@ -501,6 +509,18 @@ filter_ctl (struct _mu_stream *stream, int code, int opcode, void *ptr)
 	    return EINVAL;
 	  fs->outbuf_size = *(size_t*)ptr;
 	  break;
+
+	case MU_IOCTL_FILTER_GET_INTERACTIVE:
+	  if (!ptr)
+	    return EINVAL;
+	  *(int*)ptr = fs->flag_interactive;
+	  break;
+
+	case MU_IOCTL_FILTER_SET_INTERACTIVE:
+	  if (!ptr)
+	    return EINVAL;
+	  fs->flag_interactive = *(int*)ptr != 0;
+	  break;
 	  
 	default:
 	  return ENOSYS;
@@ -644,7 +664,14 @@ static int
 filter_wait (struct _mu_stream *stream, int *pflags, struct timeval *tvp)
 {
   struct _mu_filter_stream *fs = (struct _mu_filter_stream *)stream;
-  /* FIXME: Take into account internal buffer state. */
+
+  if ((*pflags & MU_STREAM_READY_RD) && fs->stream.read == filter_read
+      && MFB_rdbytes (&fs->outbuf))
+    {
+      /* Decoded data are available */
+      *pflags = MU_STREAM_READY_RD;
+      return 0;
+    }
   return mu_stream_wait (fs->transport, pflags, tvp);
 }
 
@@ -0,0 +1,167 @@
+/* GNU Mailutils -- a suite of utilities for electronic mail
+   Copyright (C) 2022 Free Software Foundation, Inc.
+
+   GNU Mailutils is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   GNU Mailutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Mailutils.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Test timer and signal event sources of mu_server_t.
+
+   Usage: srvev timer|signal
+
+   The output is a sequence of events, as seen by the handlers. */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <mailutils/server.h>
+#include <mailutils/debug.h>
+#include <mailutils/diag.h>
+#include <mailutils/errno.h>
+#include <mailutils/error.h>
+#include <mailutils/stream.h>
+#include <mailutils/stdstream.h>
+
+static struct timeval interval = { 0, 10000 };
+
+struct source
+{
+  char const *name;
+  int count;     /* Number of times the handler was called */
+  int freed;     /* The source was removed */
+};
+
+static void
+source_free (void *data, void *server_data)
+{
+  struct source *src = data;
+  mu_printf ("%s: removed\n", src->name);
+  src->freed = 1;
+}
+
+/* Timer test.  The "tick" timer removes itself after the third call.
+   The "stop" timer then shuts the server down. */
+
+static int
+tick_timer (void *data, void *server_data)
+{
+  struct source *src = data;
+  mu_printf ("%s: %d\n", src->name, ++src->count);
+  return src->count == 3 ? MU_SERVER_CLOSE_CONN : MU_SERVER_SUCCESS;
+}
+
+static int
+stop_timer (void *data, void *server_data)
+{
+  struct source *tick = data;
+  if (!tick->freed)
+    return MU_SERVER_SUCCESS;
+  mu_printf ("stop\n");
+  return MU_SERVER_SHUTDOWN;
+}
+
+static void
+test_timer (mu_server_t srv)
+{
+  static struct source tick = { "tick" };
+  struct timeval stop_interval = { 0, 20000 };
+
+  MU_ASSERT (mu_server_add_timer (srv, &interval, &tick, tick_timer,
+				  source_free));
+  MU_ASSERT (mu_server_add_timer (srv, &stop_interval, &tick, stop_timer,
+				  NULL));
+}
+
+/* Signal test.  The timer raises SIGUSR1 each time it is called.  The
+   signal source removes itself after having handled the signal twice,
+   which causes the timer to shut the server down.  Before and after
+   that, SIGUSR1 is ignored. */
+
+static int
+usr1_signal (int signo, void *data, void *server_data)
+{
+  struct source *src = data;
+  mu_printf ("%s: %d\n", src->name, ++src->count);
+  return src->count == 2 ? MU_SERVER_CLOSE_CONN : MU_SERVER_SUCCESS;
+}
+
+static int
+raise_timer (void *data, void *server_data)
+{
+  struct source *usr1 = data;
+  if (usr1->freed)
+    {
+      mu_printf ("stop\n");
+      return MU_SERVER_SHUTDOWN;
+    }
+  raise (SIGUSR1);
+  return MU_SERVER_SUCCESS;
+}
+
+static void
+test_signal (mu_server_t srv)
+{
+  static struct source usr1 = { "SIGUSR1" };
+
+  signal (SIGUSR1, SIG_IGN);
+  MU_ASSERT (mu_server_add_signal (srv, SIGUSR1, &usr1, usr1_signal,
+				   source_free));
+  MU_ASSERT (mu_server_add_timer (srv, &interval, &usr1, raise_timer,
+				  NULL));
+}
+
+int
+main (int argc, char **argv)
+{
+  mu_server_t srv;
+  int rc;
+  
+  mu_set_program_name (argv[0]);
+  if (argc != 2)
+    {
+      mu_error ("usage: %s timer|signal", mu_program_name);
+      return 2;
+    }
+
+  MU_ASSERT (mu_server_create (&srv));
+  if (strcmp (argv[1], "timer") == 0)
+    test_timer (srv);
+  else if (strcmp (argv[1], "signal") == 0)
+    test_signal (srv);
+  else
+    {
+      mu_error ("unknown test: %s", argv[1]);
+      return 2;
+    }
+
+  rc = mu_server_run (srv);
+  if (rc != MU_ERR_FAILURE)
+    {
+      mu_error ("mu_server_run: %s", mu_strerror (rc));
+      return 1;
+    }
+
+  if (strcmp (argv[1], "signal") == 0)
+    {
+      /* The original disposition must have been restored. */
+      void (*old) (int) = signal (SIGUSR1, SIG_IGN);
+      mu_printf ("SIGUSR1 %s\n", old == SIG_IGN ? "ignored" : "handled");
+    }
+  
+  mu_server_destroy (&srv);
+  return 0;
+}
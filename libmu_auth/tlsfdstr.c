@@ -346,7 +346,16 @@ _tlsfd_wait (mu_stream_t stream, int *pflags, struct timeval *tvp)
   int n = 0;
   fd_set rdset, wrset, exset;
   int rc;
-  
+
+  /* Decrypted data may be waiting in the session buffers, in which case
+     the descriptor would not become readable. */
+  if ((*pflags & MU_STREAM_READY_RD) && sp->state == state_open
+      && gnutls_record_check_pending (sp->session) > 0)
+    {
+      *pflags = MU_STREAM_READY_RD;
+      return 0;
+    }
+
   if (sp->fd[MU_TRANSPORT_INPUT] == sp->fd[MU_TRANSPORT_OUTPUT])
     return mu_fd_wait (sp->fd[MU_TRANSPORT_INPUT], pflags, tvp);
 
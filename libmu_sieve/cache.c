@@ -0,0 +1,403 @@
+/* Cache of compiled Sieve programs for GNU Mailutils
+   Copyright (C) 2022 Free Software Foundation, Inc.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 3 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General
+   Public License along with this library.  If not, see
+   <http://www.gnu.org/licenses/>. */
+
+/* Programs that run the same Sieve script over and over again (e.g.
+   lmtpd, which runs the user's script for each delivered message)
+   can use mu_sieve_compile_cached instead of mu_sieve_compile.  The
+   first call compiles the script as usual and keeps a copy of the
+   resulting program in memory.  Subsequent calls copy the program
+   into the supplied machine, bypassing the parser.
+
+   The lexer records the identity of each source file read during
+   compilation (the script itself and all files it includes).  A
+   cached program is used only if none of these has changed since;
+   otherwise the script is recompiled.  */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sieve-priv.h>
+
+/* Maximum number of cached programs.  Zero disables caching. */
+size_t mu_sieve_cache_size = 32;
+
+/* Identity of a source file */
+struct source_id
+{
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  struct timespec mtime;
+  struct timespec ctime;
+};
+
+struct sieve_source
+{
+  struct source_id id;
+  char name[1];
+};
+
+/* Fill ID from the file status ST.  The timestamps include nanoseconds
+   if available, so that a script edited twice within the same second
+   is not taken for unchanged. */
+static void
+source_id_init (struct source_id *id, struct stat const *st)
+{
+  id->dev = st->st_dev;
+  id->ino = st->st_ino;
+  id->size = st->st_size;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+  id->mtime = st->st_mtim;
+  id->ctime = st->st_ctim;
+#else
+  id->mtime.tv_sec = st->st_mtime;
+  id->mtime.tv_nsec = 0;
+  id->ctime.tv_sec = st->st_ctime;
+  id->ctime.tv_nsec = 0;
+#endif
+}
+
+static int
+source_id_eq (struct source_id const *a, struct source_id const *b)
+{
+  return a->dev == b->dev
+         && a->ino == b->ino
+         && a->size == b->size
+         && a->mtime.tv_sec == b->mtime.tv_sec
+         && a->mtime.tv_nsec == b->mtime.tv_nsec
+         && a->ctime.tv_sec == b->ctime.tv_sec
+         && a->ctime.tv_nsec == b->ctime.tv_nsec;
+}
+
+static void
+srclist_free (void *data)
+{
+  mu_sieve_machine_t mach = data;
+  mu_list_destroy (&mach->srclist);
+}
+
+static void
+srclist_add (mu_sieve_machine_t mach, char const *name,
+	     struct source_id const *id)
+{
+  struct sieve_source *src;
+  int rc;
+
+  if (!mach->srclist)
+    {
+      rc = mu_list_create (&mach->srclist);
+      if (rc)
+	{
+	  mu_sieve_error (mach, "mu_list_create: %s", mu_strerror (rc));
+	  mu_sieve_abort (mach);
+	}
+      mu_list_set_destroy_item (mach->srclist, mu_list_free_item);
+      mu_sieve_machine_add_destructor (mach, srclist_free, mach);
+    }
+
+  src = malloc (sizeof (*src) + strlen (name));
+  if (!src)
+    {
+      mu_sieve_error (mach, "%s", mu_strerror (errno));
+      mu_sieve_abort (mach);
+    }
+  src->id = *id;
+  strcpy (src->name, name);
+  rc = mu_list_append (mach->srclist, src);
+  if (rc)
+    {
+      free (src);
+      mu_sieve_error (mach, "mu_list_append: %s", mu_strerror (rc));
+      mu_sieve_abort (mach);
+    }
+}
+
+/* Record the source file NAME, described by ST, as used by the program
+   being compiled in MACH.  Called by the lexer. */
+void
+mu_i_sv_add_source (mu_sieve_machine_t mach, char const *name,
+		    struct stat const *st)
+{
+  struct source_id id;
+
+  source_id_init (&id, st);
+  if (name[0] == '/')
+    srclist_add (mach, name, &id);
+  else
+    {
+      char *cwd = mu_getcwd ();
+      char *absname = mu_make_file_name (cwd, name);
+      free (cwd);
+      if (!absname)
+	{
+	  mu_sieve_error (mach, "%s", mu_strerror (ENOMEM));
+	  mu_sieve_abort (mach);
+	}
+      srclist_add (mach, absname, &id);
+      free (absname);
+    }
+}
+
+static int
+source_changed (void *item, void *data)
+{
+  struct sieve_source *src = item;
+  struct stat st;
+  struct source_id id;
+
+  if (stat (src->name, &st))
+    return 1;
+  source_id_init (&id, &st);
+  return !source_id_eq (&id, &src->id);
+}
+
+static int
+srccopy (void *item, void *data)
+{
+  struct sieve_source *src = item;
+  mu_sieve_machine_t mach = data;
+
+  srclist_add (mach, src->name, &src->id);
+  return 0;
+}
+
+/* Load the modules that provided the registry records of the source
+   machine. */
+static int
+regload (void *item, void *data)
+{
+  mu_sieve_registry_t *reg = item;
+  mu_sieve_machine_t mach = data;
+
+  if (reg->handle)
+    mu_sieve_registry_require (mach, reg->name, reg->type);
+  return 0;
+}
+
+/* Copy the built-in registry records (those registered by the
+   require statements of the program) that are still missing. */
+static int
+regcopy (void *item, void *data)
+{
+  mu_sieve_registry_t *reg = item;
+  mu_sieve_machine_t mach = data;
+  mu_sieve_registry_t *newreg;
+
+  newreg = mu_sieve_registry_lookup (mach, reg->name, reg->type);
+  if (!newreg)
+    {
+      newreg = mu_sieve_registry_add (mach, reg->name);
+      newreg->type = reg->type;
+      newreg->v = reg->v;
+    }
+  newreg->required = reg->required;
+  return 0;
+}
+
+/* Copy the compiled program from SRC to DST.  User settings of DST
+   (streams, logger, environment, etc.) are retained. */
+static int
+copy_program (mu_sieve_machine_t dst, mu_sieve_machine_t src)
+{
+  size_t i;
+  int rc;
+
+  rc = mu_sieve_machine_reset (dst);
+  if (rc)
+    return rc;
+
+  rc = setjmp (dst->errbuf);
+  if (rc == 0)
+    {
+      mu_i_sv_register_standard_actions (dst);
+      mu_i_sv_register_standard_tests (dst);
+      mu_i_sv_register_standard_comparators (dst);
+      if (mu_sieve_has_variables (src))
+	mu_sieve_require_variables (dst);
+      mu_list_foreach (src->registry, regload, dst);
+      mu_list_foreach (src->registry, regcopy, dst);
+
+      dst->idspace = mu_sieve_calloc (dst, src->idcount,
+				      sizeof (dst->idspace[0]));
+      dst->idcount = dst->idmax = src->idcount;
+      for (i = 0; i < src->idcount; i++)
+	dst->idspace[i] = mu_sieve_strdup (dst, src->idspace[i]);
+
+      dst->stringspace = mu_sieve_calloc (dst, src->stringcount,
+					  sizeof (dst->stringspace[0]));
+      dst->stringcount = dst->stringmax = src->stringcount;
+      for (i = 0; i < src->stringcount; i++)
+	{
+	  dst->stringspace[i].constant = src->stringspace[i].constant;
+	  dst->stringspace[i].orig =
+	    mu_sieve_strdup (dst, src->stringspace[i].orig);
+	}
+
+      dst->valspace = mu_sieve_calloc (dst, src->valcount,
+				       sizeof (dst->valspace[0]));
+      dst->valcount = dst->valmax = src->valcount;
+      for (i = 0; i < src->valcount; i++)
+	{
+	  dst->valspace[i].type = src->valspace[i].type;
+	  dst->valspace[i].tag = mu_sieve_strdup (dst, src->valspace[i].tag);
+	  mu_locus_range_copy (&dst->valspace[i].locus,
+			       &src->valspace[i].locus);
+	  if (src->valspace[i].type == SVT_TAG)
+	    dst->valspace[i].v.string =
+	      mu_sieve_strdup (dst, src->valspace[i].v.string);
+	  else
+	    dst->valspace[i].v = src->valspace[i].v;
+	}
+
+      dst->progsize = src->progsize;
+      dst->prog = mu_sieve_calloc (dst, src->progsize,
+				   sizeof (dst->prog[0]));
+      memcpy (dst->prog, src->prog, src->progsize * sizeof (dst->prog[0]));
+
+      mu_list_foreach (src->srclist, srccopy, dst);
+
+      dst->state = mu_sieve_state_compiled;
+    }
+  else
+    dst->state = mu_sieve_state_error;
+  return rc;
+}
+
+struct cache_entry
+{
+  mu_sieve_machine_t mach;      /* Machine holding the compiled program */
+  char name[1];                 /* Absolute script file name */
+};
+
+static mu_list_t cache_list;    /* Most recently used entries first */
+
+static void
+cache_entry_free (void *item)
+{
+  struct cache_entry *ent = item;
+  mu_sieve_machine_destroy (&ent->mach);
+  free (ent);
+}
+
+static int
+cache_entry_cmp (const void *a, const void *b)
+{
+  struct cache_entry const *ent = a;
+  return strcmp (ent->name, (char const *) b);
+}
+
+/* Remove the least recently used entries, leaving at most N. */
+static void
+cache_trim (size_t n)
+{
+  size_t count;
+
+  mu_list_count (cache_list, &count);
+  while (count > n)
+    {
+      mu_list_remove_nth (cache_list, count - 1);
+      count--;
+    }
+}
+
+static void
+cache_add (char const *name, mu_sieve_machine_t mach)
+{
+  struct cache_entry *ent;
+
+  if (!cache_list)
+    {
+      if (mu_list_create (&cache_list))
+	return;
+      mu_list_set_destroy_item (cache_list, cache_entry_free);
+      mu_list_set_comparator (cache_list, cache_entry_cmp);
+    }
+
+  cache_trim (mu_sieve_cache_size - 1);
+
+  ent = malloc (sizeof (*ent) + strlen (name));
+  if (!ent)
+    return;
+  strcpy (ent->name, name);
+  if (mu_sieve_machine_create (&ent->mach))
+    {
+      free (ent);
+      return;
+    }
+  if (copy_program (ent->mach, mach) || mu_list_prepend (cache_list, ent))
+    cache_entry_free (ent);
+}
+
+int
+mu_sieve_compile_cached (mu_sieve_machine_t mach, const char *name)
+{
+  char *absname;
+  struct cache_entry *ent;
+  int rc;
+
+  if (mu_sieve_cache_size == 0)
+    return mu_sieve_compile (mach, name);
+
+  if (name[0] == '/')
+    absname = strdup (name);
+  else
+    {
+      char *cwd = mu_getcwd ();
+      absname = mu_make_file_name (cwd, name);
+      free (cwd);
+    }
+  if (!absname)
+    return ENOMEM;
+
+  if (mu_list_locate (cache_list, absname, (void **) &ent) == 0)
+    {
+      if (ent->mach->srclist
+	  && mu_list_foreach (ent->mach->srclist, source_changed, NULL) == 0)
+	{
+	  mu_debug (mu_sieve_debug_handle, MU_DEBUG_TRACE1,
+		    ("using cached program for %s", absname));
+	  /* Move the entry to the head of the list.  Notice that entries
+	     are looked up by name (see cache_entry_cmp). */
+	  mu_list_set_destroy_item (cache_list, NULL);
+	  mu_list_remove (cache_list, absname);
+	  mu_list_set_destroy_item (cache_list, cache_entry_free);
+	  mu_list_prepend (cache_list, ent);
+	  rc = copy_program (mach, ent->mach);
+	  free (absname);
+	  return rc;
+	}
+      mu_debug (mu_sieve_debug_handle, MU_DEBUG_TRACE1,
+		("cached program for %s is out of date", absname));
+      mu_list_remove (cache_list, absname);
+    }
+
+  rc = mu_sieve_compile (mach, name);
+  if (rc == 0)
+    cache_add (absname, mach);
+  free (absname);
+  return rc;
+}
+
+void
+mu_sieve_cache_flush (void)
+{
+  mu_list_destroy (&cache_list);
+}
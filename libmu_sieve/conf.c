@@ -166,6 +166,10 @@ static struct mu_cfg_param mu_sieve_param[] = {
     N_("Add directories to the include search path.  Argument is a "
        "colon-separated list of directories."),
     N_("arg: directory list") },
+  { "cache-size", mu_c_size, &mu_sieve_cache_size, 0, NULL,
+    N_("Maximum number of compiled Sieve programs to keep in memory.  "
+       "Zero disables the cache."),
+    N_("n: number") },
   { NULL }
 };
 
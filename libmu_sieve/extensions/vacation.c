@@ -750,7 +750,21 @@ vacation_reply (mu_sieve_machine_t mach, mu_message_t msg,
       mailer = mu_sieve_get_mailer (mach);
       if (mailer)
 	{
-	  rc = mu_mailer_send_message (mailer, newmsg, from_addr, to_addr);
+	  rc = mu_mailer_open (mailer, 0);
+	  if (rc)
+	    {
+	      mu_url_t url = NULL;
+	      mu_mailer_get_url (mailer, &url);
+	      mu_sieve_error (mach,
+			      _("%lu: cannot open mailer %s: %s"),
+			      (unsigned long) mu_sieve_get_message_num (mach),
+			      mu_url_to_string (url), mu_strerror (rc));
+	    }
+	  else
+	    {
+	      rc = mu_mailer_send_message (mailer, newmsg, from_addr, to_addr);
+	      mu_mailer_close (mailer);
+	    }
 	}
       else
 	rc = MU_ERR_FAILURE;
@@ -2707,6 +2707,8 @@ mu_i_sv_free_stringspace (mu_sieve_machine_t mach)
 int
 mu_sieve_machine_reset (mu_sieve_machine_t mach)
 {
+  char *daemon_email = NULL;
+  
   switch (mach->state)
     {
     case mu_sieve_state_init:
@@ -2724,12 +2726,25 @@ mu_sieve_machine_reset (mu_sieve_machine_t mach)
       return MU_ERR_FAILURE;
     }
 
+  /* The daemon address is a user setting: preserve it */
+  if (mach->daemon_email)
+    daemon_email = strdup (mach->daemon_email);
+  
   mu_i_sv_free_stringspace (mach);
+  mu_i_sv_free_idspace (mach);
+  /* Registry records are allocated in the memory pool: clear the
+     registry first */
+  mu_list_clear (mach->registry);
   mu_list_clear (mach->memory_pool);
   mu_list_clear (mach->destr_list);
   mu_opool_free (mach->string_pool, NULL);
-  mu_i_sv_free_idspace (mach);
-  mu_list_clear (mach->registry);
+
+  mach->daemon_email = daemon_email;
+  if (daemon_email)
+    mu_sieve_register_memory (mach, daemon_email, NULL);
+
+  mach->idspace = NULL;
+  mach->idmax = 0;
 
   mach->stringspace = NULL;
   mach->stringcount = 0;
@@ -2741,6 +2756,7 @@ mu_sieve_machine_reset (mu_sieve_machine_t mach)
 
   mach->progsize = 0;
   mach->prog = NULL;
+  mach->pc = 0;
 
   mu_assoc_destroy (&mach->vartab);
   mach->match_string = NULL;
@@ -2996,18 +3012,6 @@ mu_sieve_get_mailer (mu_sieve_machine_t mach)
 			  mu_strerror (rc));
 	  return NULL;
 	}
-      rc = mu_mailer_open (mach->mailer, 0);
-      if (rc)
-	{
-	  mu_url_t url = NULL;
-	  mu_mailer_get_url (mach->mailer, &url);
-	  mu_sieve_error (mach,
-			  _("%lu: cannot open mailer %s: %s"),
-			  (unsigned long) mu_sieve_get_message_num (mach),
-			  mu_url_to_string (url), mu_strerror (rc));
-	  mu_mailer_destroy (&mach->mailer);
-	  return NULL;
-	}
     }
   return mach->mailer;
 }
@@ -795,6 +795,7 @@ push_source (const char *name)
       mu_i_sv_error (mu_sieve_machine);
       return 1;
     }
+  mu_i_sv_add_source (mu_sieve_machine, name, &st);
 
   /* Push current context */
   if (trk)
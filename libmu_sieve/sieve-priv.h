@@ -82,6 +82,7 @@ struct mu_sieve_machine
   
   size_t progsize;           /* Number of allocated program cells */
   sieve_op_t *prog;          /* Compiled program */
+  mu_list_t srclist;         /* Source files the program was compiled from */
 
   /* Runtime data */
   enum mu_sieve_state state; /* Machine state */
@@ -214,6 +215,12 @@ void mu_i_sv_register_standard_actions (mu_sieve_machine_t mach);
 void mu_i_sv_register_standard_tests (mu_sieve_machine_t mach);
 void mu_i_sv_register_standard_comparators (mu_sieve_machine_t mach);
 
+int mu_sieve_machine_reset (mu_sieve_machine_t mach);
+
+struct stat;
+void mu_i_sv_add_source (mu_sieve_machine_t mach, char const *name,
+			 struct stat const *st);
+
 void mu_i_sv_error (mu_sieve_machine_t mach);
 
 void mu_i_sv_debug (mu_sieve_machine_t mach, size_t pc, const char *fmt, ...)
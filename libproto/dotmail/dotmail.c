@@ -22,6 +22,7 @@
 #endif
 #include <sys/stat.h>
 #include <signal.h>
+#include <sys/mman.h>
 #include <mailutils/sys/dotmail.h>
 #include <mailutils/sys/mailbox.h>
 #include <mailutils/sys/message.h>
@@ -40,6 +41,7 @@
 #include <mailutils/envelope.h>
 #include <mailutils/util.h>
 #include <mailutils/cctype.h>
+#include <mailutils/cstr.h>
 
 static void
 dotmail_destroy (mu_mailbox_t mailbox)
@@ -357,10 +359,233 @@ dotmail_message_alloc_uid (struct mu_dotmail_message *dmsg)
    UINT_STRWIDTH ((d)->uidvalidity) +	   \
    UINT_STRWIDTH ((d)->uidnext))
 
+/* Finalize the message DMSG, whose terminating dot is located at
+   offset END. */
+static void
+dotmail_scan_finalize (struct mu_dotmail_mailbox *dmp,
+		       struct mu_dotmail_message *dmsg, mu_off_t end,
+		       int *force_init_uids)
+{
+  size_t count;
+
+  dmsg->body_lines_scanned = 1;
+  dmsg->message_end = end;
+
+  if (dmsg->num == 0)
+    {
+      if (dmsg->hdr[mu_dotmail_hdr_x_imapbase]
+	  && sscanf (dmsg->hdr[mu_dotmail_hdr_x_imapbase],
+		     "%lu %lu",
+		     &dmp->uidvalidity, &dmp->uidnext) == 2)
+	dmp->uidvalidity_scanned = 1;
+    }
+
+  if (dmp->uidvalidity_scanned)
+    {
+      if (!(!*force_init_uids
+	    && dmsg->hdr[mu_dotmail_hdr_x_uid]
+	    && sscanf (dmsg->hdr[mu_dotmail_hdr_x_uid],
+		       "%lu", &dmsg->uid) == 1
+	    && dmsg->uid < dmp->uidnext
+	    && (dmsg->num == 0
+		|| dmsg->uid > dmp->mesg[dmsg->num - 1]->uid)))
+	{
+	  *force_init_uids = 1;
+	  dmp->uidvalidity = (unsigned long) time (NULL);
+	  dmp->uidvalidity_changed = 1;
+	}
+		  
+      if (*force_init_uids)
+	dotmail_message_alloc_uid (dmsg);
+    }
+
+  /* Every 100 mesgs update the lock, it should be every minute.  */
+  if (dmp->mailbox->locker && (dmp->mesg_count % 100) == 0)
+    mu_locker_touchlock (dmp->mailbox->locker);
+
+  count = dmp->mesg_count;
+  dotmail_dispatch (dmp->mailbox, MU_EVT_MESSAGE_ADD, &count);
+}
+
+static char *expect[] = {
+  "status:    ",
+  "x-imapbase:",
+  "x-uid:     ",
+};
+
+/*
+ * Mapped mailbox scanner.
+ *
+ * Operates on the memory-mapped mailbox file, processing it a line at a
+ * time.  Line boundaries are located using memchr, which is considerably
+ * faster than reading the mailbox character by character.  Only the
+ * header lines and the lines beginning with a dot need to be analyzed.
+ *
+ * Returns ENOSYS if the mailbox cannot be mapped.
+ */
 static int
-dotmail_rescan_unlocked (mu_mailbox_t mailbox, mu_off_t offset)
+dotmail_scan_mapped (struct mu_dotmail_mailbox *dmp, mu_off_t offset,
+		     int *force_init_uids)
 {
-  struct mu_dotmail_mailbox *dmp = mailbox->data;
+  mu_transport_t trans[2];
+  long pagesize = sysconf (_SC_PAGESIZE);
+  mu_off_t size;
+  mu_off_t map_off;
+  size_t map_len;
+  char *map;
+  char const *base, *end, *p, *q;
+  struct mu_dotmail_message *dmsg = NULL;
+  size_t lines = 0;
+  int rc;
+
+  if (pagesize <= 0
+      || mu_stream_ioctl (dmp->mailbox->stream, MU_IOCTL_TRANSPORT,
+			  MU_IOCTL_OP_GET, trans))
+    return ENOSYS;
+  /* Make sure any pending writes are visible through the mapping */
+  rc = mu_stream_flush (dmp->mailbox->stream);
+  if (rc == 0)
+    rc = mu_stream_size (dmp->mailbox->stream, &size);
+  if (rc)
+    return rc;
+  if (size <= offset)
+    return 0;
+
+  map_off = offset - offset % pagesize;
+  map_len = size - map_off;
+  map = mmap (NULL, map_len, PROT_READ, MAP_SHARED,
+	      (int) (intptr_t) trans[0], map_off);
+  if (map == MAP_FAILED)
+    {
+      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_TRACE1,
+		("%s:%s (%s): %s",
+		 __func__, "mmap", dmp->name, mu_strerror (errno)));
+      return ENOSYS;
+    }
+#ifdef MADV_SEQUENTIAL
+  madvise (map, map_len, MADV_SEQUENTIAL);
+#endif
+
+  /* Pointer to the start of the mailbox: p - base gives the offset */
+  base = map - map_off;
+  end = map + map_len;
+  p = base + offset;
+
+#define OFFSET(ptr) ((mu_off_t) ((ptr) - base))
+  
+  while (p < end)
+    {
+      size_t stuffed = 0;
+      
+      rc = dotmail_alloc_message (dmp, &dmsg);
+      if (rc)
+	{
+	  mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
+		    ("%s:%s (%s): %s",
+		     __func__, "dotmail_alloc_message", dmp->name,
+		     mu_strerror (rc)));
+	  dmsg = NULL;
+	  break;
+	}
+      dmsg->message_start = OFFSET (p);
+
+      /* Scan the header */
+      while ((q = memchr (p, '\n', end - p)) != NULL)
+	{
+	  if (q == p)
+	    break;
+	  
+	  if (p[0] == 's' || p[0] == 'S' || p[0] == 'x' || p[0] == 'X')
+	    {
+	      int i;
+
+	      for (i = 0; i < MU_DOTMAIL_HDR_MAX; i++)
+		{
+		  char const *colon = strchr (expect[i], ':');
+		  size_t len = colon - expect[i] + 1;
+
+		  if (q - p >= len
+		      && mu_c_strncasecmp (p, expect[i], len) == 0)
+		    {
+		      size_t vlen = q - p - len;
+		      char *val = malloc (vlen + 1);
+
+		      if (!val)
+			{
+			  rc = ENOMEM;
+			  goto out;
+			}
+		      memcpy (val, p + len, vlen);
+		      val[vlen] = 0;
+		      free (dmsg->hdr[i]);
+		      dmsg->hdr[i] = val;
+		      if (i == mu_dotmail_hdr_x_imapbase)
+			{
+			  dmp->x_imapbase_len = q - p;
+			  dmp->x_imapbase_off = OFFSET (p);
+			}
+		      break;
+		    }
+		}
+	    }
+	  p = q + 1;
+	  lines++;
+	}
+      if (!q)
+	break;
+      p = q + 1;
+      dmsg->body_start = OFFSET (p);
+
+      /* Scan the body */
+      while ((q = memchr (p, '\n', end - p)) != NULL)
+	{
+	  if (p[0] == '.')
+	    {
+	      if (q == p + 1)
+		break;
+	      if (p[1] == '.')
+		{
+		  dmsg->body_dot_stuffed = 1;
+		  stuffed++;
+		}
+	    }
+	  if (q > p)
+	    dmsg->body_lines++;
+	  p = q + 1;
+	  if (++lines % 1000 == 0)
+	    dotmail_dispatch (dmp->mailbox, MU_EVT_MAILBOX_PROGRESS, NULL);
+	}
+      if (!q)
+	break;
+      dmsg->body_size = OFFSET (p) - dmsg->body_start - stuffed;
+      dotmail_scan_finalize (dmp, dmsg, OFFSET (p), force_init_uids);
+      dmsg = NULL;
+      p = q + 1;
+    }
+
+#undef OFFSET
+ out:
+  if (dmsg)
+    {
+      /* Incomplete message */
+      if (rc == 0)
+	mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
+		  ("%s (%s): message %lu ended prematurely",
+		   __func__, dmp->name,
+		   (unsigned long) dmp->mesg_count));
+      mu_dotmail_message_free (dmp->mesg[--dmp->mesg_count]);
+    }
+  munmap (map, map_len);
+  return rc;
+}
+
+/* Scan the mailbox starting at OFFSET by reading it character by
+   character.  This is used if the mailbox cannot be memory-mapped. */
+static int
+dotmail_scan_stream (struct mu_dotmail_mailbox *dmp, mu_off_t offset,
+		     int *force_init_uids)
+{
+  mu_mailbox_t mailbox = dmp->mailbox;
   mu_stream_t stream;
   char cur;
   size_t n;
@@ -377,16 +602,7 @@ dotmail_rescan_unlocked (mu_mailbox_t mailbox, mu_off_t offset)
   struct mu_dotmail_message *dmsg;
   size_t lines = 0;
   int rc;
-  static char *expect[] = {
-    "status:    ",
-    "x-imapbase:",
-    "x-uid:     ",
-  };
   int i, j;
-  int force_init_uids = 0;
-
-  if (!(dmp->stream_flags & MU_STREAM_READ))
-    return 0;
 
   rc = mu_streamref_create (&stream, mailbox->stream);
   if (rc)
@@ -457,7 +673,6 @@ dotmail_rescan_unlocked (mu_mailbox_t mailbox, mu_off_t offset)
 	  state = dotmail_scan_header_newline;
 	  i = j = 0;
 	  break;
-
 	case dotmail_scan_header:
 	  if (cur == '\n')
 	    {
@@ -587,11 +802,9 @@ dotmail_rescan_unlocked (mu_mailbox_t mailbox, mu_off_t offset)
 	case dotmail_scan_dot:
 	  if (cur == '\n')
 	    {
-	      size_t count;
-
-	      dmsg->body_lines_scanned = 1;
+	      mu_off_t end;
 
-	      rc = mu_stream_seek (stream, 0, MU_SEEK_CUR, &dmsg->message_end);
+	      rc = mu_stream_seek (stream, 0, MU_SEEK_CUR, &end);
 	      if (rc)
 		{
 		  mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
@@ -600,43 +813,8 @@ dotmail_rescan_unlocked (mu_mailbox_t mailbox, mu_off_t offset)
 			     mu_strerror (rc)));
 		  return rc;
 		}
-	      dmsg->message_end -= 2;
 	      dmsg->body_size--;
-
-	      if (dmsg->num == 0)
-		{
-		  if (dmsg->hdr[mu_dotmail_hdr_x_imapbase]
-		      && sscanf (dmsg->hdr[mu_dotmail_hdr_x_imapbase],
-				 "%lu %lu",
-				 &dmp->uidvalidity, &dmp->uidnext) == 2)
-		    dmp->uidvalidity_scanned = 1;
-		}
-
-	      if (dmp->uidvalidity_scanned)
-		{
-		  if (!(!force_init_uids
-			&& dmsg->hdr[mu_dotmail_hdr_x_uid]
-			&& sscanf (dmsg->hdr[mu_dotmail_hdr_x_uid],
-				   "%lu", &dmsg->uid) == 1
-			&& dmsg->uid < dmp->uidnext
-			&& (dmsg->num == 0
-			    || dmsg->uid > dmp->mesg[dmsg->num - 1]->uid)))
-		    {
-		      force_init_uids = 1;
-		      dmp->uidvalidity = (unsigned long) time (NULL);
-		      dmp->uidvalidity_changed = 1;
-		    }
-		  
-		  if (force_init_uids)
-		    dotmail_message_alloc_uid (dmsg);
-		}
-
-	      /* Every 100 mesgs update the lock, it should be every minute.  */
-	      if (mailbox->locker && (dmp->mesg_count % 100) == 0)
-		mu_locker_touchlock (mailbox->locker);
-
-	      count = dmp->mesg_count;
-	      dotmail_dispatch (mailbox, MU_EVT_MESSAGE_ADD, &count);
+	      dotmail_scan_finalize (dmp, dmsg, end - 2, force_init_uids);
 
 	      state = dotmail_scan_init;
 	    }
@@ -664,6 +842,36 @@ dotmail_rescan_unlocked (mu_mailbox_t mailbox, mu_off_t offset)
   return rc;
 }
 
+
+static int
+dotmail_use_stream_scanner (void)
+{
+  static int stream_scanner = -1;
+  if (stream_scanner == -1)
+    {
+      char *p = getenv ("MU_DOTMAIL_SCANNER");
+      stream_scanner = p && strcmp (p, "stream") == 0;
+    }
+  return stream_scanner;
+}
+
+static int
+dotmail_rescan_unlocked (mu_mailbox_t mailbox, mu_off_t offset)
+{
+  struct mu_dotmail_mailbox *dmp = mailbox->data;
+  int force_init_uids = 0;
+  int rc;
+
+  if (!(dmp->stream_flags & MU_STREAM_READ))
+    return 0;
+
+  if (dotmail_use_stream_scanner ()
+      || (rc = dotmail_scan_mapped (dmp, offset, &force_init_uids)) == ENOSYS)
+    rc = dotmail_scan_stream (dmp, offset, &force_init_uids);
+
+  return rc;
+}
+
 /* Scan the mailbox starting from the given offset */
 static int
 dotmail_rescan (mu_mailbox_t mailbox, mu_off_t offset)
@@ -95,6 +95,8 @@ struct _maildir_message
   char *file_name;  /* File name */
   size_t uniq_len;  /* Length of the unique file name prefix. */
   size_t uid;
+  mu_off_t size;    /* File size, as given by the S= attribute (0 if
+		       unknown). */
 };
 
 static char *subdir_name[] = { "cur", "new", "tmp" };
@@ -428,6 +430,13 @@ maildir_message_name_parse (char const *name, char **attrnames,
   struct attrib *athead = NULL;
   size_t len;
   int f = 0;
+
+  if (!strchr (name, ':'))
+    {
+      /* No info part (a message in "new"): look for attributes only. */
+      state = 4;
+      endval = endp;
+    }
   
   while (p > name)
     {
@@ -590,7 +599,7 @@ maildir_message_alloc (struct _maildir_data *md, int subdir, char const *name,
 {
   struct _maildir_message *msg;
   size_t n;
-  static char *attrnames[] = { "a", "u", NULL };
+  static char *attrnames[] = { "a", "u", "S", NULL };
   struct attrib *attrs;
   char const *p;
   
@@ -633,6 +642,17 @@ maildir_message_alloc (struct _maildir_data *md, int subdir, char const *name,
 	msg->uid = n;
     }
 
+  if ((p = attrib_lookup (attrs, "S")) != NULL)
+    {
+      char *endp;
+      unsigned long long n;
+
+      errno = 0;
+      n = strtoull (p, &endp, 10);
+      if (errno == 0 && *endp == 0)
+	msg->size = n;
+    }
+
   attrib_free (attrs);
   *pmsg = msg;
   return 0;
@@ -878,13 +898,42 @@ maildir_message_fixup (struct _maildir_data *md, struct _maildir_message *msg)
     }
 }
 
+/* Messages are delivered to new/ and change their flags in cur/, which
+   does not affect the modification time of the maildir itself.  Return
+   the latest modification time of the three directories. */
+static int
+maildir_mtime (struct _amd_data *amd, struct timespec *pmtime)
+{
+  struct stat st;
+  struct timespec t, ts;
+  int i;
+
+  if (stat (amd->name, &st))
+    return errno;
+  amd_stat_mtime (&st, &t);
+  for (i = SUB_CUR; i <= SUB_NEW; i++)
+    {
+      char *name = mu_make_file_name (amd->name, subdir_name[i]);
+      if (!name)
+	return ENOMEM;
+      if (stat (name, &st) == 0)
+	{
+	  amd_stat_mtime (&st, &ts);
+	  if (amd_timespec_cmp (&ts, &t) > 0)
+	    t = ts;
+	}
+      free (name);
+    }
+  *pmtime = t;
+  return 0;
+}
+
 static int
 maildir_scan_unlocked (mu_mailbox_t mailbox, size_t *pcount, int do_notify)
 {
   struct _maildir_data *md = mailbox->data;
   int rc;
   char const *s;
-  struct stat st;
   size_t i;
   int has_new = 0;
   
@@ -974,10 +1023,11 @@ maildir_scan_unlocked (mu_mailbox_t mailbox, size_t *pcount, int do_notify)
       rc = 0;
     }
 
-  if (stat (md->amd.name, &st) == 0)
-    md->amd.mtime = st.st_mtime;
-  else
-    md->amd.mtime = time (NULL);
+  if (maildir_mtime (&md->amd, &md->amd.mtime))
+    {
+      md->amd.mtime.tv_sec = time (NULL);
+      md->amd.mtime.tv_nsec = 0;
+    }
   if (rc == 0 && pcount)
     *pcount = md->amd.msg_count;
 
@@ -1171,6 +1221,20 @@ string_buffer_format_mu_flags (struct string_buffer *buf, int flags)
   return rc;
 }
 
+/* Format the size attribute of MSG, if known. */
+static int
+string_buffer_format_size (struct string_buffer *buf,
+			   struct _maildir_message *msg)
+{
+  int rc;
+
+  if (msg->size == 0)
+    return 0;
+  if ((rc = string_buffer_append (buf, ",S=", 3)) == 0)
+    rc = string_buffer_format_long (buf, msg->size, 10);
+  return rc;
+}
+
 static int
 string_buffer_format_message_name (struct string_buffer *buf,
 				   struct _maildir_message *msg,
@@ -1179,6 +1243,7 @@ string_buffer_format_message_name (struct string_buffer *buf,
   int rc;
   
   if ((rc = string_buffer_append (buf, msg->file_name, msg->uniq_len)) == 0 &&
+      (rc = string_buffer_format_size (buf, msg)) == 0 &&
       (rc = string_buffer_format_mu_flags (buf, flags)) == 0 &&
       (rc = string_buffer_append (buf, ",u=", 3)) == 0 &&
       (rc = string_buffer_format_long (buf, msg->uid, 10)) == 0 &&
@@ -1398,6 +1463,20 @@ maildir_msg_finish_delivery (struct _amd_data *amd, struct _amd_message *amm,
   int src_fd = -1, dst_fd = -1;
   struct string_buffer sb = STRING_BUFFER_INITIALIZER;
   char const *newname;
+  struct stat st;
+  
+  rc = maildir_open (md);
+  if (rc)
+    goto err;
+    
+  rc = maildir_subdir_open (md, SUB_TMP, NULL, &src_fd);
+  if (rc)
+    goto err;
+
+  /* Record the message size in its name, so that the mailbox size can
+     be computed without stat'ing each file. */
+  if (fstatat (src_fd, msg->file_name, &st, 0) == 0)
+    msg->size = st.st_size;
   
   if ((atr || mu_message_get_attribute (orig_msg, &atr) == 0)
       && mu_attribute_get_flags (atr, &flags) == 0
@@ -1405,28 +1484,19 @@ maildir_msg_finish_delivery (struct _amd_data *amd, struct _amd_message *amm,
     {
       msg->subdir = SUB_CUR;
       rc = string_buffer_format_message_name (&sb, msg, flags);
-      if (rc == 0)
-	rc = string_buffer_append (&sb, "", 1);
-      if (rc)
-	{
-	  string_buffer_free (&sb);
-	  return rc;
-	}
-      newname = sb.base;
     }
   else
     {
       msg->subdir = SUB_NEW;
-      newname = msg->file_name;
+      if ((rc = string_buffer_append (&sb, msg->file_name,
+				      msg->uniq_len)) == 0)
+	rc = string_buffer_format_size (&sb, msg);
     }
-
-  rc = maildir_open (md);
-  if (rc)
-    goto err;
-    
-  rc = maildir_subdir_open (md, SUB_TMP, NULL, &src_fd);
+  if (rc == 0)
+    rc = string_buffer_append (&sb, "", 1);
   if (rc)
     goto err;
+  newname = sb.base;
   
   rc = maildir_subdir_open (md, msg->subdir, NULL, &dst_fd);
   if (rc)
@@ -1620,6 +1690,29 @@ maildir_message_uid (mu_message_t msg, size_t *puid)
   return 0;
 }
 
+/* The unique part of the file name stays the same during the whole
+   lifetime of the message, so it makes a natural UIDL.  RFC 1939 limits
+   UIDLs to 70 printable characters.  Unique names that do not fit are
+   left to the generic code.  */
+static int
+maildir_message_uidl (mu_message_t msg, char **puidl)
+{
+  struct _maildir_message *mp = mu_message_get_owner (msg);
+  size_t i;
+  
+  if (mp->uniq_len == 0 || mp->uniq_len > MU_UIDL_LENGTH)
+    return MU_ERR_NOENT;
+  for (i = 0; i < mp->uniq_len; i++)
+    if (!(mp->file_name[i] > ' ' && mp->file_name[i] < 127))
+      return MU_ERR_NOENT;
+  *puidl = malloc (mp->uniq_len + 1);
+  if (!*puidl)
+    return ENOMEM;
+  memcpy (*puidl, mp->file_name, mp->uniq_len);
+  (*puidl)[mp->uniq_len] = 0;
+  return 0;
+}
+
 static int
 maildir_remove (struct _amd_data *amd)
 {
@@ -1718,6 +1811,33 @@ maildir_chattr_msg (struct _amd_message *amsg, int expunge)
   return rc;
 }
 
+/* If the message file NAME has the size attribute (",S=<size>"),
+   store its value in *PSIZE and return 0.  Otherwise, return
+   MU_ERR_NOENT. */
+static int
+maildir_name_size (char const *name, off_t *psize)
+{
+  char const *end = strchr (name, ':');
+  char const *p;
+  size_t len = end ? end - name : strlen (name);
+
+  for (p = name; (p = memmem (p, len - (p - name), ",S=", 3)) != NULL;
+       p += 3)
+    {
+      char *q;
+      unsigned long long n;
+
+      errno = 0;
+      n = strtoull (p + 3, &q, 10);
+      if (errno == 0 && q > p + 3 && (*q == ',' || *q == ':' || *q == 0))
+	{
+	  *psize = n;
+	  return 0;
+	}
+    }
+  return MU_ERR_NOENT;
+}
+
 /* Compute size of the subdirectory SUBDIR.  Add the computed value to
    *PSIZE.
    Note: Maildir must be open. */
@@ -1743,7 +1863,9 @@ maildir_subdir_size (struct _maildir_data *md, int subdir, mu_off_t *psize)
 	  break;
 
 	default:
-	  if (fstatat (fd, entry->d_name, &st, 0))
+	  if (maildir_name_size (entry->d_name, &st.st_size) == 0)
+	    size += st.st_size;
+	  else if (fstatat (fd, entry->d_name, &st, 0))
 	    {
 	      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
 			("can't stat %s/%s/%s: %s",
@@ -1751,7 +1873,7 @@ maildir_subdir_size (struct _maildir_data *md, int subdir, mu_off_t *psize)
 			 mu_strerror (errno)));
 	      continue;
 	    }
-	  if (S_ISREG (st.st_mode))
+	  else if (S_ISREG (st.st_mode))
 	    size += st.st_size;
 	}
     }
@@ -1800,6 +1922,56 @@ maildir_size (mu_mailbox_t mailbox, mu_off_t *psize)
   return rc;
 }
 
+/* Count messages in the subdirectory SUBDIR.  Add the computed value
+   to *PCOUNT.
+   Note: Maildir must be open. */
+static int
+maildir_subdir_count (struct _maildir_data *md, int subdir, size_t *pcount)
+{
+  int fd;
+  DIR *dir;
+  struct dirent *entry;
+  int rc;
+  size_t count = 0;
+
+  rc = maildir_subdir_open (md, subdir, &dir, &fd);
+  if (rc)
+    return rc;
+
+  while ((entry = readdir (dir)))
+    {
+      if (entry->d_name[0] != '.')
+	count++;
+    }
+
+  closedir (dir);
+  *pcount += count;
+
+  return 0;
+}
+
+static int
+maildir_count (struct _amd_data *amd, size_t *pcount)
+{
+  struct _maildir_data *md = (struct _maildir_data *) amd;
+  size_t count = 0;
+  int rc;
+
+  rc = maildir_open (md);
+  if (rc == 0)
+    {
+      rc = maildir_subdir_count (md, SUB_NEW, &count);
+      if (rc == 0)
+	{
+	  rc = maildir_subdir_count (md, SUB_CUR, &count);
+	  if (rc == 0)
+	    *pcount = count;
+	}
+      maildir_close (md);
+    }
+  return rc;
+}
+
 /* Delivery to "dir/new" */
 #define NTRIES 30
 
@@ -1880,10 +2052,13 @@ _mailbox_maildir_init (mu_mailbox_t mailbox)
   amd->qfetch = maildir_qfetch;
   amd->msg_cmp = maildir_message_cmp;
   amd->message_uid = maildir_message_uid;
+  amd->message_uidl = maildir_message_uidl;
   amd->remove = maildir_remove;
   amd->chattr_msg = maildir_chattr_msg;
   amd->capabilities = MU_AMD_STATUS;
   amd->mailbox_size = maildir_size;
+  amd->mailbox_mtime = maildir_mtime;
+  amd->mailbox_count = maildir_count;
   
   /* Set our properties.  */
   {
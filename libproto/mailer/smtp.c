@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <signal.h>
 #include <netinet/in.h>
 
 #include <mailutils/nls.h>
@@ -50,6 +51,7 @@
 #include <mailutils/cstr.h>
 #include <mailutils/sockaddr.h>
 #include <mailutils/sys/mailer.h>
+#include <mailutils/sys/smtp.h>
 #include <mailutils/sys/url.h>
 #include <mailutils/sys/registrar.h>
 
@@ -123,6 +125,9 @@ struct _smtp_mailer
 
   enum mailer_tls tls;
   int auth:1;
+  int pipelining:1;             /* Use PIPELINING if offered */
+  int chunking:1;               /* Use CHUNKING if offered */
+  size_t msgcount;              /* Messages sent over this connection */
 };
 
 static void
@@ -171,6 +176,8 @@ _mailer_smtp_init_late (mu_mailer_t mailer)
     return 0;
   
   smp->auth = DFLAUTH;
+  smp->pipelining = 1;
+  smp->chunking = 1;
   
   rc = mu_url_sget_scheme (mailer->url, &scheme);
   if (rc == 0 && strcmp (scheme, "smtps") == 0) 
@@ -206,6 +213,10 @@ _mailer_smtp_init_late (mu_mailer_t mailer)
 	    smp->tls = MAILER_TLS_NONE;
 	  else if (strcmp (parmv[i], "noauth") == 0)
 	    smp->auth = 0;
+	  else if (strcmp (parmv[i], "nopipelining") == 0)
+	    smp->pipelining = 0;
+	  else if (strcmp (parmv[i], "nochunking") == 0)
+	    smp->chunking = 0;
 	  else if (strncmp (parmv[i], "auth=", 5) == 0)
 	    smtp_mailer_add_auth_mech (smp, parmv[i] + 5);
 	  else if (strncmp (parmv[i], "domain=", 7) == 0)
@@ -218,6 +229,75 @@ _mailer_smtp_init_late (mu_mailer_t mailer)
   return 0;
 }
 
+/* Connection caching */
+
+/* A cached connection could have been dropped by the server while
+   idle.  Make sure that talking to it does not kill the program. */
+static void
+sigpipe_ignore (struct sigaction *oldact)
+{
+  struct sigaction act;
+
+  act.sa_handler = SIG_IGN;
+  sigemptyset (&act.sa_mask);
+  act.sa_flags = 0;
+  sigaction (SIGPIPE, &act, oldact);
+}
+
+static void
+sigpipe_restore (struct sigaction *oldact)
+{
+  sigaction (SIGPIPE, oldact, NULL);
+}
+
+/* Shut down the cached connection DATA. */
+static void
+smtp_conn_free (void *data)
+{
+  mu_smtp_t smtp = data;
+  struct sigaction oldact;
+
+  sigpipe_ignore (&oldact);
+  mu_smtp_quit (smtp);
+  mu_smtp_destroy (&smtp);
+  sigpipe_restore (&oldact);
+}
+
+/* Try to reuse a cached connection for MAILER.  The connection is
+   usable if the server accepts RSET on it. */
+static int
+smtp_open_cached (mu_mailer_t mailer)
+{
+  struct _smtp_mailer *smp = mailer->data;
+  void *conn;
+  size_t count;
+  struct sigaction oldact;
+  int rc;
+
+  while (_mu_mailer_cache_get (mailer->url, &conn, &count) == 0)
+    {
+      mu_smtp_t smtp = conn;
+
+      sigpipe_ignore (&oldact);
+      rc = mu_smtp_rset (smtp);
+      if (rc)
+	{
+	  mu_debug (MU_DEBCAT_MAILER, MU_DEBUG_TRACE1,
+		    ("cached connection not usable: %s", mu_strerror (rc)));
+	  mu_smtp_destroy (&smtp);
+	}
+      sigpipe_restore (&oldact);
+      if (rc == 0)
+	{
+	  mu_smtp_destroy (&smp->smtp);
+	  smp->smtp = smtp;
+	  smp->msgcount = count;
+	  return 0;
+	}
+    }
+  return MU_ERR_NOENT;
+}
+
 static int
 smtp_open (mu_mailer_t mailer, int flags)
 {
@@ -227,6 +307,10 @@ smtp_open (mu_mailer_t mailer, int flags)
   struct mu_sockaddr_hints hints;
   mu_stream_t transport;
 
+  if (smtp_open_cached (mailer) == 0)
+    return 0;
+  smtp_mailer->msgcount = 0;
+  
   rc = _mailer_smtp_init_late (mailer);
   if (rc)
     return rc;
@@ -315,6 +399,13 @@ smtp_open (mu_mailer_t mailer, int flags)
       if (rc)
 	return rc;
     }
+
+  /* Use the extensions, if the server supports them.  Failures are
+     not fatal: the message will be sent in lock-step mode. */
+  if (smtp_mailer->pipelining)
+    mu_smtp_pipelining (smtp_mailer->smtp, MU_SMTP_TRACE_SET);
+  if (smtp_mailer->chunking)
+    mu_smtp_chunking (smtp_mailer->smtp, MU_SMTP_TRACE_SET);
   
   return 0;
 }
@@ -338,7 +429,19 @@ smtp_close (mu_mailer_t mailer)
 {
   struct _smtp_mailer *smp = mailer->data;
   mu_smtp_t smtp = smp->smtp;  
-  int rc = mu_smtp_quit (smtp);
+  int rc;
+
+  /* Keep a healthy connection open for reuse */
+  if (smtp && smtp->state == MU_SMTP_MAIL
+      && !MU_SMTP_FISSET (smtp, _MU_SMTP_ERR)
+      && _mu_mailer_cache_put (mailer->url, smtp, smp->msgcount,
+			       smtp_conn_free) == 0)
+    {
+      smp->smtp = NULL;
+      return 0;
+    }
+  
+  rc = mu_smtp_quit (smtp);
   if (rc == 0)
     {
       mu_smtp_set_carrier (smtp, NULL);
@@ -602,13 +705,19 @@ smtp_send_message (mu_mailer_t mailer, mu_message_t msg,
       mu_message_get_streamref (msg, &str);
       status = mu_smtp_send_stream (smtp, str);
       mu_stream_destroy (&str);
+      /* With pipelining, rejection of the sender or all recipients is
+	 reported here */
+      if (status == MU_ERR_REPLY)
+	mu_smtp_rset (smtp);
     }
   mu_address_destroy (&smp->rcpt_to);
   mu_address_destroy (&smp->rcpt_bcc);
   if (status == 0)
     {
       status = mu_smtp_dot (smtp);
-      if (status == MU_ERR_REPLY)
+      if (status == 0)
+	smp->msgcount++;
+      else if (status == MU_ERR_REPLY)
 	mu_smtp_rset (smtp);
     }
   return status;
@@ -0,0 +1,198 @@
+/* GNU Mailutils -- a suite of utilities for electronic mail
+   Copyright (C) 2010-2022 Free Software Foundation, Inc.
+
+   This library is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with GNU Mailutils.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Support for the CHUNKING (RFC 3030) extension.
+
+   When chunking is enabled, the message is sent in a series of BDAT
+   commands instead of DATA.  The payload is passed verbatim, so
+   dot-stuffing is not needed.  The bdat stream collects the message
+   in chunks of BDAT_CHUNK_SIZE bytes and sends each of them to the
+   server as soon as more data arrive.  The remaining data are sent
+   with the "LAST" flag when the stream is closed.
+
+   If pipelining is in effect, up to BDAT_MAX_PENDING chunks can be
+   sent without waiting for the reply.  Otherwise, the reply to each
+   chunk is read before sending the next one.  The reply to the last
+   chunk is read by mu_smtp_dot. */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mailutils/errno.h>
+#include <mailutils/filter.h>
+#include <mailutils/smtp.h>
+#include <mailutils/stream.h>
+#include <mailutils/sys/stream.h>
+#include <mailutils/sys/smtp.h>
+
+#define BDAT_CHUNK_SIZE (64*1024)
+#define BDAT_MAX_PENDING 16
+
+struct _mu_bdat_stream
+{
+  struct _mu_stream stream;
+  mu_smtp_t smtp;
+  char *buf;                 /* Chunk buffer */
+  size_t level;              /* Number of bytes in buf */
+};
+
+/* Read replies to the outstanding BDAT commands, until no more than
+   MAX of them remain unacknowledged.  Return MU_ERR_REPLY if any of
+   the chunks sent so far has been rejected. */
+int
+_mu_smtp_bdat_sync (mu_smtp_t smtp, size_t max)
+{
+  int status;
+
+  if (smtp->bdat_pending > max)
+    {
+      status = mu_stream_flush (smtp->carrier);
+      MU_SMTP_CHECK_ERROR (smtp, status);
+      for (; smtp->bdat_pending > max; smtp->bdat_pending--)
+	{
+	  status = mu_smtp_response (smtp);
+	  MU_SMTP_CHECK_ERROR (smtp, status);
+	  if (smtp->replcode[0] != '2')
+	    smtp->bdat_failed = 1;
+	}
+    }
+  return smtp->bdat_failed ? MU_ERR_REPLY : 0;
+}
+
+static int
+bdat_send_chunk (struct _mu_bdat_stream *bs, int last)
+{
+  mu_smtp_t smtp = bs->smtp;
+  int status;
+  
+  status = mu_smtp_write (smtp, "BDAT %lu%s\r\n", (unsigned long) bs->level,
+			  last ? " LAST" : "");
+  MU_SMTP_CHECK_ERROR (smtp, status);
+  if (bs->level)
+    {
+      int xlev = _mu_smtp_xscript_level (smtp, smtp->bdat_xlev);
+      status = mu_stream_write (smtp->carrier, bs->buf, bs->level, NULL);
+      _mu_smtp_xscript_level (smtp, xlev);
+      MU_SMTP_CHECK_ERROR (smtp, status);
+      bs->level = 0;
+    }
+  smtp->bdat_pending++;
+  if (last)
+    {
+      status = mu_stream_flush (smtp->carrier);
+      MU_SMTP_CHECK_ERROR (smtp, status);
+      return 0;
+    }
+  return _mu_smtp_bdat_sync (smtp,
+			     MU_SMTP_FISSET (smtp, _MU_SMTP_PIPELINING)
+			       ? BDAT_MAX_PENDING : 0);
+}
+
+static int
+_bdat_write (mu_stream_t stream, const char *buf, size_t size, size_t *pret)
+{
+  struct _mu_bdat_stream *bs = (struct _mu_bdat_stream *) stream;
+  size_t total = 0;
+
+  while (size)
+    {
+      size_t n;
+      
+      if (bs->level == BDAT_CHUNK_SIZE)
+	{
+	  int rc = bdat_send_chunk (bs, 0);
+	  if (rc)
+	    return rc;
+	}
+      n = BDAT_CHUNK_SIZE - bs->level;
+      if (n > size)
+	n = size;
+      memcpy (bs->buf + bs->level, buf, n);
+      bs->level += n;
+      buf += n;
+      size -= n;
+      total += n;
+    }
+  *pret = total;
+  return 0;
+}
+
+static int
+_bdat_close (mu_stream_t stream)
+{
+  struct _mu_bdat_stream *bs = (struct _mu_bdat_stream *) stream;
+  int rc = 0;
+
+  if (!bs->smtp->bdat_failed)
+    rc = bdat_send_chunk (bs, 1);
+  _mu_smtp_data_end (bs->smtp);
+  return rc;
+}
+
+static void
+_bdat_done (mu_stream_t stream)
+{
+  struct _mu_bdat_stream *bs = (struct _mu_bdat_stream *) stream;
+  free (bs->buf);
+}
+
+static int
+_bdat_stream_create (mu_smtp_t smtp, struct _mu_bdat_stream **pbs)
+{
+  struct _mu_bdat_stream *bs;
+
+  bs = (struct _mu_bdat_stream *)
+	 _mu_stream_create (sizeof (*bs), MU_STREAM_WRITE | _MU_STR_OPEN);
+  if (!bs)
+    return ENOMEM;
+  bs->buf = malloc (BDAT_CHUNK_SIZE);
+  if (!bs->buf)
+    {
+      free (bs);
+      return ENOMEM;
+    }
+  bs->smtp = smtp;
+  bs->stream.write = _bdat_write;
+  bs->stream.close = _bdat_close;
+  bs->stream.done = _bdat_done;
+  *pbs = bs;
+  return 0;
+}
+
+/* Create a stream for writing the message to SMTP using BDAT.  The
+   returned stream converts line endings to CRLF.  Closing it
+   terminates the message. */
+int
+_mu_smtp_bdat_writer (mu_smtp_t smtp, mu_stream_t *pstream)
+{
+  struct _mu_bdat_stream *bs;
+  int status;
+
+  status = _bdat_stream_create (smtp, &bs);
+  if (status)
+    return status;
+  status = mu_filter_create (pstream, (mu_stream_t) bs, "CRLF",
+			     MU_FILTER_ENCODE, MU_STREAM_WRITE);
+  if (status)
+    /* Prevent the close method from sending the message */
+    smtp->bdat_failed = 1;
+  mu_stream_unref ((mu_stream_t) bs);
+  return status;
+}
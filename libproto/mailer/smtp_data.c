@@ -30,42 +30,36 @@
 #include <mailutils/sys/stream.h>
 #include <mailutils/sys/smtp.h>
 
+/* Switch the carrier to full buffering, saving its previous buffering
+   state. */
 int
-_mu_smtp_data_begin (mu_smtp_t smtp)
+_mu_smtp_buffer_full (mu_smtp_t smtp)
 {
   int status;
   
-  status = mu_smtp_write (smtp, "DATA\r\n");
-  MU_SMTP_CHECK_ERROR (smtp, status);
-  status = mu_smtp_response (smtp);
-  MU_SMTP_CHECK_ERROR (smtp, status);
-  
-  if (smtp->replcode[0] != '3')
-    return MU_ERR_REPLY;
-  
-  if (mu_smtp_trace_mask (smtp, MU_SMTP_TRACE_QRY, MU_XSCRIPT_PAYLOAD))
-    _mu_smtp_xscript_level (smtp, MU_XSCRIPT_PAYLOAD);
-
   smtp->savebuf.type = MU_TRANSPORT_OUTPUT;
-  if (mu_stream_ioctl (smtp->carrier, MU_IOCTL_TRANSPORT_BUFFER,
-		       MU_IOCTL_OP_GET, &smtp->savebuf) == 0)
+  status = mu_stream_ioctl (smtp->carrier, MU_IOCTL_TRANSPORT_BUFFER,
+			    MU_IOCTL_OP_GET, &smtp->savebuf);
+  if (status == 0)
     {
       struct mu_buffer_query newbuf;
       newbuf.type = MU_TRANSPORT_OUTPUT;
       newbuf.buftype = mu_buffer_full;
       newbuf.bufsize = 64*1024;
-      if (mu_stream_ioctl (smtp->carrier, MU_IOCTL_TRANSPORT_BUFFER,
-			   MU_IOCTL_OP_SET, &newbuf) == 0)
+      status = mu_stream_ioctl (smtp->carrier, MU_IOCTL_TRANSPORT_BUFFER,
+				MU_IOCTL_OP_SET, &newbuf);
+      if (status == 0)
 	MU_SMTP_FSET (smtp, _MU_SMTP_SAVEBUF);
     }
-  return 0;
+  return status;
 }
 
+/* Restore the buffering state saved by _mu_smtp_buffer_full. */
 int
-_mu_smtp_data_end (mu_smtp_t smtp)
+_mu_smtp_buffer_restore (mu_smtp_t smtp)
 {
   int status = 0;
-  /* code is always _MU_STR_EVENT_CLOSE */
+
   if (MU_SMTP_FISSET (smtp, _MU_SMTP_SAVEBUF))
     {
       status = mu_stream_ioctl (smtp->carrier, MU_IOCTL_TRANSPORT_BUFFER,
@@ -74,7 +68,68 @@ _mu_smtp_data_end (mu_smtp_t smtp)
 	mu_diag_output (MU_DIAG_NOTICE,
 			"failed to restore buffer state on SMTP carrier: %s",
 			mu_strerror (status));
+      MU_SMTP_FCLR (smtp, _MU_SMTP_SAVEBUF);
+    }
+  return status;
+}
+
+int
+_mu_smtp_data_begin (mu_smtp_t smtp)
+{
+  int status, rc;
+
+  if (MU_SMTP_FISSET (smtp, _MU_SMTP_CHUNKING))
+    {
+      /* The message will be sent in BDAT chunks.  There is no DATA
+	 command, so the pipelined replies must be read first. */
+      status = _mu_smtp_pipeline_sync (smtp);
+      if (status)
+	return status;
+      MU_SMTP_FSET (smtp, _MU_SMTP_BDAT);
+      smtp->bdat_failed = 0;
+      smtp->bdat_xlev = MU_XSCRIPT_NORMAL;
+      if (mu_smtp_trace_mask (smtp, MU_SMTP_TRACE_QRY, MU_XSCRIPT_PAYLOAD))
+	smtp->bdat_xlev = MU_XSCRIPT_PAYLOAD;
+      _mu_smtp_buffer_full (smtp);
+      return 0;
+    }
+  
+  status = mu_smtp_write (smtp, "DATA\r\n");
+  MU_SMTP_CHECK_ERROR (smtp, status);
+  /* Flush pipelined MAIL and RCPT commands along with DATA */
+  rc = _mu_smtp_pipeline_sync (smtp);
+  if (rc && rc != MU_ERR_REPLY)
+    return rc;
+  status = mu_smtp_response (smtp);
+  MU_SMTP_CHECK_ERROR (smtp, status);
+  
+  if (smtp->replcode[0] != '3')
+    return MU_ERR_REPLY;
+
+  if (rc)
+    {
+      /* The server accepted DATA although the transaction failed.
+	 Send an empty message to terminate it. */
+      status = mu_smtp_write (smtp, ".\r\n");
+      MU_SMTP_CHECK_ERROR (smtp, status);
+      status = mu_smtp_response (smtp);
+      MU_SMTP_CHECK_ERROR (smtp, status);
+      return rc;
     }
+  
+  if (mu_smtp_trace_mask (smtp, MU_SMTP_TRACE_QRY, MU_XSCRIPT_PAYLOAD))
+    _mu_smtp_xscript_level (smtp, MU_XSCRIPT_PAYLOAD);
+
+  _mu_smtp_buffer_full (smtp);
+  return 0;
+}
+
+int
+_mu_smtp_data_end (mu_smtp_t smtp)
+{
+  int status;
+  /* code is always _MU_STR_EVENT_CLOSE */
+  status = _mu_smtp_buffer_restore (smtp);
   _mu_smtp_xscript_level (smtp, MU_XSCRIPT_NORMAL);
   smtp->state = MU_SMTP_DOT;
   return status;
@@ -105,6 +160,10 @@ mu_smtp_data (mu_smtp_t smtp, mu_stream_t *pstream)
   if (status)
     return status;
 
+  if (MU_SMTP_FISSET (smtp, _MU_SMTP_BDAT))
+    /* BDAT chunks need no dot-stuffing */
+    return _mu_smtp_bdat_writer (smtp, pstream);
+  
   status = mu_filter_create (&input, smtp->carrier, "CRLFDOT",
 			     MU_FILTER_ENCODE, MU_STREAM_WRITE);
   if (status)
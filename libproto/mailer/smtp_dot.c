@@ -39,6 +39,16 @@ mu_smtp_dot (mu_smtp_t smtp)
     return MU_ERR_FAILURE;
   if (smtp->state != MU_SMTP_DOT)
     return MU_ERR_SEQ;
+  if (MU_SMTP_FISSET (smtp, _MU_SMTP_BDAT))
+    {
+      /* Read replies to the outstanding chunks.  The reply to the
+	 last one concludes the transaction. */
+      MU_SMTP_FCLR (smtp, _MU_SMTP_BDAT);
+      status = _mu_smtp_bdat_sync (smtp, 0);
+      if (status == 0 || status == MU_ERR_REPLY)
+	smtp->state = MU_SMTP_MAIL;
+      return status;
+    }
   status = mu_smtp_response (smtp);
   MU_SMTP_CHECK_ERROR (smtp, status);
   if (smtp->replcode[0] != '2')
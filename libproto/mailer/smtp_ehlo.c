@@ -105,6 +105,8 @@ mu_smtp_ehlo (mu_smtp_t smtp)
   MU_SMTP_CHECK_ERROR (smtp, status);
   status = mu_smtp_response (smtp);
   MU_SMTP_CHECK_ERROR (smtp, status);
+  /* The set of extensions may have changed */
+  MU_SMTP_FCLR (smtp, _MU_SMTP_PIPELINING | _MU_SMTP_CHUNKING);
   if (smtp->replcode[0] == '2')
     {
       smtp->flags |= _MU_SMTP_ESMTP;
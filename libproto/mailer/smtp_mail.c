@@ -41,6 +41,8 @@ mu_smtp_mail_basic (mu_smtp_t smtp, const char *email, const char *fmt, ...)
     return MU_ERR_FAILURE;
   if (smtp->state != MU_SMTP_MAIL)
     return MU_ERR_SEQ;
+  if (MU_SMTP_FISSET (smtp, _MU_SMTP_PIPELINING))
+    _mu_smtp_pipeline_start (smtp);
   status = mu_smtp_write (smtp, "MAIL FROM:<%s>", email);
   MU_SMTP_CHECK_ERROR (smtp, status);
   if (fmt)
@@ -55,11 +57,17 @@ mu_smtp_mail_basic (mu_smtp_t smtp, const char *email, const char *fmt, ...)
     }
   status = mu_smtp_write (smtp, "\r\n");
   MU_SMTP_CHECK_ERROR (smtp, status);
-  status = mu_smtp_response (smtp);
-  MU_SMTP_CHECK_ERROR (smtp, status);
+  if (MU_SMTP_FISSET (smtp, _MU_SMTP_PIPELINING))
+    /* The reply will be read by _mu_smtp_pipeline_sync */
+    smtp->pipe_mail = 1;
+  else
+    {
+      status = mu_smtp_response (smtp);
+      MU_SMTP_CHECK_ERROR (smtp, status);
 
-  if (smtp->replcode[0] != '2')
-    return MU_ERR_REPLY;
+      if (smtp->replcode[0] != '2')
+	return MU_ERR_REPLY;
+    }
 
   smtp->state = MU_SMTP_RCPT;
   return 0;
@@ -0,0 +1,144 @@
+/* GNU Mailutils -- a suite of utilities for electronic mail
+   Copyright (C) 2010-2022 Free Software Foundation, Inc.
+
+   This library is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with GNU Mailutils.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Support for the PIPELINING (RFC 2920) extension.
+
+   When pipelining is enabled, mu_smtp_mail_basic and mu_smtp_rcpt_basic
+   don't wait for the server reply.  The commands are accumulated in
+   the carrier output buffer and sent to the server together with
+   the DATA command (or before the first BDAT chunk, if chunking is
+   in effect), after which the pending replies are read in order by
+   _mu_smtp_pipeline_sync. */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mailutils/errno.h>
+#include <mailutils/smtp.h>
+#include <mailutils/stream.h>
+#include <mailutils/sys/smtp.h>
+
+static int
+_smtp_ext_op (mu_smtp_t smtp, int op, const char *capa, int flag)
+{
+  if (!smtp)
+    return EINVAL;
+  switch (op)
+    {
+    case MU_SMTP_TRACE_SET:
+      if (smtp->state != MU_SMTP_MAIL && smtp->state != MU_SMTP_EHLO)
+	return MU_ERR_SEQ;
+      if (mu_smtp_capa_test (smtp, capa, NULL))
+	return ENOSYS;
+      MU_SMTP_FSET (smtp, flag);
+      break;
+
+    case MU_SMTP_TRACE_CLR:
+      if (smtp->state != MU_SMTP_MAIL && smtp->state != MU_SMTP_EHLO)
+	return MU_ERR_SEQ;
+      MU_SMTP_FCLR (smtp, flag);
+      break;
+
+    case MU_SMTP_TRACE_QRY:
+      if (!MU_SMTP_FISSET (smtp, flag))
+	return MU_ERR_NOENT;
+      break;
+
+    default:
+      return EINVAL;
+    }
+  return 0;
+}
+
+int
+mu_smtp_pipelining (mu_smtp_t smtp, int op)
+{
+  return _smtp_ext_op (smtp, op, "PIPELINING", _MU_SMTP_PIPELINING);
+}
+
+int
+mu_smtp_chunking (mu_smtp_t smtp, int op)
+{
+  return _smtp_ext_op (smtp, op, "CHUNKING", _MU_SMTP_CHUNKING);
+}
+
+/* Prepare the carrier for accumulating pipelined commands. */
+void
+_mu_smtp_pipeline_start (mu_smtp_t smtp)
+{
+  if (!MU_SMTP_FISSET (smtp, _MU_SMTP_SAVEBUF))
+    _mu_smtp_buffer_full (smtp);
+}
+
+/* Send the pipelined commands to the server and read their replies.
+   Return 0 if the sender and at least one recipient have been
+   accepted, MU_ERR_REPLY if not, and error code on I/O errors. */
+int
+_mu_smtp_pipeline_sync (mu_smtp_t smtp)
+{
+  int status;
+  int rc = 0;
+  size_t accepted = 0;
+
+  if (MU_SMTP_FISSET (smtp, _MU_SMTP_SAVEBUF))
+    {
+      status = mu_stream_flush (smtp->carrier);
+      MU_SMTP_CHECK_ERROR (smtp, status);
+      _mu_smtp_buffer_restore (smtp);
+    }
+
+  if (!smtp->pipe_mail && !smtp->pipe_rcpt)
+    return 0;
+  
+  if (smtp->pipe_mail)
+    {
+      smtp->pipe_mail = 0;
+      status = mu_smtp_response (smtp);
+      MU_SMTP_CHECK_ERROR (smtp, status);
+      if (smtp->replcode[0] != '2')
+	rc = MU_ERR_REPLY;
+    }
+
+  for (; smtp->pipe_rcpt; smtp->pipe_rcpt--)
+    {
+      status = mu_smtp_response (smtp);
+      MU_SMTP_CHECK_ERROR (smtp, status);
+      if (smtp->replcode[0] == '2')
+	accepted++;
+    }
+
+  if (accepted == 0)
+    rc = MU_ERR_REPLY;
+  return rc;
+}
+
+/* Read and discard any pending replies. */
+int
+_mu_smtp_pipeline_drain (mu_smtp_t smtp)
+{
+  int status = _mu_smtp_pipeline_sync (smtp);
+  if (status == MU_ERR_REPLY)
+    status = 0;
+  if (status == 0)
+    status = _mu_smtp_bdat_sync (smtp, 0);
+  if (status == MU_ERR_REPLY)
+    status = 0;
+  return status;
+}
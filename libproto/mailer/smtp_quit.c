@@ -39,6 +39,9 @@ mu_smtp_quit (mu_smtp_t smtp)
     return MU_ERR_FAILURE;
   if (smtp->state == MU_SMTP_CLOS)
     return 0;
+  status = _mu_smtp_pipeline_drain (smtp);
+  MU_SMTP_CHECK_ERROR (smtp, status);
+  MU_SMTP_FCLR (smtp, _MU_SMTP_BDAT);
   status = mu_smtp_write (smtp, "QUIT\r\n");
   MU_SMTP_CHECK_ERROR (smtp, status);
   status = mu_smtp_response (smtp);
@@ -37,6 +37,14 @@ mu_smtp_rset (mu_smtp_t smtp)
     return EINVAL;
   if (MU_SMTP_FISSET (smtp, _MU_SMTP_ERR))
     return MU_ERR_FAILURE;
+  status = _mu_smtp_pipeline_drain (smtp);
+  MU_SMTP_CHECK_ERROR (smtp, status);
+  if (MU_SMTP_FISSET (smtp, _MU_SMTP_BDAT))
+    {
+      /* Abandoned BDAT transfer */
+      MU_SMTP_FCLR (smtp, _MU_SMTP_BDAT);
+      smtp->state = MU_SMTP_MAIL;
+    }
   status = mu_smtp_write (smtp, "RSET\r\n");
   MU_SMTP_CHECK_ERROR (smtp, status);
   status = mu_smtp_response (smtp);
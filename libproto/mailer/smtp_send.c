@@ -41,6 +41,24 @@ _smtp_data_send (mu_smtp_t smtp, mu_stream_t stream)
   return status;
 }
 
+/* Send STREAM using BDAT */
+static int
+_smtp_bdat_send (mu_smtp_t smtp, mu_stream_t stream)
+{
+  mu_stream_t output;
+  int status = mu_smtp_data (smtp, &output);
+
+  if (status)
+    return status;
+  status = mu_stream_copy (output, stream, 0, NULL);
+  if (status)
+    /* Don't send the incomplete message */
+    smtp->bdat_failed = 1;
+  else
+    status = mu_stream_close (output);
+  mu_stream_destroy (&output);
+  return status;
+}
 
 int
 mu_smtp_send_stream (mu_smtp_t smtp, mu_stream_t stream)
@@ -55,6 +73,9 @@ mu_smtp_send_stream (mu_smtp_t smtp, mu_stream_t stream)
   if (smtp->state != MU_SMTP_MORE)
     return MU_ERR_SEQ;
 
+  if (MU_SMTP_FISSET (smtp, _MU_SMTP_CHUNKING))
+    return _smtp_bdat_send (smtp, stream);
+  
   status = mu_filter_create (&input, stream, "CRLFDOT", MU_FILTER_ENCODE,
 			     MU_STREAM_READ);
   if (status)
@@ -4,7 +4,7 @@
  *           transactions
  *
  * SYNOPSIS
- *   sendm MAILER_URL FILE RCPT [RCPT...]
+ *   sendm [-c SIZE] [-m MAX] [-x SPEC] MAILER_URL FILE RCPT [RCPT...]
  *
  * DESCRIPTION
  *   Creates a mailer as requested by MAILER_URL.  Reads email message
@@ -13,6 +13,12 @@
  *
  *   A new transaction is opened for each message.
  *
+ * OPTIONS
+ *   -c SIZE   Set the size of the mailer connection cache.
+ *   -m MAX    Set maximum number of messages sent over a cached
+ *             connection.
+ *   -x SPEC   Set debugging level.
+ *
  * LICENCE
  *   Copyright (C) 2020 Free Software Foundation, inc.
  *   License GPLv3+: GNU GPL version 3 or later
@@ -21,6 +27,8 @@
  *   There is NO WARRANTY, to the extent permitted by law.
  */
 #include <config.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include <mailutils/mailutils.h>
 
 int
@@ -38,6 +46,29 @@ main (int argc, char **argv)
   mu_set_program_name (argv[0]);
   mu_register_all_mailer_formats ();
 
+  while ((rc = getopt (argc, argv, "c:m:x:")) != EOF)
+    {
+      switch (rc)
+	{
+	case 'c':
+	  mu_mailer_cache_size = strtoul (optarg, NULL, 10);
+	  break;
+
+	case 'm':
+	  mu_mailer_cache_max_messages = strtoul (optarg, NULL, 10);
+	  break;
+
+	case 'x':
+	  mu_debug_parse_spec (optarg);
+	  break;
+
+	default:
+	  abort ();
+	}
+    }
+  argc -= optind - 1;
+  argv += optind - 1;
+  
   if (argc < 4)
     abort ();
   mailer_url = argv[1];
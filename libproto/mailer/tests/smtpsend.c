@@ -31,7 +31,7 @@ static char usage_text[] =
 "                   [family=4|6] [domain=STRING] [user=STRING] [pass=STRING]\n"
 "                   [service=STRING] [realm=STRING] [host=STRING]\n"
 "                   [auth=method[,...]] [url=STRING] [input=FILE] [raw=N]\n"
-"                   [skiphdr=name[,...]]\n";
+"                   [skiphdr=name[,...]] [pipelining=N] [chunking=N]\n";
 
 static void
 usage ()
@@ -90,6 +90,8 @@ main (int argc, char **argv)
   char *port = NULL;
   int tls = 0;
   int raw = 1;
+  int pipelining = 0;
+  int chunking = 0;
   int flags = 0;
   mu_stream_t stream;
   mu_smtp_t smtp;
@@ -180,6 +182,10 @@ main (int argc, char **argv)
 	infile = argv[i] + 6;
       else if (strncmp (argv[i], "raw=", 4) == 0)
 	raw = atoi (argv[i] + 4);
+      else if (strncmp (argv[i], "pipelining=", 11) == 0)
+	pipelining = atoi (argv[i] + 11);
+      else if (strncmp (argv[i], "chunking=", 9) == 0)
+	chunking = atoi (argv[i] + 9);
       else if (strncmp (argv[i], "rcpt=", 5) == 0)
 	{
 	  if (!rcpt_list)
@@ -271,6 +277,11 @@ main (int argc, char **argv)
 	  exit (1);
 	}
     }
+
+  if (pipelining)
+    MU_ASSERT (mu_smtp_pipelining (smtp, MU_SMTP_TRACE_SET));
+  if (chunking)
+    MU_ASSERT (mu_smtp_chunking (smtp, MU_SMTP_TRACE_SET));
   
   MU_ASSERT (mu_smtp_mail_basic (smtp, from, NULL));
   mu_list_foreach (rcpt_list, send_rcpt_command, smtp);
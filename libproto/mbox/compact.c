@@ -0,0 +1,611 @@
+/* GNU Mailutils -- a suite of utilities for electronic mail
+   Copyright (C) 2022 Free Software Foundation, Inc.
+
+   This library is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with GNU Mailutils.  If not, see <http://www.gnu.org/licenses/>. */
+
+/*
+ * In-place compaction of mboxrd mailboxes.
+ *
+ * When messages are expunged from a mailbox and the rest of it is left
+ * intact, there is no need to rewrite it entirely.  Instead, the
+ * surviving message ranges that follow the first deleted message are
+ * moved towards the beginning of the file and the file is truncated.
+ *
+ * Each move is described by its source offset, destination offset
+ * (always less than the source) and length.  Data are copied in large
+ * blocks, from lower offsets to higher ones.
+ * Before starting, the list of moves is saved in a journal file, located
+ * next to the mailbox: the journal of "/var/mail/smith" is
+ * "/var/mail/.smith.mujournal".  The journal header keeps the progress
+ * indicator: the number of the move being carried out and the number of
+ * bytes of it that have been copied.
+ *
+ * If the process is interrupted, the compaction is rolled forward the
+ * next time the mailbox is opened for writing.  Restarting the copy from
+ * the recorded position is safe as long as the source data past that
+ * position are intact.  The progress indicator is updated before writing
+ * a block that would overwrite them.  When the distance between the
+ * source and destination is less than the block size, writing a block
+ * overwrites its own source.  Such a block is saved in the journal
+ * before being written, and the progress indicator records it as
+ * pending, so that it is written out again on recovery.  Two journal
+ * slots are used alternately for pending blocks, so that the block
+ * referred to by the progress indicator is never overwritten.
+ *
+ * Writes are ordered using fdatasync.  The journal is flushed to disk,
+ * and its directory entry is synchronized, before the mailbox is
+ * modified.  Before the progress indicator is advanced, the mailbox data
+ * written so far are flushed.  A pending block is flushed to the journal
+ * before the progress indicator refers to it, and the progress indicator
+ * is flushed before the mailbox data it protects are overwritten.  The
+ * mailbox is flushed once more before it is truncated and again before
+ * the journal is removed.  Thus, the compaction can be completed after
+ * a system crash or power loss as well, provided that the storage
+ * honors the flush requests.
+ *
+ * The journal is replayed only if it is owned by the mailbox owner or
+ * the current user and is not writable by others, and if all moves it
+ * describes lie within the mailbox.
+ *
+ * The journal is stored in native byte order.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <libgen.h>
+#include <mailutils/sys/mboxrd.h>
+#include <mailutils/sys/mailbox.h>
+#include <mailutils/diag.h>
+#include <mailutils/errno.h>
+#include <mailutils/locker.h>
+#include <mailutils/nls.h>
+#include <mailutils/util.h>
+
+#define MBOXRD_JOURNAL_MAGIC     "MUJNL"
+#define MBOXRD_JOURNAL_VERSION   2
+#define MBOXRD_JOURNAL_BYTEORDER 0x01020304
+#define MBOXRD_JOURNAL_SUFFIX    ".mujournal"
+
+/* Size of a block copied at once.  This can be changed by setting the
+   MU_MBOXRD_COMPACT_BLOCK environment variable (mostly for testing). */
+#define MBOXRD_COMPACT_BLOCK (1024*1024)
+/* Maximum block size accepted in a journal */
+#define MBOXRD_COMPACT_BLOCK_MAX (64*1024*1024)
+
+struct mboxrd_journal_progress
+{
+  uint64_t move;             /* Index of the move being carried out */
+  uint64_t offset;           /* Number of bytes of it copied so far */
+  uint64_t block;            /* Size of the pending block, or 0 */
+  uint64_t slot;             /* Journal slot keeping the pending block */
+};
+
+struct mboxrd_journal_header
+{
+  char magic[sizeof (MBOXRD_JOURNAL_MAGIC)];
+  uint16_t version;
+  uint32_t byteorder;
+  uint64_t dev;              /* Mailbox device and inode */
+  uint64_t ino;
+  uint64_t size;             /* Mailbox size before compaction */
+  uint64_t new_size;         /* Mailbox size after compaction */
+  uint64_t block_size;       /* Size of a block */
+  uint64_t move_count;       /* Number of move records that follow */
+  struct mboxrd_journal_progress progress;
+};
+
+struct mboxrd_journal_move
+{
+  uint64_t src;
+  uint64_t dst;
+  uint64_t len;
+};
+
+struct mu_mboxrd_journal
+{
+  char *name;                /* Journal file name */
+  int fd;                    /* Journal file descriptor */
+  int mbox_fd;               /* Mailbox file descriptor */
+  struct mboxrd_journal_header hdr;
+  struct mboxrd_journal_move *mv;
+};
+
+/* Offset of the Nth pending block slot in the journal JRN */
+#define JOURNAL_SLOT_OFFSET(jrn,n)					\
+  (sizeof ((jrn)->hdr) + (jrn)->hdr.move_count * sizeof ((jrn)->mv[0])	\
+   + (n) * (jrn)->hdr.block_size)
+
+static size_t
+mboxrd_compact_block (void)
+{
+  static size_t block_size = 0;
+  if (block_size == 0)
+    {
+      char *p = getenv ("MU_MBOXRD_COMPACT_BLOCK");
+      if (!p || mu_str_to_c (p, mu_c_hsize, &block_size, NULL)
+	  || block_size == 0 || block_size > MBOXRD_COMPACT_BLOCK_MAX)
+	block_size = MBOXRD_COMPACT_BLOCK;
+    }
+  return block_size;
+}
+
+/* If set, this function is called each time a block has been written to
+   the mailbox.  The testsuite uses it to interrupt the compaction. */
+void (*mu_mboxrd_compact_hook) (void);
+
+static int
+write_full (int fd, void const *buf, size_t size, off_t off)
+{
+  char const *p = buf;
+
+  while (size)
+    {
+      ssize_t n = pwrite (fd, p, size, off);
+      if (n < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return errno;
+	}
+      p += n;
+      off += n;
+      size -= n;
+    }
+  return 0;
+}
+
+static int
+read_full (int fd, void *buf, size_t size, off_t off)
+{
+  char *p = buf;
+
+  while (size)
+    {
+      ssize_t n = pread (fd, p, size, off);
+      if (n < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return errno;
+	}
+      if (n == 0)
+	return MU_ERR_PARSE;
+      p += n;
+      off += n;
+      size -= n;
+    }
+  return 0;
+}
+
+static int
+sync_data (int fd)
+{
+  if (fdatasync (fd))
+    return errno;
+  return 0;
+}
+
+/* Make sure the directory entry of the file NAME is on disk. */
+static int
+sync_dir (char const *name)
+{
+  char *dir;
+  int fd, rc = 0;
+
+  dir = strdup (name);
+  if (!dir)
+    return ENOMEM;
+  fd = open (dirname (dir), O_RDONLY);
+  free (dir);
+  if (fd == -1)
+    return errno;
+  /* Some file systems don't support synchronizing directories. */
+  if (fsync (fd) && errno != EINVAL)
+    rc = errno;
+  close (fd);
+  return rc;
+}
+
+static void
+journal_free (struct mu_mboxrd_journal *jrn)
+{
+  if (jrn->fd != -1)
+    close (jrn->fd);
+  if (jrn->mbox_fd != -1)
+    close (jrn->mbox_fd);
+  free (jrn->mv);
+  free (jrn->name);
+  free (jrn);
+}
+
+static struct mu_mboxrd_journal *
+journal_alloc (struct mu_mboxrd_mailbox *dmp)
+{
+  struct mu_mboxrd_journal *jrn = calloc (1, sizeof (*jrn));
+  if (!jrn)
+    return NULL;
+  jrn->fd = jrn->mbox_fd = -1;
+  jrn->name = mu_mboxrd_sidecar_name (dmp, MBOXRD_JOURNAL_SUFFIX);
+  if (!jrn->name)
+    {
+      free (jrn);
+      return NULL;
+    }
+  return jrn;
+}
+
+/* Save the progress indicator.  The mailbox data it covers are flushed
+   first, and the indicator itself is flushed before returning. */
+static int
+journal_save_progress (struct mu_mboxrd_journal *jrn)
+{
+  int rc;
+
+  if ((rc = sync_data (jrn->mbox_fd)) != 0
+      || (rc = write_full (jrn->fd, &jrn->hdr.progress,
+			   sizeof (jrn->hdr.progress),
+			   offsetof (struct mboxrd_journal_header, progress)))
+         != 0)
+    return rc;
+  return sync_data (jrn->fd);
+}
+
+/* Carry out the moves described in JRN, starting from the recorded
+   progress position, and truncate the mailbox. */
+static int
+journal_replay (struct mu_mboxrd_journal *jrn)
+{
+  char *buf;
+  int rc = 0;
+
+  buf = malloc (jrn->hdr.block_size);
+  if (!buf)
+    return ENOMEM;
+  while (jrn->hdr.progress.move < jrn->hdr.move_count)
+    {
+      struct mboxrd_journal_move *mv = &jrn->mv[jrn->hdr.progress.move];
+      uint64_t gap = mv->src - mv->dst;
+      uint64_t off = jrn->hdr.progress.offset;
+      uint64_t saved = off;
+
+      if (jrn->hdr.progress.block)
+	{
+	  /* Write out the block saved before the interruption. */
+	  size_t n = jrn->hdr.progress.block;
+	  if ((rc = read_full (jrn->fd, buf, n,
+			       JOURNAL_SLOT_OFFSET (jrn,
+						    jrn->hdr.progress.slot)))
+	      != 0
+	      || (rc = write_full (jrn->mbox_fd, buf, n, mv->dst + off)) != 0)
+	    break;
+	  off += n;
+	}
+
+      while (off < mv->len)
+	{
+	  size_t n = jrn->hdr.block_size;
+
+	  if (n > mv->len - off)
+	    n = mv->len - off;
+	  if ((rc = read_full (jrn->mbox_fd, buf, n, mv->src + off)) != 0)
+	    break;
+	  /*
+	   * Restarting from the saved position is safe as long as the
+	   * bytes written since then do not reach the source data at
+	   * that position.  Otherwise, save the progress.  If the block
+	   * overwrites its own source, save it as well.
+	   */
+	  if (off + n - saved > gap)
+	    {
+	      jrn->hdr.progress.offset = saved = off;
+	      if (n > gap)
+		{
+		  uint64_t slot = !jrn->hdr.progress.slot;
+		  if ((rc = write_full (jrn->fd, buf, n,
+					JOURNAL_SLOT_OFFSET (jrn, slot))) != 0
+		      || (rc = sync_data (jrn->fd)) != 0)
+		    break;
+		  jrn->hdr.progress.block = n;
+		  jrn->hdr.progress.slot = slot;
+		}
+	      else
+		jrn->hdr.progress.block = 0;
+	      if ((rc = journal_save_progress (jrn)) != 0)
+		break;
+	    }
+	  if ((rc = write_full (jrn->mbox_fd, buf, n, mv->dst + off)) != 0)
+	    break;
+	  if (mu_mboxrd_compact_hook)
+	    mu_mboxrd_compact_hook ();
+	  off += n;
+	}
+      if (rc)
+	break;
+      jrn->hdr.progress.move++;
+      jrn->hdr.progress.offset = 0;
+      jrn->hdr.progress.block = 0;
+      if ((rc = journal_save_progress (jrn)) != 0)
+	break;
+    }
+  free (buf);
+
+  if (rc == 0)
+    rc = sync_data (jrn->mbox_fd);
+  if (rc == 0 && ftruncate (jrn->mbox_fd, jrn->hdr.new_size))
+    rc = errno;
+  if (rc == 0)
+    rc = sync_data (jrn->mbox_fd);
+  if (rc == 0 && unlink (jrn->name))
+    rc = errno;
+  return rc;
+}
+
+/* Start in-place compaction of the mailbox DMP.  MV is an array of COUNT
+   moves, ordered by source offset.  SIZE is the size the mailbox will
+   have after compaction.  On success, the journal is written and its
+   handle is returned in *PJRN.  The mailbox remains unchanged until
+   mu_mboxrd_journal_run is called.  The caller must hold the mailbox
+   lock. */
+int
+mu_mboxrd_journal_begin (struct mu_mboxrd_mailbox *dmp,
+			 struct mu_mboxrd_move *mv, size_t count,
+			 mu_off_t size,
+			 struct mu_mboxrd_journal **pjrn)
+{
+  struct mu_mboxrd_journal *jrn;
+  struct stat st;
+  size_t i;
+  int rc;
+
+  jrn = journal_alloc (dmp);
+  if (!jrn)
+    return ENOMEM;
+
+  jrn->mv = calloc (count + 1, sizeof (jrn->mv[0]));
+  if (!jrn->mv)
+    {
+      journal_free (jrn);
+      return ENOMEM;
+    }
+  for (i = 0; i < count; i++)
+    {
+      if (mv[i].dst >= mv[i].src)
+	{
+	  journal_free (jrn);
+	  return EINVAL;
+	}
+      jrn->mv[i].src = mv[i].src;
+      jrn->mv[i].dst = mv[i].dst;
+      jrn->mv[i].len = mv[i].len;
+    }
+
+  jrn->mbox_fd = open (dmp->name, O_RDWR);
+  if (jrn->mbox_fd == -1 || fstat (jrn->mbox_fd, &st))
+    {
+      rc = errno;
+      journal_free (jrn);
+      return rc;
+    }
+
+  memset (&jrn->hdr, 0, sizeof (jrn->hdr));
+  memcpy (jrn->hdr.magic, MBOXRD_JOURNAL_MAGIC, sizeof (jrn->hdr.magic));
+  jrn->hdr.version = MBOXRD_JOURNAL_VERSION;
+  jrn->hdr.byteorder = MBOXRD_JOURNAL_BYTEORDER;
+  jrn->hdr.dev = st.st_dev;
+  jrn->hdr.ino = st.st_ino;
+  jrn->hdr.size = st.st_size;
+  jrn->hdr.new_size = size;
+  jrn->hdr.block_size = mboxrd_compact_block ();
+  jrn->hdr.move_count = count;
+
+  jrn->fd = open (jrn->name, O_WRONLY | O_CREAT | O_EXCL, 0600);
+  if (jrn->fd == -1)
+    {
+      rc = errno;
+      journal_free (jrn);
+      return rc;
+    }
+  rc = write_full (jrn->fd, &jrn->hdr, sizeof (jrn->hdr), 0);
+  if (rc == 0)
+    rc = write_full (jrn->fd, jrn->mv, count * sizeof (jrn->mv[0]),
+		     sizeof (jrn->hdr));
+  if (rc == 0)
+    rc = sync_data (jrn->fd);
+  if (rc == 0)
+    rc = sync_dir (jrn->name);
+  if (rc)
+    {
+      unlink (jrn->name);
+      journal_free (jrn);
+      return rc;
+    }
+
+  *pjrn = jrn;
+  return 0;
+}
+
+/* Carry out the compaction started by mu_mboxrd_journal_begin and free
+   JRN.  On error, the journal is left in place, so that the compaction
+   is completed next time the mailbox is opened. */
+int
+mu_mboxrd_journal_run (struct mu_mboxrd_journal *jrn)
+{
+  int rc = journal_replay (jrn);
+  if (rc)
+    mu_error (_("%s: in-place compaction failed: %s; "
+		"it will be resumed when the mailbox is opened next time"),
+	      jrn->name, mu_strerror (rc));
+  journal_free (jrn);
+  return rc;
+}
+
+/* Load the journal JRN of the mailbox DMP and check its consistency
+   with the mailbox.  JST is the status of the journal file. */
+static int
+journal_load (struct mu_mboxrd_mailbox *dmp, struct mu_mboxrd_journal *jrn,
+	      struct stat const *jst)
+{
+  struct stat st;
+  struct mboxrd_journal_progress *pr = &jrn->hdr.progress;
+  size_t size, i;
+  int rc;
+
+  rc = read_full (jrn->fd, &jrn->hdr, sizeof (jrn->hdr), 0);
+  if (rc)
+    return rc;
+  if (memcmp (jrn->hdr.magic, MBOXRD_JOURNAL_MAGIC, sizeof (jrn->hdr.magic))
+      || jrn->hdr.version != MBOXRD_JOURNAL_VERSION
+      || jrn->hdr.byteorder != MBOXRD_JOURNAL_BYTEORDER
+      || jrn->hdr.new_size > jrn->hdr.size
+      || jrn->hdr.block_size == 0
+      || jrn->hdr.block_size > MBOXRD_COMPACT_BLOCK_MAX
+      || pr->move > jrn->hdr.move_count
+      || jrn->hdr.move_count >= (SIZE_MAX - sizeof (jrn->hdr))
+                                  / sizeof (jrn->mv[0])
+      || jst->st_size < JOURNAL_SLOT_OFFSET (jrn, 0))
+    return MU_ERR_PARSE;
+  if (pr->block
+      && (pr->move == jrn->hdr.move_count
+	  || pr->block > jrn->hdr.block_size
+	  || pr->slot > 1
+	  || jst->st_size < JOURNAL_SLOT_OFFSET (jrn, pr->slot) + pr->block))
+    return MU_ERR_PARSE;
+
+  jrn->mbox_fd = open (dmp->name, O_RDWR);
+  if (jrn->mbox_fd == -1 || fstat (jrn->mbox_fd, &st))
+    return errno;
+  if (jrn->hdr.dev != st.st_dev || jrn->hdr.ino != st.st_ino)
+    return MU_ERR_NOENT;
+  if (st.st_size != jrn->hdr.size)
+    {
+      /* The mailbox has been truncated, but the journal was not
+	 removed. */
+      if (st.st_size == jrn->hdr.new_size)
+	{
+	  pr->move = jrn->hdr.move_count;
+	  pr->block = 0;
+	  return 0;
+	}
+      return MU_ERR_PARSE;
+    }
+
+  size = jrn->hdr.move_count * sizeof (jrn->mv[0]);
+  jrn->mv = malloc (size + sizeof (jrn->mv[0]));
+  if (!jrn->mv)
+    return ENOMEM;
+  rc = read_full (jrn->fd, jrn->mv, size, sizeof (jrn->hdr));
+  if (rc)
+    return rc;
+  /* Moves must lie within the mailbox, be ordered by their source
+     offsets and must not overlap. */
+  for (i = 0; i < jrn->hdr.move_count; i++)
+    {
+      struct mboxrd_journal_move *mv = &jrn->mv[i];
+      if (mv->dst >= mv->src
+	  || mv->len > jrn->hdr.size
+	  || mv->src > jrn->hdr.size - mv->len
+	  || mv->dst + mv->len > jrn->hdr.new_size
+	  || (i > 0
+	      && (mv->src < jrn->mv[i-1].src + jrn->mv[i-1].len
+		  || mv->dst < jrn->mv[i-1].dst + jrn->mv[i-1].len)))
+	return MU_ERR_PARSE;
+    }
+  if (pr->move < jrn->hdr.move_count
+      && pr->offset + pr->block > jrn->mv[pr->move].len)
+    return MU_ERR_PARSE;
+  return 0;
+}
+
+/* If the journal of the mailbox DMP exists, complete the interrupted
+   compaction.  Return 0 if the compaction has been completed,
+   MU_ERR_NOENT if there is no usable journal, and error code otherwise.
+   A journal that cannot be trusted is reported and ignored. */
+int
+mu_mboxrd_journal_recover (struct mu_mboxrd_mailbox *dmp)
+{
+  struct mu_mboxrd_journal *jrn;
+  mu_locker_t locker;
+  struct stat st, jst;
+  int rc;
+
+  jrn = journal_alloc (dmp);
+  if (!jrn)
+    return ENOMEM;
+  if (access (jrn->name, F_OK))
+    {
+      rc = errno == ENOENT ? MU_ERR_NOENT : errno;
+      journal_free (jrn);
+      return rc;
+    }
+
+  locker = dmp->mailbox->locker;
+  if (!locker)
+    {
+      rc = mu_locker_create_ext (&locker, dmp->name, NULL);
+      if (rc)
+	{
+	  journal_free (jrn);
+	  return rc;
+	}
+    }
+  rc = mu_locker_lock (locker);
+  if (rc == 0)
+    {
+      /* Another process might have completed the compaction meanwhile. */
+      if (stat (dmp->name, &st))
+	rc = errno;
+      else
+	rc = mu_sidecar_open (jrn->name, O_RDWR, st.st_uid, &jrn->fd, &jst);
+      if (rc == ENOENT)
+	rc = MU_ERR_NOENT;
+      else if (rc && rc != MU_ERR_NOENT)
+	{
+	  mu_diag_output (MU_DIAG_WARNING,
+			  _("%s: ignoring untrusted journal %s: %s"),
+			  dmp->name, jrn->name, mu_strerror (rc));
+	  rc = MU_ERR_NOENT;
+	}
+      else if (rc == 0)
+	{
+	  rc = journal_load (dmp, jrn, &jst);
+	  if (rc == MU_ERR_NOENT)
+	    {
+	      /* The journal refers to another file: it is stale. */
+	      unlink (jrn->name);
+	    }
+	  else if (rc == 0)
+	    {
+	      mu_diag_output (MU_DIAG_NOTICE,
+			      _("%s: completing interrupted compaction"),
+			      dmp->name);
+	      rc = journal_replay (jrn);
+	    }
+	  if (rc && rc != MU_ERR_NOENT)
+	    mu_error (_("%s: can't complete compaction using journal %s: %s"),
+		      dmp->name, jrn->name, mu_strerror (rc));
+	}
+      mu_locker_unlock (locker);
+    }
+  if (locker != dmp->mailbox->locker)
+    mu_locker_destroy (&locker);
+  journal_free (jrn);
+  return rc;
+}
@@ -0,0 +1,586 @@
+/* GNU Mailutils -- a suite of utilities for electronic mail
+   Copyright (C) 2022 Free Software Foundation, Inc.
+
+   This library is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with GNU Mailutils.  If not, see <http://www.gnu.org/licenses/>. */
+
+/*
+ * On-disk scan index for mboxrd mailboxes.
+ *
+ * Scanning a large mailbox requires reading it in its entirety.  To avoid
+ * this, the results of the scan can be saved in a sidecar file, located
+ * in the same directory as the mailbox and named after it: the index of
+ * the mailbox "/var/mail/smith" is "/var/mail/.smith.muidx".
+ *
+ * The index begins with a header, which identifies the mailbox state it
+ * describes (device, inode, size and modification time of the mailbox
+ * file, as well as a copy of its last bytes) and keeps the mailbox UID
+ * data.  The header is followed by an array of message records, one per
+ * message.
+ *
+ * The index is considered valid if the device and inode numbers of the
+ * mailbox match these in the header and either
+ *
+ *  1. its size and modification time are the same as recorded, or
+ *  2. it grew in size and its initial part still ends with the bytes
+ *     recorded in the header.
+ *
+ * In the latter case, the mailbox is assumed to have been appended to
+ * and only the newly added part is scanned.
+ *
+ * The index is stored in native byte order.  Any mismatch in format or
+ * byte order causes it to be silently ignored.  So does an index file
+ * that is not owned by the mailbox owner or the current user, or is
+ * writable by others, or whose records are not consistent with the
+ * mailbox: a full scan is done instead.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <mailutils/sys/mboxrd.h>
+#include <mailutils/sys/mailbox.h>
+#include <mailutils/diag.h>
+#include <mailutils/errno.h>
+#include <mailutils/stream.h>
+#include <mailutils/message.h>
+#include <mailutils/header.h>
+#include <mailutils/attribute.h>
+#include <mailutils/cstr.h>
+#include <mailutils/io.h>
+#include <mailutils/util.h>
+
+#define MBOXRD_INDEX_MAGIC     "MUIDX"
+#define MBOXRD_INDEX_VERSION   2
+#define MBOXRD_INDEX_BYTEORDER 0x01020304
+#define MBOXRD_INDEX_SUFFIX    ".muidx"
+
+struct mboxrd_index_header
+{
+  char magic[sizeof (MBOXRD_INDEX_MAGIC)];
+  uint16_t version;
+  uint32_t byteorder;
+  uint32_t recsize;          /* Size of struct mboxrd_index_record */
+  uint64_t dev;              /* Mailbox device and inode */
+  uint64_t ino;
+  uint64_t size;             /* Mailbox size at the time of indexing */
+  int64_t  mtime;            /* Mailbox modification time */
+  int64_t  mtime_nsec;       /* Nanosecond part of it, if available */
+  uint64_t uidvalidity;
+  uint64_t uidnext;
+  uint64_t x_imapbase_off;
+  uint64_t x_imapbase_len;
+  uint32_t flags;            /* MBOXRD_INDEX_F_* flags */
+  uint32_t tail_len;         /* Number of bytes in tail */
+  unsigned char tail[MU_MBOXRD_TAIL_MAX]; /* Last bytes of the mailbox */
+  uint64_t mesg_count;       /* Number of message records that follow */
+};
+
+#define MBOXRD_INDEX_F_UIDVALIDITY 0x1 /* uidvalidity_scanned is set */
+
+struct mboxrd_index_record
+{
+  uint64_t message_start;
+  uint64_t from_length;
+  uint64_t body_start;
+  uint64_t message_end;
+  uint64_t uid;
+  uint64_t body_size;
+  uint64_t body_lines;
+  int32_t  env_sender_len;
+  int32_t  attr_flags;
+  uint32_t flags;            /* MBOXRD_INDEX_MSG_* flags */
+  char date[MU_DATETIME_FROM_LENGTH+1];
+};
+
+#define MBOXRD_INDEX_MSG_BODY_SCANNED 0x1
+#define MBOXRD_INDEX_MSG_FROM_ESCAPED 0x2
+
+/* Return the name of the sidecar file for mailbox DMP.  The name is
+   formed by prepending a dot and appending SUFFIX to the base name of
+   the mailbox file. */
+char *
+mu_mboxrd_sidecar_name (struct mu_mboxrd_mailbox *dmp, char const *suffix)
+{
+  char *p = strrchr (dmp->name, '/');
+  char *dir, *base, *file, *ret;
+
+  if (p)
+    {
+      size_t len = p - dmp->name;
+      dir = malloc (len + 1);
+      if (!dir)
+	return NULL;
+      memcpy (dir, dmp->name, len);
+      dir[len] = 0;
+      base = p + 1;
+    }
+  else
+    {
+      dir = NULL;
+      base = dmp->name;
+    }
+  if (mu_asprintf (&file, ".%s%s", base, suffix))
+    {
+      free (dir);
+      return NULL;
+    }
+  if (dir)
+    {
+      ret = mu_make_file_name (dir[0] ? dir : "/", file);
+      free (file);
+      free (dir);
+    }
+  else
+    ret = file;
+  return ret;
+}
+
+/* Return the nanosecond part of the modification time from ST, or 0 if
+   it is not available.  A mailbox rewritten within the same second
+   must not be taken for the indexed one. */
+static int64_t
+stat_mtime_nsec (struct stat const *st)
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+  return st->st_mtim.tv_nsec;
+#else
+  return 0;
+#endif
+}
+
+static int
+read_full (mu_stream_t str, void *buf, size_t size)
+{
+  size_t n;
+  int rc = mu_stream_read (str, buf, size, &n);
+  if (rc == 0 && n != size)
+    rc = MU_ERR_PARSE;
+  return rc;
+}
+
+/* Read into BUF LEN bytes of the mailbox, ending at offset END.  The
+   data are read directly from the file if possible, because the stream
+   buffer may be stale if the mailbox was modified by another program. */
+static int
+mboxrd_read_tail (struct mu_mboxrd_mailbox *dmp, mu_off_t end,
+		  unsigned char *buf, size_t len)
+{
+  mu_transport_t trans[2];
+  int rc;
+
+  rc = mu_stream_flush (dmp->mailbox->stream);
+  if (rc)
+    return rc;
+  if (mu_stream_ioctl (dmp->mailbox->stream, MU_IOCTL_TRANSPORT,
+		       MU_IOCTL_OP_GET, trans) == 0)
+    {
+      ssize_t n = pread ((int) (intptr_t) trans[0], buf, len, end - len);
+      if (n < 0)
+	return errno;
+      return (size_t) n == len ? 0 : MU_ERR_PARSE;
+    }
+  rc = mu_stream_seek (dmp->mailbox->stream, end - len, MU_SEEK_SET, NULL);
+  if (rc == 0)
+    rc = read_full (dmp->mailbox->stream, buf, len);
+  return rc;
+}
+
+/* Fill the mailbox tail fingerprint in DMP, using the current mailbox
+   size. */
+int
+mu_mboxrd_tail_update (struct mu_mboxrd_mailbox *dmp)
+{
+  size_t len = dmp->size < MU_MBOXRD_TAIL_MAX
+                 ? dmp->size : MU_MBOXRD_TAIL_MAX;
+  int rc = mboxrd_read_tail (dmp, dmp->size, dmp->tail, len);
+  dmp->tail_len = rc ? 0 : len;
+  return rc;
+}
+
+/* Return true if the bytes preceding offset dmp->size in the mailbox
+   are the same as recorded by the last call to mu_mboxrd_tail_update. */
+int
+mu_mboxrd_tail_unchanged (struct mu_mboxrd_mailbox *dmp)
+{
+  unsigned char tail[MU_MBOXRD_TAIL_MAX];
+
+  if (dmp->tail_len == 0)
+    return 0;
+  return mboxrd_read_tail (dmp, dmp->size, tail, dmp->tail_len) == 0
+         && memcmp (tail, dmp->tail, dmp->tail_len) == 0;
+}
+
+/* Return true if the X-IMAPbase header in the mailbox is the same as
+   recorded in the index header HDR. */
+static int
+x_imapbase_unchanged (struct mu_mboxrd_mailbox *dmp,
+		      struct mboxrd_index_header const *hdr)
+{
+  char *buf;
+  unsigned long uidvalidity, uidnext;
+  int res = 0;
+
+  if (!(hdr->flags & MBOXRD_INDEX_F_UIDVALIDITY) || hdr->x_imapbase_len == 0)
+    return 1;
+  buf = malloc (hdr->x_imapbase_len + 1);
+  if (!buf)
+    return 0;
+  if (mu_stream_seek (dmp->mailbox->stream, hdr->x_imapbase_off,
+		      MU_SEEK_SET, NULL) == 0
+      && read_full (dmp->mailbox->stream, buf, hdr->x_imapbase_len) == 0)
+    {
+      buf[hdr->x_imapbase_len] = 0;
+      res = mu_c_strncasecmp (buf, MU_HEADER_X_IMAPBASE ":",
+			      sizeof (MU_HEADER_X_IMAPBASE)) == 0
+	    && sscanf (buf + sizeof (MU_HEADER_X_IMAPBASE), "%lu %lu",
+		       &uidvalidity, &uidnext) == 2
+	    && uidvalidity == hdr->uidvalidity
+	    && uidnext == hdr->uidnext;
+    }
+  free (buf);
+  return res;
+}
+
+/* Check the index header HDR.  ST is the status of the mailbox and
+   IST that of the index file. */
+static int
+mboxrd_index_check (struct mu_mboxrd_mailbox *dmp,
+		    struct mboxrd_index_header const *hdr,
+		    struct stat const *st, struct stat const *ist)
+{
+  if (memcmp (hdr->magic, MBOXRD_INDEX_MAGIC, sizeof (hdr->magic))
+      || hdr->version != MBOXRD_INDEX_VERSION
+      || hdr->byteorder != MBOXRD_INDEX_BYTEORDER
+      || hdr->recsize != sizeof (struct mboxrd_index_record)
+      || hdr->tail_len > MU_MBOXRD_TAIL_MAX
+      || hdr->tail_len > hdr->size
+      || hdr->mesg_count == 0
+      || hdr->mesg_count > hdr->size
+      || ist->st_size != sizeof (*hdr)
+                          + hdr->mesg_count * sizeof (struct mboxrd_index_record))
+    return MU_ERR_PARSE;
+  if ((hdr->flags & MBOXRD_INDEX_F_UIDVALIDITY)
+      && (hdr->x_imapbase_off > hdr->size
+	  || hdr->x_imapbase_len > hdr->size - hdr->x_imapbase_off))
+    return MU_ERR_PARSE;
+  if (hdr->dev != st->st_dev || hdr->ino != st->st_ino
+      || hdr->size > st->st_size)
+    return MU_ERR_NOENT;
+  if (hdr->size == st->st_size)
+    {
+      if (hdr->mtime != st->st_mtime
+	  || hdr->mtime_nsec != stat_mtime_nsec (st))
+	return MU_ERR_NOENT;
+    }
+  else
+    {
+      unsigned char tail[MU_MBOXRD_TAIL_MAX];
+
+      if (hdr->tail_len == 0
+	  || mboxrd_read_tail (dmp, hdr->size, tail, hdr->tail_len)
+	  || memcmp (tail, hdr->tail, hdr->tail_len)
+	  || !x_imapbase_unchanged (dmp, hdr))
+	return MU_ERR_NOENT;
+    }
+  return 0;
+}
+
+/* Check whether the index record REC describes a message that fits
+   into a mailbox of SIZE bytes and follows the message PREV (NULL for
+   the first record).  LAST is true if REC is the last record. */
+static int
+mboxrd_index_record_check (struct mboxrd_index_record const *rec,
+			   struct mboxrd_index_record const *prev,
+			   int last, uint64_t size)
+{
+  if (rec->message_end >= size
+      || (prev && rec->message_start <= prev->message_end)
+      || rec->from_length == 0
+      || rec->env_sender_len < 0
+      || rec->env_sender_len > rec->from_length)
+    return MU_ERR_PARSE;
+  if (rec->body_start == 0)
+    {
+      /* A message without the header terminator.  This can only be the
+	 last one. */
+      if (!last || rec->message_start + rec->from_length > rec->message_end + 1)
+	return MU_ERR_PARSE;
+    }
+  else if (rec->message_start >= rec->body_start
+	   || rec->body_start > rec->message_end + 1
+	   || rec->message_start + rec->from_length > rec->body_start)
+    return MU_ERR_PARSE;
+  return 0;
+}
+
+/* Load the index for mailbox DMP.  On success, fill the message array
+   and return in *POFF the offset from which the mailbox scanning should
+   be continued.  On error, the message array is left empty. */
+int
+mu_mboxrd_index_load (struct mu_mboxrd_mailbox *dmp, mu_off_t *poff)
+{
+  char *name;
+  int fd;
+  mu_stream_t str;
+  struct mboxrd_index_header hdr;
+  struct mboxrd_index_record rec, prev;
+  struct stat st, ist;
+  size_t i;
+  int rc;
+
+  if (dmp->mesg_count)
+    return EINVAL;
+  if (stat (dmp->name, &st))
+    return errno;
+  name = mu_mboxrd_sidecar_name (dmp, MBOXRD_INDEX_SUFFIX);
+  if (!name)
+    return ENOMEM;
+  rc = mu_sidecar_open (name, O_RDONLY, st.st_uid, &fd, &ist);
+  if (rc == 0)
+    {
+      rc = mu_fd_stream_create (&str, name, fd, MU_STREAM_READ);
+      if (rc)
+	close (fd);
+    }
+  if (rc)
+    {
+      if (rc != ENOENT)
+	mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_TRACE1,
+		  ("%s: ignoring index %s: %s",
+		   dmp->name, name, mu_strerror (rc)));
+      free (name);
+      return rc;
+    }
+  rc = read_full (str, &hdr, sizeof (hdr));
+  if (rc == 0)
+    rc = mboxrd_index_check (dmp, &hdr, &st, &ist);
+
+  for (i = 0; rc == 0 && i < hdr.mesg_count; i++)
+    {
+      struct mu_mboxrd_message *dmsg;
+
+      rc = read_full (str, &rec, sizeof (rec));
+      if (rc)
+	break;
+      rc = mboxrd_index_record_check (&rec, i ? &prev : NULL,
+				      i + 1 == hdr.mesg_count, hdr.size);
+      if (rc)
+	break;
+      prev = rec;
+      rc = mu_mboxrd_alloc_message (dmp, &dmsg);
+      if (rc)
+	break;
+      dmsg->message_start = rec.message_start;
+      dmsg->from_length = rec.from_length;
+      dmsg->env_sender_len = rec.env_sender_len;
+      dmsg->body_start = rec.body_start;
+      dmsg->message_end = rec.message_end;
+      dmsg->uid = rec.uid;
+      memcpy (dmsg->date, rec.date, sizeof (dmsg->date));
+      dmsg->date[MU_DATETIME_FROM_LENGTH] = 0;
+      dmsg->attr_flags = rec.attr_flags;
+      if (rec.flags & MBOXRD_INDEX_MSG_BODY_SCANNED)
+	{
+	  dmsg->body_lines_scanned = 1;
+	  dmsg->body_from_escaped = !!(rec.flags & MBOXRD_INDEX_MSG_FROM_ESCAPED);
+	  dmsg->body_size = rec.body_size;
+	  dmsg->body_lines = rec.body_lines;
+	}
+    }
+  mu_stream_destroy (&str);
+
+  if (rc)
+    {
+      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_TRACE1,
+		("%s: ignoring index %s: %s",
+		 dmp->name, name, mu_strerror (rc)));
+      for (i = 0; i < dmp->mesg_count; i++)
+	mu_mboxrd_message_free (dmp->mesg[i]);
+      dmp->mesg_count = 0;
+    }
+  else
+    {
+      if (hdr.flags & MBOXRD_INDEX_F_UIDVALIDITY)
+	{
+	  dmp->uidvalidity = hdr.uidvalidity;
+	  dmp->uidnext = hdr.uidnext;
+	  dmp->x_imapbase_off = hdr.x_imapbase_off;
+	  dmp->x_imapbase_len = hdr.x_imapbase_len;
+	  dmp->uidvalidity_scanned = 1;
+	}
+      if (hdr.size == st.st_size)
+	*poff = hdr.size;
+      else
+	{
+	  /*
+	   * The mailbox has grown.  Its last indexed message may have
+	   * been padded by the newlines when the next message was appended
+	   * to it, so rescan it along with the new ones.
+	   */
+	  struct mu_mboxrd_message *dmsg = dmp->mesg[--dmp->mesg_count];
+	  *poff = dmsg->message_start;
+	  mu_mboxrd_message_free (dmsg);
+	}
+      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_TRACE1,
+		("%s: loaded %lu messages from index %s",
+		 dmp->name, (unsigned long) dmp->mesg_count, name));
+    }
+  free (name);
+  return rc;
+}
+
+/* Return true if the in-memory state of DMP reflects the mailbox
+   contents on disk. */
+static int
+mboxrd_is_clean (struct mu_mboxrd_mailbox *dmp)
+{
+  size_t i;
+
+  if (dmp->uidvalidity_changed)
+    return 0;
+  for (i = 0; i < dmp->mesg_count; i++)
+    {
+      struct mu_mboxrd_message *dmsg = dmp->mesg[i];
+      if (dmsg->uid_modified
+	  || (dmsg->attr_flags & MU_ATTRIBUTE_MODIFIED)
+	  || (dmsg->message && mu_message_is_modified (dmsg->message)))
+	return 0;
+    }
+  return 1;
+}
+
+static int
+mboxrd_index_write (struct mu_mboxrd_mailbox *dmp, char const *name,
+		    struct stat const *st)
+{
+  char *tempname;
+  int fd;
+  mu_stream_t str;
+  struct mboxrd_index_header hdr;
+  size_t i;
+  int rc;
+
+  rc = mu_sidecar_tempfile (name, &fd, &tempname);
+  if (rc)
+    return rc;
+  rc = mu_fd_stream_create (&str, tempname, fd, MU_STREAM_WRITE);
+  if (rc)
+    {
+      close (fd);
+      unlink (tempname);
+      free (tempname);
+      return rc;
+    }
+  mu_stream_set_buffer (str, mu_buffer_full, 0);
+
+  memset (&hdr, 0, sizeof (hdr));
+  memcpy (hdr.magic, MBOXRD_INDEX_MAGIC, sizeof (hdr.magic));
+  hdr.version = MBOXRD_INDEX_VERSION;
+  hdr.byteorder = MBOXRD_INDEX_BYTEORDER;
+  hdr.recsize = sizeof (struct mboxrd_index_record);
+  hdr.dev = st->st_dev;
+  hdr.ino = st->st_ino;
+  hdr.size = st->st_size;
+  hdr.mtime = st->st_mtime;
+  hdr.mtime_nsec = stat_mtime_nsec (st);
+  if (dmp->uidvalidity_scanned)
+    {
+      hdr.flags |= MBOXRD_INDEX_F_UIDVALIDITY;
+      hdr.uidvalidity = dmp->uidvalidity;
+      hdr.uidnext = dmp->uidnext;
+      hdr.x_imapbase_off = dmp->x_imapbase_off;
+      hdr.x_imapbase_len = dmp->x_imapbase_len;
+    }
+  hdr.tail_len = dmp->tail_len;
+  memcpy (hdr.tail, dmp->tail, dmp->tail_len);
+  hdr.mesg_count = dmp->mesg_count;
+  rc = mu_stream_write (str, &hdr, sizeof (hdr), NULL);
+
+  for (i = 0; rc == 0 && i < dmp->mesg_count; i++)
+    {
+      struct mu_mboxrd_message *dmsg = dmp->mesg[i];
+      struct mboxrd_index_record rec;
+
+      memset (&rec, 0, sizeof (rec));
+      rec.message_start = dmsg->message_start;
+      rec.from_length = dmsg->from_length;
+      rec.env_sender_len = dmsg->env_sender_len;
+      rec.body_start = dmsg->body_start;
+      rec.message_end = dmsg->message_end;
+      rec.uid = dmsg->uid;
+      memcpy (rec.date, dmsg->date, sizeof (rec.date));
+      rec.attr_flags = dmsg->attr_flags;
+      if (dmsg->body_lines_scanned)
+	{
+	  rec.flags |= MBOXRD_INDEX_MSG_BODY_SCANNED;
+	  if (dmsg->body_from_escaped)
+	    rec.flags |= MBOXRD_INDEX_MSG_FROM_ESCAPED;
+	  rec.body_size = dmsg->body_size;
+	  rec.body_lines = dmsg->body_lines;
+	}
+      rc = mu_stream_write (str, &rec, sizeof (rec), NULL);
+    }
+
+  if (rc == 0)
+    rc = mu_stream_close (str);
+  mu_stream_destroy (&str);
+  if (rc == 0 && rename (tempname, name))
+    rc = errno;
+  if (rc)
+    unlink (tempname);
+  free (tempname);
+  return rc;
+}
+
+/* Bring the index of the mailbox DMP in sync with its current state.
+   If the mailbox contains unsaved modifications, remove the index, so
+   that it gets rebuilt next time the mailbox is opened. */
+int
+mu_mboxrd_index_update (struct mu_mboxrd_mailbox *dmp)
+{
+  char *name;
+  struct stat st;
+  int rc;
+
+  if (!dmp->mailbox->stream || dmp->mesg_count == 0)
+    return 0;
+
+  name = mu_mboxrd_sidecar_name (dmp, MBOXRD_INDEX_SUFFIX);
+  if (!name)
+    return ENOMEM;
+
+  rc = mu_stream_flush (dmp->mailbox->stream);
+  if (rc == 0 && stat (dmp->name, &st))
+    rc = errno;
+  if (rc == 0)
+    {
+      if (st.st_size == dmp->size
+	  && dmp->tail_len > 0
+	  && mboxrd_is_clean (dmp))
+	rc = mboxrd_index_write (dmp, name, &st);
+      else if (unlink (name) && errno != ENOENT)
+	rc = errno;
+    }
+  if (rc)
+    mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
+	      ("%s: can't update index %s: %s",
+	       dmp->name, name, mu_strerror (rc)));
+  free (name);
+  return rc;
+}
@@ -21,6 +21,7 @@
 # include <pthread.h>
 #endif
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <signal.h>
 #include <mailutils/sys/mboxrd.h>
 #include <mailutils/sys/mailbox.h>
@@ -40,6 +41,7 @@
 #include <mailutils/envelope.h>
 #include <mailutils/util.h>
 #include <mailutils/cctype.h>
+#include <mailutils/mailbox.h>
 #include <mailutils/sys/folder.h>
 #include <mailutils/sys/registrar.h>
 
@@ -120,6 +122,18 @@ mboxrd_open (mu_mailbox_t mailbox, int flags)
 
   mailbox->flags = flags;
 
+  /* Complete interrupted compaction, if any.  This modifies the
+     mailbox, so it is left for the next process opening it for
+     writing. */
+  if (flags & (MU_STREAM_WRITE | MU_STREAM_APPEND))
+    {
+      rc = mu_mboxrd_journal_recover (dmp);
+      if (rc == MU_ERR_NOENT)
+	rc = 0;
+      else if (rc)
+	return rc;
+    }
+  
   rc = mboxrd_mailbox_init_stream (dmp);
 
   if (rc == 0
@@ -160,6 +174,8 @@ mboxrd_close (mu_mailbox_t mailbox)
 
   if (dmp->uidvalidity_changed && (dmp->stream_flags & MU_STREAM_WRITE))
     mboxrd_flush (dmp, FLUSH_UIDVALIDITY);
+  if (mu_mailbox_index_enabled ())
+    mu_mboxrd_index_update (dmp);
   
   mu_locker_unlock (mailbox->locker);
   mu_monitor_wrlock (mailbox->monitor);
@@ -171,6 +187,7 @@ mboxrd_close (mu_mailbox_t mailbox)
   dmp->mesg = NULL;
   dmp->mesg_count = dmp->mesg_max = 0;
   dmp->size = 0;
+  dmp->tail_len = 0;
   dmp->uidvalidity = 0;
   dmp->uidnext = 1;
   mu_monitor_unlock (mailbox->monitor);
@@ -192,25 +209,81 @@ mboxrd_remove (mu_mailbox_t mailbox)
   return 0;
 }
 
+/* Kinds of changes made to the mailbox file since it was last scanned */
+enum mboxrd_change
+  {
+    mboxrd_unchanged,   /* No changes */
+    mboxrd_appended,    /* New messages were appended */
+    mboxrd_rewritten,   /* The mailbox was rewritten */
+    mboxrd_shrunk       /* The mailbox shrank in size */
+  };
+
+/* Classify changes to the mailbox since the last scan.  If the mailbox
+   grew, it is considered to be appended to if the bytes preceding the
+   former end of file are the same as recorded after the scan. */
+static enum mboxrd_change
+mboxrd_classify_change (struct mu_mboxrd_mailbox *dmp)
+{
+  mu_off_t size;
+  
+  if (mu_stream_size (dmp->mailbox->stream, &size) != 0)
+    return mboxrd_unchanged;
+  if (size == dmp->size)
+    return mboxrd_unchanged;
+  if (size < dmp->size)
+    return mboxrd_shrunk;
+  if (dmp->size == 0 || dmp->tail_len == 0
+      || mu_mboxrd_tail_unchanged (dmp))
+    return mboxrd_appended;
+  return mboxrd_rewritten;
+}
+
 static int
 mboxrd_is_updated (mu_mailbox_t mailbox)
 {
   struct mu_mboxrd_mailbox *dmp = mailbox->data;
-  mu_off_t size = 0;
 
   if (!dmp)
     return 0;
 
-  if (mu_stream_size (mailbox->stream, &size) != 0)
-    return 1;
-  if (size < dmp->size)
+  switch (mboxrd_classify_change (dmp))
     {
+    case mboxrd_unchanged:
+      return 1;
+
+    case mboxrd_appended:
+      break;
+      
+    case mboxrd_shrunk:
       mu_observable_notify (mailbox->observable, MU_EVT_MAILBOX_CORRUPT,
 			    mailbox);
       mu_diag_output (MU_DIAG_EMERG, _("mailbox corrupted, shrank in size"));
-      return 0;
+      break;
+
+    case mboxrd_rewritten:
+      mu_observable_notify (mailbox->observable, MU_EVT_MAILBOX_CORRUPT,
+			    mailbox);
+      mu_diag_output (MU_DIAG_EMERG,
+		      _("mailbox corrupted, rewritten by another program"));
+      break;
+    }
+  return 0;
+}
+
+/* Notify the observers about messages appended to the mailbox, if the
+   message count grew beyond COUNT. */
+static void
+mboxrd_notify_new_messages (struct mu_mboxrd_mailbox *dmp, size_t count)
+{
+  if (dmp->mailbox->observable && dmp->mesg_count > count)
+    {
+      size_t range[2];
+
+      range[0] = count + 1;
+      range[1] = dmp->mesg_count;
+      mu_observable_notify (dmp->mailbox->observable,
+			    MU_EVT_MAILBOX_NEW_MESSAGES, range);
     }
-  return (dmp->size == size);
 }
 
 #ifdef WITH_PTHREAD
@@ -223,9 +296,9 @@ mboxrd_cleanup (void *arg)
 }
 #endif
 
-static int
-mboxrd_alloc_message (struct mu_mboxrd_mailbox *dmp,
-		       struct mu_mboxrd_message **dmsg_ptr)
+int
+mu_mboxrd_alloc_message (struct mu_mboxrd_mailbox *dmp,
+			 struct mu_mboxrd_message **dmsg_ptr)
 {
   struct mu_mboxrd_message *dmsg;
 
@@ -457,25 +530,15 @@ parse_from_line (char const *s, char **zp)
   return NULL;
 }
 
-/* Finalize current message */
+/* Finalize current message.  END is the offset of its last byte. */
 static inline int
 scan_message_finalize (struct mu_mboxrd_mailbox *dmp,
-		       struct mu_mboxrd_message *dmsg, mu_stream_t stream,
-		       size_t n, int *force_init_uids)
+		       struct mu_mboxrd_message *dmsg, mu_off_t end,
+		       int *force_init_uids)
 {
-  int rc;
   size_t count;
   
-  rc = mu_stream_seek (stream, 0, MU_SEEK_CUR, &dmsg->message_end);
-  if (rc)
-    {
-      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
-		("%s:%s (%s): %s",
-		 __func__, "mu_stream_seek", dmp->name,
-		 mu_strerror (rc)));
-      return -1;
-    }
-  dmsg->message_end -= n + 1;
+  dmsg->message_end = end;
   if (dmsg->uid == 0)
     *force_init_uids = 1;
   if (*force_init_uids)
@@ -490,33 +553,13 @@ scan_message_finalize (struct mu_mboxrd_mailbox *dmp,
   return 0;
 }
 
-static inline struct mu_mboxrd_message *
-scan_message_begin (struct mu_mboxrd_mailbox *dmp, mu_stream_t stream,
-		    char *buf, size_t n, char *ti, char *zn)
+/* Fill in the envelope information of DMSG.  BUF and N are the From_
+   line and its length, TI and ZN are the pointers returned by
+   parse_from_line. */
+static void
+scan_envelope (struct mu_mboxrd_message *dmsg,
+	       char *buf, size_t n, char *ti, char *zn)
 {
-  int rc;
-  struct mu_mboxrd_message *dmsg;
-  
-  /* Create new message */
-  rc = mboxrd_alloc_message (dmp, &dmsg);
-  if (rc)
-    {
-      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
-		("%s:%s (%s): %s",
-		 __func__, "mboxrd_alloc_message", dmp->name,
-		 mu_strerror (rc)));
-      return NULL;
-    }
-  rc = mu_stream_seek (stream, 0, MU_SEEK_CUR, &dmsg->message_start);
-  if (rc)
-    {
-      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
-		("%s:%s (%s): %s",
-		 __func__, "mu_stream_seek", dmp->name,
-		 mu_strerror (rc)));
-      return NULL;
-    }
-  dmsg->message_start -= n;
   dmsg->from_length = n;
   dmsg->env_sender_len = ti - buf - 10;
   while (dmsg->env_sender_len > 6 && buf[dmsg->env_sender_len-1] == ' ')
@@ -563,234 +606,1015 @@ scan_message_begin (struct mu_mboxrd_mailbox *dmp, mu_stream_t stream,
 	}
       dmsg->date[24] = 0;
     }
-  
-  return dmsg;
 }
 
-/* Scan the mailbox starting from the given offset.
- *
- * Notes on the mailbox format:
- *
- *  1. A mailbox consists of a series of messages.
- * 
- *  2. Each message is preceded by a From_ line and followed by a blank line.
- *     A From_ line is a line that begins with the five characters 'F', 'r',
- *     'o', 'm', and ' ', followed by sender email and delivery date.  The
- *     From_ line parser is able to handle various From_ line formats
- *     (differing mainly in date/time format), most of which are encountered
- *     only in ancient mailboxes.  Nevertheless, this makes escaping of the
- *     From_ lines less crucial and ensures optimal robustness in handling
- *     different mailbox formats (mboxo, mboxrd and mboxcl (mboxcl2) are
- *     all handled properly.
- *
- *  3. The From_ lines and the blank lines bracket messages, fore and aft.
- *     They do not comprise a message divider.  This means, in particular,
- *     that both bracketing lines should be included in the message octet
- *     and line counts.  However, counting the From_ line goes against
- *     the mailutils approach of logically dividing envelope and the rest
- *     of the message and would create useless differences compared to
- *     another mailbox formats.  For this reason, the From_ line is not
- *     reflected in returns from the mu_message_size and mu_message_lines
- *     functions.  The terminating blank line, on the contrary, is assumed
- *     to be part of the message body and is counted in body and message
- *     size and line count computations.
- *
- *  4. A mailbox that contains zero messages contains no lines.
- *
- *  5. The first message in the mailbox is not preceded by a blank line.
- *     The last message in the mailbox is not followed by a From_ line.
- * 
- *  6. If a non-empty file does not have valid From_ construct in its
- *     first physical line, it will be rejected by the parser.
- *
- *  7. A message may contain blank lines.  It should not, however, contain
- *     lines beginning with the sequence 'F', 'r', 'o', 'm', ' '.
- *
- *  8. When incorporating a message into the mailbox, any line in the message
- *     body that begins with zero or more '>' characters immediately followed
- *     by the sequence 'F', 'r', 'o', 'm', ' ', is escaped by prepending it
- *     with a '>' character.  Thus, "From " becomes ">From ", ">From "
- *     becomes ">>From ", and so on.  When reading the message body, a
- *     reverse operation is performed.
- *
- *  9. Last message in the mailbox is allowed to end with a partial last line
- *     (i.e. the one whose final characters are not two newlines).  The message
- *     will be handled as usual.  When a new message is incorporated to the
- *     mailbox, the missing newlines will be added to the end of the last
- *     message.
- */
-static int
-mboxrd_rescan_unlocked (mu_mailbox_t mailbox, mu_off_t offset)
+/* Begin new message.  START is the offset of its From_ line, BUF and N
+   are the From_ line and its length, TI and ZN are the pointers returned
+   by parse_from_line. */
+static inline struct mu_mboxrd_message *
+scan_message_begin (struct mu_mboxrd_mailbox *dmp, mu_off_t start,
+		    char *buf, size_t n, char *ti, char *zn)
 {
-  struct mu_mboxrd_mailbox *dmp = mailbox->data;
   int rc;
-  mu_stream_t stream;
-  char *buf = NULL;
-  size_t bufsize = 0;
-  size_t n;
-  enum mboxrd_scan_state
-  {
-    mboxrd_scan_init,  /* At the beginning of the file */
-    mboxrd_scan_header,/* Scanning message header */
-    mboxrd_scan_body,  /* Scanning message body */
-    mboxrd_scan_empty_line /* At the empty line within or at the end of body */
-  } state = mboxrd_scan_init;
-  struct mu_mboxrd_message *dmsg = NULL;
-  char *zn, *ti;
-  int force_init_uids = 0;
-  size_t numlines = 0;
+  struct mu_mboxrd_message *dmsg;
   
-# define IS_HEADER(h,b,n)			\
+  /* Create new message */
+  rc = mu_mboxrd_alloc_message (dmp, &dmsg);
+  if (rc)
+    {
+      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
+		("%s:%s (%s): %s",
+		 __func__, "mu_mboxrd_alloc_message", dmp->name,
+		 mu_strerror (rc)));
+      return NULL;
+    }
+  dmsg->message_start = start;
+  scan_envelope (dmsg, buf, n, ti, zn);
+  return dmsg;
+}
+
+#define IS_HEADER(h,b,n)			\
   ((n) > sizeof (h) - 1				\
    && strncasecmp (b, h, sizeof (h) - 1) == 0	\
    && b[sizeof (h) - 1] == ':')
-  
 
-  rc = mu_stream_size (mailbox->stream, &dmp->size);
-  if (rc)
-    return rc;
-  if (offset == dmp->size)
-    return 0;
-  if (!(dmp->stream_flags & MU_STREAM_READ))
-    return 0;
+/* Return true if the header line BUF of length N is of interest for
+   scan_header_line. */
+static inline int
+scan_header_wanted (struct mu_mboxrd_mailbox *dmp,
+		    struct mu_mboxrd_message *dmsg,
+		    char const *buf, size_t n, int force_init_uids)
+{
+  return (!dmp->uidvalidity_scanned && IS_HEADER (MU_HEADER_X_IMAPBASE, buf, n))
+    || (!force_init_uids && dmsg->uid == 0
+	&& IS_HEADER (MU_HEADER_X_UID, buf, n))
+    || IS_HEADER (MU_HEADER_STATUS, buf, n);
+}
 
-  rc = mu_streamref_create (&stream, mailbox->stream);
-  if (rc)
+/* Analyze the header line BUF of length N, located at offset OFF in the
+   mailbox.  BUF must be NUL-terminated. */
+static void
+scan_header_line (struct mu_mboxrd_mailbox *dmp,
+		  struct mu_mboxrd_message *dmsg,
+		  char const *buf, size_t n, mu_off_t off,
+		  int *force_init_uids)
+{
+  if (!dmp->uidvalidity_scanned
+      && IS_HEADER (MU_HEADER_X_IMAPBASE, buf, n))
     {
-      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
-		("%s:%s (%s): %s",
-		 __func__, "mu_streamref_create", dmp->name,
-		 mu_strerror (rc)));
-      return rc;
+      if (sscanf (buf + sizeof (MU_HEADER_X_IMAPBASE),
+		  "%lu %lu",
+		  &dmp->uidvalidity, &dmp->uidnext) == 2)
+	{
+	  dmp->x_imapbase_len = n - 1;
+	  dmp->x_imapbase_off = off;
+	  dmp->uidvalidity_scanned = 1;
+	}
+    }
+  else if (!*force_init_uids
+	   && dmsg->uid == 0
+	   && IS_HEADER (MU_HEADER_X_UID, buf, n))
+    {
+      if (!(sscanf (buf + sizeof (MU_HEADER_X_UID), "%lu", &dmsg->uid) == 1
+	    && dmsg->uid < dmp->uidnext
+	    && (dmsg->num == 0 || dmsg->uid > dmp->mesg[dmsg->num - 1]->uid)))
+	{
+	  *force_init_uids = 1;
+	}
+    }
+  else if (IS_HEADER (MU_HEADER_STATUS, buf, n))
+    {
+      mu_attribute_string_to_flags (buf + sizeof (MU_HEADER_STATUS),
+				    &dmsg->attr_flags);
     }
+}
 
-  rc = mu_stream_seek (stream, offset, MU_SEEK_SET, NULL);
-  if (rc)
+/*
+ * Mapped mailbox scanner.
+ *
+ * The scanner below operates on the memory-mapped mailbox file.  Instead
+ * of analyzing each line, it analyzes only message headers.  Message
+ * bodies are skipped by searching for the "\n\nFrom " sequence, which
+ * marks a From_ line candidate.  Only these candidates are passed to
+ * parse_from_line.
+ *
+ * Lines of interest are copied to a separate buffer before analyzing,
+ * because the functions doing so expect them to be NUL-terminated.
+ */
+
+struct mboxrd_linebuf
+{
+  char *buf;
+  size_t size;
+};
+
+/* Copy line of N bytes from PTR to the line buffer LB.  Return pointer
+   to the NUL-terminated copy or NULL if out of memory. */
+static char *
+linebuf_copy (struct mboxrd_linebuf *lb, char const *ptr, size_t n)
+{
+  if (n + 1 > lb->size)
     {
-      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
-		("%s:%s (%s): %s",
-		 __func__, "mu_stream_seek", dmp->name,
-		 mu_strerror (rc)));
-      return rc;
+      size_t size = lb->size ? lb->size : 128;
+      char *p;
+      while (n + 1 > size)
+	size *= 2;
+      p = realloc (lb->buf, size);
+      if (!p)
+	return NULL;
+      lb->buf = p;
+      lb->size = size;
     }
+  memcpy (lb->buf, ptr, n);
+  lb->buf[n] = 0;
+  return lb->buf;
+}
 
-  while ((rc = mu_stream_getline (stream, &buf, &bufsize, &n)) == 0
-	 && n > 0)
+/* Return the length of the line that starts at P, including the
+   terminating newline (if any).  END points past the end of buffer. */
+static inline size_t
+line_length (char const *p, char const *end)
+{
+  char const *q = memchr (p, '\n', end - p);
+  return q ? q - p + 1 : end - p;
+}
+
+/* Look for the first valid From_ line preceded by an empty line in the
+   buffer between Q and END.  The search starts at Q, which should point
+   to a newline character.  On success, store the start of the found line
+   in *PFROM, its length in *PN, and the values returned by
+   parse_from_line in *PTI and *PZN.  If no From_ line is found, store
+   NULL in *PFROM.  Return 0 or error code. */
+static int
+find_from_line (struct mboxrd_linebuf *lb, char const *q, char const *end,
+		char const **pfrom, size_t *pn, char **pti, char **pzn)
+{
+  while ((q = memmem (q, end - q, "\n\nFrom ", 7)) != NULL)
     {
-      switch (state)
+      size_t n;
+      char *buf;
+      
+      q += 2;
+      n = line_length (q, end);
+      if ((buf = linebuf_copy (lb, q, n)) == NULL)
+	return ENOMEM;
+      if ((*pti = parse_from_line (buf, pzn)) != NULL)
 	{
-	case mboxrd_scan_init:
-	  if ((ti = parse_from_line (buf, &zn)) == 0)
-	    {
-	      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
-			("%s does not start with a valid From_ line",
-			 dmp->name));
-	      rc = MU_ERR_PARSE;
-	      goto err;
-	    }
-	  if ((dmsg = scan_message_begin (dmp, stream, buf, n, ti, zn)) == NULL)
-	    goto err;
-	  state = mboxrd_scan_header;
+	  *pn = n;
 	  break;
+	}
+    }
+  *pfrom = q;
+  return 0;
+}
 
-	case mboxrd_scan_header:
-	  if (n == 1 && buf[0] == '\n')
-	    {
-	      rc = mu_stream_seek (stream, 0, MU_SEEK_CUR, &dmsg->body_start);
-	      if (rc)
-		{
-		  mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
-			    ("%s:%s (%s): %s",
-			     __func__, "mu_stream_seek", dmp->name,
-			     mu_strerror (rc)));
-		  goto err;
-		}
-	      state = mboxrd_scan_body;
-	    }
-	  else if (mu_isspace (buf[0]))
-	    continue;
-	  else if (!dmp->uidvalidity_scanned
-		   && IS_HEADER (MU_HEADER_X_IMAPBASE, buf, n))
-	    {
-	      if (sscanf (buf + sizeof (MU_HEADER_X_IMAPBASE),
-			  "%lu %lu",
-			  &dmp->uidvalidity, &dmp->uidnext) == 2)
-		{
-		  mu_off_t off;
-		  
-		  rc = mu_stream_seek (stream, 0, MU_SEEK_CUR, &off);
-		  if (rc)
-		    {
-		      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
-				("%s:%s (%s): %s",
-				 __func__, "mu_stream_seek", dmp->name,
-				 mu_strerror (rc)));
-		      goto err;
-		    }
-		  dmp->x_imapbase_len = n - 1;
-		  dmp->x_imapbase_off = off - n;
-		  dmp->uidvalidity_scanned = 1;
-		}
-	    }
-	  else if (!force_init_uids
-		   && dmsg->uid == 0
-		   && IS_HEADER (MU_HEADER_X_UID, buf, n))
-	    {
-	      if (!(sscanf (buf + sizeof (MU_HEADER_X_UID), "%lu", &dmsg->uid) == 1
-		    && dmsg->uid < dmp->uidnext
-		    && (dmsg->num == 0 || dmsg->uid > dmp->mesg[dmsg->num - 1]->uid)))
-		{
-		  force_init_uids = 1;
-		}
-	    }
-	  else if (IS_HEADER (MU_HEADER_STATUS, buf, n))
-	    {
-	      mu_attribute_string_to_flags (buf + sizeof (MU_HEADER_STATUS),
-					    &dmsg->attr_flags);
-	    }
-	  break;
+/* Return true if the line starting at P (and ending before END) is a
+   From-escaped line, i.e. one or more '>' followed by "From ".  Such
+   lines lose their first '>' when the body is read. */
+static inline int
+is_escaped_from (char const *p, char const *end)
+{
+  if (p == end || *p != '>')
+    return 0;
+  while (++p < end && *p == '>')
+    ;
+  return end - p >= 5 && memcmp (p, "From ", 5) == 0;
+}
 
-	case mboxrd_scan_body:
-	  if (n == 1 && buf[0] == '\n')
-	    {
-	      state = mboxrd_scan_empty_line;
-	    }
-	  break;
+/* Store the body statistics of DMSG, whose body ends at offset END
+   (inclusive).  LINES is the number of lines in it, ESC is the number
+   of From-escaped lines.  This saves mboxrd_message_body_scan from
+   reading the body later. */
+static void
+scan_body_stats (struct mu_mboxrd_message *dmsg, mu_off_t end,
+		 size_t lines, size_t esc)
+{
+  dmsg->body_lines = lines;
+  dmsg->body_size = end - dmsg->body_start + 1 - esc;
+  dmsg->body_from_escaped = esc != 0;
+  dmsg->body_lines_scanned = 1;
+}
+
+/* Compute body statistics of DMSG from the mapped mailbox.  BASE is
+   the start of the mailbox, END points past the last byte of the
+   message. */
+static void
+scan_body_mapped (struct mu_mboxrd_message *dmsg, char const *base,
+		  char const *end)
+{
+  char const *p = base + dmsg->body_start;
+  char const *q;
+  size_t lines = 0, esc = 0;
+
+  if (dmsg->body_start == 0)
+    return;
+  /* Simple enough for the compiler to vectorize */
+  for (q = p; q < end; q++)
+    lines += *q == '\n';
+  /* Escaped lines are rare: look for line starts beginning with '>' */
+  for (q = p; q < end; q++)
+    {
+      esc += is_escaped_from (q, end);
+      if ((q = memmem (q, end - q, "\n>", 2)) == NULL)
+	break;
+    }
+  scan_body_stats (dmsg, end - base - 1, lines, esc);
+}
+
+/* When scanning of appended messages resumes past the end of the
+   message DMSG, the blank lines separating it from the first appended
+   message are skipped.  A full scan counts them as part of DMSG: extend
+   it so that it ends at offset END (exclusive), as it would do. */
+static void
+scan_extend_message (struct mu_mboxrd_message *dmsg, mu_off_t end)
+{
+  mu_off_t n = end - (dmsg->message_end + 1);
+
+  if (dmsg->body_start == 0)
+    /* The first blank line terminates the header. */
+    dmsg->body_start = dmsg->message_end + 2;
+  else if (dmsg->body_lines_scanned)
+    {
+      dmsg->body_lines += n;
+      dmsg->body_size += n;
+    }
+  dmsg->message_end = end - 1;
+}
+
+#ifdef WITH_PTHREAD
+/*
+ * Parallel scanner.
+ *
+ * A large mailbox is split into chunks at message boundaries and the
+ * chunks are scanned concurrently, each by its own thread.  A thread
+ * collects the messages found in its chunk into a private array, filling
+ * in their envelope and attribute information.  Interpretation of the
+ * X-IMAPbase and X-UID headers is deferred until the chunks are merged
+ * into the mailbox, because the checks involved depend on the preceding
+ * messages.  To that effect, threads record locations of these headers.
+ */
+
+/* Minimal size of a chunk.  This can be changed by setting the
+   MU_MBOXRD_SCAN_CHUNK environment variable (mostly for testing). */
+#define MBOXRD_SCAN_CHUNK_MIN (16*1024*1024)
+
+static size_t
+mboxrd_scan_chunk_min (void)
+{
+  static size_t chunk_min = 0;
+  if (chunk_min == 0)
+    {
+      char *p = getenv ("MU_MBOXRD_SCAN_CHUNK");
+      if (!p || mu_str_to_c (p, mu_c_hsize, &chunk_min, NULL)
+	  || chunk_min == 0)
+	chunk_min = MBOXRD_SCAN_CHUNK_MIN;
+    }
+  return chunk_min;
+}
+
+struct mboxrd_hline
+{
+  size_t msgno;              /* Index of the message in the chunk */
+  mu_off_t off;              /* Offset of the header line */
+  size_t len;                /* Length of the line with the newline */
+};
+
+struct mboxrd_chunk
+{
+  pthread_t tid;             /* Thread scanning this chunk */
+  int threaded;              /* True if tid is valid */
+  char const *base;          /* Start of the mailbox */
+  char const *start;         /* Start of the chunk */
+  char const *end;           /* End of the chunk */
+  struct mu_mboxrd_message **mesg; /* Messages found in the chunk */
+  size_t mesg_count;         /* Number of messages in mesg */
+  size_t mesg_max;           /* Actual capacity of mesg */
+  struct mboxrd_hline *hline;/* X-IMAPbase and X-UID header lines */
+  size_t hline_count;        /* Number of entries in hline */
+  size_t hline_max;          /* Actual capacity of hline */
+  int rc;                    /* Result of the scan */
+};
+
+/* Make sure the array *PARR of elements of size SIZE, currently holding
+   COUNT elements, has room for one more element.  *PMAX is the actual
+   capacity of the array. */
+static int
+chunk_array_reserve (void **parr, size_t *pmax, size_t count, size_t size)
+{
+  if (count == *pmax)
+    {
+      size_t n = *pmax;
+      void *p;
+
+      if (n == 0)
+	n = 64;
+      else
+	{
+	  if ((size_t) -1 / 3 * 2 / size <= n)
+	    return ENOMEM;
+	  n += (n + 1) / 2;
+	}
+      p = realloc (*parr, n * size);
+      if (!p)
+	return ENOMEM;
+      *parr = p;
+      *pmax = n;
+    }
+  return 0;
+}
+
+static void
+chunk_free (struct mboxrd_chunk *chunk)
+{
+  size_t i;
+
+  for (i = 0; i < chunk->mesg_count; i++)
+    free (chunk->mesg[i]);
+  free (chunk->mesg);
+  free (chunk->hline);
+}
+
+/* Scan the chunk. */
+static int
+chunk_scan (struct mboxrd_chunk *chunk)
+{
+  char const *base = chunk->base;
+  char const *end = chunk->end;
+  char const *p = chunk->start, *q;
+  struct mboxrd_linebuf lb = { NULL, 0 };
+  struct mu_mboxrd_message *dmsg;
+  char *buf, *zn, *ti;
+  size_t n;
+  int rc;
+
+#define OFFSET(ptr) ((mu_off_t) ((ptr) - base))
+  
+  /* The chunk starts with a valid From_ line */
+  n = line_length (p, end);
+  if ((buf = linebuf_copy (&lb, p, n)) == NULL)
+    return ENOMEM;
+  ti = parse_from_line (buf, &zn);
+  
+  for (;;)
+    {
+      rc = chunk_array_reserve ((void**) &chunk->mesg, &chunk->mesg_max,
+				chunk->mesg_count, sizeof (chunk->mesg[0]));
+      if (rc)
+	break;
+      dmsg = calloc (1, sizeof (*dmsg));
+      if (!dmsg)
+	{
+	  rc = ENOMEM;
+	  break;
+	}
+      chunk->mesg[chunk->mesg_count++] = dmsg;
+      dmsg->message_start = OFFSET (p);
+      scan_envelope (dmsg, buf, n, ti, zn);
+      p += n;
+
+      /* Scan the header */
+      while (p < end)
+	{
+	  n = line_length (p, end);
+	  if (n == 1 && p[0] == '\n')
+	    {
+	      p++;
+	      dmsg->body_start = OFFSET (p);
+	      break;
+	    }
+	  if (IS_HEADER (MU_HEADER_STATUS, p, n))
+	    {
+	      if ((buf = linebuf_copy (&lb, p, n)) == NULL)
+		{
+		  rc = ENOMEM;
+		  goto err;
+		}
+	      mu_attribute_string_to_flags (buf + sizeof (MU_HEADER_STATUS),
+					    &dmsg->attr_flags);
+	    }
+	  else if (IS_HEADER (MU_HEADER_X_IMAPBASE, p, n)
+		   || IS_HEADER (MU_HEADER_X_UID, p, n))
+	    {
+	      rc = chunk_array_reserve ((void**) &chunk->hline,
+					&chunk->hline_max,
+					chunk->hline_count,
+					sizeof (chunk->hline[0]));
+	      if (rc)
+		goto err;
+	      chunk->hline[chunk->hline_count].msgno = chunk->mesg_count - 1;
+	      chunk->hline[chunk->hline_count].off = OFFSET (p);
+	      chunk->hline[chunk->hline_count].len = n;
+	      chunk->hline_count++;
+	    }
+	  p += n;
+	}
+
+      /* Look for the next From_ line */
+      q = NULL;
+      if (dmsg->body_start)
+	{
+	  rc = find_from_line (&lb, p - 1, end, &q, &n, &ti, &zn);
+	  if (rc)
+	    break;
+	  buf = lb.buf;
+	}
+      if (!q)
+	{
+	  dmsg->message_end = OFFSET (end) - 1;
+	  scan_body_mapped (dmsg, base, end);
+	  break;
+	}
+      p = q;
+      dmsg->message_end = OFFSET (p) - 1;
+      scan_body_mapped (dmsg, base, p);
+    }
+#undef OFFSET
+ err:
+  free (lb.buf);
+  return rc;
+}
+
+static void *
+chunk_thread (void *arg)
+{
+  struct mboxrd_chunk *chunk = arg;
+  chunk->rc = chunk_scan (chunk);
+  return NULL;
+}
+
+/* Append messages from CHUNK to the mailbox, processing their UID
+   headers in order. */
+static int
+chunk_merge (struct mu_mboxrd_mailbox *dmp, struct mboxrd_chunk *chunk,
+	     int *force_init_uids)
+{
+  struct mboxrd_linebuf lb = { NULL, 0 };
+  size_t i, j = 0;
+  int rc = 0;
+  
+  for (i = 0; i < chunk->mesg_count; i++)
+    {
+      struct mu_mboxrd_message *dmsg;
+      size_t num;
+      
+      rc = mu_mboxrd_alloc_message (dmp, &dmsg);
+      if (rc)
+	{
+	  mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
+		    ("%s:%s (%s): %s",
+		     __func__, "mu_mboxrd_alloc_message", dmp->name,
+		     mu_strerror (rc)));
+	  break;
+	}
+      num = dmsg->num;
+      *dmsg = *chunk->mesg[i];
+      dmsg->mbox = dmp;
+      dmsg->num = num;
+
+      for (; j < chunk->hline_count && chunk->hline[j].msgno == i; j++)
+	{
+	  struct mboxrd_hline *hl = &chunk->hline[j];
+	  char *buf = linebuf_copy (&lb, chunk->base + hl->off, hl->len);
+	  if (!buf)
+	    {
+	      rc = ENOMEM;
+	      goto err;
+	    }
+	  scan_header_line (dmp, dmsg, buf, hl->len, hl->off, force_init_uids);
+	}
+      
+      scan_message_finalize (dmp, dmsg, dmsg->message_end, force_init_uids);
+      if (dmp->mesg_count % 100 == 0)
+	mboxrd_dispatch (dmp->mailbox, MU_EVT_MAILBOX_PROGRESS, NULL);
+    }
+ err:
+  free (lb.buf);
+  return rc;
+}
+
+/* Scan the region between START and END using multiple threads.  START
+   points to a valid From_ line.  BASE is the start of the mailbox.
+   Return EAGAIN if the region should be scanned sequentially instead. */
+static int
+mboxrd_scan_parallel (struct mu_mboxrd_mailbox *dmp, char const *base,
+		      char const *start, char const *end,
+		      int *force_init_uids)
+{
+  size_t nthreads = mu_mailbox_scan_threads ();
+  size_t chunk_min = mboxrd_scan_chunk_min ();
+  size_t len = end - start;
+  struct mboxrd_chunk *chunks;
+  struct mboxrd_linebuf lb = { NULL, 0 };
+  size_t nchunks, i;
+  int rc = 0;
+
+  if (nthreads > len / chunk_min)
+    nthreads = len / chunk_min;
+  if (nthreads < 2)
+    return EAGAIN;
+
+  chunks = calloc (nthreads, sizeof (chunks[0]));
+  if (!chunks)
+    return ENOMEM;
+
+  /* Split the region at the From_ lines nearest to the equidistant
+     points. */
+  chunks[0].start = start;
+  nchunks = 1;
+  for (i = 1; i < nthreads; i++)
+    {
+      char const *p = start + i * (len / nthreads);
+      char const *q;
+      size_t n;
+      char *ti, *zn;
+
+      if (p < chunks[nchunks-1].start)
+	p = chunks[nchunks-1].start;
+      rc = find_from_line (&lb, p, end, &q, &n, &ti, &zn);
+      if (rc)
+	break;
+      if (!q)
+	break;
+      if (q > chunks[nchunks-1].start)
+	chunks[nchunks++].start = q;
+    }
+  free (lb.buf);
+  
+  if (rc == 0 && nchunks < 2)
+    rc = EAGAIN;
+  if (rc)
+    {
+      free (chunks);
+      return rc;
+    }
+
+  for (i = 0; i < nchunks; i++)
+    {
+      chunks[i].base = base;
+      chunks[i].end = i + 1 < nchunks ? chunks[i+1].start : end;
+    }
+
+  mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_TRACE1,
+	    ("%s: scanning %lu chunks in parallel",
+	     dmp->name, (unsigned long) nchunks));
+
+  /* The first chunk is scanned by the calling thread. */
+  for (i = 1; i < nchunks; i++)
+    {
+      if (pthread_create (&chunks[i].tid, NULL, chunk_thread, &chunks[i]))
+	break;
+      chunks[i].threaded = 1;
+    }
+  /* Chunks for which no thread could be created are scanned here as
+     well. */
+  for (i = 0; i < nchunks; i++)
+    {
+      if (chunks[i].threaded)
+	pthread_join (chunks[i].tid, NULL);
+      else
+	chunk_thread (&chunks[i]);
+    }
+
+  for (i = 0; i < nchunks; i++)
+    {
+      if (chunks[i].rc)
+	{
+	  rc = chunks[i].rc;
+	  break;
+	}
+      /* A From_ line immediately following the header of the preceding
+	 message is not a message boundary.  The sequential scanner would
+	 have treated it as part of the message body. */
+      if (i > 0)
+	{
+	  struct mboxrd_chunk *prev = &chunks[i-1];
+	  struct mu_mboxrd_message *last = prev->mesg[prev->mesg_count - 1];
+	  if (last->body_start == 0
+	      || last->body_start >= chunks[i].start - base)
+	    {
+	      rc = EAGAIN;
+	      break;
+	    }
+	}
+    }
+  
+  for (i = 0; i < nchunks; i++)
+    {
+      if (rc == 0)
+	rc = chunk_merge (dmp, &chunks[i], force_init_uids);
+      chunk_free (&chunks[i]);
+    }
+  free (chunks);
+  return rc;
+}
+#endif
+
+/* Scan the mailbox starting at OFFSET using memory mapping.  Return
+   ENOSYS if the mailbox cannot be mapped. */
+static int
+mboxrd_scan_mapped (struct mu_mboxrd_mailbox *dmp, mu_off_t offset,
+		    int *force_init_uids)
+{
+  mu_transport_t trans[2];
+  long pagesize = sysconf (_SC_PAGESIZE);
+  mu_off_t map_off;
+  size_t map_len;
+  char *map;
+  char const *base, *end, *p;
+  struct mboxrd_linebuf lb = { NULL, 0 };
+  struct mu_mboxrd_message *dmsg;
+  char *buf, *zn, *ti;
+  size_t n;
+  int rc = 0;
+
+  if (pagesize <= 0
+      || mu_stream_ioctl (dmp->mailbox->stream, MU_IOCTL_TRANSPORT,
+			  MU_IOCTL_OP_GET, trans))
+    return ENOSYS;
+  /* Make sure any pending writes are visible through the mapping */
+  rc = mu_stream_flush (dmp->mailbox->stream);
+  if (rc)
+    return rc;
+  
+  map_off = offset - offset % pagesize;
+  map_len = dmp->size - map_off;
+  map = mmap (NULL, map_len, PROT_READ, MAP_SHARED,
+	      (int) (intptr_t) trans[0], map_off);
+  if (map == MAP_FAILED)
+    {
+      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_TRACE1,
+		("%s:%s (%s): %s",
+		 __func__, "mmap", dmp->name, mu_strerror (errno)));
+      return ENOSYS;
+    }
+#ifdef MADV_SEQUENTIAL
+  madvise (map, map_len, MADV_SEQUENTIAL);
+#endif
+  
+  /* Pointer to the start of the mailbox: p - base gives the offset */
+  base = map - map_off;
+  end = map + map_len;
+  p = base + offset;
+
+  /* When scanning appended messages, skip the blank lines separating
+     them from the last known message. */
+  if (offset > 0)
+    {
+      while (p < end && *p == '\n')
+	p++;
+      if (p == end)
+	goto err;
+    }
+
+#define OFFSET(ptr) ((mu_off_t) ((ptr) - base))
+  
+  n = line_length (p, end);
+  if ((buf = linebuf_copy (&lb, p, n)) == NULL)
+    {
+      rc = ENOMEM;
+      goto err;
+    }
+  if ((ti = parse_from_line (buf, &zn)) == NULL)
+    {
+      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
+		("%s does not start with a valid From_ line",
+		 dmp->name));
+      rc = MU_ERR_PARSE;
+      goto err;
+    }
+
+#ifdef WITH_PTHREAD
+  rc = mboxrd_scan_parallel (dmp, base, p, end, force_init_uids);
+  if (rc != EAGAIN)
+    goto err;
+  rc = 0;
+#endif
+  
+  for (;;)
+    {
+      char const *q;
+      
+      if ((dmsg = scan_message_begin (dmp, OFFSET (p), buf, n, ti, zn)) == NULL)
+	{
+	  rc = ENOMEM;
+	  goto err;
+	}
+      p += n;
+
+      /* Scan the header */
+      while (p < end)
+	{
+	  n = line_length (p, end);
+	  if (n == 1 && p[0] == '\n')
+	    {
+	      p++;
+	      dmsg->body_start = OFFSET (p);
+	      break;
+	    }
+	  if (!mu_isspace (p[0])
+	      && scan_header_wanted (dmp, dmsg, p, n, *force_init_uids))
+	    {
+	      if ((buf = linebuf_copy (&lb, p, n)) == NULL)
+		{
+		  rc = ENOMEM;
+		  goto err;
+		}
+	      scan_header_line (dmp, dmsg, buf, n, OFFSET (p),
+				force_init_uids);
+	    }
+	  p += n;
+	}
+
+      /* Look for the next From_ line preceded by an empty line. */
+      q = NULL;
+      if (dmsg->body_start)
+	{
+	  /* The search starts at the newline that terminates the header,
+	     so that an empty first body line is taken into account. */
+	  rc = find_from_line (&lb, p - 1, end, &q, &n, &ti, &zn);
+	  if (rc)
+	    goto err;
+	  buf = lb.buf;
+	}
+      
+      if (!q)
+	{
+	  scan_body_mapped (dmsg, base, end);
+	  scan_message_finalize (dmp, dmsg, dmp->size - 1, force_init_uids);
+	  break;
+	}
+
+      p = q;
+      scan_body_mapped (dmsg, base, p);
+      scan_message_finalize (dmp, dmsg, OFFSET (p) - 1, force_init_uids);
+      if (dmp->mesg_count % 100 == 0)
+	mboxrd_dispatch (dmp->mailbox, MU_EVT_MAILBOX_PROGRESS, NULL);
+    }
+#undef OFFSET
+  
+ err:
+  munmap (map, map_len);
+  free (lb.buf);
+  return rc;
+}
+
+/* Scan the mailbox starting at OFFSET by reading it line by line.  This
+   is used if the mailbox cannot be memory-mapped. */
+static int
+mboxrd_scan_stream (struct mu_mboxrd_mailbox *dmp, mu_off_t offset,
+		    int *force_init_uids)
+{
+  int rc;
+  mu_stream_t stream;
+  char *buf = NULL;
+  size_t bufsize = 0;
+  size_t n;
+  enum mboxrd_scan_state
+  {
+    mboxrd_scan_init,  /* At the beginning of the file */
+    mboxrd_scan_header,/* Scanning message header */
+    mboxrd_scan_body,  /* Scanning message body */
+    mboxrd_scan_empty_line /* At the empty line within or at the end of body */
+  } state = mboxrd_scan_init;
+  struct mu_mboxrd_message *dmsg = NULL;
+  char *zn, *ti;
+  size_t numlines = 0;
+  size_t body_lines = 0, esc_count = 0;
+  mu_off_t off = offset;
+  
+  rc = mu_streamref_create (&stream, dmp->mailbox->stream);
+  if (rc)
+    {
+      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
+		("%s:%s (%s): %s",
+		 __func__, "mu_streamref_create", dmp->name,
+		 mu_strerror (rc)));
+      return rc;
+    }
+
+  rc = mu_stream_seek (stream, offset, MU_SEEK_SET, NULL);
+  if (rc)
+    {
+      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
+		("%s:%s (%s): %s",
+		 __func__, "mu_stream_seek", dmp->name,
+		 mu_strerror (rc)));
+      mu_stream_unref (stream);
+      return rc;
+    }
+
+  /* OFF is the offset of the current line in the mailbox. */
+  for (; (rc = mu_stream_getline (stream, &buf, &bufsize, &n)) == 0
+	 && n > 0; off += n)
+    {
+      switch (state)
+	{
+	case mboxrd_scan_init:
+	  /* Skip the blank lines separating appended messages from the
+	     last known one. */
+	  if (offset > 0 && n == 1 && buf[0] == '\n')
+	    continue;
+	  if ((ti = parse_from_line (buf, &zn)) == 0)
+	    {
+	      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
+			("%s does not start with a valid From_ line",
+			 dmp->name));
+	      rc = MU_ERR_PARSE;
+	      goto err;
+	    }
+	  if ((dmsg = scan_message_begin (dmp, off, buf, n, ti, zn)) == NULL)
+	    {
+	      rc = ENOMEM;
+	      goto err;
+	    }
+	  state = mboxrd_scan_header;
+	  break;
+
+	case mboxrd_scan_header:
+	  if (n == 1 && buf[0] == '\n')
+	    {
+	      dmsg->body_start = off + n;
+	      body_lines = esc_count = 0;
+	      state = mboxrd_scan_body;
+	    }
+	  else if (mu_isspace (buf[0]))
+	    continue;
+	  else
+	    scan_header_line (dmp, dmsg, buf, n, off, force_init_uids);
+	  break;
+
+	case mboxrd_scan_body:
+	  body_lines += buf[n-1] == '\n';
+	  esc_count += is_escaped_from (buf, buf + n);
+	  if (n == 1 && buf[0] == '\n')
+	    {
+	      state = mboxrd_scan_empty_line;
+	    }
+	  break;
+
+	case mboxrd_scan_empty_line:
+	  if ((ti = parse_from_line (buf, &zn)) != 0)
+	    {
+	      scan_body_stats (dmsg, off - 1, body_lines, esc_count);
+	      scan_message_finalize (dmp, dmsg, off - 1, force_init_uids);
+	      if ((dmsg = scan_message_begin (dmp, off, buf, n, ti, zn)) == NULL)
+		{
+		  rc = ENOMEM;
+		  goto err;
+		}
+	      state = mboxrd_scan_header;
+	    }
+	  else
+	    {
+	      body_lines += buf[n-1] == '\n';
+	      esc_count += is_escaped_from (buf, buf + n);
+	      if (n == 1 && buf[0] == '\n')
+		state = mboxrd_scan_empty_line;
+	      else
+		state = mboxrd_scan_body;
+	    }
+	}
+      if (++numlines % 1000 == 0)
+	mboxrd_dispatch (dmp->mailbox, MU_EVT_MAILBOX_PROGRESS, NULL);
+    }
+
+  if (dmsg)
+    {
+      if (dmsg->body_start)
+	scan_body_stats (dmsg, off - 1, body_lines, esc_count);
+      scan_message_finalize (dmp, dmsg, off - 1, force_init_uids);
+    }
+  
+ err:
+  mu_stream_unref (stream);
+  free (buf);
+  return rc;
+}
+
+/* Select the scanner to use.  The mapped scanner is used whenever
+   possible.  Setting MU_MBOXRD_SCANNER=stream in the environment forces
+   the use of the stream scanner (mostly useful for benchmarking). */
+static int
+mboxrd_use_stream_scanner (void)
+{
+  static int stream_scanner = -1;
+  if (stream_scanner == -1)
+    {
+      char *p = getenv ("MU_MBOXRD_SCANNER");
+      stream_scanner = p && strcmp (p, "stream") == 0;
+    }
+  return stream_scanner;
+}
+
+/* Scan the mailbox starting from the given offset.
+ *
+ * Notes on the mailbox format:
+ *
+ *  1. A mailbox consists of a series of messages.
+ * 
+ *  2. Each message is preceded by a From_ line and followed by a blank line.
+ *     A From_ line is a line that begins with the five characters 'F', 'r',
+ *     'o', 'm', and ' ', followed by sender email and delivery date.  The
+ *     From_ line parser is able to handle various From_ line formats
+ *     (differing mainly in date/time format), most of which are encountered
+ *     only in ancient mailboxes.  Nevertheless, this makes escaping of the
+ *     From_ lines less crucial and ensures optimal robustness in handling
+ *     different mailbox formats (mboxo, mboxrd and mboxcl (mboxcl2) are
+ *     all handled properly.
+ *
+ *  3. The From_ lines and the blank lines bracket messages, fore and aft.
+ *     They do not comprise a message divider.  This means, in particular,
+ *     that both bracketing lines should be included in the message octet
+ *     and line counts.  However, counting the From_ line goes against
+ *     the mailutils approach of logically dividing envelope and the rest
+ *     of the message and would create useless differences compared to
+ *     another mailbox formats.  For this reason, the From_ line is not
+ *     reflected in returns from the mu_message_size and mu_message_lines
+ *     functions.  The terminating blank line, on the contrary, is assumed
+ *     to be part of the message body and is counted in body and message
+ *     size and line count computations.
+ *
+ *  4. A mailbox that contains zero messages contains no lines.
+ *
+ *  5. The first message in the mailbox is not preceded by a blank line.
+ *     The last message in the mailbox is not followed by a From_ line.
+ * 
+ *  6. If a non-empty file does not have valid From_ construct in its
+ *     first physical line, it will be rejected by the parser.
+ *
+ *  7. A message may contain blank lines.  It should not, however, contain
+ *     lines beginning with the sequence 'F', 'r', 'o', 'm', ' '.
+ *
+ *  8. When incorporating a message into the mailbox, any line in the message
+ *     body that begins with zero or more '>' characters immediately followed
+ *     by the sequence 'F', 'r', 'o', 'm', ' ', is escaped by prepending it
+ *     with a '>' character.  Thus, "From " becomes ">From ", ">From "
+ *     becomes ">>From ", and so on.  When reading the message body, a
+ *     reverse operation is performed.
+ *
+ *  9. Last message in the mailbox is allowed to end with a partial last line
+ *     (i.e. the one whose final characters are not two newlines).  The message
+ *     will be handled as usual.  When a new message is incorporated to the
+ *     mailbox, the missing newlines will be added to the end of the last
+ *     message.
+ */
+static int
+mboxrd_rescan_unlocked (mu_mailbox_t mailbox, mu_off_t offset)
+{
+  struct mu_mboxrd_mailbox *dmp = mailbox->data;
+  int rc;
+  int force_init_uids = 0;
+  size_t count;
+
+  rc = mu_stream_size (mailbox->stream, &dmp->size);
+  if (rc)
+    return rc;
+  if (offset == dmp->size)
+    return 0;
+  if (!(dmp->stream_flags & MU_STREAM_READ))
+    return 0;
+
+  if (offset == 0 && dmp->mesg_count == 0 && mu_mailbox_index_enabled ()
+      && mu_mboxrd_index_load (dmp, &offset) == 0)
+    {
+      size_t i;
 
-	case mboxrd_scan_empty_line:
-	  if ((ti = parse_from_line (buf, &zn)) != 0)
-	    {
-	      if (scan_message_finalize (dmp, dmsg, stream, n, &force_init_uids))
-		goto err;
-	      if ((dmsg = scan_message_begin (dmp, stream, buf, n, ti, zn)) == NULL)
-		goto err;
-	      state = mboxrd_scan_header;
-	    }
-	  else if (n == 1 && buf[0] == '\n')
-	    state = mboxrd_scan_empty_line;
-	  else
-	    state = mboxrd_scan_body;
+      for (i = 1; i <= dmp->mesg_count; i++)
+	{
+	  size_t count = i;
+	  mboxrd_dispatch (mailbox, MU_EVT_MESSAGE_ADD, &count);
+	}
+      if (offset == dmp->size)
+	{
+	  mu_mboxrd_tail_update (dmp);
+	  return 0;
 	}
-      if (++numlines % 1000 == 0)
-	mboxrd_dispatch (mailbox, MU_EVT_MAILBOX_PROGRESS, NULL);
     }
 
-  if (dmsg)
-    {
-      if (scan_message_finalize (dmp, dmsg, stream, 0, &force_init_uids))
-	goto err;
-    }
-  
- err:
+  count = dmp->mesg_count;
+  if (mboxrd_use_stream_scanner ()
+      || (rc = mboxrd_scan_mapped (dmp, offset, &force_init_uids)) == ENOSYS)
+    rc = mboxrd_scan_stream (dmp, offset, &force_init_uids);
+
   if (rc)
     {
       mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
 		("%s:%s (%s): %s",
-		 __func__, "mu_stream_read", dmp->name,
+		 __func__, "scan", dmp->name,
 		 mu_strerror (rc)));
     }
-  mu_stream_unref (stream);
-  free (buf);
+  else
+    {
+      if (count > 0 && dmp->mesg[count - 1]->message_end + 1 == offset)
+	{
+	  mu_off_t end = count < dmp->mesg_count
+	                   ? dmp->mesg[count]->message_start
+	                   : dmp->size;
+	  if (end > offset)
+	    scan_extend_message (dmp->mesg[count - 1], end);
+	}
+      mu_mboxrd_tail_update (dmp);
+    }
   
   if (force_init_uids)
     {
@@ -843,13 +1667,26 @@ static int
 mboxrd_refresh (mu_mailbox_t mailbox)
 {
   struct mu_mboxrd_mailbox *dmp = mailbox->data;
-
+  size_t count;
+  int scanned;
+  int rc;
+  
   if (mboxrd_is_updated (mailbox))
     return 0;
-  return mboxrd_rescan (mailbox,
-			 dmp->mesg_count == 0
-			   ? 0
-			   : dmp->mesg[dmp->mesg_count - 1]->message_end + 1);
+  /* Only appended messages can be picked up incrementally.  In other
+     cases, the observers have been notified and the mailbox must be
+     reopened. */
+  if (mboxrd_classify_change (dmp) != mboxrd_appended)
+    return 0;
+  count = dmp->mesg_count;
+  scanned = dmp->size > 0;
+  rc = mboxrd_rescan (mailbox,
+		      dmp->mesg_count == 0
+		        ? 0
+		        : dmp->mesg[dmp->mesg_count - 1]->message_end + 1);
+  if (rc == 0 && scanned)
+    mboxrd_notify_new_messages (dmp, count);
+  return rc;
 }
 
 static int
@@ -1248,6 +2085,50 @@ mailbox_append_message (mu_mailbox_t mailbox, mu_message_t msg,
   return 0;
 }
 
+/* Return true if the mailbox file has been replaced by another one
+   (e.g. by mboxrd_flush in another process) since it was opened. */
+static int
+mboxrd_is_replaced (struct mu_mboxrd_mailbox *dmp)
+{
+  mu_transport_t trans[2];
+  struct stat st, fst;
+
+  if (mu_stream_ioctl (dmp->mailbox->stream, MU_IOCTL_TRANSPORT,
+		       MU_IOCTL_OP_GET, trans)
+      || fstat ((int) (intptr_t) trans[0], &fst)
+      || stat (dmp->name, &st))
+    return 0;
+  return st.st_dev != fst.st_dev || st.st_ino != fst.st_ino;
+}
+
+/* Reopen the mailbox stream and rescan the mailbox.  Must be called
+   with the mailbox locked. */
+static int
+mboxrd_reopen_unlocked (mu_mailbox_t mailbox)
+{
+  struct mu_mboxrd_mailbox *dmp = mailbox->data;
+  size_t i;
+  int rc;
+
+  mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_TRACE1,
+	    ("%s (%s)", __func__, dmp->name));
+  for (i = 0; i < dmp->mesg_count; i++)
+    mu_mboxrd_message_free (dmp->mesg[i]);
+  dmp->mesg_count = 0;
+  dmp->size = 0;
+  dmp->tail_len = 0;
+  dmp->uidvalidity = 0;
+  dmp->uidnext = 1;
+  dmp->uidvalidity_scanned = 0;
+  dmp->uidvalidity_changed = 0;
+  dmp->x_imapbase_off = dmp->x_imapbase_len = 0;
+  mu_stream_destroy (&mailbox->stream);
+  rc = mboxrd_mailbox_init_stream (dmp);
+  if (rc == 0)
+    rc = mboxrd_rescan_unlocked (mailbox, 0);
+  return rc;
+}
+
 static int
 mboxrd_append_message (mu_mailbox_t mailbox, mu_message_t msg,
 		       mu_envelope_t env, mu_attribute_t atr)
@@ -1269,7 +2150,13 @@ mboxrd_append_message (mu_mailbox_t mailbox, mu_message_t msg,
     }
   else
     {
-      rc = mailbox_append_message (mailbox, msg, env, atr);
+      /* A mailbox opened for appending may have been rewritten by
+	 another process while we were waiting for the lock.  Appending
+	 to the old file would lose the message. */
+      if ((mailbox->flags & MU_STREAM_APPEND) && mboxrd_is_replaced (dmp))
+	rc = mboxrd_reopen_unlocked (mailbox);
+      if (rc == 0)
+	rc = mailbox_append_message (mailbox, msg, env, atr);
 
       if (mailbox->locker)
 	mu_locker_unlock (mailbox->locker);
@@ -1620,22 +2507,297 @@ mboxrd_copyback (struct mu_mboxrd_flush_tracker *trk, mu_stream_t tempstr)
   return 0;
 }
 
-/* Flush the mailbox described by the tracker TRK to the stream TEMPSTR.
-   EXPUNGE is 1 if the MU_ATTRIBUTE_DELETED attribute is to be honored.
-   Assumes that simultaneous access to the mailbox has been blocked.
+/* Save the changes in the mailbox described by TRK, starting from the
+   message DIRTY, by writing the mailbox to a temporary file and renaming
+   it over the original one.  If the spool directory is not writable,
+   the temporary file is created elsewhere and copied back to the
+   mailbox.  EXPUNGE is 1 if the MU_ATTRIBUTE_DELETED attribute is to be
+   honored.
 */
 static int
-mboxrd_flush_unlocked (struct mu_mboxrd_flush_tracker *trk, int mode)
+mboxrd_flush_rewrite (struct mu_mboxrd_flush_tracker *trk, size_t dirty,
+		      int expunge)
 {
   struct mu_mboxrd_mailbox *dmp = trk->dmp;
   int rc;
-  size_t dirty;
   mu_stream_t tempstr;
   struct mu_tempfile_hints hints;
   int tempfd;
   char *tempname;
   char *p;
 
+  p = strrchr (dmp->name, '/');
+  if (p)
+    {
+      size_t l = p - dmp->name;
+      hints.tmpdir = malloc (l + 1);
+      if (!hints.tmpdir)
+	return ENOMEM;
+      memcpy (hints.tmpdir, dmp->name, l);
+      hints.tmpdir[l] = 0;
+    }
+  else
+    {
+      hints.tmpdir = mu_getcwd ();
+      if (!hints.tmpdir)
+	return ENOMEM;
+    }
+  rc = mu_tempfile (&hints, MU_TEMPFILE_TMPDIR, &tempfd, &tempname);
+  if (rc == 0)
+    {
+      rc = mu_fd_stream_create (&tempstr, tempname, tempfd,
+				MU_STREAM_RDWR|MU_STREAM_SEEK);
+    }
+  else if (rc == EACCES)
+    {
+      /*
+       * Mail spool directory is not writable for the user. Fall
+       * back to using temporary stream located elsewhere. When
+       * ready, it will be copied back to the mailbox.
+       *
+       * Reset the tempname to NULL to instruct the code below
+       * which approach to take.
+       */
+      tempname = NULL;
+
+      rc = mu_temp_file_stream_create (&tempstr, NULL, 0);
+    }
+
+  if (rc)
+    {
+      free (hints.tmpdir);
+      close (tempfd);
+      free (tempname);
+      return rc;
+    }
+
+  rc = mboxrd_flush_temp (trk, dirty, tempstr, expunge);
+  if (rc == 0)
+    {
+      if (tempname)
+	{
+	  /* Mail spool is writable. Rename the temporary copy back
+	     to mailbox */
+	  char *backup;
+	  struct stat st;
+
+	  if ((rc = mboxrd_stat (dmp->mailbox, &st)) != 0)
+	    {
+	      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
+			("%s:%s: stat failed: %s",
+			 __func__, dmp->name, strerror (errno)));
+	    }
+	  else
+	    {
+	      mu_stream_flush (tempstr);
+	      backup = mu_tempname (hints.tmpdir);
+	      if (rename (dmp->name, backup))
+		{
+		  rc = errno;
+		  mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
+			    ("%s:%s: failed to rename to backup file %s: %s",
+			     __func__, dmp->name, tempname,
+			     mu_strerror (rc)));
+		  unlink (backup);
+		}
+	      else
+		{
+		  rc = rename (tempname, dmp->name);
+		  if (rc == 0)
+		    {
+		      /* Success. Synchronize internal data with the
+			 counter. */
+		      mboxrd_tracker_sync (trk);
+		      mu_stream_destroy (&dmp->mailbox->stream);
+		      rc = mboxrd_mailbox_init_stream (dmp);
+		      if (rc == 0)
+			mboxrd_set_priv (dmp, &st);
+		    }
+		  else
+		    {
+		      int rc1;
+		      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
+				("%s: failed to rename temporary file %s %s: %s",
+				 __func__, tempname, dmp->name,
+				 mu_strerror (rc)));
+		      rc1 = rename (backup, dmp->name);
+		      if (rc1)
+			{
+			  mu_error (_("failed to restore %s from backup %s: %s"),
+				    dmp->name, backup, mu_strerror (rc1));
+			  mu_error (_("backup left in %s"), backup);
+			  free (backup);
+			  backup = NULL;
+			}
+		    }
+		}
+
+	      if (backup)
+		{
+		  unlink (backup);
+		  free (backup);
+		}
+	      unlink (tempname);
+	    }
+	}
+      else
+	{
+	  /* Mail spool not writable.  Copy the tempstr back to mailbox. */
+	  rc = mboxrd_copyback (trk, tempstr);
+	}
+    }
+  free (tempname);
+  free (hints.tmpdir);
+  mu_stream_unref (tempstr);
+  return rc;
+}
+
+/* Return true if the changes to the mailbox DMP, starting from the
+   message DIRTY, can be saved by in-place compaction, i.e. if they
+   consist only of deleting messages.  EXPUNGE is 1 if the
+   MU_ATTRIBUTE_DELETED attribute is to be honored. */
+static int
+mboxrd_can_compact (struct mu_mboxrd_mailbox *dmp, size_t dirty, int expunge)
+{
+  size_t i;
+  int keep = dirty > 0;
+
+  if (!expunge)
+    return 0;
+  for (i = dirty; i < dmp->mesg_count; i++)
+    {
+      struct mu_mboxrd_message *dmsg = dmp->mesg[i];
+
+      if (dmsg->attr_flags & MU_ATTRIBUTE_DELETED)
+	continue;
+      if (dmsg->uid_modified
+	  || (dmsg->attr_flags & MU_ATTRIBUTE_MODIFIED)
+	  || (dmsg->message && mu_message_is_modified (dmsg->message)))
+	return 0;
+      keep = 1;
+    }
+  /*
+   * If the first message is deleted, its X-IMAPbase header must be
+   * transferred to the first surviving message, which involves
+   * reformatting it.
+   */
+  return !(keep && (dmp->mesg[0]->attr_flags & MU_ATTRIBUTE_DELETED));
+}
+
+/* Expunge deleted messages from the mailbox described by TRK by moving
+   the surviving messages that follow the first deleted one (DIRTY)
+   towards the beginning of the file.  The mailbox must satisfy
+   mboxrd_can_compact.  Return ENOSYS if compaction could not be
+   started, in which case the mailbox is left unchanged.
+*/
+static int
+mboxrd_flush_compact (struct mu_mboxrd_flush_tracker *trk, size_t dirty)
+{
+  struct mu_mboxrd_mailbox *dmp = trk->dmp;
+  struct mu_mboxrd_move *mv;
+  struct mu_mboxrd_journal *jrn;
+  size_t nmv = 0;
+  size_t i, j;
+  size_t expcount = 0;
+  mu_off_t pos, size;
+  int rc;
+
+  mv = calloc (dmp->mesg_count, sizeof (mv[0]));
+  if (!mv)
+    return ENOMEM;
+
+  /* Compute the moves and the resulting mailbox size */
+  pos = dmp->mesg[dirty]->message_start;
+  size = dirty > 0 ? dmp->mesg[dirty - 1]->message_end + 1 : 0;
+  for (i = dirty; i < dmp->mesg_count; )
+    {
+      mu_off_t end;
+
+      if (dmp->mesg[i]->attr_flags & MU_ATTRIBUTE_DELETED)
+	{
+	  i++;
+	  continue;
+	}
+      for (j = i; j < dmp->mesg_count
+	     && !(dmp->mesg[j]->attr_flags & MU_ATTRIBUTE_DELETED); j++)
+	;
+      end = j == dmp->mesg_count
+	      ? dmp->mesg[j - 1]->message_end + 1
+	      : dmp->mesg[j]->message_start;
+      mv[nmv].src = dmp->mesg[i]->message_start;
+      mv[nmv].dst = pos;
+      mv[nmv].len = end - mv[nmv].src;
+      size = pos + dmp->mesg[j - 1]->message_end + 1 - mv[nmv].src;
+      pos += mv[nmv].len;
+      nmv++;
+      i = j;
+    }
+
+  rc = mu_stream_flush (dmp->mailbox->stream);
+  if (rc == 0)
+    rc = mu_mboxrd_journal_begin (dmp, mv, nmv, size, &jrn);
+  if (rc)
+    {
+      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_TRACE1,
+		("%s: can't compact in place: %s", dmp->name,
+		 mu_strerror (rc)));
+      free (mv);
+      return ENOSYS;
+    }
+
+  mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_TRACE1,
+	    ("%s: compacting in place from offset %lu, %lu ranges to move",
+	     dmp->name, (unsigned long) dmp->mesg[dirty]->message_start,
+	     (unsigned long) nmv));
+  rc = mu_mboxrd_journal_run (jrn);
+  if (rc == 0)
+    {
+      /* Synchronize the message data with the new mailbox layout */
+      mu_off_t off = 0;
+
+      for (i = 0, j = 0; i < dmp->mesg_count; i++)
+	{
+	  struct mu_mboxrd_message *dmsg = dmp->mesg[i];
+
+	  if (i >= dirty && (dmsg->attr_flags & MU_ATTRIBUTE_DELETED))
+	    {
+	      size_t expevt[2] = { i + 1, expcount };
+	      mu_observable_notify (dmp->mailbox->observable,
+				    MU_EVT_MAILBOX_MESSAGE_EXPUNGE,
+				    expevt);
+	      expcount++;
+	      mu_message_destroy (&dmsg->message, dmsg);
+	      continue;
+	    }
+	  if (j < nmv && dmsg->message_start == mv[j].src)
+	    {
+	      off = mv[j].dst - mv[j].src;
+	      j++;
+	    }
+	  dmsg = tracker_next_ref (trk, i);
+	  dmsg->message_start += off;
+	  dmsg->body_start += off;
+	  dmsg->message_end += off;
+	}
+      mboxrd_tracker_sync (trk);
+      mu_stream_destroy (&dmp->mailbox->stream);
+      rc = mboxrd_mailbox_init_stream (dmp);
+    }
+  free (mv);
+  return rc;
+}
+
+/* Flush the mailbox described by the tracker TRK to the stream TEMPSTR.
+   EXPUNGE is 1 if the MU_ATTRIBUTE_DELETED attribute is to be honored.
+   Assumes that simultaneous access to the mailbox has been blocked.
+*/
+static int
+mboxrd_flush_unlocked (struct mu_mboxrd_flush_tracker *trk, int mode)
+{
+  struct mu_mboxrd_mailbox *dmp = trk->dmp;
+  int rc;
+  size_t dirty;
+
   mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_TRACE1,
 	    ("%s (%s)", __func__, dmp->name));
   if (dmp->mesg_count == 0)
@@ -1643,9 +2805,22 @@ mboxrd_flush_unlocked (struct mu_mboxrd_flush_tracker *trk, int mode)
   if (mode == FLUSH_UIDVALIDITY && !dmp->uidvalidity_changed)
     return 0;
   
-  rc = mboxrd_refresh (dmp->mailbox);
-  if (rc)
-    return rc;
+  switch (mboxrd_classify_change (dmp))
+    {
+    case mboxrd_unchanged:
+      break;
+
+    case mboxrd_appended:
+      rc = mboxrd_refresh (dmp->mailbox);
+      if (rc)
+	return rc;
+      break;
+
+    default:
+      /* Message offsets are meaningless if the mailbox was rewritten
+	 by another program.  Refuse to overwrite it. */
+      return MU_ERR_MBX_CHANGED;
+    }
 
   if (dmp->uidvalidity_changed)
     {
@@ -1723,129 +2898,11 @@ mboxrd_flush_unlocked (struct mu_mboxrd_flush_tracker *trk, int mode)
   rc = 0;
   if (dirty < dmp->mesg_count)
     {
-      p = strrchr (dmp->name, '/');
-      if (p)
-	{
-	  size_t l = p - dmp->name;
-	  hints.tmpdir = malloc (l + 1);
-	  if (!hints.tmpdir)
-	    return ENOMEM;
-	  memcpy (hints.tmpdir, dmp->name, l);
-	  hints.tmpdir[l] = 0;
-	}
-      else
-	{
-	  hints.tmpdir = mu_getcwd ();
-	  if (!hints.tmpdir)
-	    return ENOMEM;
-	}
-      rc = mu_tempfile (&hints, MU_TEMPFILE_TMPDIR, &tempfd, &tempname);
-      if (rc == 0)
-	{
-	  rc = mu_fd_stream_create (&tempstr, tempname, tempfd,
-				    MU_STREAM_RDWR|MU_STREAM_SEEK);
-	}
-      else if (rc == EACCES)
-	{
-	  /*
-	   * Mail spool directory is not writable for the user. Fall
-	   * back to using temporary stream located elsewhere. When
-	   * ready, it will be copied back to the mailbox.
-	   *
-	   * Reset the tempname to NULL to instruct the code below
-	   * which approach to take.
-	   */
-	  tempname = NULL;
-
-	  rc = mu_temp_file_stream_create (&tempstr, NULL, 0);
-	}
-
-      if (rc)
-	{
-	  free (hints.tmpdir);
-	  close (tempfd);
-	  free (tempname);
-	  return rc;
-	}
-      
-      rc = mboxrd_flush_temp (trk, dirty, tempstr, mode == FLUSH_EXPUNGE);
-      if (rc == 0)
-	{
-	  if (tempname)
-	    {
-	      /* Mail spool is writable. Rename the temporary copy back
-		 to mailbox */
-	      char *backup;
-	      struct stat st;
-
-	      if ((rc = mboxrd_stat (dmp->mailbox, &st)) != 0)
-		{
-		  mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
-			    ("%s:%s: stat failed: %s",
-			     __func__, dmp->name, strerror (errno)));
-		}
-	      else
-		{
-		  mu_stream_flush (tempstr);
-		  backup = mu_tempname (hints.tmpdir);
-		  if (rename (dmp->name, backup))
-		    {
-		      rc = errno;
-		      mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
-				("%s:%s: failed to rename to backup file %s: %s",
-				 __func__, dmp->name, tempname,
-				 mu_strerror (rc)));
-		      unlink (backup);
-		    }
-		  else
-		    {
-		      rc = rename (tempname, dmp->name);
-		      if (rc == 0)
-			{
-			  /* Success. Synchronize internal data with the
-			     counter. */
-			  mboxrd_tracker_sync (trk);
-			  mu_stream_destroy (&dmp->mailbox->stream);
-			  rc = mboxrd_mailbox_init_stream (dmp);
-			  if (rc == 0)
-			    mboxrd_set_priv (dmp, &st);
-			}
-		      else
-			{
-			  int rc1;
-			  mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_ERROR,
-				    ("%s: failed to rename temporary file %s %s: %s",
-				     __func__, tempname, dmp->name,
-				     mu_strerror (rc)));
-			  rc1 = rename (backup, dmp->name);
-			  if (rc1)
-			    {
-			      mu_error (_("failed to restore %s from backup %s: %s"),
-					dmp->name, backup, mu_strerror (rc1));
-			      mu_error (_("backup left in %s"), backup);
-			      free (backup);
-			      backup = NULL;
-			    }
-			}
-		    }
-	  
-		  if (backup)
-		    {
-		      unlink (backup);
-		      free (backup);
-		    }
-		  unlink (tempname);
-		}
-	    }
-	  else
-	    {
-	      /* Mail spool not writable.  Copy the tempstr back to mailbox. */
-	      rc = mboxrd_copyback (trk, tempstr);
-	    }
-	}
-      free (tempname);
-      free (hints.tmpdir);
-      mu_stream_unref (tempstr);
+      rc = ENOSYS;
+      if (mboxrd_can_compact (dmp, dirty, mode == FLUSH_EXPUNGE))
+	rc = mboxrd_flush_compact (trk, dirty);
+      if (rc == ENOSYS)
+	rc = mboxrd_flush_rewrite (trk, dirty, mode == FLUSH_EXPUNGE);
     }
   
   dmp->uidvalidity_changed = 0;  
@@ -1894,6 +2951,8 @@ mboxrd_flush (struct mu_mboxrd_mailbox *dmp, int mode)
     {
       rc = mboxrd_flush_unlocked (&trk, mode);
       tracker_free (&trk);
+      if (rc == 0)
+	mu_mboxrd_tail_update (dmp);
     }
 
 #ifdef WITH_PTHREAD
@@ -2055,7 +3114,10 @@ mboxrd_is_scheme (mu_record_t record, mu_url_t url, int flags)
 
       if (S_ISREG (st.st_mode) || S_ISCHR (st.st_mode))
 	{
-	  if (st.st_size == 0)
+	  /* Don't look into the file if the scheme is given explicitly:
+	     another process may be writing it right now, so that its
+	     content need not yet look like a mailbox. */
+	  if (st.st_size == 0 || scheme_matched)
 	    {
 	      rc |= MU_FOLDER_ATTRIBUTE_FILE;
 	    }
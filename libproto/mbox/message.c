@@ -16,6 +16,7 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
 #include <mailutils/sys/mboxrd.h>
 #include <mailutils/sys/mailbox.h>
 #include <mailutils/sys/message.h>
@@ -37,6 +38,7 @@ mu_mboxrd_message_free (struct mu_mboxrd_message *dmsg)
   if (dmsg)
     {
       mu_message_destroy (&dmsg->message, dmsg);
+      free (dmsg->uidl);
       free (dmsg);
     }
 }
@@ -102,6 +104,10 @@ mboxrd_message_body_scan (struct mu_mboxrd_message *dmsg)
 
   if (dmsg->body_lines_scanned)
     return 0;
+
+  mu_debug (MU_DEBCAT_MAILBOX, MU_DEBUG_TRACE1,
+	    ("%s: scanning body of message %lu",
+	     dmsg->mbox->name, (unsigned long) dmsg->num + 1));
   
   rc = mu_streamref_create_abridged (&stream,
 				     dmsg->mbox->mailbox->stream,
@@ -331,6 +337,62 @@ mboxrd_message_uid (mu_message_t msg, size_t *puid)
   return rc;
 }
 
+/* Return the POP3 UIDL of the message.  An existing X-UIDL header takes
+   precedence, so that the identifiers handed out by the generic code in
+   the past remain valid.  Otherwise, the UIDL is derived from the
+   mailbox UIDVALIDITY and the message UID, which avoids reading the
+   message body.  The value is cached in DMSG.  */
+static int
+mboxrd_message_uidl (mu_message_t msg, char *buffer, size_t buflen,
+		     size_t *pwriten)
+{
+  struct mu_mboxrd_message *dmsg = mu_message_get_owner (msg);
+  struct mu_mboxrd_mailbox *dmp = dmsg->mbox;
+  size_t len;
+  int rc;
+
+  if (!dmsg->uidl)
+    {
+      mu_header_t header;
+
+      rc = mu_message_get_header (msg, &header);
+      if (rc)
+	return rc;
+      rc = mu_header_aget_value_unfold (header, MU_HEADER_X_UIDL,
+					&dmsg->uidl);
+      if (rc == 0 && dmsg->uidl[0] == 0)
+	{
+	  free (dmsg->uidl);
+	  dmsg->uidl = NULL;
+	  rc = MU_ERR_NOENT;
+	}
+      if (rc == MU_ERR_NOENT)
+	{
+	  rc = mu_mboxrd_mailbox_uid_setup (dmp);
+	  if (rc)
+	    return rc;
+	  /* UIDs that cannot be saved would change in the next session.
+	     Let the caller fall back to the default method. */
+	  if (dmp->uidvalidity_changed
+	      && !(dmp->stream_flags & MU_STREAM_WRITE))
+	    return ENOSYS;
+	  rc = mu_asprintf (&dmsg->uidl, "%lu.%lu",
+			    dmp->uidvalidity, dmsg->uid);
+	}
+      if (rc)
+	return rc;
+    }
+
+  len = strlen (dmsg->uidl);
+  if (len >= buflen)
+    len = buflen - 1;
+  memcpy (buffer, dmsg->uidl, len);
+  buffer[len] = 0;
+  if (pwriten)
+    *pwriten = len;
+  return 0;
+}
+
 static int
 mboxrd_message_qid (mu_message_t msg, mu_message_qid_t *pqid)
 {
@@ -398,6 +460,7 @@ mu_mboxrd_message_get (struct mu_mboxrd_message *dmsg, mu_message_t *mptr)
       
       /* Set the UID.  */
       mu_message_set_uid (msg, mboxrd_message_uid, dmsg);
+      mu_message_set_uidl (msg, mboxrd_message_uidl, dmsg);
       mu_message_set_qid (msg, mboxrd_message_qid, dmsg);
 
       /* Attach the message to the mailbox mbox data.  */
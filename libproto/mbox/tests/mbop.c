@@ -1,3 +1,29 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <mailutils/sys/mboxrd.h>
+
 #define MBOP_RECORD mu_mbox_record
 #define MBOP_SCHEME "mbox"
+#define MBOP_PRE_OPEN_HOOK mbop_pre_open_hook
+
+/* If the MU_MBOXRD_COMPACT_ABORT environment variable is set to N,
+   terminate the process after N blocks have been written to the
+   mailbox during in-place compaction.  This is used to test recovery
+   of interrupted compaction. */
+static long compact_abort_count;
+
+static void
+compact_abort (void)
+{
+  if (--compact_abort_count == 0)
+    _exit (EXIT_FAILURE);
+}
+
+static void
+mbop_pre_open_hook (void)
+{
+  char *env = getenv ("MU_MBOXRD_COMPACT_ABORT");
+  if (env && (compact_abort_count = strtol (env, NULL, 10)) > 0)
+    mu_mboxrd_compact_hook = compact_abort;
+}
 #include "testsuite/mbop.c"
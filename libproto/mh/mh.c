@@ -277,7 +277,7 @@ mh_scan0 (mu_mailbox_t mailbox, size_t msgno MU_ARG_UNUSED, size_t *pcount,
 	}
   
       if (stat (amd->name, &st) == 0)
-	amd->mtime = st.st_mtime;
+	amd_stat_mtime (&st, &amd->mtime);
 
       if (pcount)
 	*pcount = amd->msg_count;
@@ -355,6 +355,31 @@ mh_size (mu_mailbox_t mailbox, mu_off_t *psize)
 }
 
 
+/* Count messages in the folder.  Unlike mh_size, this needs no
+   stat calls. */
+static int
+mh_count (struct _amd_data *amd, size_t *pcount)
+{
+  DIR *dir;
+  struct dirent *entry;
+  size_t count = 0;
+
+  dir = opendir (amd->name);
+  if (!dir)
+    return errno;
+
+  while ((entry = readdir (dir)))
+    {
+      if (*mu_str_skip_class (entry->d_name, MU_CTYPE_DIGIT) == 0)
+	count++;
+    }
+
+  closedir (dir);
+  *pcount = count;
+
+  return 0;
+}
+
 static int
 mh_qfetch (struct _amd_data *amd, mu_message_qid_t qid)
 {
@@ -522,6 +547,7 @@ _mailbox_mh_init (mu_mailbox_t mailbox)
   amd->remove = mh_remove;
   amd->capabilities = MU_AMD_DASHDELIM;
   amd->mailbox_size = mh_size;
+  amd->mailbox_count = mh_count;
   
   mailbox->_get_property = mh_get_property;
   mailbox->_translate = mh_translate;
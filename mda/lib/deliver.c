@@ -172,6 +172,71 @@ mda_run_delivery (mda_delivery_fn delivery_fun, int argc, char **argv)
   return exit_code;
 }
 
+/* Account for the message MSG delivered to MBOX in the usage ledger of
+   the recipient, if the mailbox is located in the recipient's home
+   directory. */
+static void
+update_usage_ledger (mu_mailbox_t mbox, mu_message_t msg,
+		     struct mu_auth_data *auth)
+{
+  mu_url_t url;
+  char const *path;
+  size_t len, size;
+  int rc;
+
+  if (!auth->dir
+      || mu_mailbox_get_url (mbox, &url)
+      || mu_url_sget_path (url, &path))
+    return;
+  len = strlen (auth->dir);
+  while (len > 1 && auth->dir[len-1] == '/')
+    len--;
+  if (strncmp (path, auth->dir, len) || path[len] != '/')
+    return;
+  if (mu_message_size (msg, &size))
+    return;
+  rc = mu_usage_ledger_update (auth->dir, size, NULL);
+  if (rc && rc != ENOENT)
+    mda_error (_("cannot update usage ledger in %s: %s"),
+	       auth->dir, mu_strerror (rc));
+}
+
+/* If the mailbox MBOX has a full-text index, add the newly delivered
+   messages to it.  The mailbox is reopened for reading, since its
+   messages cannot be accessed in append mode. */
+static void
+update_text_index (mu_mailbox_t mbox)
+{
+  mu_url_t url;
+  mu_mailbox_t rdbox;
+  txtidx_t idx;
+  int rc;
+
+  if (mu_mailbox_get_url (mbox, &url) || mu_url_dup (url, &url))
+    return;
+  rc = mu_mailbox_create_from_url (&rdbox, url);
+  if (rc)
+    {
+      mu_url_destroy (&url);
+      return;
+    }
+  rc = mu_mailbox_open (rdbox, MU_STREAM_READ);
+  if (rc == 0)
+    {
+      rc = txtidx_open (rdbox, TXTIDX_APPEND, &idx);
+      if (rc == 0)
+	{
+	  rc = txtidx_update (idx, rdbox);
+	  if (rc)
+	    mda_error (_("cannot update text index %s: %s"),
+		       txtidx_file (idx), mu_strerror (rc));
+	  txtidx_close (&idx);
+	}
+      mu_mailbox_close (rdbox);
+    }
+  mu_mailbox_destroy (&rdbox);
+}
+
 static int
 deliver_to_mailbox (mu_mailbox_t mbox, mu_message_t msg,
 		    struct mu_auth_data *auth,
@@ -287,11 +352,15 @@ deliver_to_mailbox (mu_mailbox_t mbox, mu_message_t msg,
 			    path, mu_strerror (status));
 	      failed++;
 	    }
+	  else if (auth)
+	    update_usage_ledger (mbox, msg, auth);
 	}
     }
 
   mu_mailbox_close (mbox);
   mu_locker_unlock (lock);
+  if (!failed)
+    update_text_index (mbox);
   return failed ? exit_code : 0;
 }
 
@@ -61,6 +61,7 @@
 
 #include <mailutils/mailutils.h>
 #include "muscript.h"
+#include "muaux.h"
 
 /* mailquota settings */
 enum {
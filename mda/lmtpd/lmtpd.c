@@ -22,6 +22,7 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <sys/un.h>
+#include <sys/wait.h>
 
 static const char *program_version = "lmtpd (" PACKAGE_STRING ")";
 
@@ -29,6 +30,7 @@ static mu_m_server_t server;
 static int reuse_lmtp_address = 1;
 static int mda_transcript;
 static mu_list_t lmtp_groups;
+static size_t delivery_workers = 1;
 
 static int
 cb2_group (const char *gname, void *data)
@@ -139,6 +141,9 @@ struct mu_cfg_param lmtp_cfg_param[] = {
     N_("url: string") },
   { "reuse-address", mu_c_bool, &reuse_lmtp_address, 0, NULL,
     N_("Reuse existing address (LMTP mode).  Default is \"yes\".") },
+  { "delivery-workers", mu_c_size, &delivery_workers, 0, NULL,
+    N_("Deliver to at most this number of recipients in parallel.  "
+       "Default is 1, i.e. deliver sequentially.") },
   { "filter", mu_cfg_section, NULL, 0, NULL,
     N_("Add a message filter") },
   { ".server", mu_cfg_section, NULL, 0, NULL,
@@ -187,6 +192,9 @@ main (int argc, char **argv)
   mu_locker_defaults.retry_sleep = 1;
   mu_locker_defaults.retry_count = 300;
 
+  /* Reuse SMTP connections for forwarded and redirected messages */
+  mu_mailer_cache_size = 4;
+
   /* Register needed modules */
   MU_AUTH_REGISTER_ALL_MODULES ();
 
@@ -504,14 +512,11 @@ dot_temp_fail (void *item, void *cbdata)
   return 0;
 }
 
-static int
-dot_deliver (void *item, void *cbdata)
+static void
+delivery_reply (mu_stream_t iostr, char const *name, int status,
+		char const *errp)
 {
-  char *name = item;
-  mu_stream_t iostr = cbdata;
-  char *errp = NULL;
-  
-  switch (mda_deliver_to_user (mesg, name, &errp))
+  switch (status)
     {
     case 0:
       lmtp_reply (iostr, "250", "2.0.0", "%s: delivered", name);
@@ -533,10 +538,285 @@ dot_deliver (void *item, void *cbdata)
 		    name);
       break;
     }
+}
+
+static int
+dot_deliver (void *item, void *cbdata)
+{
+  char *name = item;
+  mu_stream_t iostr = cbdata;
+  char *errp = NULL;
+  int status;
+  
+  status = mda_deliver_to_user (mesg, name, &errp);
+  delivery_reply (iostr, name, status, errp);
   free (errp);
   return 0;
 }
 
+/* Parallel delivery.
+
+   When delivery-workers is greater than 1, the message is spooled to
+   a named temporary file and each recipient is served by a separate
+   worker process, at most delivery_workers of them running at a time.
+   Each worker opens the spool file on its own (so that the workers
+   don't share the file offset), delivers the message (switching to
+   the recipient's privileges as usual) and exits with the delivery
+   status.  The error message, if any, is passed back over a pipe.
+   Once all workers have finished, the replies are sent in the order
+   of RCPT commands, as required by RFC 2033. */
+
+/* Maximum length of the error message passed back by a worker */
+#define WORKER_ERRMAX 1024
+
+struct delivery_worker
+{
+  pid_t pid;           /* Worker PID, 0 if not running */
+  int fd;              /* Read end of the error message pipe */
+  int status;          /* Delivery status */
+  char *errp;          /* Error message */
+};
+
+static void
+worker_main (char const *tempname, char *name, int fd)
+{
+  mu_stream_t str;
+  mu_message_t msg;
+  char *errp = NULL;
+  int rc;
+
+  rc = mu_file_stream_create (&str, tempname, MU_STREAM_READ);
+  if (rc)
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "mu_file_stream_create", tempname, rc);
+      rc = EX_TEMPFAIL;
+    }
+  else
+    {
+      rc = mu_stream_to_message (str, &msg);
+      mu_stream_unref (str);
+      if (rc)
+	{
+	  mda_error (_("error creating temporary message: %s"),
+		     mu_strerror (rc));
+	  rc = EX_TEMPFAIL;
+	}
+      else
+	{
+	  rc = mda_deliver_to_user (msg, name, &errp);
+	  mu_message_destroy (&msg, mu_message_get_owner (msg));
+	}
+    }
+
+  mu_mailer_cache_flush ();
+  
+  if (errp)
+    {
+      char const *p = errp;
+      size_t len = strlen (errp);
+      if (len > WORKER_ERRMAX)
+	len = WORKER_ERRMAX;
+      while (len > 0)
+	{
+	  ssize_t n = write (fd, p, len);
+	  if (n < 0)
+	    {
+	      if (errno == EINTR)
+		continue;
+	      mu_diag_funcall (MU_DIAG_ERROR, "write", NULL, errno);
+	      break;
+	    }
+	  p += n;
+	  len -= n;
+	}
+    }
+  close (fd);
+  mu_stream_flush (mu_strerr);
+  _exit (rc);
+}
+
+/* Start a worker delivering to NAME.  Return 0 on success. */
+static int
+worker_start (struct delivery_worker *wp, char const *tempname, char *name)
+{
+  int p[2];
+  pid_t pid;
+
+  if (pipe (p))
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "pipe", NULL, errno);
+      return -1;
+    }
+  pid = fork ();
+  if (pid == -1)
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "fork", NULL, errno);
+      close (p[0]);
+      close (p[1]);
+      return -1;
+    }
+  if (pid == 0)
+    {
+      close (p[0]);
+      worker_main (tempname, name, p[1]);
+    }
+  close (p[1]);
+  wp->pid = pid;
+  wp->fd = p[0];
+  return 0;
+}
+
+static void
+worker_finish (struct delivery_worker *wp, int status)
+{
+  char buf[WORKER_ERRMAX + 1];
+  size_t len = 0;
+  ssize_t n;
+
+  while (len < WORKER_ERRMAX
+	 && ((n = read (wp->fd, buf + len, WORKER_ERRMAX - len)) > 0
+	     || (n == -1 && errno == EINTR)))
+    if (n > 0)
+      len += n;
+  close (wp->fd);
+  if (len)
+    {
+      buf[len] = 0;
+      wp->errp = strdup (buf);
+    }
+  wp->status = status;
+  wp->pid = 0;
+}
+
+/* Wait for any of the running workers to terminate.  Return the number
+   of workers reaped. */
+static size_t
+worker_reap (struct delivery_worker *wtab, size_t count)
+{
+  pid_t pid;
+  int status;
+  size_t i, n;
+
+  pid = waitpid ((pid_t)-1, &status, 0);
+  if (pid == -1)
+    {
+      if (errno == EINTR)
+	return 0;
+      mu_diag_funcall (MU_DIAG_ERROR, "waitpid", NULL, errno);
+      /* Should not happen: give up on all running workers. */
+      for (i = n = 0; i < count; i++)
+	if (wtab[i].pid)
+	  {
+	    worker_finish (&wtab[i], EX_TEMPFAIL);
+	    n++;
+	  }
+      return n;
+    }
+
+  for (i = 0; i < count; i++)
+    if (wtab[i].pid == pid)
+      {
+	if (WIFEXITED (status))
+	  worker_finish (&wtab[i], WEXITSTATUS (status));
+	else
+	  {
+	    if (WIFSIGNALED (status))
+	      mu_error (_("delivery worker %lu terminated on signal %d"),
+			(unsigned long) pid, WTERMSIG (status));
+	    worker_finish (&wtab[i], EX_TEMPFAIL);
+	  }
+	return 1;
+      }
+  return 0;
+}
+
+static int
+deliver_parallel (mu_stream_t iostr, char const *tempname)
+{
+  struct delivery_worker *wtab;
+  size_t count, i, running = 0;
+  mu_iterator_t itr;
+  int rc;
+
+  rc = mu_list_count (rcpt_list, &count);
+  if (rc)
+    return rc;
+  wtab = calloc (count, sizeof (wtab[0]));
+  if (!wtab)
+    return ENOMEM;
+  rc = mu_list_get_iterator (rcpt_list, &itr);
+  if (rc)
+    {
+      free (wtab);
+      return rc;
+    }
+
+  for (mu_iterator_first (itr), i = 0; !mu_iterator_is_done (itr);
+       mu_iterator_next (itr), i++)
+    {
+      char *name;
+
+      mu_iterator_current (itr, (void **) &name);
+      while (running >= delivery_workers)
+	running -= worker_reap (wtab, count);
+      if (worker_start (&wtab[i], tempname, name) == 0)
+	running++;
+      else
+	/* Fall back to delivering in this process. */
+	wtab[i].status = mda_deliver_to_user (mesg, name, &wtab[i].errp);
+    }
+
+  while (running > 0)
+    running -= worker_reap (wtab, count);
+
+  for (mu_iterator_first (itr), i = 0; !mu_iterator_is_done (itr);
+       mu_iterator_next (itr), i++)
+    {
+      char *name;
+
+      mu_iterator_current (itr, (void **) &name);
+      delivery_reply (iostr, name, wtab[i].status, wtab[i].errp);
+      free (wtab[i].errp);
+    }
+  mu_iterator_destroy (&itr);
+  free (wtab);
+  return 0;
+}
+
+/* Create a stream for spooling the incoming message.  If parallel
+   delivery is to be used, the stream is backed by a named temporary
+   file, whose name is returned in *PNAME. */
+static int
+spool_stream_create (mu_stream_t *pstr, char **pname)
+{
+  size_t count = 0;
+  int fd;
+  int rc;
+
+  *pname = NULL;
+  mu_list_count (rcpt_list, &count);
+  if (delivery_workers < 2 || count < 2)
+    return mu_temp_stream_create (pstr, 0);
+
+  rc = mu_tempfile (NULL, 0, &fd, pname);
+  if (rc)
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "mu_tempfile", NULL, rc);
+      return mu_temp_stream_create (pstr, 0);
+    }
+  rc = mu_fd_stream_create (pstr, *pname, fd,
+			    MU_STREAM_RDWR | MU_STREAM_SEEK);
+  if (rc)
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "mu_fd_stream_create", *pname, rc);
+      unlink (*pname);
+      free (*pname);
+      *pname = NULL;
+      close (fd);
+    }
+  return rc;
+}
+
 static int
 cfun_data (mu_stream_t iostr, char *arg)
 {
@@ -545,6 +825,7 @@ cfun_data (mu_stream_t iostr, char *arg)
   time_t t;
   struct tm *tm;
   int xlev = MU_XSCRIPT_PAYLOAD, xlev_switch = 0;
+  char *tempname;
   
   if (*arg)
     {
@@ -562,7 +843,7 @@ cfun_data (mu_stream_t iostr, char *arg)
       return 1;
     }
 
-  rc = mu_temp_stream_create (&tempstr, 0);
+  rc = spool_stream_create (&tempstr, &tempname);
   if (rc)
     {
       mda_error (_("unable to open temporary stream: %s"), mu_strerror (rc));
@@ -600,6 +881,18 @@ cfun_data (mu_stream_t iostr, char *arg)
       mu_list_foreach (rcpt_list, dot_temp_fail, iostr);
     }
 
+  if (tempname)
+    {
+      rc = mu_stream_flush (tempstr);
+      if (rc)
+	{
+	  mda_error (_("copy error: %s"), mu_strerror (rc));
+	  unlink (tempname);
+	  free (tempname);
+	  tempname = NULL;
+	}
+    }
+
   rc = mu_stream_to_message (tempstr, &mesg);
   mu_stream_unref (tempstr);
   if (rc)
@@ -609,7 +902,14 @@ cfun_data (mu_stream_t iostr, char *arg)
       mu_list_foreach (rcpt_list, dot_temp_fail, iostr);
     }
   
-  rc = mu_list_foreach (rcpt_list, dot_deliver, iostr);
+  if (tempname)
+    {
+      rc = deliver_parallel (iostr, tempname);
+      unlink (tempname);
+      free (tempname);
+    }
+  else
+    rc = mu_list_foreach (rcpt_list, dot_deliver, iostr);
 
   mu_message_destroy (&mesg, mu_message_get_owner (mesg));
   if (rc)
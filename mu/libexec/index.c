@@ -0,0 +1,181 @@
+/* GNU Mailutils -- a suite of utilities for electronic mail
+   Copyright (C) 2022 Free Software Foundation, Inc.
+
+   GNU Mailutils is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   GNU Mailutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Mailutils.  If not, see <http://www.gnu.org/licenses/>. */
+
+#if defined(HAVE_CONFIG_H)
+# include <config.h>
+#endif
+#include <mailutils/mailutils.h>
+#include <sysexits.h>
+#include "mu.h"
+#include "muaux.h"
+
+char index_docstring[] = N_("build or verify full-text indexes of mailboxes");
+char index_args_doc[] = N_("[MAILBOX...]");
+
+static int rebuild_option;
+static int compact_option;
+static int verify_option;
+static int stat_option;
+
+static struct mu_option index_options[] = {
+  { "rebuild", 'r', NULL, MU_OPTION_DEFAULT,
+    N_("discard the existing index and build it anew"),
+    mu_c_bool, &rebuild_option },
+  { "compact", 'c', NULL, MU_OPTION_DEFAULT,
+    N_("rewrite the index, removing the data of deleted messages"),
+    mu_c_bool, &compact_option },
+  { "verify", 'V', NULL, MU_OPTION_DEFAULT,
+    N_("verify the index against the mailbox, without modifying it"),
+    mu_c_bool, &verify_option },
+  { "stat", 's', NULL, MU_OPTION_DEFAULT,
+    N_("display index statistics, without modifying it"),
+    mu_c_bool, &stat_option },
+  MU_OPTION_END
+};
+
+static void
+print_stat (char const *name, txtidx_t idx, struct txtidx_stat *st)
+{
+  mu_printf ("%s: %s\n", _("mailbox"), name);
+  mu_printf ("%s: %s\n", _("index"), txtidx_file (idx));
+  mu_printf ("%s: %zu\n", _("size"), st->size);
+  mu_printf ("%s: %zu\n", _("segments"), st->segments);
+  mu_printf ("%s: %zu\n", _("trigrams"), st->trigrams);
+  mu_printf ("%s: %zu\n", _("indexed messages"), st->indexed);
+  mu_printf ("%s: %zu\n", _("deleted messages"), st->stale);
+  mu_printf ("%s: %zu\n", _("unindexed messages"), st->unindexed);
+}
+
+static int
+index_mailbox (char const *name)
+{
+  mu_mailbox_t mbox;
+  txtidx_t idx;
+  struct txtidx_stat st;
+  int readonly = verify_option || stat_option;
+  int rc;
+  int status = EX_OK;
+
+  rc = mu_mailbox_create_default (&mbox, name);
+  if (rc)
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "mu_mailbox_create_default", name, rc);
+      return EX_UNAVAILABLE;
+    }
+
+  /* Open the mailbox for writing when updating the index, so that its
+     UIDVALIDITY is saved if it has not been assigned yet. */
+  rc = mu_mailbox_open (mbox, readonly ? MU_STREAM_READ : MU_STREAM_RDWR);
+  if (rc)
+    {
+      mu_diag_funcall (MU_DIAG_ERROR, "mu_mailbox_open", name, rc);
+      mu_mailbox_destroy (&mbox);
+      return EX_UNAVAILABLE;
+    }
+
+  if (!name)
+    {
+      mu_url_t url;
+      mu_mailbox_get_url (mbox, &url);
+      name = mu_url_to_string (url);
+    }
+
+  rc = txtidx_open (mbox, readonly ? 0 : TXTIDX_CREATE, &idx);
+  if (rc)
+    {
+      if (rc == ENOSYS)
+	mu_error (_("%s: mailbox cannot be indexed"), name);
+      else
+	mu_diag_funcall (MU_DIAG_ERROR, "txtidx_open", name, rc);
+      status = EX_UNAVAILABLE;
+    }
+  else
+    {
+      if (verify_option)
+	{
+	  rc = txtidx_verify (idx, mbox, 1, &st);
+	  if (rc)
+	    mu_diag_funcall (MU_DIAG_ERROR, "txtidx_verify", name, rc);
+	  else if (st.errors)
+	    {
+	      mu_error (_("%s: %zu errors found"), txtidx_file (idx),
+			st.errors);
+	      status = EX_DATAERR;
+	    }
+	}
+      else if (stat_option)
+	rc = txtidx_stat (idx, mbox, &st);
+      else
+	{
+	  if (rebuild_option)
+	    {
+	      rc = txtidx_clear (idx);
+	      if (rc)
+		mu_diag_funcall (MU_DIAG_ERROR, "txtidx_clear", name, rc);
+	    }
+	  if (rc == 0)
+	    {
+	      rc = txtidx_update (idx, mbox);
+	      if (rc)
+		mu_diag_funcall (MU_DIAG_ERROR, "txtidx_update", name, rc);
+	    }
+	  if (rc == 0 && compact_option)
+	    {
+	      rc = txtidx_compact (idx, mbox);
+	      if (rc)
+		mu_diag_funcall (MU_DIAG_ERROR, "txtidx_compact", name, rc);
+	    }
+	}
+
+      if (rc)
+	status = EX_UNAVAILABLE;
+      else if (stat_option || verify_option)
+	print_stat (name, idx, &st);
+      txtidx_close (&idx);
+    }
+
+  mu_mailbox_close (mbox);
+  mu_mailbox_destroy (&mbox);
+  return status;
+}
+
+int
+main (int argc, char **argv)
+{
+  int i;
+  int status = EX_OK;
+
+  mu_register_all_mbox_formats ();
+
+  mu_action_getopt (&argc, &argv, index_options, index_docstring,
+		    index_args_doc);
+  if (verify_option + stat_option + (rebuild_option || compact_option) > 1)
+    {
+      mu_error (_("conflicting options"));
+      return EX_USAGE;
+    }
+
+  if (argc == 0)
+    status = index_mailbox (NULL);
+  else
+    for (i = 0; i < argc; i++)
+      {
+	int rc = index_mailbox (argv[i]);
+	if (rc != EX_OK)
+	  status = rc;
+      }
+  return status;
+}
@@ -123,6 +123,8 @@ pop3d_abquit (int reason)
       break;
     }
 
+  /* Output is buffered: make sure the final response gets sent */
+  mu_stream_flush (iostream);
   closelog ();
   exit (code);
 }
@@ -185,7 +187,10 @@ pop3d_setio (int ifd, int ofd, struct mu_tls_config *tls_conf)
   
       if (mu_stdio_stream_create (&ostream, ofd, MU_STREAM_WRITE))
 	pop3d_abquit (ERR_FILE);
-      mu_stream_set_buffer (ostream, mu_buffer_line, 0);
+      /* Responses are accumulated in the output buffer and sent out
+	 when the client has no more commands in transit (see
+	 pop3d_mainloop).  This allows for pipelining (RFC 2449). */
+      mu_stream_set_buffer (ostream, mu_buffer_full, pop3d_output_bufsize);
   
       /* Combine the two streams into an I/O one. */
       if (mu_iostream_create (&str, istream, ostream))
@@ -260,6 +265,18 @@ pop3d_flush_output ()
   mu_stream_flush (iostream);
 }
 
+/* Return true if more input from the client is available without
+   blocking. */
+int
+pop3d_input_pending ()
+{
+  int flags = MU_STREAM_READY_RD;
+  struct timeval tv = { 0, 0 };
+
+  return mu_stream_wait (iostream, &flags, &tv) == 0
+         && (flags & MU_STREAM_READY_RD);
+}
+
 int
 pop3d_is_master ()
 {
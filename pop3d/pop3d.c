@@ -361,8 +361,11 @@ pop3d_mainloop (int ifd, int ofd, struct pop3d_srv_config *cfg)
       char *buf;
       char *arg, *cmd;
       pop3d_command_handler_t handler;
-      
-      pop3d_flush_output ();
+
+      /* If the client has pipelined more commands, process them before
+	 sending the accumulated responses. */
+      if (!pop3d_input_pending ())
+	pop3d_flush_output ();
       status = OK;
       buf = pop3d_readline (buffer, sizeof (buffer));
       pop3d_parse_command (buf, &cmd, &arg);
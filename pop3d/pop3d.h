@@ -299,6 +299,7 @@ extern void pop3d_outf          (const char *fmt, ...) MU_PRINTFLIKE(1,2);
 extern void pop3d_setio         (int, int, struct mu_tls_config *);
 extern char *pop3d_readline     (char *, size_t);
 extern void pop3d_flush_output  (void);
+extern int pop3d_input_pending  (void);
 
 extern int pop3d_is_master      (void);
 
@@ -24,15 +24,22 @@ pop3d_send_payload (mu_stream_t stream, mu_stream_t linestr, size_t maxlines)
   mu_stream_t flt;
   struct mu_buffer_query oldbuf, newbuf;
   int xscript_level = set_xscript_level (MU_XSCRIPT_PAYLOAD);
+  int setbuf;
 
+  /* Unless the output is already fully buffered (see pop3d_setio),
+     switch to full buffering for the duration of the transfer. */
   oldbuf.type = MU_TRANSPORT_OUTPUT;
-  mu_stream_ioctl (iostream, MU_IOCTL_TRANSPORT_BUFFER, MU_IOCTL_OP_GET,
-		   &oldbuf);
-  newbuf.type = MU_TRANSPORT_OUTPUT;
-  newbuf.buftype = mu_buffer_full;
-  newbuf.bufsize = pop3d_output_bufsize;
-  mu_stream_ioctl (iostream, MU_IOCTL_TRANSPORT_BUFFER, MU_IOCTL_OP_SET,
-		   &newbuf);
+  setbuf = mu_stream_ioctl (iostream, MU_IOCTL_TRANSPORT_BUFFER,
+			    MU_IOCTL_OP_GET, &oldbuf) != 0
+           || oldbuf.buftype != mu_buffer_full;
+  if (setbuf)
+    {
+      newbuf.type = MU_TRANSPORT_OUTPUT;
+      newbuf.buftype = mu_buffer_full;
+      newbuf.bufsize = pop3d_output_bufsize;
+      mu_stream_ioctl (iostream, MU_IOCTL_TRANSPORT_BUFFER, MU_IOCTL_OP_SET,
+		       &newbuf);
+    }
   /* FIXME: Return code */
   mu_filter_create (&flt, iostream, "DOT", MU_FILTER_ENCODE,
 		    MU_STREAM_WRITE);
@@ -55,8 +62,9 @@ pop3d_send_payload (mu_stream_t stream, mu_stream_t linestr, size_t maxlines)
   mu_stream_close (flt);
   mu_stream_destroy (&flt);
   
-  mu_stream_ioctl (iostream, MU_IOCTL_TRANSPORT_BUFFER, MU_IOCTL_OP_SET,
-		   &oldbuf);
+  if (setbuf)
+    mu_stream_ioctl (iostream, MU_IOCTL_TRANSPORT_BUFFER, MU_IOCTL_OP_SET,
+		     &oldbuf);
   set_xscript_level (xscript_level);
 }
 
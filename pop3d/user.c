@@ -84,7 +84,8 @@ pop3d_user (char *arg, struct pop3d_session *sess)
     return ERR_BAD_ARGS;
 
   pop3d_outf ("+OK\n");
-  pop3d_flush_output ();
+  if (!pop3d_input_pending ())
+    pop3d_flush_output ();
 
   xscript_level = set_xscript_level (MU_XSCRIPT_SECURE);
   buf = pop3d_readline (buffer, sizeof (buffer));
@@ -0,0 +1,155 @@
+/* GNU Mailutils -- a suite of utilities for electronic mail
+   Copyright (C) 2022 Free Software Foundation, Inc.
+
+   GNU Mailutils is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3, or (at your option)
+   any later version.
+
+   GNU Mailutils is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GNU Mailutils.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Test the cache of compiled Sieve programs.
+
+   Usage: svcache [CACHE-SIZE]
+
+   Reads commands from the standard input, one per line:
+
+     compile FILE   Compile FILE with mu_sieve_compile_cached.  Unless
+                    a "new" command preceded it, the program is compiled
+                    into the machine used by the previous command.
+     new            Use a new machine for the next compilation.
+     run            Run the compiled program on a test message, in
+                    dry-run mode, printing the actions it takes.
+     system CMD     Run the shell command CMD.
+
+   Cache hits and misses are reported on the standard error via the
+   Sieve debug category.  The standard output is flushed after each
+   command, so that both can be merged. */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <mailutils/mailutils.h>
+#include <mailutils/sieve.h>
+
+static char message_text[] =
+  "From: alice@wonder.land\n"
+  "To: hare@wonder.land\n"
+  "Subject: Invitation\n"
+  "\n"
+  "Have some wine\n";
+
+static mu_message_t message;
+
+static void
+action_log (mu_sieve_machine_t mach, const char *action, const char *fmt,
+	    va_list ap)
+{
+  mu_printf ("%s", action);
+  if (fmt && fmt[0])
+    {
+      mu_printf (": ");
+      mu_stream_vprintf (mu_strout, fmt, ap);
+    }
+  mu_printf ("\n");
+}
+
+static mu_sieve_machine_t
+machine_create (void)
+{
+  mu_sieve_machine_t mach;
+
+  MU_ASSERT (mu_sieve_machine_create (&mach));
+  mu_sieve_set_logger (mach, action_log);
+  mu_sieve_set_dry_run (mach, 1);
+  return mach;
+}
+
+int
+main (int argc, char **argv)
+{
+  mu_sieve_machine_t mach = NULL;
+  mu_stream_t str;
+  char *buf = NULL;
+  size_t size = 0, n;
+  int rc;
+
+  mu_set_program_name (argv[0]);
+  mu_registrar_record (mu_mbox_record);
+  mu_sieve_debug_init ();
+
+  if (argc > 2)
+    {
+      mu_error ("usage: %s [CACHE-SIZE]", mu_program_name);
+      return 2;
+    }
+  if (argc == 2)
+    mu_sieve_cache_size = strtoul (argv[1], NULL, 10);
+
+  /* Report cache hits and misses */
+  mu_debug_set_category_level (mu_sieve_debug_handle,
+			       MU_DEBUG_LEVEL_MASK (MU_DEBUG_TRACE1));
+
+  MU_ASSERT (mu_static_memory_stream_create (&str, message_text,
+					     sizeof (message_text) - 1));
+  MU_ASSERT (mu_stream_to_message (str, &message));
+
+  while ((rc = mu_stream_getline (mu_strin, &buf, &size, &n)) == 0 && n > 0)
+    {
+      char *cmd, *arg;
+
+      mu_rtrim_class (buf, MU_CTYPE_ENDLN);
+      cmd = buf;
+      arg = strchr (buf, ' ');
+      if (arg)
+	*arg++ = 0;
+
+      if (strcmp (cmd, "compile") == 0 && arg)
+	{
+	  if (!mach)
+	    mach = machine_create ();
+	  mu_printf ("compile %s\n", arg);
+	  mu_stream_flush (mu_strout);
+	  rc = mu_sieve_compile_cached (mach, arg);
+	  if (rc)
+	    mu_printf ("compile: %s\n", mu_strerror (rc));
+	}
+      else if (strcmp (cmd, "new") == 0)
+	{
+	  if (mach)
+	    mu_sieve_machine_destroy (&mach);
+	}
+      else if (strcmp (cmd, "run") == 0 && mach)
+	{
+	  rc = mu_sieve_message (mach, message);
+	  if (rc)
+	    mu_printf ("run: %s\n", mu_strerror (rc));
+	}
+      else if (strcmp (cmd, "system") == 0 && arg)
+	{
+	  rc = system (arg);
+	  if (rc)
+	    mu_printf ("system: exit status %d\n", rc);
+	}
+      else
+	{
+	  mu_error ("bad command: %s", cmd);
+	  return 2;
+	}
+      mu_stream_flush (mu_strout);
+    }
+  if (mach)
+    mu_sieve_machine_destroy (&mach);
+  mu_message_destroy (&message, NULL);
+  mu_sieve_cache_flush ();
+  return 0;
+}
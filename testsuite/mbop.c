@@ -14,6 +14,8 @@
    You should have received a copy of the GNU Lesser General Public License
    along with GNU Mailutils.  If not, see <http://www.gnu.org/licenses/>. */
 
+#include <stdlib.h>
+#include <sys/wait.h>
 #include <mailutils/mailutils.h>
 #include <mailutils/sys/envelope.h>
 #include "tesh.h"
@@ -221,6 +223,17 @@ mbop_uid (int argc, char **argv, mu_assoc_t options, void *env)
   return 0;
 }
 
+int
+mbop_uidl (int argc, char **argv, mu_assoc_t options, void *env)
+{
+  struct interp_env *ienv = env;
+  char buf[MU_UIDL_BUFFER_SIZE];
+
+  MU_ASSERT (mu_message_get_uidl (ienv->msg, buf, sizeof (buf), NULL));
+  mu_printf ("%s", buf);
+  return 0;
+}
+
 int
 mbop_message_lines (int argc, char **argv, mu_assoc_t options, void *env)
 {
@@ -406,6 +419,17 @@ mbop_unseen (int argc, char **argv, mu_assoc_t options, void *env)
   return 0;
 }
 
+int
+mbop_mailbox_size (int argc, char **argv, mu_assoc_t options, void *env)
+{
+  struct interp_env *ienv = env;
+  mu_off_t size;
+
+  MU_ASSERT (mu_mailbox_get_size (ienv->mbx, &size));
+  mu_printf ("%lu", (unsigned long) size);
+  return 0;
+}
+
 static char const *mbox_actions[] = {
   "expunge",
   "sync",
@@ -417,6 +441,8 @@ static char const *mbox_actions[] = {
   "recent",
   "unseen",
   "qget",
+  "mailbox_size",
+  "system",
   NULL
 };
 
@@ -498,6 +524,26 @@ mbop_uidvalidity_reset (int argc, char **argv, mu_assoc_t options, void *data)
   return 0;
 }
 
+/* Run a shell command.  This is used to modify the mailbox behind the
+   back of the driver. */
+int
+mbop_system (int argc, char **argv, mu_assoc_t options, void *data)
+{
+  char *cmd;
+  int rc;
+  
+  MU_ASSERT (mu_argcv_join (argc - 1, argv + 1, " ", mu_argcv_escape_no,
+			    &cmd));
+  rc = system (cmd);
+  free (cmd);
+  if (rc == -1 || !WIFEXITED (rc) || WEXITSTATUS (rc) != 0)
+    {
+      mu_error ("command failed");
+      exit (1);
+    }
+  mu_printf ("OK");
+  return 0;
+}
 
 struct mu_tesh_command commands[] = {
   { "__ENVINIT__",    "", mbop_envinit  },
@@ -516,6 +562,7 @@ struct mu_tesh_command commands[] = {
   { "body_text",      "", mbop_body_text      },
   { "attr",           "", mbop_attr           },
   { "uid",            "", mbop_uid            },
+  { "uidl",           "", mbop_uidl           },
   { "set_seen",       "", mbop_set_seen       },
   { "set_answered",   "", mbop_set_answered   },
   { "set_flagged",    "", mbop_set_flagged    },
@@ -542,6 +589,8 @@ struct mu_tesh_command commands[] = {
   { "qget",           "QID", mbop_qget },
   { "message_lines",  "", mbop_message_lines },
   { "message_size",  "", mbop_message_size },
+  { "mailbox_size",  "", mbop_mailbox_size },
+  { "system",         "COMMAND...", mbop_system },
   { NULL }
 };
 
@@ -587,6 +636,15 @@ test_notify (mu_observer_t obs, size_t type, void *data, void *action_data)
 }
 
 
+static int
+test_notify_new (mu_observer_t obs, size_t type, void *data, void *action_data)
+{
+  size_t *range = data;
+  mu_stream_printf (mu_strerr, "new messages: %lu-%lu\n",
+		    (unsigned long) range[0], (unsigned long) range[1]);
+  return 0;
+}
+
 int
 main (int argc, char **argv)
 {
@@ -681,6 +739,11 @@ main (int argc, char **argv)
       mu_mailbox_get_observable (env.mbx, &observable);
       mu_observable_attach (observable, MU_EVT_MAILBOX_MESSAGE_APPEND, 
 			    observer);
+
+      mu_observer_create (&observer, &env);
+      mu_observer_set_action (observer, test_notify_new, &env);
+      mu_observable_attach (observable, MU_EVT_MAILBOX_NEW_MESSAGES,
+			    observer);
     }
   
   mu_tesh_read_and_eval (argc, argv, commands, &env);
@@ -3,7 +3,7 @@
     mockmta - mock MTA server for use in test suites
 
   SYNOPSIS
-    mockmta [-ad] [-c CERT] [-f CA] [-k KEY] [-p PORT] [-t SEC] [DUMPFILE]
+    mockmta [-abd] [-c CERT] [-f CA] [-k KEY] [-p PORT] [-t SEC] [DUMPFILE]
 
   DESCRIPTION
     Starts a mock MTA, which behaves almost identically to the real one,
@@ -41,6 +41,9 @@
     To enable the STARTTLS ESMTP command, supply the names of the certificate
     (-c CERT) and certificate key (-k KEY) files.
 
+    The CHUNKING extension (the BDAT command, RFC 3030) is enabled by the
+    -b option.
+
     Output summary
 
     Depending on the command line options given, mockmta can output port
@@ -67,6 +70,7 @@
        
   OPTIONS
     -a        Append to DUMPFILE instead of overwriting it.
+    -b        Advertise and support the CHUNKING extension.
     -c CERT   Name of the certificate file.
     -d        Daemon mode
     -f CA     Name of certificate authority file.
@@ -102,6 +106,9 @@
     This line is followed by <N> bytes representing the material received
     after the DATA SMTP keyword.
 
+    For messages received with BDAT, LENGTH is the total length of the
+    chunks, with CRLF changed to LF.  There is no dot terminator.
+
     Message dump is terminated by a single LF character.
 	      
   EXIT CODES
@@ -148,6 +155,7 @@
 char *progname;
 int daemon_opt;
 int daemon_timeout = 60;
+int chunking_opt;
 int port;
 int msgid = 1;
 
@@ -371,8 +379,6 @@ iobase_eof (struct iobase *bp)
   return bp->iob_eof && iobase_data_bytes (bp) == 0;
 }
 
-#if 0
-/* Not actually used.  Provided for completeness sake. */
 static ssize_t
 iobase_read (struct iobase *bp, char *buf, size_t size)
 {
@@ -402,7 +408,6 @@ iobase_read (struct iobase *bp, char *buf, size_t size)
     return -1;
   return len;
 }
-#endif
 
 static ssize_t
 iobase_readln (struct iobase *bp, char *buf, size_t size)
@@ -877,6 +882,7 @@ enum smtp_state
     STATE_MAIL,
     STATE_RCPT,
     STATE_DATA,
+    STATE_BDAT,
     STATE_QUIT,
     MAX_STATE
   };
@@ -989,6 +995,7 @@ enum smtp_keyword
     KW_DATA,
     KW_STARTTLS,
     KW_QUIT,
+    KW_BDAT,
     MAX_KW
   };
 
@@ -1001,7 +1008,8 @@ static char *smtp_keyword_trans[MAX_KW] = {
   [KW_RCPT] = "RCPT",
   [KW_DATA] = "DATA",
   [KW_STARTTLS] = "STARTTLS",
-  [KW_QUIT] = "QUIT"
+  [KW_QUIT] = "QUIT",
+  [KW_BDAT] = "BDAT"
 };
 
 static int
@@ -1031,7 +1039,8 @@ smtp_rset (struct smtp *smtp)
     }
   smtp_io_send (smtp->iob, 250, "Reset state");
 
-  smtp_reset (smtp, STATE_INIT);
+  /* RFC 5321, 4.1.1.5: RSET does not affect the EHLO state */
+  smtp_reset (smtp, STATE_MAIL);
 
   return 0;
 }
@@ -1041,13 +1050,15 @@ enum
     CAPA_PIPELINING,
     CAPA_STARTTLS,
     CAPA_HELP,
+    CAPA_CHUNKING,
     MAX_CAPA
   };
 
 static char const *capa_str[] = {
   "PIPELINING",
   "STARTTLS",
-  "HELP"
+  "HELP",
+  "CHUNKING"
 };
 
 #define CAPA_MASK(n) (1<<(n))
@@ -1204,9 +1215,8 @@ smtp_rcpt (struct smtp *smtp)
 }
 
 static void
-smtp_data_save (struct smtp *smtp)
+smtp_data_append (struct smtp *smtp, char const *buf, size_t len)
 {
-  size_t len = strlen (smtp->buf);
   while (smtp->data_len + len > smtp->data_size)
     {
       char *p;
@@ -1227,24 +1237,37 @@ smtp_data_save (struct smtp *smtp)
       smtp->data_buf = p;
       smtp->data_size = n;
     }
-  memcpy (smtp->data_buf + smtp->data_len, smtp->buf, len);
+  memcpy (smtp->data_buf + smtp->data_len, buf, len);
   smtp->data_len += len;
 }
 
-static int
-smtp_data (struct smtp *smtp)
+static void
+smtp_data_save (struct smtp *smtp)
+{
+  smtp_data_append (smtp, smtp->buf, strlen (smtp->buf));
+}
+
+static void
+smtp_log_envelope (struct smtp *smtp)
 {
-  ssize_t n;
   int i;
   
-  smtp_io_send (smtp->iob, 354,
-		"Enter mail, end with \".\" on a line by itself");
   fprintf (logfile, "MSGID: %04d\n", msgid);
   fprintf (logfile, "DOMAIN: %s\n", smtp->helo);
   fprintf (logfile, "SENDER: %s\n", smtp->sender);
   fprintf (logfile, "NRCPT: %d\n", smtp->nrcpt);
   for (i = 0; i < smtp->nrcpt; i++)
     fprintf (logfile, "RCPT[%d]: %s\n", i, smtp->rcpt[i]);
+}
+
+static int
+smtp_data (struct smtp *smtp)
+{
+  ssize_t n;
+  
+  smtp_io_send (smtp->iob, 354,
+		"Enter mail, end with \".\" on a line by itself");
+  smtp_log_envelope (smtp);
   
   while (1)
     {
@@ -1282,6 +1305,92 @@ smtp_data (struct smtp *smtp)
   return 0;
 }
 
+/* Return the iobase to read raw data from.  Reading from io2 would
+   alter line endings. */
+static struct iobase *
+smtp_raw_input (struct smtp *smtp)
+{
+  if (smtp->iob->iob_drv == &io2_drv)
+    return ((struct io2 *) smtp->iob)->iob[IO2_RD];
+  return smtp->iob;
+}
+
+static int
+smtp_bdat (struct smtp *smtp)
+{
+  char *p;
+  unsigned long size;
+  int last = 0;
+  size_t i, j;
+  
+  if (smtp->capa_mask & CAPA_MASK (CAPA_CHUNKING))
+    {
+      smtp_io_send (smtp->iob, 500, "Command unrecognized");
+      return -1;
+    }
+  if (!smtp->arg)
+    {
+      smtp_io_send (smtp->iob, 501, "bdat requires chunk size");
+      return -1;
+    }
+  errno = 0;
+  size = strtoul (smtp->arg, &p, 10);
+  if (errno || p == smtp->arg)
+    {
+      smtp_io_send (smtp->iob, 501, "syntax error");
+      return -1;
+    }
+  while (*p == ' ' || *p == '\t')
+    p++;
+  if (strcasecmp (p, "LAST") == 0)
+    last = 1;
+  else if (*p)
+    {
+      smtp_io_send (smtp->iob, 501, "syntax error");
+      return -1;
+    }
+
+  while (size)
+    {
+      size_t n = size < sizeof (smtp->buf) ? size : sizeof (smtp->buf);
+      ssize_t rc = iobase_read (smtp_raw_input (smtp), smtp->buf, n);
+      if (rc <= 0)
+	{
+	  smtp->state = STATE_QUIT;
+	  return -1;
+	}
+      smtp_data_append (smtp, smtp->buf, rc);
+      size -= rc;
+    }
+
+  if (!last)
+    {
+      smtp_io_send (smtp->iob, 250, "Chunk accepted");
+      return 0;
+    }
+
+  /* Change CRLF to LF */
+  for (i = j = 0; i < smtp->data_len; i++)
+    {
+      if (smtp->data_buf[i] == '\r' && i + 1 < smtp->data_len
+	  && smtp->data_buf[i+1] == '\n')
+	continue;
+      smtp->data_buf[j++] = smtp->data_buf[i];
+    }
+  smtp->data_len = j;
+  
+  smtp_log_envelope (smtp);
+  fprintf (logfile, "LENGTH: %lu\n", (unsigned long)smtp->data_len);
+  fwrite (smtp->data_buf, smtp->data_len, 1, logfile);
+  fputc ('\n', logfile);
+  fflush (logfile);
+  smtp_io_send (smtp->iob, 250, "%04d Message accepted for delivery", msgid);
+  msgid++;
+  smtp_reset (smtp, STATE_DATA);
+  smtp->state = STATE_EHLO;
+  return 1;
+}
+
 
 struct smtp_transition
 {
@@ -1299,7 +1408,7 @@ static struct smtp_transition smtp_transition_table[MAX_STATE][MAX_KW] = {
   },
   [STATE_EHLO] = {
     [KW_HELP] = { STATE_EHLO, smtp_help },
-    [KW_RSET] = { STATE_INIT, smtp_rset },
+    [KW_RSET] = { STATE_EHLO, smtp_rset },
     [KW_HELO] = { STATE_EHLO, smtp_helo },
     [KW_EHLO] = { STATE_EHLO, smtp_ehlo },
     [KW_MAIL] = { STATE_MAIL, smtp_mail },
@@ -1308,7 +1417,7 @@ static struct smtp_transition smtp_transition_table[MAX_STATE][MAX_KW] = {
   },
   [STATE_MAIL] = {
     [KW_HELP] = { STATE_MAIL, smtp_help },
-    [KW_RSET] = { STATE_INIT, smtp_rset },
+    [KW_RSET] = { STATE_EHLO, smtp_rset },
     [KW_RCPT] = { STATE_RCPT, smtp_rcpt },
     [KW_HELO] = { STATE_EHLO, smtp_helo },
     [KW_EHLO] = { STATE_EHLO, smtp_ehlo },
@@ -1316,11 +1425,17 @@ static struct smtp_transition smtp_transition_table[MAX_STATE][MAX_KW] = {
   },
   [STATE_RCPT] = {
     [KW_HELP] = { STATE_RCPT, smtp_help },
-    [KW_RSET] = { STATE_INIT, smtp_rset },
+    [KW_RSET] = { STATE_EHLO, smtp_rset },
     [KW_RCPT] = { STATE_RCPT, smtp_rcpt },
     [KW_HELO] = { STATE_EHLO, smtp_helo },
     [KW_EHLO] = { STATE_EHLO, smtp_ehlo },
     [KW_DATA] = { STATE_EHLO, smtp_data },
+    [KW_BDAT] = { STATE_BDAT, smtp_bdat },
+    [KW_QUIT] = { STATE_QUIT, smtp_quit }
+  },
+  [STATE_BDAT] = {
+    [KW_RSET] = { STATE_EHLO, smtp_rset },
+    [KW_BDAT] = { STATE_BDAT, smtp_bdat },
     [KW_QUIT] = { STATE_QUIT, smtp_quit }
   },
 };  
@@ -1346,6 +1461,8 @@ do_smtp (int fd)
   smtp.capa_mask = 0;
   if (!enable_tls ())
     smtp.capa_mask |= CAPA_MASK (CAPA_STARTTLS);
+  if (!chunking_opt)
+    smtp.capa_mask |= CAPA_MASK (CAPA_CHUNKING);
   smtp.helo = NULL;
   smtp.sender = NULL;
   smtp.nrcpt = 0;
@@ -1480,13 +1597,17 @@ main (int argc, char **argv)
   
   progname = argv[0];
   
-  while ((c = getopt (argc, argv, "adc:f:k:p:t:")) != EOF)
+  while ((c = getopt (argc, argv, "abdc:f:k:p:t:")) != EOF)
     {
       switch (c)
 	{
 	case 'a':
 	  append_opt = 1;
 	  break;
+
+	case 'b':
+	  chunking_opt = 1;
+	  break;
 	  
 	case 'd':
 	  daemon_opt = 1;